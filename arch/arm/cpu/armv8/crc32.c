@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CRC-32 and CRC-32C using the ARMv8 CRC32 instructions
+ */
+
+#include <common.h>
+#include <efi_loader.h>
+#include <asm/armv8/cpu.h>
+
+/* Let the assembler accept the instructions whatever -march says */
+#define CRC_INSN(insn)	".arch_extension crc\n\t" insn
+
+/*
+ * Both take and return the CRC without the ones' complement, like
+ * crc32_no_comp() and crc32c_cal(). The data is read eight bytes at a time
+ * once aligned, since unaligned accesses fault with the MMU off.
+ */
+#define ARMV8_CRC32(name, insn)						\
+uint32_t __efi_runtime name(uint32_t crc, const uint8_t *p, size_t len)	\
+{									\
+	for (; len && ((uintptr_t)p & 7); len--, p++)			\
+		asm(CRC_INSN(insn "b %w0, %w0, %w1")			\
+		    : "+r" (crc) : "r" (*p));				\
+	for (; len >= 8; len -= 8, p += 8)				\
+		asm(CRC_INSN(insn "x %w0, %w0, %x1")			\
+		    : "+r" (crc) : "r" (*(const uint64_t *)p));		\
+	for (; len; len--, p++)						\
+		asm(CRC_INSN(insn "b %w0, %w0, %w1")			\
+		    : "+r" (crc) : "r" (*p));				\
+									\
+	return crc;							\
+}
+
+ARMV8_CRC32(armv8_crc32_le, "crc32")
+ARMV8_CRC32(armv8_crc32c_le, "crc32c")
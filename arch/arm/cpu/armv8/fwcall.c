@@ -20,7 +20,7 @@
  * x0~x7: input arguments
  * x0~x3: output arguments
  */
-static void hvc_call(struct pt_regs *args)
+void hvc_call(struct pt_regs *args)
 {
 	asm volatile(
 		"ldr x0, %0\n"
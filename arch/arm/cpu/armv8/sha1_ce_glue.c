@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 block processing using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <u-boot/sha1.h>
+#include <asm/armv8/cpu.h>
+
+void sha1_armv8_ce_process(uint32_t state[5], const unsigned char *data,
+			   unsigned int blocks);
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	uint32_t state[5];
+	int i;
+
+	if (!blocks)
+		return;
+
+	/* The Crypto Extensions are optional, e.g. on the Cortex-A53 */
+	if (!cpu_has_sha1()) {
+		sha1_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	/* The context keeps the state in unsigned longs */
+	for (i = 0; i < ARRAY_SIZE(state); i++)
+		state[i] = ctx->state[i];
+	sha1_armv8_ce_process(state, data, blocks);
+	for (i = 0; i < ARRAY_SIZE(state); i++)
+		ctx->state[i] = state[i];
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 block processing using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <u-boot/sha256.h>
+#include <asm/armv8/cpu.h>
+
+void sha256_armv8_ce_process(uint32_t state[8], const uint8_t *data,
+			     unsigned int blocks);
+
+void sha256_process(sha256_context *ctx, const uint8_t *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	/* The Crypto Extensions are optional, e.g. on the Cortex-A53 */
+	if (!cpu_has_sha2()) {
+		sha256_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha256_armv8_ce_process(ctx->state, data, blocks);
+}
@@ -0,0 +1,411 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running work-queue jobs on the secondary CPUs of an ARMv8 system
+ *
+ * Secondary CPUs are found in the /cpus node of the control device tree.
+ * Those with enable-method = "psci" are switched on through the PSCI firmware
+ * (with SMC or HVC, as its node says) to run a function and switch themselves
+ * off again afterwards. With
+ * CONFIG_ARMV8_SPIN_TABLE, those with enable-method = "spin-table" are
+ * released from U-Boot's spin table and go back to it when they are done,
+ * so that the OS can still release them in the usual way.
+ *
+ * A secondary CPU starts with its MMU and caches off. It takes on the boot
+ * CPU's translation tables and system control settings (see
+ * work_queue_entry.S), so that it has the same coherent view of memory as
+ * the boot CPU while it runs its function.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <errno.h>
+#include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <work_queue.h>
+#include <asm/armv8/work_queue.h>
+#include <asm/cache.h>
+#include <asm/psci.h>
+#include <asm/ptrace.h>
+#include <asm/spin_table.h>
+#include <asm/system.h>
+#include <linux/libfdt.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define WQ_STACK_SIZE		0x8000
+
+/* How long to wait for a CPU to come out of the spin table the first time */
+#define WQ_SPIN_TABLE_TIMEOUT_MS	100
+
+static struct wq_cpu *wq_cpus[CONFIG_WORK_QUEUE_MAX_CPUS];
+static int wq_cpu_num = -1;
+
+/* true if the PSCI firmware is called with HVC rather than SMC */
+static bool wq_psci_hvc;
+
+struct wq_cpu *wq_spin_table_cpus[CONFIG_WORK_QUEUE_MAX_CPUS];
+
+static void wq_flush(struct wq_cpu *wc)
+{
+	flush_dcache_range((ulong)wc, (ulong)wc + sizeof(*wc));
+}
+
+static bool wq_is_spin_table(struct wq_cpu *wc)
+{
+	return CONFIG_IS_ENABLED(ARMV8_SPIN_TABLE) && wc->spin_table;
+}
+
+/* Capture the boot CPU's MMU set-up for a secondary CPU to copy */
+static void wq_save_regs(struct wq_cpu *wc)
+{
+	switch (current_el()) {
+	case 3:
+		asm volatile("mrs %0, ttbr0_el3" : "=r" (wc->ttbr));
+		asm volatile("mrs %0, tcr_el3" : "=r" (wc->tcr));
+		asm volatile("mrs %0, mair_el3" : "=r" (wc->mair));
+		asm volatile("mrs %0, sctlr_el3" : "=r" (wc->sctlr));
+		asm volatile("mrs %0, vbar_el3" : "=r" (wc->vbar));
+		break;
+	case 2:
+		asm volatile("mrs %0, ttbr0_el2" : "=r" (wc->ttbr));
+		asm volatile("mrs %0, tcr_el2" : "=r" (wc->tcr));
+		asm volatile("mrs %0, mair_el2" : "=r" (wc->mair));
+		asm volatile("mrs %0, sctlr_el2" : "=r" (wc->sctlr));
+		asm volatile("mrs %0, vbar_el2" : "=r" (wc->vbar));
+		break;
+	default:
+		asm volatile("mrs %0, ttbr0_el1" : "=r" (wc->ttbr));
+		asm volatile("mrs %0, tcr_el1" : "=r" (wc->tcr));
+		asm volatile("mrs %0, mair_el1" : "=r" (wc->mair));
+		asm volatile("mrs %0, sctlr_el1" : "=r" (wc->sctlr));
+		asm volatile("mrs %0, vbar_el1" : "=r" (wc->vbar));
+		break;
+	}
+}
+
+static ulong wq_psci_call(ulong func, ulong arg0, ulong arg1, ulong arg2)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = func;
+	regs.regs[1] = arg0;
+	regs.regs[2] = arg1;
+	regs.regs[3] = arg2;
+	if (wq_psci_hvc)
+		hvc_call(&regs);
+	else
+		smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+/* PSCI CPUs can only be used if we know how to call the firmware */
+static bool wq_psci_find(const void *blob)
+{
+	static const char *const compats[] = {
+		"arm,psci-1.0",
+		"arm,psci-0.2",
+	};
+	const char *method;
+	int offset, i;
+
+	for (i = 0; i < ARRAY_SIZE(compats); i++) {
+		offset = fdt_node_offset_by_compatible(blob, -1, compats[i]);
+		if (offset >= 0)
+			break;
+	}
+	if (offset < 0)
+		return false;
+
+	method = fdt_getprop(blob, offset, "method", NULL);
+	if (!method)
+		return false;
+	if (!strcmp(method, "hvc"))
+		wq_psci_hvc = true;
+	else if (strcmp(method, "smc"))
+		return false;
+
+	return true;
+}
+
+void __noreturn wq_secondary_main(struct wq_cpu *wc)
+{
+	/* The boot CPU may have given up on this CPU before it got here */
+	if (wc->state == WQ_CPU_RUN) {
+		wc->func(wc->arg);
+
+		/* Make sure that all results are visible before saying so */
+		dsb();
+		wc->state = WQ_CPU_DONE;
+		dsb();
+		asm volatile("sev");
+	}
+
+	if (wq_is_spin_table(wc))
+		wq_spin_table_park(wc);
+
+	wq_psci_call(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+	while (1)
+		wfi();
+}
+
+static void wq_spin_table_release(void)
+{
+	spin_table_cpu_release_addr = (ulong)wq_spin_table_entry;
+	flush_dcache_range((ulong)&spin_table_cpu_release_addr,
+			   (ulong)&spin_table_cpu_release_addr + sizeof(u64));
+	asm volatile("sev");
+}
+
+/*
+ * Stop sending CPUs from the spin table to us, once none has work to do.
+ * CPUs mark themselves idle with their MMU off, so read that from memory.
+ */
+static void wq_spin_table_close(void)
+{
+	struct wq_cpu *wc;
+	int i;
+
+	for (i = 0; wq_spin_table_cpus[i]; i++) {
+		wc = wq_spin_table_cpus[i];
+		invalidate_dcache_range((ulong)wc, (ulong)wc + sizeof(*wc));
+		if (wc->state != WQ_CPU_IDLE)
+			return;
+	}
+	spin_table_cpu_release_addr = 0;
+	flush_dcache_range((ulong)&spin_table_cpu_release_addr,
+			   (ulong)&spin_table_cpu_release_addr + sizeof(u64));
+}
+
+/* Wait for a CPU from the spin table to be back there, with its MMU off */
+static int wq_spin_table_wait(struct wq_cpu *wc, ulong timeout_ms)
+{
+	ulong start = get_timer(0);
+
+	while (1) {
+		invalidate_dcache_range((ulong)wc, (ulong)wc + sizeof(*wc));
+		if (wc->state == WQ_CPU_IDLE)
+			break;
+		if (get_timer(start) > timeout_ms)
+			return -ETIMEDOUT;
+	}
+	wq_spin_table_close();
+
+	return 0;
+}
+
+/*
+ * Give up on a CPU which did not finish in time. If it has not started its
+ * function yet, it sees that it is idle and does not run it. If it is stuck
+ * part-way through, nothing can be done about it. Either way, it is not
+ * started again.
+ */
+static void wq_give_up(struct wq_cpu *wc)
+{
+	wc->stuck = true;
+	wc->state = WQ_CPU_IDLE;
+	wq_flush(wc);
+	if (wq_is_spin_table(wc))
+		wq_spin_table_close();
+}
+
+/* Set up a CPU to run a function, ready for it to be started */
+static void wq_prepare(struct wq_cpu *wc, void (*func)(void *arg), void *arg)
+{
+	wq_save_regs(wc);
+	wc->gd_copy = *gd;
+	/* Only the boot CPU looks after the watchdog */
+	wc->gd_copy.flags &= ~GD_FLG_WDT_READY;
+	wc->gd = &wc->gd_copy;
+	wc->func = func;
+	wc->arg = arg;
+	wc->state = WQ_CPU_RUN;
+	wq_flush(wc);
+}
+
+static void wq_nop(void *arg)
+{
+}
+
+/*
+ * The spin table gives no way to find out whether a CPU is actually in it,
+ * so check that the CPU comes out to run a function that does nothing. If
+ * it does not, it is never asked to run anything else.
+ */
+static int wq_spin_table_probe(struct wq_cpu *wc)
+{
+	int ret;
+
+	wq_prepare(wc, wq_nop, NULL);
+	wq_spin_table_release();
+	ret = wq_spin_table_wait(wc, WQ_SPIN_TABLE_TIMEOUT_MS);
+	if (ret) {
+		wc->state = WQ_CPU_IDLE;
+		wq_flush(wc);
+		wq_spin_table_close();
+	}
+
+	return ret;
+}
+
+static struct wq_cpu *wq_add_cpu(u64 mpidr, bool spin_table)
+{
+	struct wq_cpu *wc;
+	void *stack;
+
+	wc = memalign(ARCH_DMA_MINALIGN, ALIGN(sizeof(*wc), ARCH_DMA_MINALIGN));
+	stack = memalign(16, WQ_STACK_SIZE);
+	if (!wc || !stack) {
+		free(wc);
+		free(stack);
+		return NULL;
+	}
+	memset(wc, '\0', sizeof(*wc));
+	wc->sp = (ulong)stack + WQ_STACK_SIZE;
+	wc->mpidr = mpidr;
+	wc->spin_table = spin_table;
+
+	return wc;
+}
+
+static void wq_find_cpus(void)
+{
+	const void *blob = gd->fdt_blob;
+	int cpus_offset, offset, len;
+	const char *method;
+	const fdt32_t *reg;
+	struct wq_cpu *wc;
+	bool spin_table;
+	bool psci_ok;
+	int spin_count;
+	u64 mpidr;
+
+	wq_cpu_num = 1;
+	spin_count = 0;
+	cpus_offset = fdt_path_offset(blob, "/cpus");
+	if (cpus_offset < 0)
+		return;
+	psci_ok = current_el() != 3 && wq_psci_find(blob);
+
+	fdt_for_each_subnode(offset, blob, cpus_offset) {
+		if (wq_cpu_num == CONFIG_WORK_QUEUE_MAX_CPUS)
+			break;
+		method = fdt_getprop(blob, offset, "device_type", NULL);
+		if (!method || strcmp(method, "cpu"))
+			continue;
+		reg = fdt_getprop(blob, offset, "reg", &len);
+		if (!reg || (len != sizeof(u32) && len != sizeof(u64)))
+			continue;
+		mpidr = len == sizeof(u64) ? fdt64_to_cpu(*(fdt64_t *)reg) :
+			fdt32_to_cpu(*reg);
+		if (mpidr == (read_mpidr() & WQ_MPIDR_MASK))
+			continue;
+
+		method = fdt_getprop(blob, offset, "enable-method", NULL);
+		if (!method)
+			continue;
+		if (!strcmp(method, "psci") && psci_ok) {
+			spin_table = false;
+		} else if (CONFIG_IS_ENABLED(ARMV8_SPIN_TABLE) &&
+			   !strcmp(method, "spin-table")) {
+			spin_table = true;
+		} else {
+			continue;
+		}
+
+		wc = wq_add_cpu(mpidr, spin_table);
+		if (!wc) {
+			log_warning("Out of memory for CPU %llx\n", mpidr);
+			break;
+		}
+		if (wq_is_spin_table(wc)) {
+			/*
+			 * If the CPU does not turn up, its slot is reused and
+			 * wc is kept, in case the CPU turns up later after all
+			 */
+			wq_spin_table_cpus[spin_count] = wc;
+			flush_dcache_range((ulong)wq_spin_table_cpus,
+					   (ulong)wq_spin_table_cpus +
+					   sizeof(wq_spin_table_cpus));
+			if (wq_spin_table_probe(wc)) {
+				log_debug("CPU %llx is not in the spin table\n",
+					  mpidr);
+				continue;
+			}
+			spin_count++;
+		}
+		wq_cpus[wq_cpu_num++] = wc;
+	}
+	log_debug("%d CPUs available for jobs\n", wq_cpu_num);
+}
+
+int arch_wq_cpu_count(void)
+{
+	if (wq_cpu_num < 0)
+		wq_find_cpus();
+
+	return wq_cpu_num;
+}
+
+int arch_wq_start(int cpu, void (*func)(void *arg), void *arg)
+{
+	struct wq_cpu *wc = wq_cpus[cpu];
+	ulong ret;
+
+	if (wc->stuck)
+		return -EBUSY;
+	wq_prepare(wc, func, arg);
+	if (wq_is_spin_table(wc)) {
+		wq_spin_table_release();
+		return 0;
+	}
+
+	ret = wq_psci_call(ARM_PSCI_0_2_FN64_CPU_ON, wc->mpidr,
+			   (ulong)wq_secondary_entry, (ulong)wc);
+	if (ret != ARM_PSCI_RET_SUCCESS) {
+		wc->state = WQ_CPU_IDLE;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int arch_wq_wait(int cpu, ulong timeout_ms)
+{
+	struct wq_cpu *wc = wq_cpus[cpu];
+	ulong start, info;
+	int ret;
+
+	if (wq_is_spin_table(wc)) {
+		ret = wq_spin_table_wait(wc, timeout_ms);
+		if (ret)
+			wq_give_up(wc);
+		return ret;
+	}
+
+	/* Wait until the CPU has finished and switched itself off */
+	start = get_timer(0);
+	while (1) {
+		info = wq_psci_call(ARM_PSCI_0_2_FN64_AFFINITY_INFO,
+				    wc->mpidr, 0, 0);
+		if (info == PSCI_AFFINITY_LEVEL_OFF)
+			break;
+		if ((long)info < 0) {
+			wq_give_up(wc);
+			return -EIO;
+		}
+		if (get_timer(start) > timeout_ms) {
+			wq_give_up(wc);
+			return -ETIMEDOUT;
+		}
+	}
+
+	if (wc->state != WQ_CPU_DONE) {
+		wc->state = WQ_CPU_IDLE;
+		return -EIO;
+	}
+	wc->state = WQ_CPU_IDLE;
+
+	return 0;
+}
@@ -24,3 +24,28 @@ static inline unsigned int read_midr(void)
 			 MIDR_PARTNUM_SHIFT) == MIDR_PARTNUM_CORTEX_A53)
 #define is_cortex_a72() (((read_midr() & MIDR_PARTNUM_MASK) >>\
 			 MIDR_PARTNUM_SHIFT) == MIDR_PARTNUM_CORTEX_A72)
+
+#define ID_AA64ISAR0_SHA1_SHIFT	8
+#define ID_AA64ISAR0_SHA2_SHIFT	12
+#define ID_AA64ISAR0_CRC32_SHIFT	16
+#define ID_AA64ISAR0_FIELD(val, shift)	(((val) >> (shift)) & 0xf)
+
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
+#define cpu_has_sha1() (ID_AA64ISAR0_FIELD(read_id_aa64isar0(), \
+			ID_AA64ISAR0_SHA1_SHIFT) != 0)
+#define cpu_has_sha2() (ID_AA64ISAR0_FIELD(read_id_aa64isar0(), \
+			ID_AA64ISAR0_SHA2_SHIFT) != 0)
+#define cpu_has_crc32() (ID_AA64ISAR0_FIELD(read_id_aa64isar0(), \
+			 ID_AA64ISAR0_CRC32_SHIFT) != 0)
+
+/* arch/arm/cpu/armv8/crc32.c, without the ones' complement */
+uint32_t armv8_crc32_le(uint32_t crc, const uint8_t *p, size_t len);
+uint32_t armv8_crc32c_le(uint32_t crc, const uint8_t *p, size_t len);
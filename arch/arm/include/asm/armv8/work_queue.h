@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * State shared with a secondary CPU running work-queue jobs
+ */
+
+#ifndef _ASM_ARMV8_WORK_QUEUE_H_
+#define _ASM_ARMV8_WORK_QUEUE_H_
+
+/* Offsets into struct wq_cpu, for work_queue_entry.S */
+#define WQ_CPU_SP	0x00
+#define WQ_CPU_GD	0x08
+#define WQ_CPU_TTBR	0x10
+#define WQ_CPU_TCR	0x18
+#define WQ_CPU_MAIR	0x20
+#define WQ_CPU_SCTLR	0x28
+#define WQ_CPU_VBAR	0x30
+#define WQ_CPU_MPIDR	0x38
+#define WQ_CPU_STATE	0x40
+
+/* Values of wq_cpu->state */
+#define WQ_CPU_IDLE	0	/* nothing to do */
+#define WQ_CPU_RUN	1	/* func is waiting to be run */
+#define WQ_CPU_DONE	2	/* func has been run */
+
+/* Affinity fields of MPIDR_EL1, as used by PSCI */
+#define WQ_MPIDR_MASK	0xff00ffffff
+
+#ifndef __ASSEMBLY__
+#include <asm/global_data.h>
+#include <linux/kernel.h>
+
+/**
+ * struct wq_cpu - state of a secondary CPU
+ *
+ * The first part is read by the CPU with its MMU and caches off, so the boot
+ * CPU must flush it to memory after making changes.
+ *
+ * @sp:		Initial stack pointer
+ * @gd:		Global data pointer, pointing to @gd_copy
+ * @ttbr:	Translation table base of the boot CPU
+ * @tcr:	Translation control register of the boot CPU
+ * @mair:	Memory attributes of the boot CPU
+ * @sctlr:	System control register of the boot CPU
+ * @vbar:	Exception vector base of the boot CPU
+ * @mpidr:	Affinity of this CPU (MPIDR_EL1 & WQ_MPIDR_MASK)
+ * @state:	WQ_CPU_... state
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @spin_table:	true if the CPU is held in the spin table, false for PSCI
+ * @stuck:	true if the CPU did not finish a function in time, so is not
+ *		used again
+ * @gd_copy:	Global data for the CPU, so that nothing it does can update
+ *		the boot CPU's global data
+ */
+struct wq_cpu {
+	u64 sp;
+	gd_t *gd;
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 sctlr;
+	u64 vbar;
+	u64 mpidr;
+	volatile u64 state;
+	void (*func)(void *arg);
+	void *arg;
+	bool spin_table;
+	bool stuck;
+	gd_t gd_copy;
+};
+
+check_member(wq_cpu, sp, WQ_CPU_SP);
+check_member(wq_cpu, gd, WQ_CPU_GD);
+check_member(wq_cpu, ttbr, WQ_CPU_TTBR);
+check_member(wq_cpu, tcr, WQ_CPU_TCR);
+check_member(wq_cpu, mair, WQ_CPU_MAIR);
+check_member(wq_cpu, sctlr, WQ_CPU_SCTLR);
+check_member(wq_cpu, vbar, WQ_CPU_VBAR);
+check_member(wq_cpu, mpidr, WQ_CPU_MPIDR);
+check_member(wq_cpu, state, WQ_CPU_STATE);
+
+/* Entry points in work_queue_entry.S */
+void wq_secondary_entry(struct wq_cpu *wc);
+void wq_spin_table_entry(void);
+void __noreturn wq_spin_table_park(struct wq_cpu *wc);
+
+/* Called by wq_secondary_entry() once the MMU is on */
+void __noreturn wq_secondary_main(struct wq_cpu *wc);
+
+/* NULL-terminated list of CPUs for wq_spin_table_entry() to look in */
+extern struct wq_cpu *wq_spin_table_cpus[];
+#endif
+
+#endif /* _ASM_ARMV8_WORK_QUEUE_H_ */
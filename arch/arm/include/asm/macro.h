@@ -77,6 +77,28 @@ lr	.req	x30
 	b.eq	\el1_label
 .endm
 
+/*
+ * Branch if unaligned data accesses would fault at the current exception
+ * level: either the MMU is off (so all memory is Device memory) or
+ * alignment checking is enabled in SCTLR_ELx. Also taken at EL0, where
+ * SCTLR cannot be read.
+ */
+.macro	branch_if_strict_align, xreg, label
+	switch_el \xreg, .Lsa_el3_\@, .Lsa_el2_\@, .Lsa_el1_\@
+	b	\label
+.Lsa_el3_\@:
+	mrs	\xreg, sctlr_el3
+	b	.Lsa_chk_\@
+.Lsa_el2_\@:
+	mrs	\xreg, sctlr_el2
+	b	.Lsa_chk_\@
+.Lsa_el1_\@:
+	mrs	\xreg, sctlr_el1
+.Lsa_chk_\@:
+	tbz	\xreg, #0, \label	/* SCTLR_ELx.M */
+	tbnz	\xreg, #1, \label	/* SCTLR_ELx.A */
+.endm
+
 /*
  * Branch if current processor is a Cortex-A57 core.
  */
@@ -12,6 +12,7 @@
 #include <linux/delay.h>
 #include <linux/libfdt.h>
 #include <os.h>
+#include <work_queue.h>
 #include <asm/io.h>
 #include <asm/malloc.h>
 #include <asm/setjmp.h>
@@ -344,3 +345,46 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+/*
+ * Each secondary CPU is a host thread, started afresh for each wq_run().
+ * The threads share gd with the boot CPU, so the watchdog is marked as not
+ * ready while any of them runs, to keep them away from driver model.
+ */
+static void *wq_threads[CONFIG_WORK_QUEUE_MAX_CPUS];
+static int wq_running;
+static ulong wq_wdt_flags;
+
+int arch_wq_cpu_count(void)
+{
+	return os_get_cpu_count();
+}
+
+int arch_wq_start(int cpu, void (*func)(void *arg), void *arg)
+{
+	int ret;
+
+	if (!wq_running++) {
+		wq_wdt_flags = gd->flags & GD_FLG_WDT_READY;
+		gd->flags &= ~GD_FLG_WDT_READY;
+	}
+	ret = os_thread_create(&wq_threads[cpu], func, arg);
+	if (ret && !--wq_running)
+		gd->flags |= wq_wdt_flags;
+
+	return ret;
+}
+
+/* Host threads do not get stuck, so there is no need for a timeout */
+int arch_wq_wait(int cpu, ulong timeout_ms)
+{
+	int ret;
+
+	ret = os_thread_join(wq_threads[cpu]);
+	if (!--wq_running)
+		gd->flags |= wq_wdt_flags;
+
+	return ret;
+}
+#endif
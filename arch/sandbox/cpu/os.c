@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -814,3 +815,56 @@ void *os_find_text_base(void)
 
 	return base;
 }
+
+int os_get_cpu_count(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? count : 1;
+}
+
+struct os_thread {
+	pthread_t thread;
+	void (*func)(void *arg);
+	void *arg;
+};
+
+static void *os_thread_start(void *ptr)
+{
+	struct os_thread *thr = ptr;
+
+	thr->func(thr->arg);
+
+	return NULL;
+}
+
+int os_thread_create(void **threadp, void (*func)(void *arg), void *arg)
+{
+	struct os_thread *thr;
+	int ret;
+
+	thr = os_malloc(sizeof(*thr));
+	if (!thr)
+		return -ENOMEM;
+	thr->func = func;
+	thr->arg = arg;
+	ret = pthread_create(&thr->thread, NULL, os_thread_start, thr);
+	if (ret) {
+		os_free(thr);
+		return -ret;
+	}
+	*threadp = thr;
+
+	return 0;
+}
+
+int os_thread_join(void *thread)
+{
+	struct os_thread *thr = thread;
+	int ret;
+
+	ret = pthread_join(thr->thread, NULL);
+	os_free(thr);
+
+	return -ret;
+}
@@ -244,4 +244,13 @@ uint sandbox_pci_read_bar(u32 barval, int type, uint size);
  */
 void sandbox_set_enable_memio(bool enable);
 
+/**
+ * sandbox_mmc_get_cmd_count() - Get the number of times a command was sent
+ *
+ * @dev: MMC device to check
+ * @cmdidx: Command index (0 to 63)
+ * @return number of times the command has been sent to the device
+ */
+uint sandbox_mmc_get_cmd_count(struct udevice *dev, int cmdidx);
+
 #endif
@@ -14,18 +14,36 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
 	struct block_cache_stats stats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "readahead: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "ways: %u\n",
+	       stats.hits, stats.misses, stats.readahead, stats.entries,
+	       stats.max_blocks_per_entry, stats.max_entries, stats.ways);
+	for (i = 0; i < stats.num_devs; i++) {
+		struct block_cache_dev_stats *dev = &stats.devs[i];
+
+		printf("%s %d: hits %u, misses %u, readahead %u, reads %u, writes %u, writeback %u, dirty %u\n",
+		       blk_get_if_type_name(dev->iftype), dev->devnum,
+		       dev->hits, dev->misses, dev->readahead, dev->reads,
+		       dev->writes, dev->writeback, dev->dirty);
+	}
 	return 0;
 }
 
+static int blkc_flush(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	return blkcache_flush_all() ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
@@ -35,7 +53,10 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
+	if (blkcache_configure(blocks_per_entry, max_entries)) {
+		printf("cannot write back cached blocks, not changed\n");
+		return CMD_RET_FAILURE;
+	}
 	printf("changed to max of %u entries of %u blocks each\n",
 	       max_entries, blocks_per_entry);
 	return 0;
@@ -44,6 +65,7 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(flush, 0, 0, blkc_flush, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -84,4 +106,5 @@ U_BOOT_CMD(
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
 	"blkcache configure blocks entries\n"
+	"blkcache flush - write back dirty blocks\n"
 );
@@ -30,8 +30,11 @@ static int do_load_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	load,	7,	0,	do_load_wrapper,
+	load,	8,	0,	do_load_wrapper,
 	"load binary file from a filesystem",
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"[-z] "
+#endif
 	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [pos]]]]]\n"
 	"    - Load binary file 'filename' from partition 'part' on device\n"
 	"       type 'interface' instance 'dev' to address 'addr' in memory.\n"
@@ -39,6 +42,11 @@ U_BOOT_CMD(
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
 	"      If 'pos' is 0 or omitted, the file is read from the start."
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"\n"
+	"      With -z a compressed file is decompressed as it is read;\n"
+	"      'filesize' is set to the uncompressed size."
+#endif
 )
 
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
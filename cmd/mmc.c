@@ -11,11 +11,23 @@
 #include <memalign.h>
 #include <mmc.h>
 #include <part.h>
+#include <div64.h>
 #include <sparse_format.h>
 #include <image-sparse.h>
 
 static int curr_device = -1;
 
+static void print_mmc_stats(const char *name, ulong cmds, u64 blocks,
+			    uint blksz, u64 us)
+{
+	u64 bytes = blocks * blksz;
+
+	printf("%s: %llu blocks in %lu commands", name, blocks, cmds);
+	if (us)
+		printf(", %llu KiB/s", lldiv(bytes * 1000000 / 1024, us));
+	printf("\n");
+}
+
 static void print_mmcinfo(struct mmc *mmc)
 {
 	int i;
@@ -49,6 +61,14 @@ static void print_mmcinfo(struct mmc *mmc)
 	printf("Bus Width: %d-bit%s\n", mmc->bus_width,
 			mmc->ddr_mode ? " DDR" : "");
 
+	print_mmc_stats("Reads", mmc->stats.read_cmds, mmc->stats.read_blocks,
+			mmc->read_bl_len, mmc->stats.read_us);
+#if CONFIG_IS_ENABLED(MMC_WRITE)
+	print_mmc_stats("Writes", mmc->stats.write_cmds,
+			mmc->stats.write_blocks, mmc->write_bl_len,
+			mmc->stats.write_us);
+#endif
+
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 	puts("Erase Group Size: ");
 	print_size(((u64)mmc->erase_grp_size) << 9, "\n");
@@ -139,7 +159,10 @@ static struct mmc *init_mmc_device(int dev, bool force_init)
 
 #ifdef CONFIG_BLOCK_CACHE
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
-	blkcache_invalidate(bd->if_type, bd->devnum);
+
+	/* Dirty blocks stay cached if they cannot be written back */
+	if (blkcache_invalidate(bd->if_type, bd->devnum))
+		printf("Cached blocks were not written back\n");
 #endif
 
 	return mmc;
@@ -313,6 +313,8 @@ static int initr_dm(void)
 	/* Save the pre-reloc driver model and start a new one */
 	gd->dm_root_f = gd->dm_root;
 	gd->dm_root = NULL;
+	/* Any compatible-string index is in the pre-reloc malloc() area */
+	gd->dm_compat_index = NULL;
 #ifdef CONFIG_TIMER
 	gd->timer = NULL;
 #endif
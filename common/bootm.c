@@ -6,6 +6,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <cpu_func.h>
 #include <env.h>
@@ -624,9 +625,11 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 	}
 
 	/* Now run the OS! We hope this doesn't return */
-	if (!ret && (states & BOOTM_STATE_OS_GO))
+	if (!ret && (states & BOOTM_STATE_OS_GO)) {
+		blkcache_flush_all();
 		ret = boot_selected_os(argc, argv, BOOTM_STATE_OS_GO,
 				images, boot_fn);
+	}
 
 	/* Deal with any fallout */
 err:
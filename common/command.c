@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <console.h>
 #include <env.h>
@@ -580,6 +581,10 @@ static int cmd_call(struct cmd_tbl *cmdtp, int flag, int argc,
 	result = cmdtp->cmd_rep(cmdtp, flag, argc, argv, repeatable);
 	if (result)
 		debug("Command failed, result=%d\n", result);
+
+	/* Don't leave data written by the command only in the block cache */
+	blkcache_flush_all();
+
 	return result;
 }
 
@@ -1800,6 +1800,11 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto)
 	has_symbols = err >= 0;
 
 	err = fdt_overlay_apply(fdt, fdto);
+	/*
+	 * Nodes may have moved, even if the overlay failed part-way through.
+	 * This is cheap, so do not bother checking whether fdt is U-Boot's.
+	 */
+	fdtdec_phandle_cache_invalidate();
 	if (err < 0) {
 		printf("failed on fdt_overlay_apply(): %s\n",
 				fdt_strerror(err));
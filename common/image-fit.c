@@ -32,6 +32,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #include <u-boot/md5.h>
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
+#include <work_queue.h>
 
 /*****************************************************************************/
 /* New uImage format routines */
@@ -1216,8 +1217,325 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/**
+ * fit_image_hash_get_chunks() - set up chunked checking for a hash node
+ *
+ * @fit:	FIT to check
+ * @noffset:	Offset of hash node
+ * @data:	Start of image data
+ * @size:	Size of image data
+ * @ctx:	Returns the chunk-checking state
+ * @return 0 if OK, -ENOENT if the node has no chunk table, -EINVAL if the
+ *	table is malformed or uses an unsupported algorithm
+ */
+static int fit_image_hash_get_chunks(const void *fit, int noffset,
+				     const void *data, size_t size,
+				     struct fit_chunk_verify *ctx)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	const fdt32_t *chunk_size;
+	size_t count;
+	int value_len;
+	char *algo;
+	int len;
+
+	chunk_size = fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, &len);
+	if (!chunk_size)
+		return -ENOENT;
+	if (len != sizeof(*chunk_size) || !fdt32_to_cpu(*chunk_size))
+		return -EINVAL;
+
+	/* Hash nothing, just to find out the digest length */
+	if (fit_image_hash_get_algo(fit, noffset, &algo) ||
+	    calculate_hash(data, 0, algo, value, &value_len))
+		return -EINVAL;
+
+	ctx->data = data;
+	ctx->size = size;
+	ctx->chunk_size = fdt32_to_cpu(*chunk_size);
+	ctx->done = 0;
+	ctx->algo = algo;
+	ctx->value_len = value_len;
+	ctx->table = fdt_getprop(fit, noffset, FIT_CHUNK_VALUE_PROP, &len);
+	count = (size + ctx->chunk_size - 1) / ctx->chunk_size;
+	if (!ctx->table || len != count * value_len)
+		return -EINVAL;
+
+	return 0;
+}
+
+int fit_image_chunk_verify_init(const void *fit, int image_noffset,
+				const void *data, size_t size,
+				struct fit_chunk_verify *ctx)
+{
+	int noffset;
+	int ignore;
+	int ret;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		ret = fit_image_hash_get_chunks(fit, noffset, data, size, ctx);
+		if (ret != -ENOENT)
+			return ret;
+	}
+
+	return -ENOENT;
+}
+
+int fit_image_chunk_verify_update(struct fit_chunk_verify *ctx, size_t avail)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	size_t len;
+
+	while (ctx->done < ctx->size) {
+		len = ctx->size - ctx->done;
+		if (len > ctx->chunk_size)
+			len = ctx->chunk_size;
+		if (ctx->done + len > avail)
+			break;
+		if (calculate_hash(ctx->data + ctx->done, len, ctx->algo,
+				   value, &value_len))
+			return -EPROTONOSUPPORT;
+		if (memcmp(value, ctx->table, value_len))
+			return -EBADMSG;
+		ctx->table += value_len;
+		ctx->done += len;
+	}
+
+	return 0;
+}
+
+/*
+ * Hashing one image does not depend on any other, so with CONFIG_WORK_QUEUE
+ * the digests of several images, or of the hash nodes of one image, are
+ * worked out on all CPUs at once. The images are then checked one by one as
+ * usual, using those digests. The chunks in a chunk table are independent
+ * too, so they are shared out between the CPUs; this is what speeds up
+ * checking a single large image. Host tools do not have the work queue.
+ */
+#ifndef USE_HOSTCC
+
+/**
+ * struct fit_chunk_job - a run of chunks for one CPU to check
+ *
+ * @ctx:	Chunk-checking state, starting at the first chunk of the run
+ * @end:	Offset of the end of the last chunk of the run
+ */
+struct fit_chunk_job {
+	struct fit_chunk_verify ctx;
+	size_t end;
+};
+
+/* Runs on any CPU, so it must only calculate, see work_queue.h */
+static int fit_chunk_job(void *arg)
+{
+	struct fit_chunk_job *job = arg;
+
+	return fit_image_chunk_verify_update(&job->ctx, job->end);
+}
+
+/**
+ * fit_chunk_verify_all() - check every chunk of an image, on all CPUs
+ *
+ * @ctx:	Chunk-checking state from fit_image_hash_get_chunks()
+ * @return 0 if all chunks are OK, -EBADMSG if one does not match,
+ *	-EPROTONOSUPPORT if the algorithm is not supported
+ */
+static int fit_chunk_verify_all(struct fit_chunk_verify *ctx)
+{
+	struct fit_chunk_job *cjobs;
+	struct wq_job *jobs;
+	size_t chunks, per, first;
+	int cpus, i, ret;
+
+	chunks = (ctx->size + ctx->chunk_size - 1) / ctx->chunk_size;
+	cpus = wq_cpu_count();
+	if (chunks < cpus)
+		cpus = chunks;
+	if (cpus < 2)
+		return fit_image_chunk_verify_update(ctx, ctx->size);
+
+	cjobs = calloc(cpus, sizeof(*cjobs));
+	jobs = calloc(cpus, sizeof(*jobs));
+	if (!cjobs || !jobs) {
+		free(cjobs);
+		free(jobs);
+		return fit_image_chunk_verify_update(ctx, ctx->size);
+	}
+
+	/* Give each CPU a run of neighbouring chunks */
+	per = (chunks + cpus - 1) / cpus;
+	for (i = 0; i < cpus; i++) {
+		first = min(i * per, chunks);
+		cjobs[i].ctx = *ctx;
+		cjobs[i].ctx.done = first * ctx->chunk_size;
+		cjobs[i].ctx.table += first * ctx->value_len;
+		cjobs[i].end = min((first + per) * ctx->chunk_size, ctx->size);
+		jobs[i].func = fit_chunk_job;
+		jobs[i].arg = &cjobs[i];
+	}
+	ret = wq_run(jobs, cpus);
+	free(jobs);
+	free(cjobs);
+
+	return ret;
+}
+
+/* Runs on any CPU, so it must only calculate, see work_queue.h */
+static int fit_hash_job(void *arg)
+{
+	struct fit_hash_result *res = arg;
+
+	res->ret = calculate_hash(res->data, res->size, res->algo, res->value,
+				  &res->value_len);
+
+	return 0;
+}
+
+/**
+ * fit_hash_precalc_image() - set up the digests to work out for an image
+ *
+ * @fit:	FIT containing the image
+ * @image_noffset: Offset of the image node
+ * @results:	Place to put the hash nodes found, or NULL to just count them
+ * @return number of hash nodes whose digest is wanted
+ */
+static int fit_hash_precalc_image(const void *fit, int image_noffset,
+				  struct fit_hash_result *results)
+{
+	const void *data;
+	int noffset;
+	size_t size;
+	int ignore;
+	int count;
+	char *algo;
+
+	if (fit_image_get_data_and_size(fit, image_noffset, &data, &size))
+		return 0;
+
+	count = 0;
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		/* A chunk table is checked instead of the value */
+		if (FIT_IMAGE_ENABLE_CHUNKED_HASH &&
+		    fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, NULL))
+			continue;
+		if (results) {
+			results[count].fit = fit;
+			results[count].noffset = noffset;
+			results[count].data = data;
+			results[count].size = size;
+			results[count].algo = algo;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * fit_hash_precalc() - work out the digests of some images on all CPUs
+ *
+ * Nothing is done if there is only one CPU, since checking each image in
+ * turn takes just as long.
+ *
+ * @fit:	FIT containing the images
+ * @image_noffsets: Offsets of the image nodes
+ * @count:	Number of image nodes
+ * @resultsp:	Returns an allocated list of digests, or NULL if there are
+ *		none. The caller must free it.
+ * @return number of digests in *@resultsp
+ */
+static int fit_hash_precalc(const void *fit, const int *image_noffsets,
+			    int count, struct fit_hash_result **resultsp)
+{
+	struct fit_hash_result *results;
+	struct wq_job *jobs;
+	int total, i;
+
+	*resultsp = NULL;
+	if (wq_cpu_count() < 2)
+		return 0;
+
+	for (i = 0, total = 0; i < count; i++)
+		total += fit_hash_precalc_image(fit, image_noffsets[i], NULL);
+	if (total < 2)
+		return 0;
+
+	results = calloc(total, sizeof(*results));
+	jobs = calloc(total, sizeof(*jobs));
+	if (!results || !jobs) {
+		free(results);
+		free(jobs);
+		return 0;
+	}
+	for (i = 0, total = 0; i < count; i++)
+		total += fit_hash_precalc_image(fit, image_noffsets[i],
+						results + total);
+	for (i = 0; i < total; i++) {
+		jobs[i].func = fit_hash_job;
+		jobs[i].arg = &results[i];
+	}
+	wq_run(jobs, total);
+	free(jobs);
+	*resultsp = results;
+
+	return total;
+}
+#else
+static int fit_chunk_verify_all(struct fit_chunk_verify *ctx)
+{
+	return fit_image_chunk_verify_update(ctx, ctx->size);
+}
+
+static int fit_hash_precalc(const void *fit, const int *image_noffsets,
+			    int count, struct fit_hash_result **resultsp)
+{
+	*resultsp = NULL;
+
+	return 0;
+}
+#endif
+
+static const struct fit_hash_result *fit_hash_find(
+		const struct fit_hash_result *results, int count,
+		const void *fit, int noffset, const void *data, size_t size)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (results[i].fit == fit && results[i].noffset == noffset &&
+		    results[i].data == data && results[i].size == size)
+			return &results[i];
+	}
+
+	return NULL;
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const struct fit_hash_result *pre,
+				char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
@@ -1248,7 +1566,36 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	/*
+	 * The chunk table covers the same data as the value, so there is no
+	 * need to hash everything twice
+	 */
+	if (FIT_IMAGE_ENABLE_CHUNKED_HASH) {
+		struct fit_chunk_verify chunks;
+		int ret;
+
+		ret = fit_image_hash_get_chunks(fit, noffset, data, size,
+						&chunks);
+		if (!ret) {
+			if (fit_chunk_verify_all(&chunks)) {
+				*err_msgp = "Bad chunk hash value";
+				return -1;
+			}
+			return 0;
+		} else if (ret != -ENOENT) {
+			*err_msgp = "Bad chunk hash table";
+			return -1;
+		}
+	}
+
+	if (pre) {
+		if (pre->ret) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		memcpy(value, pre->value, pre->value_len);
+		value_len = pre->value_len;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1264,8 +1611,22 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
-int fit_image_verify_with_data(const void *fit, int image_noffset,
-			       const void *data, size_t size)
+/**
+ * fit_image_verify_data() - check an image, perhaps with digests worked out
+ *	in advance
+ *
+ * @fit:	FIT containing the image
+ * @image_noffset: Offset of the image node
+ * @data:	Image data
+ * @size:	Size of the image data in bytes
+ * @results:	Digests from fit_hash_precalc(), or NULL
+ * @result_count: Number of digests in @results
+ * @return 1 if the image is valid, 0 if not
+ */
+static int fit_image_verify_data(const void *fit, int image_noffset,
+				 const void *data, size_t size,
+				 const struct fit_hash_result *results,
+				 int result_count)
 {
 	int		noffset = 0;
 	char		*err_msg = "";
@@ -1292,6 +1653,10 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
+						 fit_hash_find(results,
+							       result_count,
+							       fit, noffset,
+							       data, size),
 						 &err_msg))
 				goto error;
 			puts("+ ");
@@ -1328,20 +1693,15 @@ error:
 	return 0;
 }
 
-/**
- * fit_image_verify - verify data integrity
- * @fit: pointer to the FIT format image header
- * @image_noffset: component image node offset
- *
- * fit_image_verify() goes over component image hash nodes,
- * re-calculates each data hash and compares with the value stored in hash
- * node.
- *
- * returns:
- *     1, if all hashes are valid
- *     0, otherwise (or on error)
- */
-int fit_image_verify(const void *fit, int image_noffset)
+int fit_image_verify_with_data(const void *fit, int image_noffset,
+			       const void *data, size_t size)
+{
+	return fit_image_verify_data(fit, image_noffset, data, size, NULL, 0);
+}
+
+static int fit_image_verify_node(const void *fit, int image_noffset,
+				 const struct fit_hash_result *results,
+				 int result_count)
 {
 	const void	*data;
 	size_t		size;
@@ -1357,7 +1717,26 @@ int fit_image_verify(const void *fit, int image_noffset)
 		return 0;
 	}
 
-	return fit_image_verify_with_data(fit, image_noffset, data, size);
+	return fit_image_verify_data(fit, image_noffset, data, size, results,
+				     result_count);
+}
+
+/**
+ * fit_image_verify - verify data integrity
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ *
+ * fit_image_verify() goes over component image hash nodes,
+ * re-calculates each data hash and compares with the value stored in hash
+ * node.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+int fit_image_verify(const void *fit, int image_noffset)
+{
+	return fit_image_verify_node(fit, image_noffset, NULL, 0);
 }
 
 /**
@@ -1373,8 +1752,11 @@ int fit_image_verify(const void *fit, int image_noffset)
  */
 int fit_all_image_verify(const void *fit)
 {
+	struct fit_hash_result *results = NULL;
+	int result_count = 0;
 	int images_noffset;
 	int noffset;
+	int ret = 1;
 	int ndepth;
 	int count;
 
@@ -1386,6 +1768,23 @@ int fit_all_image_verify(const void *fit)
 		return 0;
 	}
 
+	if (CONFIG_IS_ENABLED(WORK_QUEUE)) {
+		int *image_noffsets;
+
+		count = 0;
+		fdt_for_each_subnode(noffset, fit, images_noffset)
+			count++;
+		image_noffsets = malloc(count * sizeof(*image_noffsets));
+		if (image_noffsets) {
+			count = 0;
+			fdt_for_each_subnode(noffset, fit, images_noffset)
+				image_noffsets[count++] = noffset;
+			result_count = fit_hash_precalc(fit, image_noffsets,
+							count, &results);
+			free(image_noffsets);
+		}
+	}
+
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
@@ -1402,12 +1801,16 @@ int fit_all_image_verify(const void *fit)
 			       fit_get_name(fit, noffset, NULL));
 			count++;
 
-			if (!fit_image_verify(fit, noffset))
-				return 0;
+			ret = fit_image_verify_node(fit, noffset, results,
+						    result_count);
+			if (!ret)
+				break;
 			printf("\n");
 		}
 	}
-	return 1;
+	free(results);
+
+	return ret;
 }
 
 #ifdef CONFIG_FIT_CIPHER
@@ -1793,13 +2196,28 @@ int fit_conf_get_prop_node(const void *fit, int noffset,
 	return fit_conf_get_prop_node_index(fit, noffset, prop_name, 0);
 }
 
-static int fit_image_select(const void *fit, int rd_noffset, int verify)
+static int fit_image_select(bootm_headers_t *images, const void *fit,
+			    int rd_noffset)
 {
 	fit_image_print(fit, rd_noffset, "   ");
 
-	if (verify) {
+	if (images->verify) {
+		struct fit_hash_result *results = NULL;
+		int result_count = 0;
+		int ok;
+
+		/*
+		 * Only hash the image now that it is being checked: loading
+		 * an earlier image may have overwritten part of the FIT
+		 */
+		if (CONFIG_IS_ENABLED(WORK_QUEUE))
+			result_count = fit_hash_precalc(fit, &rd_noffset, 1,
+							&results);
 		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
+		ok = fit_image_verify_node(fit, rd_noffset, results,
+					   result_count);
+		free(results);
+		if (!ok) {
 			puts("Bad Data Hash\n");
 			return -EACCES;
 		}
@@ -1960,7 +2378,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	ret = fit_image_select(images, fit, noffset);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming decompression of images
+ *
+ * image_decomp() needs the whole compressed image in memory before it can
+ * start. The functions here accept the compressed data in pieces, so that a
+ * loader can decompress each piece as soon as it has been read and does not
+ * need a buffer for the compressed image at all.
+ */
+
+#include <common.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <u-boot/zlib.h>
+
+#ifdef CONFIG_GZIP
+static void *gzip_stream_alloc(void *x, unsigned int items, unsigned int size)
+{
+	return malloc(items * size);
+}
+
+static void gzip_stream_free(void *x, void *addr, unsigned int nb)
+{
+	free(addr);
+}
+
+static int gzip_stream_start(struct image_decomp_stream *ds)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzip_stream_alloc;
+	s->zfree = gzip_stream_free;
+
+	/* Adding 16 to the window size makes zlib handle the gzip header */
+	if (inflateInit2(s, 16 + MAX_WBITS) != Z_OK) {
+		free(s);
+		return -ENOMEM;
+	}
+	s->next_out = ds->out;
+	s->avail_out = min_t(ulong, ds->out_size, UINT_MAX);
+	ds->priv = s;
+
+	return 0;
+}
+
+static int gzip_stream_feed(struct image_decomp_stream *ds, const void *in,
+			    ulong len)
+{
+	z_stream *s = ds->priv;
+	int r;
+
+	s->next_in = (Bytef *)in;
+	s->avail_in = len;
+	while (1) {
+		r = inflate(s, Z_NO_FLUSH);
+		/* total_out starts again with each member */
+		ds->out_len = s->next_out - (Bytef *)ds->out;
+		if (r != Z_STREAM_END)
+			break;
+
+		/* Another member may follow, as with 'cat a.gz b.gz' */
+		inflateReset(s);
+		if (!s->avail_in)
+			return 1;
+	}
+	if (r != Z_OK && r != Z_BUF_ERROR) {
+		debug("%s: inflate() returned %d\n", __func__, r);
+		return -EINVAL;
+	}
+
+	/* inflate() only stops early when the output is full */
+	return s->avail_in ? -ENOBUFS : 0;
+}
+
+static void gzip_stream_end(struct image_decomp_stream *ds)
+{
+	inflateEnd(ds->priv);
+	free(ds->priv);
+}
+#endif /* CONFIG_GZIP */
+
+#ifdef CONFIG_LZMA
+/* Properties followed by the 64-bit uncompressed size */
+#define LZMA_HEADER_SIZE	(LZMA_PROPS_SIZE + 8)
+
+struct lzma_stream {
+	CLzmaDec dec;
+	ISzAlloc alloc;
+	Byte header[LZMA_HEADER_SIZE];
+	uint header_len;
+	SizeT unc_size;
+	bool finished;
+};
+
+static void *lzma_stream_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void lzma_stream_free(void *p, void *address)
+{
+	free(address);
+}
+
+static int lzma_stream_start(struct image_decomp_stream *ds)
+{
+	struct lzma_stream *ls;
+
+	ls = calloc(1, sizeof(*ls));
+	if (!ls)
+		return -ENOMEM;
+	LzmaDec_Construct(&ls->dec);
+	ls->alloc.Alloc = lzma_stream_alloc;
+	ls->alloc.Free = lzma_stream_free;
+	ds->priv = ls;
+
+	return 0;
+}
+
+/* Set up the decoder once the complete header has been seen */
+static int lzma_stream_init(struct image_decomp_stream *ds)
+{
+	struct lzma_stream *ls = ds->priv;
+	u64 unc_size;
+	int i;
+
+	unc_size = 0;
+	for (i = 0; i < 8; i++)
+		unc_size |= (u64)ls->header[LZMA_PROPS_SIZE + i] << (i * 8);
+	ls->unc_size = unc_size == (u64)-1 ? (SizeT)-1 : (SizeT)unc_size;
+	if (unc_size != (u64)-1 && unc_size > ds->out_size)
+		return -ENOBUFS;
+
+	if (LzmaDec_AllocateProbs(&ls->dec, ls->header, LZMA_PROPS_SIZE,
+				  &ls->alloc) != SZ_OK)
+		return -EINVAL;
+
+	/* Decode straight into the output, which is also the dictionary */
+	ls->dec.dic = ds->out;
+	ls->dec.dicBufSize = ds->out_size;
+	LzmaDec_Init(&ls->dec);
+
+	return 0;
+}
+
+static int lzma_stream_feed(struct image_decomp_stream *ds, const void *in,
+			    ulong len)
+{
+	struct lzma_stream *ls = ds->priv;
+	const Byte *src = in;
+	ELzmaStatus status;
+	SizeT limit, in_len;
+	SRes res;
+	int ret;
+
+	/* There is only one stream; anything after it is ignored */
+	if (ls->finished)
+		return 1;
+	if (ls->header_len < LZMA_HEADER_SIZE) {
+		uint n = min_t(ulong, LZMA_HEADER_SIZE - ls->header_len, len);
+
+		memcpy(ls->header + ls->header_len, src, n);
+		ls->header_len += n;
+		src += n;
+		len -= n;
+		if (ls->header_len < LZMA_HEADER_SIZE)
+			return 0;
+		ret = lzma_stream_init(ds);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * LZMA_FINISH_END makes the decoder look for an end marker once the
+	 * output is full, which a stream of unknown size that exactly fills
+	 * the output still has to provide.
+	 */
+	limit = min_t(SizeT, ls->unc_size, ds->out_size);
+	in_len = len;
+	res = LzmaDec_DecodeToDic(&ls->dec, limit, src, &in_len, LZMA_FINISH_END,
+				  &status);
+	ds->out_len = ls->dec.dicPos;
+	if (res != SZ_OK)
+		return ds->out_len == ds->out_size ? -ENOBUFS : -EINVAL;
+
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+	    ls->dec.dicPos == ls->unc_size) {
+		ls->finished = true;
+		return 1;
+	}
+
+	return in_len < len ? -ENOBUFS : 0;
+}
+
+static void lzma_stream_end(struct image_decomp_stream *ds)
+{
+	struct lzma_stream *ls = ds->priv;
+
+	LzmaDec_FreeProbs(&ls->dec, &ls->alloc);
+	free(ls);
+}
+#endif /* CONFIG_LZMA */
+
+#ifdef CONFIG_ZSTD
+/*
+ * The buffer-less zstd API wants each frame header and block passed in one
+ * piece. Blocks usually lie entirely within an input piece and are decoded
+ * in place; only those that straddle two pieces are gathered here first.
+ */
+struct zstd_stream {
+	ZSTD_DCtx *dctx;
+	void *workspace;
+	u8 *stage;
+	size_t staged;
+};
+
+static int zstd_stream_start(struct image_decomp_stream *ds)
+{
+	struct zstd_stream *zs;
+	size_t wsize;
+
+	zs = calloc(1, sizeof(*zs));
+	if (!zs)
+		return -ENOMEM;
+	wsize = ZSTD_DCtxWorkspaceBound();
+	zs->workspace = malloc(wsize);
+	zs->stage = malloc(ZSTD_BLOCKSIZE_ABSOLUTEMAX);
+	if (zs->workspace && zs->stage)
+		zs->dctx = ZSTD_initDCtx(zs->workspace, wsize);
+	if (!zs->dctx) {
+		free(zs->stage);
+		free(zs->workspace);
+		free(zs);
+		return -ENOMEM;
+	}
+	ZSTD_decompressBegin(zs->dctx);
+	ds->priv = zs;
+
+	return 0;
+}
+
+static int zstd_stream_feed(struct image_decomp_stream *ds, const void *in,
+			    ulong len)
+{
+	struct zstd_stream *zs = ds->priv;
+	const u8 *src = in;
+	const void *block;
+	size_t need, n, ret;
+
+	while (1) {
+		need = ZSTD_nextSrcSizeToDecompress(zs->dctx);
+		if (need > ZSTD_BLOCKSIZE_ABSOLUTEMAX)
+			return -EINVAL;
+
+		if (!zs->staged && len >= need) {
+			block = src;
+			src += need;
+			len -= need;
+		} else {
+			n = min_t(size_t, need - zs->staged, len);
+			memcpy(zs->stage + zs->staged, src, n);
+			zs->staged += n;
+			src += n;
+			len -= n;
+			if (zs->staged < need)
+				return 0;
+			block = zs->stage;
+			zs->staged = 0;
+		}
+
+		ret = ZSTD_decompressContinue(zs->dctx, ds->out + ds->out_len,
+					      ds->out_size - ds->out_len,
+					      block, need);
+		if (ZSTD_isError(ret)) {
+			debug("%s: error %d\n", __func__,
+			      ZSTD_getErrorCode(ret));
+			if (ZSTD_getErrorCode(ret) ==
+			    ZSTD_error_dstSize_tooSmall)
+				return -ENOBUFS;
+			return -EINVAL;
+		}
+		ds->out_len += ret;
+
+		/* Another frame may follow, as with 'zstd -c a b' */
+		if (!ZSTD_nextSrcSizeToDecompress(zs->dctx)) {
+			ZSTD_decompressBegin(zs->dctx);
+			if (!len)
+				return 1;
+		}
+	}
+}
+
+static void zstd_stream_end(struct image_decomp_stream *ds)
+{
+	struct zstd_stream *zs = ds->priv;
+
+	free(zs->stage);
+	free(zs->workspace);
+	free(zs);
+}
+#endif /* CONFIG_ZSTD */
+
+int image_decomp_stream_start(struct image_decomp_stream *ds, int comp,
+			      void *out, ulong out_size)
+{
+	ds->comp = comp;
+	ds->out = out;
+	ds->out_size = out_size;
+	ds->out_len = 0;
+	ds->priv = NULL;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		return 0;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return gzip_stream_start(ds);
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		return lzma_stream_start(ds);
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return zstd_stream_start(ds);
+#endif
+	default:
+		printf("Cannot stream compression type %d\n", comp);
+		return -ENOSYS;
+	}
+}
+
+int image_decomp_stream_feed(struct image_decomp_stream *ds, const void *in,
+			     ulong len)
+{
+	WATCHDOG_RESET();
+
+	switch (ds->comp) {
+	case IH_COMP_NONE:
+		if (len > ds->out_size - ds->out_len)
+			return -ENOBUFS;
+		memcpy(ds->out + ds->out_len, in, len);
+		ds->out_len += len;
+		return 0;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return gzip_stream_feed(ds, in, len);
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		return lzma_stream_feed(ds, in, len);
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return zstd_stream_feed(ds, in, len);
+#endif
+	default:
+		return -ENOSYS;
+	}
+}
+
+void image_decomp_stream_end(struct image_decomp_stream *ds)
+{
+	if (!ds->priv)
+		return;
+
+	switch (ds->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		gzip_stream_end(ds);
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		lzma_stream_end(ds);
+		break;
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		zstd_stream_end(ds);
+		break;
+#endif
+	}
+	ds->priv = NULL;
+}
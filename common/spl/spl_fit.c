@@ -15,6 +15,7 @@
 #include <spl.h>
 #include <asm/cache.h>
 #include <linux/libfdt.h>
+#include <linux/zstd.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -219,6 +220,45 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/**
+ * spl_fit_read_chunked(): read image data, checking it as it arrives
+ * @info:	points to information about the device to load data from
+ * @sector:	the first sector to read
+ * @count:	the number of sectors to read
+ * @buf:	where to put the data
+ * @overhead:	offset of the image data from @buf
+ * @chunks:	state for checking the data against the chunk table
+ *
+ * The data is read one chunk at a time and each chunk is checked as soon as it
+ * is in memory, so that a corrupted image is rejected without reading the rest
+ * of it.
+ *
+ * Return:	0 on success or a negative error number.
+ */
+static int spl_fit_read_chunked(struct spl_load_info *info, ulong sector,
+				int count, void *buf, ulong overhead,
+				struct fit_chunk_verify *chunks)
+{
+	int step = max_t(int, chunks->chunk_size / info->bl_len, 1);
+	ulong avail;
+	int done;
+	int ret;
+
+	for (done = 0; done < count; done += step) {
+		step = min(step, count - done);
+		if (info->read(info, sector + done, step,
+			       buf + done * info->bl_len) != step)
+			return -EIO;
+		avail = (done + step) * info->bl_len;
+		avail = avail > overhead ? avail - overhead : 0;
+		ret = fit_image_chunk_verify_update(chunks, avail);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -252,6 +292,9 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	bool external_data = false;
+	struct fit_chunk_verify chunks;
+	bool chunked = false;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA_SUPPORT) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -261,7 +304,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			debug("%s ", genimg_get_type_name(type));
 	}
 
-	if (IS_ENABLED(CONFIG_SPL_GZIP)) {
+	if (IS_ENABLED(CONFIG_SPL_GZIP) || IS_ENABLED(CONFIG_SPL_ZSTD)) {
 		fit_image_get_comp(fit, node, &image_comp);
 		debug("%s ", genimg_get_comp_name(image_comp));
 	}
@@ -286,15 +329,33 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 
 		overhead = get_aligned_image_overhead(info, offset);
 		nr_sectors = get_aligned_image_size(info, length, offset);
+		src = (void *)load_ptr + overhead;
 
-		if (info->read(info,
+		if (CONFIG_IS_ENABLED(FIT_CHUNKED_HASH))
+			chunked = !fit_image_chunk_verify_init(fit, node, src,
+							       length, &chunks);
+
+		if (chunked) {
+			printf("## Checking chunk hashes for Image %s ... ",
+			       fit_get_name(fit, node, NULL));
+			ret = spl_fit_read_chunked(info,
+				sector + get_aligned_image_offset(info, offset),
+				nr_sectors, (void *)load_ptr, overhead,
+				&chunks);
+			if (ret) {
+				printf("error %d at offset %lx\n", ret,
+				       (ulong)chunks.done);
+				return ret == -EIO ? ret : -EPERM;
+			}
+			puts("OK\n");
+		} else if (info->read(info,
 			       sector + get_aligned_image_offset(info, offset),
-			       nr_sectors, (void *)load_ptr) != nr_sectors)
+			       nr_sectors, (void *)load_ptr) != nr_sectors) {
 			return -EIO;
+		}
 
 		debug("External data: dst=%lx, offset=%x, size=%lx\n",
 		      load_ptr, offset, (unsigned long)length);
-		src = (void *)load_ptr + overhead;
 	} else {
 		/* Embedded data */
 		if (fit_image_get_data(fit, node, &data, &length)) {
@@ -306,14 +367,21 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		src = (void *)data;
 	}
 
-#ifdef CONFIG_SPL_FIT_SIGNATURE
-	printf("## Checking hash(es) for Image %s ... ",
-	       fit_get_name(fit, node, NULL));
-	if (!fit_image_verify_with_data(fit, node,
-					 src, length))
-		return -EPERM;
-	puts("OK\n");
-#endif
+	if (FIT_IMAGE_ENABLE_VERIFY && chunked) {
+		int verify_all;
+
+		/* The hashes were checked above, so only signatures remain */
+		if (fit_image_verify_required_sigs(fit, node, src, length,
+						   gd_fdt_blob(), &verify_all))
+			return -EPERM;
+	} else if (FIT_IMAGE_ENABLE_VERIFY) {
+		printf("## Checking hash(es) for Image %s ... ",
+		       fit_get_name(fit, node, NULL));
+		if (!fit_image_verify_with_data(fit, node,
+						 src, length))
+			return -EPERM;
+		puts("OK\n");
+	}
 
 #ifdef CONFIG_SPL_FIT_IMAGE_POST_PROCESS
 	board_fit_image_post_process(&src, &length);
@@ -327,6 +395,14 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			return -EIO;
 		}
 		length = size;
+	} else if (IS_ENABLED(CONFIG_SPL_ZSTD) && image_comp == IH_COMP_ZSTD) {
+		size_t unc_len = CONFIG_SYS_BOOTM_LEN;
+
+		if (zstd_decompress(src, length, (void *)load_addr, &unc_len)) {
+			puts("Uncompressing error\n");
+			return -EIO;
+		}
+		length = unc_len;
 	} else {
 		memcpy((void *)load_addr, src, length);
 	}
@@ -238,7 +238,9 @@ void part_init(struct blk_desc *dev_desc)
 	const int n_ents = ll_entry_count(struct part_driver, part_driver);
 	struct part_driver *entry;
 
-	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	/* Dirty blocks stay cached if they cannot be written back */
+	if (blkcache_invalidate(dev_desc->if_type, dev_desc->devnum))
+		log_warning("Cached blocks were not written back\n");
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -343,12 +343,17 @@ ulong blk_write_devnum(enum if_type if_type, int devnum, lbaint_t start,
 int blk_select_hwpart(struct udevice *dev, int hwpart)
 {
 	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_desc *desc;
 
 	if (!ops)
 		return -ENOSYS;
 	if (!ops->select_hwpart)
 		return 0;
 
+	/* Cached writes belong to the current hardware partition */
+	desc = dev_get_uclass_platdata(dev);
+	blkcache_flush(desc->if_type, desc->devnum);
+
 	return ops->select_hwpart(dev, hwpart);
 }
 
@@ -432,25 +437,32 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+static ulong blk_read_dev(struct blk_desc *block_dev, lbaint_t start,
+			  lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+
+	return blk_get_ops(dev)->read(dev, start, blkcnt, buffer);
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
+	return blkcache_dread(block_dev, start, blkcnt, buffer, blk_read_dev);
+}
+
+static ulong blk_write_dev(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
 
-	return blks_read;
+	return blk_get_ops(dev)->write(dev, start, blkcnt, buffer);
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -462,8 +474,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	return blkcache_dwrite(block_dev, start, blkcnt, buffer,
+			       blk_write_dev);
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -472,10 +484,14 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 
+	int ret;
+
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	ret = blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	if (ret)
+		return ret;
 	return ops->erase(dev, start, blkcnt);
 }
 
@@ -655,9 +671,27 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	int ret;
+
+	/* Write back and drop anything cached for this device */
+	ret = blkcache_invalidate(desc->if_type, desc->devnum);
+	if (ret) {
+		/* The device is going away, so its blocks cannot be kept */
+		log_err("%s: Cached blocks were not written back (err=%d)\n",
+			dev->name, ret);
+		blkcache_discard(desc->if_type, desc->devnum);
+	}
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
 };
@@ -8,80 +8,745 @@
 #include <blk.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <sort.h>
 #include <linux/ctype.h>
-#include <linux/list.h>
+#include <linux/log2.h>
 
-struct block_cache_node {
-	struct list_head lh;
+/*
+ * The cache is organised as a set-associative array of lines. Each line
+ * holds up to max_blocks_per_entry consecutive blocks, aligned to the line
+ * size, and keeps a bitmap of which of those blocks are valid. A line is
+ * located by hashing (iftype, devnum, line number) into a set, then
+ * searching the BLKCACHE_WAYS lines of that set. Replacement within a set
+ * is least-recently-used.
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK small writes are kept in the cache and
+ * marked dirty. Dirty blocks of a device are written back in ascending
+ * order, merged into as few device writes as possible, when the device is
+ * flushed or invalidated, or when a dirty line has to be evicted.
+ */
+#define BLKCACHE_WAYS		4
+#define BLKCACHE_MAX_LINE_BLOCKS	32
+
+#ifndef CONFIG_BLOCK_CACHE_READAHEAD
+#define CONFIG_BLOCK_CACHE_READAHEAD	0
+#endif
+
+struct block_cache_line {
 	int iftype;
 	int devnum;
 	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
-	char *cache;
+	u32 valid;		/* bitmap of valid blocks, 0 if line unused */
+	u32 dirty;		/* bitmap of blocks not yet written back */
+	unsigned int age;	/* LRU stamp, larger is more recent */
+	unsigned long size;	/* allocated size of @data in bytes */
+	char *data;
 };
 
-#ifndef CONFIG_M68K
-static LIST_HEAD(block_cache);
-#else
-static struct list_head block_cache;
-#endif
+/* per-device state: statistics and sequential-read detection */
+struct block_cache_dev {
+	struct block_cache_dev_stats stats;
+	lbaint_t next;		/* block following the previous request */
+	lbaint_t ra_blocks;	/* current readahead window in blocks */
+	bool used;
+	/* device used to write back dirty blocks, NULL if there are none */
+	struct blk_desc *desc;
+	blkcache_write_fn write;
+};
+
+static struct block_cache_line *lines;
+static unsigned int num_sets;
+static unsigned int num_ways;
+static unsigned int line_shift;
+static unsigned int clock;
+static struct block_cache_dev devs[BLKCACHE_MAX_DEVS];
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
 	.max_entries = 32
 };
 
+static void cache_free_lines(void)
+{
+	unsigned int i;
+
+	if (lines) {
+		for (i = 0; i < num_sets * num_ways; i++)
+			free(lines[i].data);
+		free(lines);
+		lines = NULL;
+	}
+	_stats.entries = 0;
+}
+
 #ifdef CONFIG_M68K
 int blkcache_init(void)
 {
-	INIT_LIST_HEAD(&block_cache);
+	lines = NULL;
+	memset(devs, '\0', sizeof(devs));
 
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
-{
-	struct block_cache_node *node;
-
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+static int cache_setup(void)
+{
+	if (lines)
+		return 0;
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry)
+		return -ENOSPC;
+
+	line_shift = ilog2(_stats.max_blocks_per_entry);
+	num_ways = min_t(unsigned int, BLKCACHE_WAYS, _stats.max_entries);
+	num_sets = rounddown_pow_of_two(_stats.max_entries / num_ways);
+	lines = calloc(num_sets * num_ways, sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static struct block_cache_dev *cache_get_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *free_dev = NULL;
+	int i;
+
+	for (i = 0; i < BLKCACHE_MAX_DEVS; i++) {
+		struct block_cache_dev *bdev = &devs[i];
+
+		if (!bdev->used) {
+			if (!free_dev)
+				free_dev = bdev;
+			continue;
+		}
+		if (bdev->stats.iftype == iftype &&
+		    bdev->stats.devnum == devnum)
+			return bdev;
+	}
+	if (!free_dev)
+		return NULL;
+
+	memset(free_dev, '\0', sizeof(*free_dev));
+	free_dev->used = true;
+	free_dev->stats.iftype = iftype;
+	free_dev->stats.devnum = devnum;
+
+	return free_dev;
+}
+
+static inline lbaint_t line_start(lbaint_t blk)
+{
+	return blk & ~(lbaint_t)(_stats.max_blocks_per_entry - 1);
+}
+
+static struct block_cache_line *cache_set(int iftype, int devnum,
+					  lbaint_t start)
+{
+	u64 lineno = start >> line_shift;
+	u32 hash;
+
+	hash = (u32)(lineno ^ (lineno >> 32)) * 0x9e3779b1;
+	hash ^= ((u32)iftype << 8 | (u32)devnum) * 0x85ebca6b;
+	hash ^= hash >> 16;
+
+	return &lines[(hash & (num_sets - 1)) * num_ways];
+}
+
+/* find the line holding block @blk, or NULL if it is not cached */
+static struct block_cache_line *cache_find(int iftype, int devnum,
+					   lbaint_t blk, unsigned long blksz)
+{
+	struct block_cache_line *set, *line;
+	lbaint_t start;
+	unsigned int way;
+
+	if (!lines)
+		return NULL;
+
+	start = line_start(blk);
+	set = cache_set(iftype, devnum, start);
+	for (way = 0; way < num_ways; way++) {
+		line = &set[way];
+		if (line->valid && line->iftype == iftype &&
+		    line->devnum == devnum && line->blksz == blksz &&
+		    line->start == start)
+			return line;
+	}
+
+	return NULL;
+}
+
+static int cache_cmp_lines(const void *a, const void *b)
+{
+	const struct block_cache_line *la = *(struct block_cache_line **)a;
+	const struct block_cache_line *lb = *(struct block_cache_line **)b;
+
+	if (la->start == lb->start)
+		return 0;
+
+	return la->start < lb->start ? -1 : 1;
+}
+
+static int cache_write_run(struct block_cache_dev *bdev, lbaint_t start,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	ulong blks_written;
+
+	debug("writeback: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	blks_written = bdev->write(bdev->desc, start, blkcnt, buffer);
+	bdev->stats.writes++;
+	bdev->stats.writeback += blkcnt;
+
+	return blks_written == blkcnt ? 0 : -EIO;
+}
+
+/*
+ * cache_flush_run() - write back a run of dirty blocks
+ *
+ * The run covers blocks from lines @dirty[first] to @dirty[last]. Those
+ * blocks are only marked clean once the device has taken them, so a failed
+ * write leaves them dirty and is tried again by the next flush.
+ */
+static int cache_flush_run(struct block_cache_dev *bdev,
+			   struct block_cache_line **dirty, unsigned int first,
+			   unsigned int last, lbaint_t start, lbaint_t blkcnt,
+			   const void *buffer)
+{
+	struct block_cache_line *line;
+	unsigned int i, idx;
+	lbaint_t blk;
+
+	if (cache_write_run(bdev, start, blkcnt, buffer))
+		return -EIO;
+	for (i = first; i <= last; i++) {
+		line = dirty[i];
+		for (idx = 0; idx < _stats.max_blocks_per_entry; idx++) {
+			blk = line->start + idx;
+			if ((line->dirty & BIT(idx)) && blk >= start &&
+			    blk < start + blkcnt) {
+				line->dirty &= ~BIT(idx);
+				bdev->stats.dirty--;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * cache_flush_dev() - write back the dirty blocks of a device
+ *
+ * Dirty lines are sorted by block number so that adjacent dirty blocks,
+ * even in different lines, go to the device in a single write.
+ */
+static int cache_flush_dev(struct block_cache_dev *bdev)
+{
+	struct block_cache_line **dirty, *line;
+	unsigned long blksz;
+	lbaint_t run_start = 0, run_len = 0;
+	unsigned int i, count = 0, idx, run_line = 0;
+	char *buf;
+	int ret = 0;
+
+	if (!bdev->desc || !lines || !bdev->stats.dirty)
+		return 0;
+
+	dirty = malloc(num_sets * num_ways * sizeof(*dirty));
+	if (!dirty)
+		return -ENOMEM;
+	for (i = 0; i < num_sets * num_ways; i++) {
+		line = &lines[i];
+		if (line->dirty && line->iftype == bdev->stats.iftype &&
+		    line->devnum == bdev->stats.devnum)
+			dirty[count++] = line;
+	}
+	if (!count)
+		goto out;
+
+	blksz = dirty[0]->blksz;
+	buf = malloc_cache_aligned(count * _stats.max_blocks_per_entry * blksz);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	qsort(dirty, count, sizeof(*dirty), cache_cmp_lines);
+	for (i = 0; i < count; i++) {
+		line = dirty[i];
+		for (idx = 0; idx < _stats.max_blocks_per_entry; idx++) {
+			lbaint_t blk = line->start + idx;
+
+			if (!(line->dirty & BIT(idx)))
+				continue;
+			if (run_len && blk != run_start + run_len) {
+				if (cache_flush_run(bdev, dirty, run_line, i,
+						    run_start, run_len, buf))
+					ret = -EIO;
+				run_len = 0;
+			}
+			if (!run_len) {
+				run_start = blk;
+				run_line = i;
+			}
+			memcpy(buf + run_len * blksz, line->data + idx * blksz,
+			       blksz);
+			run_len++;
+		}
+	}
+	if (run_len && cache_flush_run(bdev, dirty, run_line, count - 1,
+				       run_start, run_len, buf))
+		ret = -EIO;
+	free(buf);
+	if (ret)
+		printf("blkcache: write back to %s %d failed\n",
+		       blk_get_if_type_name(bdev->stats.iftype),
+		       bdev->stats.devnum);
+out:
+	free(dirty);
+
+	return ret;
+}
+
+static int cache_flush_line(struct block_cache_line *line)
+{
+	struct block_cache_dev *bdev;
+
+	bdev = cache_get_dev(line->iftype, line->devnum);
+	if (!bdev)
+		return -ENOSPC;
+
+	return cache_flush_dev(bdev);
+}
+
+/* find or allocate the line that will hold block @blk */
+static struct block_cache_line *cache_get_line(int iftype, int devnum,
+					       lbaint_t blk,
+					       unsigned long blksz)
+{
+	struct block_cache_line *set, *line, *victim = NULL;
+	lbaint_t start = line_start(blk);
+	unsigned long bytes = _stats.max_blocks_per_entry * blksz;
+	unsigned int way;
+
+	line = cache_find(iftype, devnum, blk, blksz);
+	if (line)
+		return line;
+
+	set = cache_set(iftype, devnum, start);
+	for (way = 0; way < num_ways; way++) {
+		line = &set[way];
+		if (!line->valid) {
+			victim = line;
+			break;
+		}
+		if (!victim || line->age < victim->age)
+			victim = line;
+	}
+
+	if (victim->dirty && cache_flush_line(victim))
+		return NULL;
+	if (victim->valid) {
+		debug("drop: start " LBAF ", valid %x\n", victim->start,
+		      victim->valid);
+		_stats.entries--;
+	}
+	victim->valid = 0;
+	if (victim->size < bytes) {
+		free(victim->data);
+		victim->data = malloc(bytes);
+		if (!victim->data) {
+			victim->size = 0;
+			return NULL;
+		}
+		victim->size = bytes;
+	}
+	victim->iftype = iftype;
+	victim->devnum = devnum;
+	victim->start = start;
+	victim->blksz = blksz;
+
+	return victim;
+}
+
+/*
+ * cache_copy_out() - copy the leading cached blocks of a request
+ *
+ * @return number of blocks copied to @buffer, starting at @start
+ */
+static lbaint_t cache_copy_out(int iftype, int devnum, lbaint_t start,
+			       lbaint_t blkcnt, unsigned long blksz,
+			       void *buffer)
+{
+	struct block_cache_line *line;
+	lbaint_t done = 0;
+
+	while (done < blkcnt) {
+		lbaint_t blk = start + done;
+		unsigned int idx, n = 0;
+
+		line = cache_find(iftype, devnum, blk, blksz);
+		if (!line)
+			break;
+		idx = blk - line->start;
+		while (idx + n < _stats.max_blocks_per_entry &&
+		       done + n < blkcnt && (line->valid & BIT(idx + n)))
+			n++;
+		if (!n)
+			break;
+		memcpy(buffer + done * blksz, line->data + idx * blksz,
+		       n * blksz);
+		line->age = ++clock;
+		done += n;
+	}
+
+	return done;
+}
+
+/* count the leading blocks of a request which are not in the cache */
+static lbaint_t cache_count_missing(int iftype, int devnum, lbaint_t start,
+				    lbaint_t blkcnt, unsigned long blksz)
+{
+	struct block_cache_line *line;
+	lbaint_t n;
+
+	for (n = 0; n < blkcnt; n++) {
+		line = cache_find(iftype, devnum, start + n, blksz);
+		if (line && (line->valid & BIT(start + n - line->start)))
+			break;
+	}
+
+	return n;
+}
+
+/*
+ * cache_insert() - add blocks to the cache
+ *
+ * Blocks read from the device never replace dirty blocks. If @bdev is
+ * given, the blocks are marked dirty for write-back to that device.
+ *
+ * @return 0 if all blocks were added, -ve on error
+ */
+static int cache_insert(int iftype, int devnum, lbaint_t start,
+			lbaint_t blkcnt, unsigned long blksz,
+			const void *buffer, struct block_cache_dev *bdev)
+{
+	struct block_cache_line *line;
+	lbaint_t done = 0;
+	int ret;
+
+	ret = cache_setup();
+	if (ret)
+		return ret;
+
+	debug("fill: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	while (done < blkcnt) {
+		lbaint_t blk = start + done;
+		unsigned int idx, n, i;
+
+		line = cache_get_line(iftype, devnum, blk, blksz);
+		if (!line)
+			return -ENOMEM;
+		idx = blk - line->start;
+		n = min_t(lbaint_t, _stats.max_blocks_per_entry - idx,
+			  blkcnt - done);
+		if (!line->valid)
+			_stats.entries++;
+		for (i = 0; i < n; i++) {
+			u32 mask = BIT(idx + i);
+
+			if (!bdev && (line->dirty & mask))
+				continue;
+			memcpy(line->data + (idx + i) * blksz,
+			       buffer + (done + i) * blksz, blksz);
+			line->valid |= mask;
+			if (bdev && !(line->dirty & mask)) {
+				line->dirty |= mask;
+				bdev->stats.dirty++;
 			}
-			return node;
 		}
+		line->age = ++clock;
+		done += n;
+	}
+
 	return 0;
 }
 
+/* drop cached copies of a range of blocks, dirty or not */
+static void cache_drop_range(int iftype, int devnum, lbaint_t start,
+			     lbaint_t blkcnt, unsigned long blksz)
+{
+	struct block_cache_dev *bdev = cache_get_dev(iftype, devnum);
+	struct block_cache_line *line;
+	unsigned int i;
+
+	if (!lines)
+		return;
+
+	/* walk the lines rather than the blocks, the range may be large */
+	for (i = 0; i < num_sets * num_ways; i++) {
+		lbaint_t first, last;
+		u32 mask;
+
+		line = &lines[i];
+		if (!line->valid || line->iftype != iftype ||
+		    line->devnum != devnum || line->blksz != blksz ||
+		    line->start >= start + blkcnt ||
+		    line->start + _stats.max_blocks_per_entry <= start)
+			continue;
+		first = max(line->start, start) - line->start;
+		last = min(line->start + _stats.max_blocks_per_entry,
+			   start + blkcnt) - line->start;
+		mask = GENMASK(last - 1, first);
+		if (bdev)
+			bdev->stats.dirty -= hweight32(line->dirty & mask);
+		line->dirty &= ~mask;
+		line->valid &= ~mask;
+		if (!line->valid)
+			_stats.entries--;
+	}
+}
+
+/* copy dirty blocks over data which was read from the device directly */
+static void cache_overlay_dirty(int iftype, int devnum, lbaint_t start,
+				lbaint_t blkcnt, unsigned long blksz,
+				void *buffer)
+{
+	struct block_cache_line *line;
+	unsigned int i, idx;
+
+	for (i = 0; i < num_sets * num_ways; i++) {
+		line = &lines[i];
+		if (!line->dirty || line->iftype != iftype ||
+		    line->devnum != devnum || line->blksz != blksz)
+			continue;
+		for (idx = 0; idx < _stats.max_blocks_per_entry; idx++) {
+			lbaint_t blk = line->start + idx;
+
+			if ((line->dirty & BIT(idx)) && blk >= start &&
+			    blk < start + blkcnt)
+				memcpy(buffer + (blk - start) * blksz,
+				       line->data + idx * blksz, blksz);
+		}
+	}
+}
+
+/*
+ * cache_readahead() - work out how far to read beyond a request
+ *
+ * Sequential requests double the readahead window, up to
+ * CONFIG_BLOCK_CACHE_READAHEAD blocks and a quarter of the cache capacity.
+ * A non-sequential request closes the window again.
+ */
+static lbaint_t cache_readahead(struct block_cache_dev *bdev, lbaint_t start)
+{
+	lbaint_t max = CONFIG_BLOCK_CACHE_READAHEAD;
+
+	max = min_t(lbaint_t, max,
+		    _stats.max_entries * _stats.max_blocks_per_entry / 4);
+	if (!bdev || !max)
+		return 0;
+
+	if (start == bdev->next && bdev->next) {
+		if (!bdev->ra_blocks)
+			bdev->ra_blocks = _stats.max_blocks_per_entry;
+		else
+			bdev->ra_blocks *= 2;
+		bdev->ra_blocks = min(bdev->ra_blocks, max);
+	} else {
+		bdev->ra_blocks = 0;
+	}
+
+	return bdev->ra_blocks;
+}
+
+ulong blkcache_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		     void *buffer, blkcache_read_fn read)
+{
+	struct block_cache_dev *bdev;
+	unsigned long blksz = desc->blksz;
+	lbaint_t left = blkcnt, ra;
+	void *buf = buffer;
+	lbaint_t pos = start;
+
+	bdev = cache_get_dev(desc->if_type, desc->devnum);
+
+	/* don't cache big stuff */
+	if (blkcnt > _stats.max_blocks_per_entry || !_stats.max_entries ||
+	    !_stats.max_blocks_per_entry) {
+		ulong blks_read = read(desc, start, blkcnt, buffer);
+
+		if (bdev && bdev->stats.dirty && blks_read == blkcnt)
+			cache_overlay_dirty(desc->if_type, desc->devnum, start,
+					    blkcnt, blksz, buffer);
+		return blks_read;
+	}
+
+	ra = cache_readahead(bdev, start);
+	if (bdev)
+		bdev->next = start + blkcnt;
+
+	while (left) {
+		lbaint_t n, total;
+		ulong blks_read;
+		void *dst;
+
+		n = cache_copy_out(desc->if_type, desc->devnum, pos, left,
+				   blksz, buf);
+		if (n) {
+			debug("hit: start " LBAF ", count " LBAFU "\n", pos, n);
+			_stats.hits += n;
+			if (bdev)
+				bdev->stats.hits += n;
+			pos += n;
+			buf += n * blksz;
+			left -= n;
+			continue;
+		}
+
+		n = cache_count_missing(desc->if_type, desc->devnum, pos, left,
+					blksz);
+		debug("miss: start " LBAF ", count " LBAFU "\n", pos, n);
+		_stats.misses += n;
+		if (bdev)
+			bdev->stats.misses += n;
+
+		/*
+		 * Only read ahead beyond the end of the request, and stop at
+		 * the first cached block since it may be dirty
+		 */
+		total = n;
+		if (n == left && ra) {
+			if (desc->lba && pos + n + ra > desc->lba)
+				ra = desc->lba > pos + n ? desc->lba - pos - n : 0;
+			total += cache_count_missing(desc->if_type,
+						     desc->devnum, pos + n, ra,
+						     blksz);
+		}
+
+		dst = buf;
+		if (total > n) {
+			dst = malloc_cache_aligned(total * blksz);
+			if (!dst) {
+				dst = buf;
+				total = n;
+			}
+		}
+
+		blks_read = read(desc, pos, total, dst);
+		if (bdev)
+			bdev->stats.reads++;
+		if (dst != buf && blks_read != total) {
+			/* readahead failed, e.g. at the end of the medium */
+			free(dst);
+			dst = buf;
+			total = n;
+			blks_read = read(desc, pos, total, dst);
+			if (bdev)
+				bdev->stats.reads++;
+		}
+		if (blks_read != total) {
+			if (blkcnt == left)
+				return blks_read;
+			return blkcnt - left;
+		}
+
+		cache_insert(desc->if_type, desc->devnum, pos, total, blksz,
+			     dst, NULL);
+		if (dst != buf) {
+			/* the missing blocks cannot be dirty, copy them all */
+			memcpy(buf, dst, n * blksz);
+			free(dst);
+			_stats.readahead += total - n;
+			if (bdev)
+				bdev->stats.readahead += total - n;
+		}
+		pos += n;
+		buf += n * blksz;
+		left -= n;
+	}
+
+	return blkcnt;
+}
+
+ulong blkcache_dwrite(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		      const void *buffer, blkcache_write_fn write)
+{
+	struct block_cache_dev *bdev;
+
+	bdev = cache_get_dev(desc->if_type, desc->devnum);
+	cache_drop_range(desc->if_type, desc->devnum, start, blkcnt,
+			 desc->blksz);
+
+	if (!IS_ENABLED(CONFIG_BLOCK_CACHE_WRITEBACK) || !bdev ||
+	    blkcnt > _stats.max_blocks_per_entry || !_stats.max_entries ||
+	    !_stats.max_blocks_per_entry) {
+		if (bdev)
+			bdev->stats.writes++;
+		return write(desc, start, blkcnt, buffer);
+	}
+
+	bdev->desc = desc;
+	bdev->write = write;
+	if (cache_insert(desc->if_type, desc->devnum, start, blkcnt,
+			 desc->blksz, buffer, bdev)) {
+		/* some blocks may be cached, make sure they are up to date */
+		bdev->stats.writes++;
+		return write(desc, start, blkcnt, buffer);
+	}
+
+	return blkcnt;
+}
+
+int blkcache_flush(int iftype, int devnum)
+{
+	int i;
+
+	for (i = 0; i < BLKCACHE_MAX_DEVS; i++) {
+		if (devs[i].used && devs[i].stats.iftype == iftype &&
+		    devs[i].stats.devnum == devnum)
+			return cache_flush_dev(&devs[i]);
+	}
+
+	return 0;
+}
+
+int blkcache_flush_all(void)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < BLKCACHE_MAX_DEVS; i++) {
+		if (devs[i].used && cache_flush_dev(&devs[i]))
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+	struct block_cache_dev *bdev = cache_get_dev(iftype, devnum);
+
+	if (blkcnt <= _stats.max_blocks_per_entry &&
+	    !cache_count_missing(iftype, devnum, start, blkcnt, blksz) &&
+	    cache_copy_out(iftype, devnum, start, blkcnt, blksz,
+			   buffer) == blkcnt) {
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
-		++_stats.hits;
+		_stats.hits += blkcnt;
+		if (bdev)
+			bdev->stats.hits += blkcnt;
 		return 1;
 	}
 
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
+	_stats.misses += blkcnt;
+	if (bdev)
+		bdev->stats.misses += blkcnt;
 	return 0;
 }
 
@@ -89,9 +754,6 @@ void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
-
 	/* don't cache big stuff */
 	if (blkcnt > _stats.max_blocks_per_entry)
 		return;
@@ -99,76 +761,76 @@ void blkcache_fill(int iftype, int devnum,
 	if (_stats.max_entries == 0)
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
+	cache_insert(iftype, devnum, start, blkcnt, blksz, buffer, NULL);
+}
+
+/* Drop the cache for a device, keeping dirty lines if @keep_dirty */
+static void cache_drop_dev(int iftype, int devnum, bool keep_dirty)
+{
+	struct block_cache_line *line;
+	unsigned int i;
+	int j;
+
+	for (j = 0; j < BLKCACHE_MAX_DEVS; j++) {
+		if (devs[j].used && devs[j].stats.iftype == iftype &&
+		    devs[j].stats.devnum == devnum) {
+			devs[j].next = 0;
+			devs[j].ra_blocks = 0;
+			if (!keep_dirty) {
+				devs[j].stats.dirty = 0;
+				devs[j].desc = NULL;
+				devs[j].write = NULL;
+			}
 		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
 	}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+	if (!lines)
+		return;
+
+	for (i = 0; i < num_sets * num_ways; i++) {
+		line = &lines[i];
+		if (line->valid && line->iftype == iftype &&
+		    line->devnum == devnum && !(keep_dirty && line->dirty)) {
+			line->valid = 0;
+			line->dirty = 0;
+			--_stats.entries;
 		}
 	}
+}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+int blkcache_invalidate(int iftype, int devnum)
+{
+	int ret;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	/* don't lose data which was written to the cache */
+	ret = blkcache_flush(iftype, devnum);
+	cache_drop_dev(iftype, devnum, ret != 0);
+
+	return ret;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_discard(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
-
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
-	}
+	cache_drop_dev(iftype, devnum, false);
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_configure(unsigned blocks, unsigned entries)
 {
-	struct block_cache_node *node;
+	int ret;
+
+	/* don't lose data which was written to the cache */
+	ret = blkcache_flush_all();
+	if (ret)
+		return ret;
+
+	/* lines are indexed by shifting, and their validity is a u32 bitmap */
+	blocks = min(blocks, (unsigned)BLKCACHE_MAX_LINE_BLOCKS);
+	if (blocks)
+		blocks = rounddown_pow_of_two(blocks);
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+		cache_free_lines();
 	}
 
 	_stats.max_blocks_per_entry = blocks;
@@ -176,11 +838,30 @@ void blkcache_configure(unsigned blocks, unsigned entries)
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readahead = 0;
+	memset(devs, '\0', sizeof(devs));
+
+	return 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
+	int i;
+
 	memcpy(stats, &_stats, sizeof(*stats));
+	stats->ways = lines ? num_ways : 0;
+	stats->num_devs = 0;
+	for (i = 0; i < BLKCACHE_MAX_DEVS; i++) {
+		if (devs[i].used)
+			stats->devs[stats->num_devs++] = devs[i].stats;
+		devs[i].stats.hits = 0;
+		devs[i].stats.misses = 0;
+		devs[i].stats.readahead = 0;
+		devs[i].stats.reads = 0;
+		devs[i].stats.writes = 0;
+		devs[i].stats.writeback = 0;
+	}
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readahead = 0;
 }
@@ -209,6 +209,7 @@ int device_remove(struct udevice *dev, uint flags)
 
 		dev->seq = -1;
 		dev->flags &= ~DM_FLAG_ACTIVATED;
+		uclass_index_invalidate(dev->uclass);
 	}
 
 	return ret;
@@ -24,6 +24,7 @@
 #include <dm/pinctrl.h>
 #include <dm/platdata.h>
 #include <dm/read.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -33,6 +34,22 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/*
+ * Binding or probing a device can change its name, node or sequence
+ * numbers, as well as those of any children its driver binds, so the
+ * uclass hash tables must be built again before use
+ */
+static void device_index_changed(struct udevice *dev)
+{
+	struct udevice *child;
+
+	if (!CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		return;
+	uclass_index_invalidate(dev->uclass);
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		uclass_index_invalidate(child->uclass);
+}
+
 static int device_bind_common(struct udevice *parent, const struct driver *drv,
 			      const char *name, void *platdata,
 			      ulong driver_data, ofnode node,
@@ -176,6 +193,7 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 		*devp = dev;
 
 	dev->flags |= DM_FLAG_BOUND;
+	device_index_changed(dev);
 
 	return 0;
 
@@ -382,6 +400,7 @@ int device_ofdata_to_platdata(struct udevice *dev)
 		ret = drv->ofdata_to_platdata(dev);
 		if (ret)
 			goto fail;
+		uclass_index_invalidate(dev->uclass);
 	}
 
 	dev->flags |= DM_FLAG_PLATDATA_VALID;
@@ -434,6 +453,7 @@ int device_probe(struct udevice *dev)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_index_invalidate(dev->uclass);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -487,6 +507,7 @@ int device_probe(struct udevice *dev)
 
 	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL)
 		pinctrl_select_state(dev, "default");
+	device_index_changed(dev);
 
 	return 0;
 fail_uclass:
@@ -498,6 +519,7 @@ fail:
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	dev->seq = -1;
+	uclass_index_invalidate(dev->uclass);
 	device_free(dev);
 
 	return ret;
@@ -717,6 +739,8 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	if (!*devp && !dm_lazy_bind_ofnode(ofnode))
+		*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 
 	return *devp ? 0 : -ENOENT;
 }
@@ -726,6 +750,8 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 	struct udevice *dev;
 
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	if (!dev && !dm_lazy_bind_ofnode(ofnode))
+		dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
 
@@ -937,6 +963,7 @@ int device_set_name(struct udevice *dev, const char *name)
 		return -ENOMEM;
 	dev->name = name;
 	device_set_name_alloced(dev);
+	uclass_index_invalidate(dev->uclass);
 
 	return 0;
 }
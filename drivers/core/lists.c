@@ -9,8 +9,11 @@
 #define LOG_CATEGORY LOGC_DM
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <open_hash.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -19,6 +22,9 @@
 #include <dm/util.h>
 #include <fdtdec.h>
 #include <linux/compiler.h>
+#include <linux/err.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -125,11 +131,182 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
-		   bool pre_reloc_only)
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/*
+ * Each slot holds the index of the driver in the top 16 bits and the index
+ * of the compatible string in its of_match list in the bottom 16 bits, plus
+ * one so that 0 marks an empty slot
+ */
+#define COMPAT_SLOT(drv, idx)	(((drv) << 16 | (idx)) + 1)
+#define COMPAT_SLOT_DRV(slot)	(((slot) - 1) >> 16)
+#define COMPAT_SLOT_IDX(slot)	(((slot) - 1) & 0xffff)
+
+/**
+ * struct dm_compat_index - hash table of the drivers' compatible strings
+ *
+ * Only the first driver with a given compatible string is entered, since
+ * that is the one which a linear search finds.
+ *
+ * @drivers:	Start of the driver list when the table was built; the table
+ *		must be built again if the list has moved, e.g. by relocation
+ * @mask:	Number of slots minus one
+ * @slots:	Slots, see COMPAT_SLOT()
+ */
+struct dm_compat_index {
+	struct driver *drivers;
+	uint mask;
+	u32 slots[];
+};
+
+static const struct udevice_id *compat_slot_id(struct driver *driver,
+					       u32 slot)
+{
+	return &driver[COMPAT_SLOT_DRV(slot)].of_match[COMPAT_SLOT_IDX(slot)];
+}
+
+/**
+ * compat_index_find() - find the slot for a compatible string
+ *
+ * @index:	Index to search
+ * @compat:	Compatible string to look for
+ * @return pointer to the slot holding @compat, or to the empty slot where it
+ *	belongs
+ */
+static u32 *compat_index_find(struct dm_compat_index *index,
+			      const char *compat)
+{
+	u32 *slot;
+	uint pos;
+
+	open_hash_for_each_slot(pos, open_hash_str(compat), index->mask) {
+		slot = &index->slots[pos];
+		if (!*slot || !strcmp(compat_slot_id(index->drivers,
+						     *slot)->compatible, compat))
+			return slot;
+	}
+}
+
+/*
+ * Before relocation, only use the pre-relocation malloc() area if it has
+ * plenty of space left for the devices still to be bound
+ */
+static bool compat_index_fits(size_t size)
+{
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return gd->malloc_limit - gd->malloc_ptr >= size * 4;
+#endif
+	return true;
+}
+
+static struct dm_compat_index *compat_index_build(struct driver *driver,
+						  int n_ents)
+{
+	const struct udevice_id *id;
+	struct dm_compat_index *index;
+	uint count = 0, slots;
+	size_t size;
+	int drv, idx;
+	u32 *slot;
+
+	if (n_ents > 0xffff)
+		return NULL;
+	for (drv = 0; drv < n_ents; drv++) {
+		for (idx = 0, id = driver[drv].of_match; id && id->compatible;
+		     idx++, id++) {
+			if (idx == 0xffff)
+				return NULL;
+			count++;
+		}
+	}
+
+	slots = open_hash_slots(count, 2);
+	size = sizeof(*index) + slots * sizeof(u32);
+	if (!compat_index_fits(size))
+		return NULL;
+	index = calloc(1, size);
+	if (!index)
+		return NULL;
+	index->drivers = driver;
+	index->mask = slots - 1;
+
+	for (drv = 0; drv < n_ents; drv++) {
+		for (idx = 0, id = driver[drv].of_match; id && id->compatible;
+		     idx++, id++) {
+			slot = compat_index_find(index, id->compatible);
+			if (!*slot)
+				*slot = COMPAT_SLOT(drv, idx);
+		}
+	}
+	log_debug("Indexed %u compatible strings in %u slots\n", count, slots);
+
+	return index;
+}
+
+/*
+ * Get the index of the drivers' compatible strings, building it if needed.
+ * If it cannot be built, an error pointer is stored so that later lookups go
+ * straight to a linear search. board_init_r() clears it after relocation, so
+ * a build which failed for lack of space is tried again there.
+ */
+static struct dm_compat_index *compat_index_get(struct driver *driver,
+						int n_ents)
+{
+	struct dm_compat_index *index = gd->dm_compat_index;
+
+	if (IS_ERR(index))
+		return NULL;
+	if (index && index->drivers == driver)
+		return index;
+
+	/*
+	 * An index built before relocation is in the pre-relocation malloc()
+	 * area, so it is not freed
+	 */
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_INDEX, "dm_index");
+	index = compat_index_build(driver, n_ents);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_INDEX);
+	gd->dm_compat_index = index ? index : ERR_PTR(-ENOMEM);
+
+	return index;
+}
+#endif /* DM_COMPAT_INDEX */
+
+int lists_driver_lookup_compat(const char *compat, struct driver **drvp,
+			       const struct udevice_id **idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	struct dm_compat_index *index;
+	u32 slot;
+
+	index = compat_index_get(driver, n_ents);
+	if (index) {
+		slot = *compat_index_find(index, compat);
+		if (!slot)
+			return -ENOENT;
+		*drvp = &driver[COMPAT_SLOT_DRV(slot)];
+		*idp = compat_slot_id(driver, slot);
+
+		return 0;
+	}
+#endif
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, idp, compat)) {
+			*drvp = entry;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+		   bool pre_reloc_only)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -166,13 +343,8 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		log_debug("   - attempt to match compatible string '%s'\n",
 			  compat);
 
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
-		}
-		if (entry == driver + n_ents)
+		ret = lists_driver_lookup_compat(compat, &entry, &id);
+		if (ret)
 			continue;
 
 		if (pre_reloc_only) {
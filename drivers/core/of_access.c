@@ -22,6 +22,7 @@
 #include <common.h>
 #include <log.h>
 #include <malloc.h>
+#include <open_hash.h>
 #include <linux/bug.h>
 #include <linux/libfdt.h>
 #include <dm/of_access.h>
@@ -46,6 +47,14 @@ static struct device_node *of_stdout;
 /* pointer to options given after the alias (separated by :) or NULL if none */
 static const char *of_stdout_options;
 
+/*
+ * Nodes of the tree at of_phandle_root with a phandle, in a hash table of
+ * of_phandle_mask + 1 slots, see of_phandle_cache_build()
+ */
+static struct device_node *of_phandle_root;
+static struct device_node **of_phandle_cache;
+static uint of_phandle_mask;
+
 /**
  * struct alias_prop - Alias property in 'aliases' node
  *
@@ -438,6 +447,58 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 	return np;
 }
 
+/*
+ * Find the slot for a phandle, which is either empty or holds its node.
+ * Phandles are mostly allocated in sequence, so they are their own hash.
+ */
+static struct device_node **of_phandle_slot(phandle handle)
+{
+	struct device_node **slot;
+	uint pos;
+
+	open_hash_for_each_slot(pos, handle, of_phandle_mask) {
+		slot = &of_phandle_cache[pos];
+		if (!*slot || (*slot)->phandle == handle)
+			return slot;
+	}
+}
+
+void of_phandle_cache_invalidate(void)
+{
+	free(of_phandle_cache);
+	of_phandle_cache = NULL;
+	of_phandle_root = NULL;
+}
+
+int of_phandle_cache_build(struct device_node *root)
+{
+	struct device_node **slot;
+	struct device_node *np;
+	uint count = 0;
+
+	of_phandle_cache_invalidate();
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		if (np->phandle)
+			count++;
+	}
+
+	/* If there is no memory, lookups search the tree instead */
+	of_phandle_root = root;
+	of_phandle_mask = open_hash_slots(count, 2) - 1;
+	of_phandle_cache = calloc(of_phandle_mask + 1, sizeof(np));
+	if (!of_phandle_cache)
+		return -ENOMEM;
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		if (!np->phandle)
+			continue;
+		slot = of_phandle_slot(np->phandle);
+		if (!*slot)
+			*slot = np;
+	}
+
+	return 0;
+}
+
 struct device_node *of_find_node_by_phandle(phandle handle)
 {
 	struct device_node *np;
@@ -445,6 +506,15 @@ struct device_node *of_find_node_by_phandle(phandle handle)
 	if (!handle)
 		return NULL;
 
+	if (of_phandle_root != gd->of_root)
+		of_phandle_cache_build(gd->of_root);
+	if (of_phandle_cache) {
+		np = *of_phandle_slot(handle);
+		if (np)
+			return of_node_get(np);
+	}
+
+	/* Nodes are never added to a live tree, but check just in case */
 	for_each_of_allnodes(np)
 		if (np->phandle == handle)
 			break;
@@ -775,8 +845,15 @@ static void of_alias_add(struct alias_prop *ap, struct device_node *np,
 
 int of_alias_scan(void)
 {
+	struct alias_prop *ap, *next;
 	struct property *pp;
 
+	/* Drop the aliases of any tree scanned before */
+	list_for_each_entry_safe(ap, next, &aliases_lookup, link) {
+		list_del(&ap->link);
+		free(ap);
+	}
+
 	of_aliases = of_find_node_by_path("/aliases");
 	of_chosen = of_find_node_by_path("/chosen");
 	if (of_chosen == NULL)
@@ -7,6 +7,7 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <fdtdec.h>
 #include <log.h>
@@ -138,8 +139,23 @@ int dm_init(bool of_live)
 		dm_warn("Virtual root driver already exists!\n");
 		return -EINVAL;
 	}
+	dm_lazy_reset();
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
 
+	/*
+	 * Index uclasses by ID once the table can be freed, i.e. after
+	 * relocation. A table left by an earlier dm_init() is reused.
+	 */
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX) &&
+	    (gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		if (gd->uclass_tab)
+			memset(gd->uclass_tab, '\0',
+			       UCLASS_COUNT * sizeof(struct uclass *));
+		else
+			gd->uclass_tab = calloc(UCLASS_COUNT,
+						sizeof(struct uclass *));
+	}
+
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
 	fix_drivers();
 	fix_uclass();
@@ -169,6 +185,7 @@ int dm_uninit(void)
 	device_remove(dm_root(), DM_REMOVE_NORMAL);
 	device_unbind(dm_root());
 	gd->dm_root = NULL;
+	dm_lazy_reset();
 
 	return 0;
 }
@@ -309,14 +326,16 @@ static int dm_scan_fdt_ofnode_path(const void *blob, const char *path,
 				pre_reloc_only);
 }
 
+/* Some nodes aren't devices themselves but may contain some */
+static const char * const dm_scan_extra_nodes[] = {
+	"/chosen",
+	"/clocks",
+	"/firmware"
+};
+
 int dm_extended_scan_fdt(const void *blob, bool pre_reloc_only)
 {
 	int ret, i;
-	const char * const nodes[] = {
-		"/chosen",
-		"/clocks",
-		"/firmware"
-	};
 
 	ret = dm_scan_fdt(blob, pre_reloc_only);
 	if (ret) {
@@ -324,18 +343,329 @@ int dm_extended_scan_fdt(const void *blob, bool pre_reloc_only)
 		return ret;
 	}
 
-	/* Some nodes aren't devices themselves but may contain some */
-	for (i = 0; i < ARRAY_SIZE(nodes); i++) {
-		ret = dm_scan_fdt_ofnode_path(blob, nodes[i], pre_reloc_only);
+	for (i = 0; i < ARRAY_SIZE(dm_scan_extra_nodes); i++) {
+		ret = dm_scan_fdt_ofnode_path(blob, dm_scan_extra_nodes[i],
+					       pre_reloc_only);
 		if (ret) {
 			debug("dm_scan_fdt() scan for %s failed: %d\n",
-			      nodes[i], ret);
+			      dm_scan_extra_nodes[i], ret);
+			return ret;
+		}
+	}
+
+	return ret;
+}
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/**
+ * struct dm_lazy_ref - a node which can provide a device in a uclass
+ *
+ * @node:	Node with a compatible string which a driver matches
+ * @id:		Uclass of that driver
+ * @top:	Index into dm_lazy.tops of the node to bind to get the device
+ */
+struct dm_lazy_ref {
+	ofnode node;
+	enum uclass_id id;
+	int top;
+};
+
+/**
+ * struct dm_lazy_top - a top-level node waiting to be bound
+ *
+ * @node:	Node to bind as a child of the root device
+ * @bound:	true once it has been bound
+ * @any:	true if binding it may give devices in any uclass, since a
+ *		driver binds subnodes which have no compatible string
+ */
+struct dm_lazy_top {
+	ofnode node;
+	bool bound;
+	bool any;
+};
+
+/*
+ * Lazy binding only happens after relocation, so this can live in BSS, but
+ * must not be touched before then. The refs are in device tree order, so the
+ * devices of a uclass are bound in that order, although a node may be bound
+ * earlier for another uclass.
+ */
+static struct dm_lazy {
+	struct dm_lazy_top *tops;
+	int top_count;
+	int top_size;
+	struct dm_lazy_ref *refs;
+	int ref_count;
+	int ref_size;
+	bool done[UCLASS_COUNT];
+	bool busy;
+} dm_lazy;
+
+static void *dm_lazy_grow(void *ptr, int count, int *sizep, size_t each)
+{
+	int size;
+
+	if (count < *sizep)
+		return ptr;
+	size = *sizep ? *sizep * 2 : 32;
+	ptr = realloc(ptr, size * each);
+	if (ptr)
+		*sizep = size;
+
+	return ptr;
+}
+
+/*
+ * A driver or its uclass may bind subnodes itself, e.g. PMIC regulators which
+ * are matched by node name. These have no compatible string so cannot be
+ * recorded, and may be in any uclass.
+ */
+static bool dm_lazy_binds_subnodes(ofnode node, struct driver *drv)
+{
+	struct uclass_driver *uc_drv;
+	ofnode subnode;
+
+	uc_drv = lists_uclass_lookup(drv->id);
+	if (!drv->bind && !(uc_drv && uc_drv->post_bind))
+		return false;
+	ofnode_for_each_subnode(subnode, node) {
+		if (ofnode_is_available(subnode) &&
+		    !ofnode_get_property(subnode, "compatible", NULL))
+			return true;
+	}
+
+	return false;
+}
+
+/* Record each uclass that @node can provide, returning how many were found */
+static int dm_lazy_add_refs(ofnode node, int top)
+{
+	const struct udevice_id *of_id;
+	const char *compat_list, *compat;
+	struct dm_lazy_ref *refs;
+	struct driver *drv;
+	int len, i, found = 0;
+
+	compat_list = ofnode_get_property(node, "compatible", &len);
+	if (!compat_list)
+		return 0;
+
+	/* Drivers may refuse to bind, so record all that might be used */
+	for (i = 0; i < len; i += strlen(compat) + 1) {
+		compat = compat_list + i;
+		if (lists_driver_lookup_compat(compat, &drv, &of_id))
+			continue;
+		refs = dm_lazy_grow(dm_lazy.refs, dm_lazy.ref_count,
+				    &dm_lazy.ref_size, sizeof(*refs));
+		if (!refs)
+			return -ENOMEM;
+		dm_lazy.refs = refs;
+		refs[dm_lazy.ref_count].node = node;
+		refs[dm_lazy.ref_count].id = drv->id;
+		refs[dm_lazy.ref_count].top = top;
+		dm_lazy.ref_count++;
+		found++;
+		if (dm_lazy_binds_subnodes(node, drv))
+			dm_lazy.tops[top].any = true;
+	}
+
+	return found;
+}
+
+static int dm_lazy_scan_subtree(ofnode parent, int top)
+{
+	ofnode node;
+	int ret;
+
+	ofnode_for_each_subnode(node, parent) {
+		if (!ofnode_is_available(node))
+			continue;
+		ret = dm_lazy_add_refs(node, top);
+		if (ret < 0)
+			return ret;
+		ret = dm_lazy_scan_subtree(node, top);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int dm_lazy_scan_node(ofnode parent)
+{
+	struct dm_lazy_top *tops;
+	ofnode node;
+	int ret, top;
+
+	if (!ofnode_valid(parent))
+		return 0;
+	ofnode_for_each_subnode(node, parent) {
+		if (!ofnode_is_available(node))
+			continue;
+		top = dm_lazy.top_count;
+		tops = dm_lazy_grow(dm_lazy.tops, top, &dm_lazy.top_size,
+				    sizeof(*tops));
+		if (!tops)
+			return -ENOMEM;
+		dm_lazy.tops = tops;
+		tops[top].node = node;
+		tops[top].bound = false;
+		tops[top].any = false;
+		ret = dm_lazy_add_refs(node, top);
+		if (ret < 0)
+			return ret;
+		/* If no driver matches, the node would not be bound anyway */
+		if (!ret)
+			continue;
+		dm_lazy.top_count++;
+		ret = dm_lazy_scan_subtree(node, top);
+		if (ret)
 			return ret;
+	}
+
+	return 0;
+}
+
+int dm_scan_fdt_lazy(void)
+{
+	int ret, i;
+
+	dm_lazy_reset();
+	ret = dm_lazy_scan_node(ofnode_path("/"));
+	for (i = 0; !ret && i < ARRAY_SIZE(dm_scan_extra_nodes); i++)
+		ret = dm_lazy_scan_node(ofnode_path(dm_scan_extra_nodes[i]));
+	if (ret) {
+		dm_lazy_reset();
+		return ret;
+	}
+	log_debug("%d nodes to bind on demand\n", dm_lazy.top_count);
+
+	return 0;
+}
+
+static int dm_lazy_bind_top(int top)
+{
+	struct dm_lazy_top *entry = &dm_lazy.tops[top];
+	struct udevice *dev;
+	int ret;
+
+	if (entry->bound)
+		return 0;
+	entry->bound = true;
+
+	/* It may have been bound already, e.g. by the 'bind' command */
+	list_for_each_entry(dev, &gd->dm_root->child_head, sibling_node) {
+		if (ofnode_equal(dev_ofnode(dev), entry->node))
+			return 0;
+	}
+	ret = lists_bind_fdt(gd->dm_root, entry->node, NULL, false);
+	if (ret)
+		dm_warn("%s: bind failed, ret=%d\n",
+			ofnode_get_name(entry->node), ret);
+
+	return ret;
+}
+
+/*
+ * Binding a device calls uclass_get() for its uclass (and perhaps others),
+ * which must not start binding more devices while this is in progress
+ */
+static bool dm_lazy_start(void)
+{
+	if (!(gd->flags & GD_FLG_RELOC) || dm_lazy.busy || !dm_lazy.top_count)
+		return false;
+	dm_lazy.busy = true;
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_LAZY, "dm_lazy");
+
+	return true;
+}
+
+static void dm_lazy_finish(int ret)
+{
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_LAZY);
+	dm_lazy.busy = false;
+	if (ret)
+		dm_warn("Some drivers failed to bind\n");
+}
+
+int dm_lazy_bind_uclass(enum uclass_id id)
+{
+	int ret = 0, err, i;
+
+	if (id < 0 || id >= UCLASS_COUNT || !(gd->flags & GD_FLG_RELOC) ||
+	    dm_lazy.done[id])
+		return 0;
+	if (!dm_lazy_start())
+		return 0;
+	for (i = 0; i < dm_lazy.ref_count; i++) {
+		struct dm_lazy_ref *ref = &dm_lazy.refs[i];
+
+		if (ref->id != id && !dm_lazy.tops[ref->top].any)
+			continue;
+		err = dm_lazy_bind_top(ref->top);
+		if (err && !ret)
+			ret = err;
+	}
+	dm_lazy.done[id] = true;
+	dm_lazy_finish(ret);
+
+	/*
+	 * As with a full scan, a node which fails to bind is reported and then
+	 * skipped. Its devices are simply not found, whichever uclass is used
+	 * first.
+	 */
+	return 0;
+}
+
+int dm_lazy_bind_ofnode(ofnode node)
+{
+	int ret, i;
+
+	if (!dm_lazy_start())
+		return -ENOENT;
+	ret = -ENOENT;
+	for (i = 0; i < dm_lazy.ref_count; i++) {
+		struct dm_lazy_ref *ref = &dm_lazy.refs[i];
+
+		if (ofnode_equal(ref->node, node) &&
+		    !dm_lazy.tops[ref->top].bound) {
+			ret = dm_lazy_bind_top(ref->top);
+			break;
 		}
 	}
+	dm_lazy_finish(ret == -ENOENT ? 0 : ret);
 
 	return ret;
 }
+
+int dm_lazy_bind_all(void)
+{
+	int ret = 0, err, i;
+
+	if (!dm_lazy_start())
+		return 0;
+	for (i = 0; i < dm_lazy.top_count; i++) {
+		err = dm_lazy_bind_top(i);
+		if (err && !ret)
+			ret = err;
+	}
+	for (i = 0; i < UCLASS_COUNT; i++)
+		dm_lazy.done[i] = true;
+	dm_lazy_finish(ret);
+
+	return 0;
+}
+
+void dm_lazy_reset(void)
+{
+	/* There is no BSS before relocation, and nothing to drop either */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	free(dm_lazy.tops);
+	free(dm_lazy.refs);
+	memset(&dm_lazy, '\0', sizeof(dm_lazy));
+}
+#endif /* DM_LAZY_BIND */
 #endif
 
 __weak int dm_scan_other(bool pre_reloc_only)
@@ -359,7 +689,13 @@ int dm_init_and_scan(bool pre_reloc_only)
 	}
 
 	if (CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)) {
-		ret = dm_extended_scan_fdt(gd->fdt_blob, pre_reloc_only);
+		/* Bind everything if lazy binding is not used or fails */
+		ret = -ENOSYS;
+		if (CONFIG_IS_ENABLED(DM_LAZY_BIND) && !pre_reloc_only)
+			ret = dm_scan_fdt_lazy();
+		if (ret)
+			ret = dm_extended_scan_fdt(gd->fdt_blob,
+						   pre_reloc_only);
 		if (ret) {
 			debug("dm_extended_scan_dt() failed: %d\n", ret);
 			return ret;
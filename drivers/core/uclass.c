@@ -13,26 +13,216 @@
 #include <errno.h>
 #include <log.h>
 #include <malloc.h>
+#include <open_hash.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
+#include <linux/bitops.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Keys which devices in a uclass can be looked up by */
+enum uclass_index_key {
+	UCLASS_INDEX_NAME,
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_REQ_SEQ,
+	UCLASS_INDEX_NODE,
+
+	UCLASS_INDEX_COUNT,
+};
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * struct uclass_index - hash tables of the devices in a uclass
+ *
+ * Each table holds the devices which have a value for one key, using open
+ * addressing. A table is built from the device list when first used, and
+ * again when used after uclass_index_invalidate(), so entries are never
+ * removed. Devices are added in list order, so where several have the same
+ * key, the one found first is the first in the list, as with a linear
+ * search.
+ *
+ * @dirty:	Bitmask of tables which must be built before use, indexed by
+ *		enum uclass_index_key
+ * @mask:	Number of slots in each table minus one
+ * @tab:	Tables, each with @mask + 1 slots, or NULL if not allocated
+ */
+struct uclass_index {
+	uint dirty;
+	uint mask;
+	struct udevice **tab[UCLASS_INDEX_COUNT];
+};
+
+/* Get a device's value for a key, returning false if it has none */
+static bool uclass_index_val(struct udevice *dev, enum uclass_index_key key,
+			     long *valp)
+{
+	switch (key) {
+	case UCLASS_INDEX_NAME:
+		*valp = (long)dev->name;
+		return dev->name;
+	case UCLASS_INDEX_SEQ:
+		*valp = dev->seq;
+		return dev->seq != -1;
+	case UCLASS_INDEX_REQ_SEQ:
+		*valp = dev->req_seq;
+		return dev->req_seq != -1;
+	default:
+		*valp = dev->node.of_offset;
+		return ofnode_valid(dev->node);
+	}
+}
+
+static uint uclass_index_hash(enum uclass_index_key key, long val)
+{
+	if (key == UCLASS_INDEX_NAME)
+		return open_hash_str((const char *)val);
+
+	return open_hash_long(val);
+}
+
+static bool uclass_index_match(struct udevice *dev, enum uclass_index_key key,
+			       long val)
+{
+	long dev_val;
+
+	if (!uclass_index_val(dev, key, &dev_val))
+		return false;
+	if (key == UCLASS_INDEX_NAME)
+		return !strcmp((const char *)dev_val, (const char *)val);
+
+	return dev_val == val;
+}
+
+/* Get the table for a key, building it if needed */
+static struct udevice **uclass_index_table(struct uclass *uc,
+					   enum uclass_index_key key)
+{
+	struct uclass_index *index = uc->index;
+	struct udevice *dev, **tab;
+	uint slots, pos;
+	long val;
+	int i;
+
+	/* Tables built before relocation could not be freed */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return NULL;
+	if (!index) {
+		index = calloc(1, sizeof(*index));
+		if (!index)
+			return NULL;
+		index->dirty = ~0U;
+		uc->index = index;
+	}
+	if (!(index->dirty & BIT(key)))
+		return index->tab[key];
+
+	slots = open_hash_slots(list_count_items(&uc->dev_head), 16);
+	if (slots > index->mask + 1) {
+		for (i = 0; i < UCLASS_INDEX_COUNT; i++) {
+			free(index->tab[i]);
+			index->tab[i] = NULL;
+		}
+		index->mask = slots - 1;
+		index->dirty = ~0U;
+	}
+	tab = index->tab[key];
+	if (!tab) {
+		tab = malloc((index->mask + 1) * sizeof(*tab));
+		if (!tab)
+			return NULL;
+		index->tab[key] = tab;
+	}
+
+	memset(tab, '\0', (index->mask + 1) * sizeof(*tab));
+	uclass_foreach_dev(dev, uc) {
+		if (!uclass_index_val(dev, key, &val))
+			continue;
+		open_hash_for_each_slot(pos, uclass_index_hash(key, val),
+					index->mask) {
+			if (!tab[pos])
+				break;
+		}
+		tab[pos] = dev;
+	}
+	index->dirty &= ~BIT(key);
+
+	return tab;
+}
+
+/**
+ * uclass_index_lookup() - find a device in a uclass using its hash tables
+ *
+ * @uc:		uclass to search
+ * @key:	Key to look up
+ * @val:	Value to look for: a string for UCLASS_INDEX_NAME, else a number
+ *		or the ofnode's of_offset
+ * @devp:	Returns the first device in the uclass with that value
+ * @return 0 if found, -ENODEV if not, -EAGAIN if there is no table, so the
+ *	caller must search the device list itself
+ */
+static int uclass_index_lookup(struct uclass *uc, enum uclass_index_key key,
+			       long val, struct udevice **devp)
+{
+	struct udevice **tab, *dev;
+	uint pos;
+
+	tab = uclass_index_table(uc, key);
+	if (!tab)
+		return -EAGAIN;
+	open_hash_for_each_slot(pos, uclass_index_hash(key, val),
+				uc->index->mask) {
+		dev = tab[pos];
+		if (!dev)
+			return -ENODEV;
+		if (uclass_index_match(dev, key, val)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+}
+
+void uclass_index_invalidate(struct uclass *uc)
+{
+	if (uc->index)
+		uc->index->dirty = ~0U;
+}
+
+static void uclass_index_free(struct uclass *uc)
+{
+	int i;
+
+	if (!uc->index)
+		return;
+	for (i = 0; i < UCLASS_INDEX_COUNT; i++)
+		free(uc->index->tab[i]);
+	free(uc->index);
+	uc->index = NULL;
+}
+#else
+static inline int uclass_index_lookup(struct uclass *uc,
+				      enum uclass_index_key key, long val,
+				      struct udevice **devp)
+{
+	return -EAGAIN;
+}
+
+static inline void uclass_index_free(struct uclass *uc) {}
+#endif
+
 struct uclass *uclass_find(enum uclass_id key)
 {
 	struct uclass *uc;
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX) && gd->uclass_tab)
+		return (uint)key < UCLASS_COUNT ? gd->uclass_tab[key] : NULL;
+
 	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -82,6 +272,8 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+	if (gd->uclass_tab)
+		gd->uclass_tab[id] = uc;
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -98,6 +290,8 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+	if (gd->uclass_tab)
+		gd->uclass_tab[id] = NULL;
 fail_mem:
 	free(uc);
 
@@ -131,8 +325,11 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	if (gd->uclass_tab)
+		gd->uclass_tab[uc_drv->id] = NULL;
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
+	uclass_index_free(uc);
 	free(uc);
 
 	return 0;
@@ -141,8 +338,12 @@ int uclass_destroy(struct uclass *uc)
 int uclass_get(enum uclass_id id, struct uclass **ucp)
 {
 	struct uclass *uc;
+	int ret;
 
 	*ucp = NULL;
+	ret = dm_lazy_bind_uclass(id);
+	if (ret)
+		return ret;
 	uc = uclass_find(id);
 	if (!uc)
 		return uclass_add(id, ucp);
@@ -261,6 +462,9 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_lookup(uc, UCLASS_INDEX_NAME, (long)name, devp);
+	if (ret != -EAGAIN)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		if (!strcmp(dev->name, name)) {
@@ -308,6 +512,12 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_lookup(uc, find_req_seq ? UCLASS_INDEX_REQ_SEQ :
+				  UCLASS_INDEX_SEQ, seq_or_req_seq, devp);
+	if (ret != -EAGAIN) {
+		log_debug("   - %s\n", ret ? "not found" : "found");
+		return ret;
+	}
 
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - %d %d '%s'\n",
@@ -362,6 +572,9 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_lookup(uc, UCLASS_INDEX_NODE, node.of_offset, devp);
+	if (ret != -EAGAIN)
+		goto done;
 
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
@@ -650,6 +863,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_invalidate(uc);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -665,6 +879,7 @@ int uclass_bind_device(struct udevice *dev)
 err:
 	/* There is no need to undo the parent's post_bind call */
 	list_del(&dev->uclass_node);
+	uclass_index_invalidate(uc);
 
 	return ret;
 }
@@ -683,6 +898,8 @@ int uclass_unbind_device(struct udevice *dev)
 	}
 
 	list_del(&dev->uclass_node);
+	uclass_index_invalidate(uc);
+
 	return 0;
 }
 #endif
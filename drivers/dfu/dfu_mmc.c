@@ -219,6 +219,8 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 	if (dfu->layout != DFU_RAW_ADDR) {
 		/* Do stuff here. */
 		ret = mmc_file_buf_write_finish(dfu);
+	} else {
+		ret = blkcache_flush(IF_TYPE_MMC, dfu->data.mmc.dev_num);
 	}
 
 	return ret;
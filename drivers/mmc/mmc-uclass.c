@@ -222,6 +222,8 @@ int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 		cfg->host_caps |= MMC_CAP(MMC_HS_400);
 	if (dev_read_bool(dev, "mmc-hs400-enhanced-strobe"))
 		cfg->host_caps |= MMC_CAP(MMC_HS_400_ES);
+	if (dev_read_bool(dev, "u-boot,cap-cmd23"))
+		cfg->host_caps |= MMC_CAP_CMD23;
 
 	if (dev_read_bool(dev, "non-removable")) {
 		cfg->host_caps |= MMC_CAP_NONREMOVABLE;
@@ -416,11 +418,16 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
+	/* Dirty blocks must reach the partition they were written to */
+	ret = blkcache_flush(desc->if_type, desc->devnum);
+	if (ret)
+		return ret;
+
 	ret = mmc_switch_part(mmc, hwpart);
-	if (!ret)
-		blkcache_invalidate(desc->if_type, desc->devnum);
+	if (ret)
+		return ret;
 
-	return ret;
+	return blkcache_invalidate(desc->if_type, desc->devnum);
 }
 
 static int mmc_blk_probe(struct udevice *dev)
@@ -372,11 +372,33 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 #endif
 
+bool mmc_set_block_count(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+
+	if (!(mmc->cfg->host_caps & MMC_CAP_CMD23) || mmc_host_is_spi(mmc))
+		return false;
+	if (blkcnt < 2 || blkcnt > 0xffff)
+		return false;
+	if (IS_SD(mmc) ? !(mmc->scr[0] & SD_SCR_CMD23) :
+	    mmc->version < MMC_VERSION_3)
+		return false;
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blkcnt;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return !mmc_send_cmd(mmc, &cmd, NULL);
+}
+
 static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
+	bool sbc;
+
+	sbc = mmc_set_block_count(mmc, blkcnt);
 
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -397,8 +419,9 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
+	mmc->stats.read_cmds++;
 
-	if (blkcnt > 1) {
+	if (blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -436,6 +459,7 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	int dev_num = block_dev->devnum;
 	int err;
 	lbaint_t cur, blocks_todo = blkcnt;
+	ulong start_us;
 	uint b_max;
 
 	if (blkcnt == 0)
@@ -468,6 +492,7 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
+	start_us = timer_get_us();
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -478,6 +503,8 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		start += cur;
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
+	mmc->stats.read_blocks += blkcnt;
+	mmc->stats.read_us += timer_get_us() - start_us;
 
 	return blkcnt;
 }
@@ -16,6 +16,20 @@ int mmc_send_status(struct mmc *mmc, unsigned int *status);
 int mmc_poll_for_busy(struct mmc *mmc, int timeout);
 
 int mmc_set_blocklen(struct mmc *mmc, int len);
+
+/**
+ * mmc_set_block_count() - set the length of the next multi-block transfer
+ *
+ * This sends CMD23 (SET_BLOCK_COUNT) if both the host and the card support
+ * it, so that the transfer ends by itself and no STOP_TRANSMISSION is
+ * needed.
+ *
+ * @mmc:	MMC device
+ * @blkcnt:	Number of blocks in the next transfer
+ * @return true if the block count was set, false if the transfer must be
+ *	   stopped with CMD12
+ */
+bool mmc_set_block_count(struct mmc *mmc, lbaint_t blkcnt);
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 void mmc_adapter_card_type_ident(void);
 #endif
@@ -12,9 +12,13 @@
 #include <mmc.h>
 #include <asm/test.h>
 
+/* Number of command indexes, which are 6 bits */
+#define SANDBOX_MMC_CMDS	64
+
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
+	uint cmd_count[SANDBOX_MMC_CMDS];
 };
 
 /**
@@ -26,6 +30,11 @@ struct sandbox_mmc_plat {
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	if (cmd->cmdidx < SANDBOX_MMC_CMDS)
+		plat->cmd_count[cmd->cmdidx]++;
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
@@ -65,6 +74,7 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		strcpy(data->dest, "this is a test");
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
+	case MMC_CMD_SET_BLOCK_COUNT:
 		break;
 	case SD_CMD_APP_SEND_OP_COND:
 		cmd->response[0] = OCR_BUSY | OCR_HCS;
@@ -79,7 +89,8 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	case SD_CMD_APP_SEND_SCR: {
 		u32 *scr = (u32 *)data->dest;
 
-		scr[0] = cpu_to_be32(2 << 24 | 1 << 15);  /* SD version 3 */
+		/* SD version 3, with CMD23 */
+		scr[0] = cpu_to_be32(2 << 24 | 1 << 15 | SD_SCR_CMD23);
 		break;
 	}
 	default:
@@ -90,6 +101,13 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	return 0;
 }
 
+uint sandbox_mmc_get_cmd_count(struct udevice *dev, int cmdidx)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	return plat->cmd_count[cmdidx];
+}
+
 static int sandbox_mmc_set_ios(struct udevice *dev)
 {
 	return 0;
@@ -117,6 +135,7 @@ int sandbox_mmc_bind(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
 	struct mmc_config *cfg = &plat->cfg;
+	int ret;
 
 	cfg->name = dev->name;
 	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT;
@@ -124,6 +143,9 @@ int sandbox_mmc_bind(struct udevice *dev)
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
 	cfg->b_max = U32_MAX;
+	ret = mmc_of_parse(dev, cfg);
+	if (ret)
+		return ret;
 
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
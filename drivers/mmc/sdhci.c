@@ -767,11 +767,13 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 #endif
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
-		printf("%s: Your controller doesn't support SDMA!!\n",
+		printf("%s: Your controller doesn't support ADMA2!!\n",
 		       __func__);
 		return -EINVAL;
 	}
 	host->adma_desc_table = memalign(ARCH_DMA_MINALIGN, ADMA_TABLE_SZ);
+	if (!host->adma_desc_table)
+		return -ENOMEM;
 
 	host->adma_addr = (dma_addr_t)host->adma_desc_table;
 #ifdef CONFIG_DMA_ADDR_T_64BIT
@@ -879,6 +881,12 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 	if (caps_1 & SDHCI_SUPPORT_DDR50)
 		cfg->host_caps |= MMC_CAP(UHS_DDR50);
 
+	/*
+	 * Drivers for controllers which stop a transfer once the block count
+	 * is reached can set MMC_CAP_CMD23 here, so that CMD23 is used in
+	 * place of CMD12. Drivers which call mmc_of_parse() get it from the
+	 * "u-boot,cap-cmd23" property instead.
+	 */
 	if (host->host_caps)
 		cfg->host_caps |= host->host_caps;
 
@@ -386,6 +386,32 @@ static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 	return 0;
 }
 
+/* Stand in for hardware which can DMA the payload to a separate buffer */
+static int sb_eth_recv_split(struct udevice *dev, int flags,
+			     struct eth_rx_split *split)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	unsigned int hdr_len;
+	uchar *packet;
+	int len;
+
+	len = sb_eth_recv(dev, flags, &packet);
+	if (len <= 0)
+		return len;
+	if (len > split->hdr_len + split->payload_len)
+		return -E2BIG;
+
+	hdr_len = min_t(unsigned int, len, split->hdr_len);
+	memcpy(split->hdr, packet, hdr_len);
+	if (len > hdr_len) {
+		memcpy(split->payload, packet + hdr_len, len - hdr_len);
+		priv->split_packets++;
+	}
+	sb_eth_free_pkt(dev, packet, len);
+
+	return len;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
 	debug("eth_sandbox: Stop\n");
@@ -405,6 +431,7 @@ static const struct eth_ops sb_eth_ops = {
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
 	.free_pkt		= sb_eth_free_pkt,
+	.recv_split		= sb_eth_recv_split,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
@@ -18,40 +18,12 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
-
-enum nvme_queue_id {
-	NVME_ADMIN_Q,
-	NVME_IO_Q,
-	NVME_Q_NUM,
-};
-
-/*
- * An NVM Express queue. Each device has at least two (one for admin
- * commands and one for I/O commands).
- */
-struct nvme_queue {
-	struct nvme_dev *dev;
-	struct nvme_command *sq_cmds;
-	struct nvme_completion *cqes;
-	wait_queue_head_t sq_full;
-	u32 __iomem *q_db;
-	u16 q_depth;
-	s16 cq_vector;
-	u16 sq_head;
-	u16 sq_tail;
-	u16 cq_head;
-	u16 qid;
-	u8 cq_phase;
-	u8 cqe_seen;
-	unsigned long cmdid_data[];
-};
 
 static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 {
@@ -71,68 +43,67 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/* Number of PRP list pages needed for a transfer of @len bytes */
+static u32 nvme_prp_list_pages(struct nvme_dev *dev, u64 len)
+{
+	u32 prps_per_page = (dev->page_size >> 3) - 1;
+	u32 nprps = DIV_ROUND_UP(len, dev->page_size) + 1;
+
+	return DIV_ROUND_UP(nprps, prps_per_page);
+}
+
+/**
+ * nvme_setup_prps() - fill in the PRP entries for a transfer
+ *
+ * The first page of the buffer goes in PRP1. If the rest fits in one page
+ * it goes in PRP2, otherwise PRP2 points to a PRP list. The last entry of
+ * each full list page points to the next page of the list.
+ *
+ * @dev:	NVMe controller device
+ * @prp_list:	PRP list pages for this command
+ * @prp2:	Returns the value for PRP2
+ * @total_len:	Length of the transfer in bytes
+ * @dma_addr:	Address of the buffer
+ */
+static void nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
+			    int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
+	u32 prps_per_page = page_size >> 3;
+	u64 *prp = prp_list;
 	int length = total_len;
 	int i, nprps;
-	u32 prps_per_page = (page_size >> 3) - 1;
-	u32 num_pages;
 
 	length -= (page_size - offset);
 
 	if (length <= 0) {
 		*prp2 = 0;
-		return 0;
+		return;
 	}
 
-	if (length)
-		dma_addr += (page_size - offset);
+	dma_addr += (page_size - offset);
 
 	if (length <= page_size) {
 		*prp2 = dma_addr;
-		return 0;
+		return;
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
-
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = prps_per_page * num_pages;
-	}
-
-	prp_pool = dev->prp_pool;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
+		if (i == prps_per_page - 1 && nprps > 1) {
+			prp[i] = cpu_to_le64((ulong)(prp + prps_per_page));
+			prp += prps_per_page;
 			i = 0;
-			prp_pool += page_size;
 		}
-		*(prp_pool + i++) = cpu_to_le64(dma_addr);
+		prp[i++] = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
-
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
+	*prp2 = (ulong)prp_list;
 
-	return 0;
+	flush_dcache_range((ulong)prp_list, (ulong)(prp + prps_per_page));
 }
 
 static __le16 nvme_get_cmd_id(void)
@@ -153,12 +124,12 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -168,8 +139,68 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
+	nvmeq->stats.cmds++;
+}
+
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/**
+ * nvme_reap_cmd() - wait for the next completion on a queue
+ *
+ * Completions may arrive in any order, so the caller identifies the
+ * command by the returned command ID.
+ *
+ * @nvmeq:	The queue to use
+ * @cmdid:	Returns the command ID of the completed command
+ * @timeout_us:	Time to wait in microseconds
+ * @return 0 if the command succeeded, -EIO if it failed, -ETIMEDOUT if
+ *	   nothing completed in time
+ */
+static int nvme_reap_cmd(struct nvme_queue *nvmeq, u16 *cmdid,
+			 ulong timeout_us)
+{
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	ulong start_time;
+	u16 status;
+
+	start_time = timer_get_us();
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) == phase)
+			break;
+		if (timer_get_us() - start_time >= timeout_us)
+			return -ETIMEDOUT;
+	}
+
+	*cmdid = readw(&nvmeq->cqes[head].command_id);
+	if (++head == nvmeq->q_depth) {
+		head = 0;
+		phase = !phase;
+	}
+	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+	nvmeq->cq_head = head;
+	nvmeq->cq_phase = phase;
+
+	status >>= 1;
+	if (status) {
+		printf("ERROR: status = %x, command id = %d\n", status, *cmdid);
+		nvmeq->stats.errors++;
+		return -EIO;
+	}
+
+	return 0;
 }
 
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
@@ -200,6 +231,7 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	if (status) {
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
+		nvmeq->stats.errors++;
 		status = 0;
 		if (++head == nvmeq->q_depth) {
 			head = 0;
@@ -312,6 +344,8 @@ static int nvme_disable_ctrl(struct nvme_dev *dev)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	free(nvmeq->prp_lists);
+	free(nvmeq->slots);
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
 	free(nvmeq);
@@ -713,64 +747,174 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/**
+ * nvme_reset_io_queue() - abort all commands on an I/O queue and restart it
+ *
+ * Deleting the submission queue makes the controller abort the commands
+ * still in it, so that none of them can complete later and be taken for a
+ * new command with the same ID, or write to a buffer that has been reused.
+ * Both queues are then created again, empty.
+ *
+ * @dev:	NVMe controller
+ * @qid:	Queue ID
+ * @return 0 if OK, -ve on error
+ */
+static int nvme_reset_io_queue(struct nvme_dev *dev, u16 qid)
+{
+	struct nvme_queue *nvmeq = dev->queues[qid];
+	int ret;
+
+	ret = nvme_delete_sq(dev, qid);
+	if (!ret)
+		ret = nvme_delete_cq(dev, qid);
+	if (ret)
+		return ret;
+	dev->online_queues--;
+
+	return nvme_create_queue(nvmeq, qid);
+}
+
+/*
+ * Allocate the per-command state of an I/O queue, including a PRP list
+ * big enough for the maximum transfer size of each command slot
+ */
+static int nvme_alloc_io_slots(struct nvme_dev *dev, struct nvme_queue *nvmeq)
+{
+	u32 pages;
+	int i;
+
+	if (nvmeq->slots)
+		return 0;
+
+	pages = nvme_prp_list_pages(dev, 1ULL << dev->max_transfer_shift);
+	nvmeq->prp_list_size = pages * dev->page_size;
+	nvmeq->prp_lists = memalign(dev->page_size,
+				    nvmeq->q_depth * nvmeq->prp_list_size);
+	nvmeq->slots = calloc(nvmeq->q_depth, sizeof(*nvmeq->slots));
+	if (!nvmeq->prp_lists || !nvmeq->slots) {
+		free(nvmeq->prp_lists);
+		free(nvmeq->slots);
+		nvmeq->prp_lists = NULL;
+		nvmeq->slots = NULL;
+		return -ENOMEM;
+	}
+	for (i = 0; i < nvmeq->q_depth; i++)
+		nvmeq->slots[i].prp_list = (void *)nvmeq->prp_lists +
+					   i * nvmeq->prp_list_size;
+
+	return 0;
+}
+
+/**
+ * nvme_blk_rw() - transfer blocks using many outstanding commands
+ *
+ * The request is split into commands of at most the controller's maximum
+ * transfer size. Up to q_depth - 1 of them are kept in flight, and each
+ * completion, which may come in any order, frees a slot for the next one.
+ *
+ * @return number of blocks transferred before the first failed command
+ */
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
-	struct nvme_command c;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
 	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
-	u64 prp2;
 	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
+	ulong timeout_us = IO_TIMEOUT * 1000000;
+	lbaint_t next = 0, failed = blkcnt;
+	u32 lbas;
+	int inflight = 0;
+	u16 cmdid;
+	int ret;
 
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
+	if (nvme_alloc_io_slots(dev, nvmeq))
+		return 0;
+
+	/* the NLB field of a command is 16 bits */
+	lbas = min(1U << (dev->max_transfer_shift - ns->lba_shift), 0x10000U);
 
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+	while (next < blkcnt || inflight) {
+		struct nvme_io_slot *slot;
+		bool queued = false;
+
+		/* Keep the submission queue as full as possible */
+		while (next < blkcnt && failed == blkcnt &&
+		       inflight < nvmeq->q_depth - 1) {
+			struct nvme_command c;
+			void *buf;
+			u64 prp2;
+			u32 n;
+
+			for (cmdid = 0; nvmeq->slots[cmdid].busy; cmdid++)
+				;
+			slot = &nvmeq->slots[cmdid];
+			n = min_t(lbaint_t, lbas, blkcnt - next);
+			buf = buffer + (next << ns->lba_shift);
+			nvme_setup_prps(dev, slot->prp_list, &prp2,
+					n << ns->lba_shift, (ulong)buf);
+
+			memset(&c, '\0', sizeof(c));
+			c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+			c.rw.command_id = cmdid;
+			c.rw.nsid = cpu_to_le32(ns->ns_id);
+			c.rw.slba = cpu_to_le64(blknr + next);
+			c.rw.length = cpu_to_le16(n - 1);
+			c.rw.prp1 = cpu_to_le64((ulong)buf);
+			c.rw.prp2 = cpu_to_le64(prp2);
+			nvme_queue_cmd(nvmeq, &c);
+
+			slot->busy = true;
+			slot->start = next;
+			slot->count = n;
+			next += n;
+			inflight++;
+			queued = true;
+		}
+		if (queued) {
+			writel(nvmeq->sq_tail, nvmeq->q_db);
+			nvmeq->stats.max_inflight = max_t(u16, inflight,
+						nvmeq->stats.max_inflight);
 		}
+		if (!inflight)
+			break;
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+		ret = nvme_reap_cmd(nvmeq, &cmdid, timeout_us);
+		if (ret == -ETIMEDOUT || cmdid >= nvmeq->q_depth ||
+		    !nvmeq->slots[cmdid].busy) {
+			int i;
+
+			/* Give up, counting only blocks before the oldest */
+			printf("Error: %s: I/O timed out\n", udev->name);
+			for (i = 0; i < nvmeq->q_depth; i++) {
+				slot = &nvmeq->slots[i];
+				if (slot->busy && slot->start < failed)
+					failed = slot->start;
+				slot->busy = false;
+			}
+			if (nvme_reset_io_queue(dev, NVME_IO_Q))
+				printf("Error: %s: cannot reset I/O queue\n",
+				       udev->name);
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+		}
+		slot = &nvmeq->slots[cmdid];
+		slot->busy = false;
+		inflight--;
+		if (ret)
+			failed = min(failed, slot->start);
+		else
+			nvmeq->stats.blocks += slot->count;
 	}
 
 	if (read)
 		invalidate_dcache_range((unsigned long)buffer,
 					(unsigned long)buffer + total_len);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	return failed;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -841,15 +985,6 @@ static int nvme_probe(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
 		goto free_queue;
@@ -624,11 +624,72 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
 };
 
+enum nvme_queue_id {
+	NVME_ADMIN_Q,
+	NVME_IO_Q,
+	NVME_Q_NUM,
+};
+
+/**
+ * struct nvme_queue_stats - counters for one NVMe queue
+ *
+ * @cmds:		Number of commands submitted
+ * @errors:		Number of commands which completed with an error
+ * @blocks:		Number of blocks transferred (I/O queues only)
+ * @max_inflight:	Largest number of commands outstanding at once
+ */
+struct nvme_queue_stats {
+	ulong cmds;
+	ulong errors;
+	u64 blocks;
+	u16 max_inflight;
+};
+
+/**
+ * struct nvme_io_slot - state of an outstanding I/O command
+ *
+ * The slot index is used as the command ID.
+ *
+ * @prp_list:	PRP list pages for this command
+ * @start:	First block of the command, relative to the request
+ * @count:	Number of blocks in the command
+ * @busy:	true if the command has been submitted but not completed
+ */
+struct nvme_io_slot {
+	u64 *prp_list;
+	lbaint_t start;
+	u32 count;
+	bool busy;
+};
+
+/*
+ * An NVM Express queue. Each device has at least two (one for admin
+ * commands and one for I/O commands).
+ */
+struct nvme_queue {
+	struct nvme_dev *dev;
+	struct nvme_command *sq_cmds;
+	struct nvme_completion *cqes;
+	wait_queue_head_t sq_full;
+	u32 __iomem *q_db;
+	u16 q_depth;
+	s16 cq_vector;
+	u16 sq_head;
+	u16 sq_tail;
+	u16 cq_head;
+	u16 qid;
+	u8 cq_phase;
+	u8 cqe_seen;
+	struct nvme_queue_stats stats;
+	struct nvme_io_slot *slots;
+	void *prp_lists;
+	u32 prp_list_size;
+	unsigned long cmdid_data[];
+};
+
 /*
  * An NVM Express namespace is equivalent to a SCSI LUN.
  * Each namespace is operated as an independent "device".
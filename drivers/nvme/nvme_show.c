@@ -5,10 +5,12 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
 #include <errno.h>
 #include <memalign.h>
 #include <nvme.h>
+#include <linux/compat.h>
 #include "nvme.h"
 
 static void print_optional_admin_cmd(u16 oacs, int devnum)
@@ -102,6 +104,28 @@ static void print_metadata_cap(u8 mc, int devnum)
 	       mc & 0x01 ? "yes" : "No");
 }
 
+static void print_queue_stats(struct nvme_dev *dev, int devnum)
+{
+	static const char *const names[NVME_Q_NUM] = { "Admin", "I/O" };
+	int i;
+
+	printf("Blk device %d: Queue statistics:\n", devnum);
+	for (i = 0; i < NVME_Q_NUM; i++) {
+		struct nvme_queue *nvmeq = dev->queues[i];
+
+		if (!nvmeq)
+			continue;
+		printf("\t%s queue %d: depth %d, commands %lu, errors %lu",
+		       names[i], nvmeq->qid, nvmeq->q_depth,
+		       nvmeq->stats.cmds, nvmeq->stats.errors);
+		if (i == NVME_IO_Q)
+			printf(", blocks %llu, max in flight %d",
+			       (unsigned long long)nvmeq->stats.blocks,
+			       nvmeq->stats.max_inflight);
+		printf("\n");
+	}
+}
+
 int nvme_print_info(struct udevice *udev)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -124,6 +148,7 @@ int nvme_print_info(struct udevice *udev)
 	print_formats(id, ns);
 	print_data_protect_cap(id->dpc, ns->devnum);
 	print_metadata_cap(id->mc, ns->devnum);
+	print_queue_stats(dev, ns->devnum);
 
 	return 0;
 }
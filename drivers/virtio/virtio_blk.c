@@ -11,48 +11,152 @@
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <linux/sizes.h>
 #include "virtio_blk.h"
 
+/* Maximum number of requests kept in flight */
+#define VIRTIO_BLK_NUM_REQS	32
+/* Maximum number of data segments in one request */
+#define VIRTIO_BLK_MAX_SEGS	16
+/* Largest request, in sectors, so that big transfers are spread out */
+#define VIRTIO_BLK_MAX_SECTORS	(SZ_1M / 512)
+
+/**
+ * struct virtio_blk_req - an outstanding request
+ *
+ * @out_hdr:	Request header, which is the first buffer of the request and
+ *		so identifies it when it completes
+ * @status:	Status written by the device
+ * @start:	First sector of the request, relative to the transfer
+ * @count:	Number of sectors in the request
+ * @busy:	true if the request has been added to the virtqueue
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	lbaint_t start;
+	lbaint_t count;
+	bool busy;
+};
+
+/**
+ * struct virtio_blk_priv - private data for a virtio block device
+ *
+ * @vq:		The request virtqueue
+ * @size_max:	Maximum size of a data segment in bytes
+ * @seg_max:	Maximum number of data segments in a request
+ * @req_sectors: Maximum number of sectors in a request
+ * @reqs:	Request slots
+ */
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	u32 size_max;
+	u32 seg_max;
+	u32 req_sectors;
+	struct virtio_blk_req reqs[VIRTIO_BLK_NUM_REQS];
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/* Add a request for @blkcnt sectors to the virtqueue */
+static int virtio_blk_add_req(struct udevice *dev, struct virtio_blk_req *req,
+			      u64 sector, lbaint_t blkcnt, void *buffer,
+			      u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
+	struct virtio_sg sg[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	unsigned int num = 0, num_out, num_in;
+	ulong len = blkcnt * 512;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	req->out_hdr.type = cpu_to_virtio32(dev, type);
+	req->out_hdr.ioprio = 0;
+	req->out_hdr.sector = cpu_to_virtio64(dev, sector);
+	req->status = VIRTIO_BLK_S_IOERR;
 
-	sgs[num_out++] = &hdr_sg;
+	sg[num].addr = &req->out_hdr;
+	sg[num++].length = sizeof(req->out_hdr);
+	while (len) {
+		sg[num].addr = buffer;
+		sg[num].length = min_t(ulong, len, priv->size_max);
+		buffer += sg[num].length;
+		len -= sg[num++].length;
+	}
+	sg[num].addr = &req->status;
+	sg[num++].length = sizeof(req->status);
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
-	else
-		sgs[num_out + num_in++] = &data_sg;
+	for (num_out = 0; num_out < num; num_out++)
+		sgs[num_out] = &sg[num_out];
 
-	sgs[num_out + num_in++] = &status_sg;
+	if (type & VIRTIO_BLK_T_OUT) {
+		num_out = num - 1;
+		num_in = 1;
+	} else {
+		num_out = 1;
+		num_in = num - 1;
+	}
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
+	return virtqueue_add(priv->vq, sgs, num_out, num_in);
+}
 
-	virtqueue_kick(priv->vq);
+/**
+ * virtio_blk_do_req() - transfer sectors using many outstanding requests
+ *
+ * The transfer is split into requests that respect the device's segment
+ * limits. As many as fit in the virtqueue are added before kicking the
+ * device, and each completion makes room for another.
+ *
+ * @return number of sectors transferred before the first failed request
+ */
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	lbaint_t next = 0, failed = blkcnt;
+	struct virtio_blk_outhdr *hdr;
+	struct virtio_blk_req *req;
+	int inflight = 0;
+	int i, ret;
+
+	while (next < blkcnt || inflight) {
+		bool added = false;
+
+		while (next < blkcnt && failed == blkcnt &&
+		       inflight < VIRTIO_BLK_NUM_REQS) {
+			lbaint_t n = min_t(lbaint_t, priv->req_sectors,
+					   blkcnt - next);
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+			for (i = 0; priv->reqs[i].busy; i++)
+				;
+			req = &priv->reqs[i];
+			ret = virtio_blk_add_req(dev, req, sector + next, n,
+						 buffer + next * 512, type);
+			if (ret == -ENOSPC && inflight)
+				break;
+			if (ret) {
+				failed = next;
+				break;
+			}
+			req->busy = true;
+			req->start = next;
+			req->count = n;
+			next += n;
+			inflight++;
+			added = true;
+		}
+		if (added)
+			virtqueue_kick(priv->vq);
+		if (!inflight)
+			break;
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+		while (!(hdr = virtqueue_get_buf(priv->vq, NULL)))
+			;
+		req = container_of(hdr, struct virtio_blk_req, out_hdr);
+		req->busy = false;
+		inflight--;
+		if (req->status != VIRTIO_BLK_S_OK)
+			failed = min(failed, req->start);
+	}
+
+	return failed;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -69,6 +173,12 @@ static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
 				 VIRTIO_BLK_T_OUT);
 }
 
+static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
+	VIRTIO_BLK_F_SEG_MAX,
+	VIRTIO_RING_F_INDIRECT_DESC,
+};
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -98,7 +208,8 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    NULL, 0);
 
 	return 0;
 }
@@ -118,6 +229,30 @@ static int virtio_blk_probe(struct udevice *dev)
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	/* Work out how big a request can be */
+	ret = virtio_cread_feature(dev, VIRTIO_BLK_F_SIZE_MAX,
+				   struct virtio_blk_config, size_max,
+				   &priv->size_max);
+	if (ret || priv->size_max < 512)
+		priv->size_max = VIRTIO_BLK_MAX_SECTORS * 512;
+	priv->size_max = ALIGN_DOWN(priv->size_max, 512);
+
+	ret = virtio_cread_feature(dev, VIRTIO_BLK_F_SEG_MAX,
+				   struct virtio_blk_config, seg_max,
+				   &priv->seg_max);
+	if (ret || !priv->seg_max)
+		priv->seg_max = 1;
+	priv->seg_max = min(priv->seg_max, (u32)VIRTIO_BLK_MAX_SEGS);
+	/* Without indirect descriptors, a request must fit in the ring */
+	if (!virtio_has_feature(dev, VIRTIO_RING_F_INDIRECT_DESC))
+		priv->seg_max = min(priv->seg_max,
+				    virtqueue_get_vring_size(priv->vq) - 2);
+	if (!priv->seg_max)
+		return -EINVAL;
+
+	priv->req_sectors = min_t(u64, (u64)priv->seg_max * priv->size_max / 512,
+				  VIRTIO_BLK_MAX_SECTORS);
+
 	return 0;
 }
 
@@ -16,21 +16,54 @@
 #include <linux/bug.h>
 #include <linux/compat.h>
 
+static struct vring_desc *alloc_indirect(struct virtqueue *vq,
+					 unsigned int total_sg)
+{
+	struct vring_desc *desc;
+	unsigned int i;
+
+	desc = malloc(total_sg * sizeof(struct vring_desc));
+	if (!desc)
+		return NULL;
+
+	for (i = 0; i < total_sg; i++)
+		desc[i].next = cpu_to_virtio16(vq->vdev, i + 1);
+
+	return desc;
+}
+
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs)
 {
 	struct vring_desc *desc;
 	unsigned int total_sg = out_sgs + in_sgs;
 	unsigned int i, n, avail, descs_used, uninitialized_var(prev);
+	bool indirect;
 	int head;
 
 	WARN_ON(total_sg == 0);
 
 	head = vq->free_head;
 
-	desc = vq->vring.desc;
-	i = head;
-	descs_used = total_sg;
+	/*
+	 * With indirect descriptors a buffer takes a single ring entry, so
+	 * many more requests fit in the ring at once
+	 */
+	if (vq->indirect && total_sg > 1 && vq->num_free)
+		desc = alloc_indirect(vq, total_sg);
+	else
+		desc = NULL;
+
+	if (desc) {
+		indirect = true;
+		i = 0;
+		descs_used = 1;
+	} else {
+		indirect = false;
+		desc = vq->vring.desc;
+		i = head;
+		descs_used = total_sg;
+	}
 
 	if (vq->num_free < descs_used) {
 		debug("Can't add buf len %i - avail = %i\n",
@@ -70,6 +103,19 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	/* Last one doesn't continue */
 	desc[prev].flags &= cpu_to_virtio16(vq->vdev, ~VRING_DESC_F_NEXT);
 
+	if (indirect) {
+		/* Now that the indirect table is filled in, point to it */
+		vq->vring.desc[head].flags = cpu_to_virtio16(vq->vdev,
+						VRING_DESC_F_INDIRECT);
+		vq->vring.desc[head].addr = cpu_to_virtio64(vq->vdev,
+						(u64)(uintptr_t)desc);
+		vq->vring.desc[head].len = cpu_to_virtio32(vq->vdev,
+				total_sg * sizeof(struct vring_desc));
+		vq->indir_desc[head] = desc;
+
+		i = virtio16_to_cpu(vq->vdev, vq->vring.desc[head].next);
+	}
+
 	/* We're using some buffers from the free list. */
 	vq->num_free -= descs_used;
 
@@ -152,6 +198,11 @@ static void detach_buf(struct virtqueue *vq, unsigned int head)
 
 	/* Plus final descriptor */
 	vq->num_free++;
+
+	if (vq->indir_desc && vq->indir_desc[head]) {
+		free(vq->indir_desc[head]);
+		vq->indir_desc[head] = NULL;
+	}
 }
 
 static inline bool more_used(const struct virtqueue *vq)
@@ -162,8 +213,10 @@ static inline bool more_used(const struct virtqueue *vq)
 
 void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 {
+	struct vring_desc *desc;
 	unsigned int i;
 	u16 last_used;
+	void *buf;
 
 	if (!more_used(vq)) {
 		debug("(%s.%d): No more buffers in queue\n",
@@ -189,6 +242,12 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		return NULL;
 	}
 
+	/* Return the first buffer, which is in the indirect table if used */
+	desc = &vq->vring.desc[i];
+	if (vq->indir_desc && vq->indir_desc[i])
+		desc = vq->indir_desc[i];
+	buf = (void *)(uintptr_t)virtio64_to_cpu(vq->vdev, desc->addr);
+
 	detach_buf(vq, i);
 	vq->last_used_idx++;
 	/*
@@ -200,8 +259,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)virtio64_to_cpu(vq->vdev,
-						  vq->vring.desc[i].addr);
+	return buf;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
@@ -228,6 +286,13 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	list_add_tail(&vq->list, &uc_priv->vqs);
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC);
+	vq->indir_desc = NULL;
+	if (vq->indirect) {
+		vq->indir_desc = calloc(vring.num, sizeof(*vq->indir_desc));
+		if (!vq->indir_desc)
+			vq->indirect = false;
+	}
 
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
@@ -290,6 +355,13 @@ struct virtqueue *vring_create_virtqueue(unsigned int index, unsigned int num,
 
 void vring_del_virtqueue(struct virtqueue *vq)
 {
+	unsigned int i;
+
+	if (vq->indir_desc) {
+		for (i = 0; i < vq->vring.num; i++)
+			free(vq->indir_desc[i]);
+		free(vq->indir_desc);
+	}
 	free(vq->vring.desc);
 	list_del(&vq->list);
 	free(vq);
@@ -331,8 +403,8 @@ void virtqueue_dump(struct virtqueue *vq)
 	printf("virtqueue %p for dev %s:\n", vq, vq->vdev->name);
 	printf("\tindex %u, phys addr %p num %u\n",
 	       vq->index, vq->vring.desc, vq->vring.num);
-	printf("\tfree_head %u, num_added %u, num_free %u\n",
-	       vq->free_head, vq->num_added, vq->num_free);
+	printf("\tfree_head %u, num_added %u, num_free %u, indirect %d\n",
+	       vq->free_head, vq->num_added, vq->num_free, vq->indirect);
 	printf("\tlast_used_idx %u, avail_flags_shadow %u, avail_idx_shadow %u\n",
 	       vq->last_used_idx, vq->avail_flags_shadow, vq->avail_idx_shadow);
 
@@ -1642,8 +1642,82 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/*
+ * Look up 'fileblock' in the extent tree of 'inode'. Return its physical
+ * block, 0 if it lies in a hole, or -ve on error. *countp is set to the
+ * number of blocks from 'fileblock' on that are mapped the same way, i.e.
+ * that are contiguous on disk or are all part of the hole.
+ *
+ * The extent found is remembered in 'cache', so that the following blocks of
+ * a sequential read are resolved without walking the tree again.
+ */
+static long int read_extent_block(struct ext2_inode *inode, int fileblock,
+				  struct ext_block_cache *cache,
+				  long int *countp)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	long int startblock, endblock;
+	unsigned long long start;
+	int log2_blksz;
+	int i;
+
+	if (cache->ext_len && fileblock >= cache->ext_block &&
+	    fileblock < cache->ext_block + cache->ext_len) {
+		*countp = cache->ext_block + cache->ext_len - fileblock;
+		if (!cache->ext_start)
+			return 0;
+		return (fileblock - cache->ext_block) + cache->ext_start;
+	}
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	ext_block = ext4fs_get_extent_block(ext4fs_root, cache,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		endblock = startblock + le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			cache->ext_block = fileblock;
+			cache->ext_len = startblock - fileblock;
+			cache->ext_start = 0;
+			*countp = cache->ext_len;
+			return 0;
+
+		} else if (fileblock < endblock) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			cache->ext_block = startblock;
+			cache->ext_len = endblock - startblock;
+			cache->ext_start = start;
+			*countp = endblock - fileblock;
+			return (fileblock - startblock) + start;
+		}
+	}
+
+	return 0;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
+{
+	return read_allocated_blocks(inode, fileblock, cache, NULL);
+}
+
+long int read_allocated_blocks(struct ext2_inode *inode, int fileblock,
+			       struct ext_block_cache *cache, long int *countp)
 {
 	long int blknr;
 	int blksz;
@@ -1652,62 +1726,28 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
+	long int count;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		struct ext_block_cache *c, cd;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (cache) {
-			c = cache;
-		} else {
-			c = &cd;
-			ext_cache_init(c);
-		}
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, c,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			if (!cache)
-				ext_cache_fini(c);
-			return -EINVAL;
-		}
+	if (!countp)
+		countp = &count;
+	*countp = 1;
 
-		extent = (struct ext4_extent *)(ext_block + 1);
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
+		struct ext_block_cache cd;
 
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
+		if (cache)
+			return read_extent_block(inode, fileblock, cache,
+						 countp);
 
-			if (startblock > fileblock) {
-				/* Sparse file */
-				if (!cache)
-					ext_cache_fini(c);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				if (!cache)
-					ext_cache_fini(c);
-				return (fileblock - startblock) + start;
-			}
-		}
+		ext_cache_init(&cd);
+		blknr = read_extent_block(inode, fileblock, &cd, countp);
+		ext_cache_fini(&cd);
 
-		if (!cache)
-			ext_cache_fini(c);
-		return 0;
+		return blknr;
 	}
 
 	/* Direct blocks. */
@@ -2341,7 +2381,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* A file may be read several times before the filesystem is closed */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
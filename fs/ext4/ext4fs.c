@@ -53,8 +53,9 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	lbaint_t i, n;
 	lbaint_t blockcnt;
+	lbaint_t firstblock;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
@@ -65,7 +66,6 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
 	short status;
 	struct ext_block_cache cache;
 
@@ -81,42 +81,41 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	}
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
+	firstblock = lldiv(pos, blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
+	/* Handle a run of blocks mapped the same way at a time */
+	for (i = firstblock; i < blockcnt; i += n) {
+		long int blknr, count;
+		loff_t runstart = (loff_t)blocksize * i;
+		loff_t runend;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
+		int runlen;
+
+		blknr = read_allocated_blocks(&node->inode, i, &cache, &count);
 		if (blknr < 0) {
 			ext_cache_fini(&cache);
 			return -1;
 		}
 
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		n = min_t(lbaint_t, count, blockcnt - i);
+		runend = min_t(loff_t, runstart + (loff_t)blocksize * n,
+			       len + pos);
 
 		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		if (i == firstblock)
+			skipfirst = pos - runstart;
+		runlen = runend - runstart - skipfirst;
+
 		if (blknr) {
-			int status;
+			blknr = blknr << log2_fs_blocksize;
 
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
+			if (previous_block_number != -1 &&
+			    delayed_next == blknr) {
+				delayed_extent += runlen;
+				delayed_next += n << log2_fs_blocksize;
+			} else {
+				if (previous_block_number != -1) {
+					/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
@@ -125,26 +124,15 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 						ext_cache_fini(&cache);
 						return -1;
 					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
 				}
-			} else {
 				previous_block_number = blknr;
 				delayed_start = blknr;
-				delayed_extent = blockend;
+				delayed_extent = runlen;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
+				delayed_next = blknr + (n << log2_fs_blocksize);
 			}
 		} else {
-			int n;
-			int n_left;
 			if (previous_block_number != -1) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
@@ -157,14 +145,9 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 				}
 				previous_block_number = -1;
 			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
+			memset(buf, 0, runlen);
 		}
-		buf += blocksize - skipfirst;
+		buf += runlen;
 	}
 	if (previous_block_number != -1) {
 		/* spill */
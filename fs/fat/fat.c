@@ -22,6 +22,7 @@
 #include <asm/cache.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
 
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
@@ -39,6 +40,39 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static struct disk_partition cur_part_info;
 
+/*
+ * Cluster map of the most recently read file
+ *
+ * The cluster chain of a file is kept as a list of extents (runs of
+ * consecutive clusters), so that reading at an offset does not need to walk
+ * the FAT from the first cluster again and each run can be read with a single
+ * disk_read(). The map is filled in lazily, only as far as a read needs it,
+ * and is dropped whenever the FAT may have changed or another device is used.
+ */
+struct fat_extent {
+	__u32	clust;		/* First cluster of the run */
+	__u32	count;		/* Number of clusters in the run */
+};
+
+#define FAT_MAP_GROW	16
+
+static struct {
+	struct blk_desc *dev;	/* Device and partition the map belongs to */
+	lbaint_t part_start;
+	__u32	start;		/* First cluster of the file */
+	__u32	size;		/* Size of the file in bytes */
+	struct fat_extent *ext;	/* Extents mapped so far */
+	int	nr_ext;
+	int	max_ext;
+	__u32	nr_clust;	/* Number of clusters mapped so far */
+} fat_map;
+
+static void fat_map_invalidate(void)
+{
+	free(fat_map.ext);
+	memset(&fat_map, '\0', sizeof(fat_map));
+}
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -62,6 +96,7 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	fat_map_invalidate();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -303,6 +338,65 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Make sure the map is for the file starting at cluster 'start' with 'size'
+ * bytes and covers at least its first 'nr_clust' clusters.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_map_extend(fsdata *mydata, __u32 start, __u32 size,
+			  __u32 nr_clust)
+{
+	struct fat_extent *ext;
+	__u32 clust;
+
+	if (fat_map.dev != cur_dev ||
+	    fat_map.part_start != cur_part_info.start ||
+	    fat_map.start != start || fat_map.size != size) {
+		fat_map_invalidate();
+		fat_map.dev = cur_dev;
+		fat_map.part_start = cur_part_info.start;
+		fat_map.start = start;
+		fat_map.size = size;
+	}
+
+	while (fat_map.nr_clust < nr_clust) {
+		if (fat_map.nr_ext) {
+			ext = &fat_map.ext[fat_map.nr_ext - 1];
+			clust = get_fatent(mydata, ext->clust + ext->count - 1);
+		} else {
+			clust = start;
+			ext = NULL;
+		}
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			return -1;
+		}
+
+		if (ext && ext->clust + ext->count == clust) {
+			ext->count++;
+		} else {
+			if (fat_map.nr_ext == fat_map.max_ext) {
+				ext = realloc(fat_map.ext, (fat_map.max_ext +
+					      FAT_MAP_GROW) * sizeof(*ext));
+				if (!ext) {
+					debug("Error: allocating cluster map\n");
+					fat_map_invalidate();
+					return -1;
+				}
+				fat_map.ext = ext;
+				fat_map.max_ext += FAT_MAP_GROW;
+			}
+			ext = &fat_map.ext[fat_map.nr_ext++];
+			ext->clust = clust;
+			ext->count = 1;
+		}
+		fat_map.nr_clust++;
+	}
+
+	return 0;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -323,9 +417,9 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	struct fat_extent *ext, *ext_end;
+	loff_t cur, end, actsize;
+	__u32 idx, skip;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -340,101 +434,78 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	/* a file can be just short of 4GiB, so keep to 64 bits here */
+	cur = pos;
+	end = filesize;
+
+	if (fat_map_extend(mydata, START(dentptr), FAT2CPU32(dentptr->size),
+			   div_u64(end + bytesperclust - 1, bytesperclust)))
+		return -1;
 
 	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
+	idx = div_u64_rem(cur, bytesperclust, &skip);
+	ext = fat_map.ext;
+	ext_end = fat_map.ext + fat_map.nr_ext;
+	while (ext < ext_end && idx >= ext->count) {
+		idx -= ext->count;
+		ext++;
+	}
+	if (ext == ext_end) {
+		printf("Cluster map is too short\n");
+		return -1;
 	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
 
 	/* align to beginning of next cluster if any */
-	if (pos) {
+	if (skip) {
 		__u8 *tmp_buffer;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
+		actsize = min_t(loff_t, end - (cur - skip), bytesperclust);
 		tmp_buffer = malloc_cache_aligned(actsize);
 		if (!tmp_buffer) {
 			debug("Error: allocating buffer\n");
 			return -1;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+		if (get_cluster(mydata, ext->clust + idx, tmp_buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			free(tmp_buffer);
 			return -1;
 		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
+		actsize -= skip;
+		memcpy(buffer, tmp_buffer + skip, actsize);
 		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
-			return 0;
 		buffer += actsize;
+		cur += actsize;
 
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
+		if (++idx == ext->count) {
+			ext++;
+			idx = 0;
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
+	/* read the rest one run of consecutive clusters at a time */
+	while (cur < end) {
+		if (ext == ext_end) {
+			printf("Cluster map is too short\n");
 			return -1;
 		}
-		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		actsize = min((loff_t)(ext->count - idx) * bytesperclust,
+			      end - cur);
+		if (get_cluster(mydata, ext->clust + idx, buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
+		*gotsize += actsize;
 		buffer += actsize;
+		cur += actsize;
+		ext++;
+		idx = 0;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -1317,4 +1388,5 @@ void fat_closedir(struct fs_dir_stream *dirs)
 
 void fat_close(void)
 {
+	fat_map_invalidate();
 }
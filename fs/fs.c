@@ -7,20 +7,25 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <bootstage.h>
 #include <env.h>
 #include <lmb.h>
 #include <log.h>
 #include <mapmem.h>
+#include <memalign.h>
 #include <part.h>
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <image.h>
+#include <malloc.h>
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <linux/sizes.h>
 #include <efi_loader.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -411,6 +416,9 @@ void fs_close(void)
 
 	info->close();
 
+	if (fs_dev_desc)
+		blkcache_flush(fs_dev_desc->if_type, fs_dev_desc->devnum);
+
 	fs_type = FS_TYPE_ANY;
 }
 
@@ -532,6 +540,121 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return _fs_read(filename, addr, offset, len, 0, actread);
 }
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/* Amount of the file read and then decompressed in each step */
+#define FS_DECOMP_CHUNK		SZ_1M
+
+/*
+ * Read a file a chunk at a time and decompress each chunk before reading the
+ * next, so the compressed file is never held in memory as a whole. The
+ * compression type is detected from the start of the file.
+ */
+static int fs_read_decomp(const char *filename, ulong addr, loff_t offset,
+			  loff_t len, loff_t *actread, ulong *unc_len)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct image_decomp_stream ds;
+	ulong out_size = CONFIG_SYS_BOOTM_LEN;
+	loff_t size, chunk, nread;
+	bool started = false;
+	void *buf, *out;
+	int ret;
+
+	*actread = 0;
+	*unc_len = 0;
+	ret = info->size(filename, &size);
+	if (ret)
+		goto out_close;
+	if (offset >= size) {
+		ret = -EINVAL;
+		goto out_close;
+	}
+	size -= offset;
+	if (len && len < size)
+		size = len;
+
+#ifdef CONFIG_LMB
+	{
+		struct lmb lmb;
+
+		lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+		out_size = lmb_get_free_size(&lmb, addr);
+		if (!out_size) {
+			printf("** Reading file would overwrite reserved memory **\n");
+			ret = -ENOSPC;
+			goto out_close;
+		}
+	}
+#endif
+
+	buf = malloc_cache_aligned(FS_DECOMP_CHUNK);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out_close;
+	}
+	out = map_sysmem(addr, out_size);
+
+	/* A member or frame may end in one chunk with another to follow */
+	while (ret >= 0 && *actread < size) {
+		chunk = min_t(loff_t, size - *actread, FS_DECOMP_CHUNK);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FS_READ, "fs_read");
+		ret = info->read(filename, buf, offset + *actread, chunk,
+				 &nread);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FS_READ);
+		if (ret < 0)
+			break;
+		if (nread != chunk) {
+			printf("** %s: short read **\n", filename);
+			ret = -EIO;
+			break;
+		}
+		*actread += nread;
+
+		if (!started) {
+			ret = image_decomp_stream_start(&ds,
+					image_decomp_type(buf, nread),
+					out, out_size);
+			if (ret)
+				break;
+			started = true;
+		}
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP, "decompress");
+		ret = image_decomp_stream_feed(&ds, buf, nread);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+	}
+
+	if (started) {
+		*unc_len = ds.out_len;
+		if (!ret && ds.comp != IH_COMP_NONE) {
+			printf("** %s: compressed data is truncated **\n",
+			       filename);
+			ret = -EIO;
+		} else if (ret == -ENOBUFS) {
+			printf("** Uncompressed file does not fit in %#lx bytes **\n",
+			       out_size);
+		} else if (ret < 0) {
+			printf("** %s: decompression failed (%d) **\n",
+			       filename, ret);
+		}
+		image_decomp_stream_end(&ds);
+	}
+	if (ret == 1)
+		ret = 0;
+
+	unmap_sysmem(out);
+	free(buf);
+out_close:
+	fs_close();
+
+	return ret;
+}
+#endif
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
@@ -676,8 +799,16 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	loff_t len_read;
 	int ret;
 	unsigned long time;
+	ulong unc_len = 0;
+	bool decomp = false;
 	char *ep;
 
+	if (IS_ENABLED(CONFIG_IMAGE_DECOMP_STREAM) && argc > 1 &&
+	    !strcmp(argv[1], "-z")) {
+		decomp = true;
+		argc--;
+		argv++;
+	}
 	if (argc < 2)
 		return CMD_RET_USAGE;
 	if (argc > 7)
@@ -720,12 +851,23 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 			(argc > 4) ? argv[4] : "");
 #endif
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	if (decomp)
+		ret = fs_read_decomp(filename, addr, pos, bytes, &len_read,
+				     &unc_len);
+	else
+#endif
+		ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
 
-	printf("%llu bytes read in %lu ms", len_read, time);
+	printf("%llu bytes read", len_read);
+	if (decomp) {
+		printf(", %lu bytes uncompressed", unc_len);
+		len_read = unc_len;
+	}
+	printf(" in %lu ms", time);
 	if (time > 0) {
 		puts(" (");
 		print_size(div_u64(len_read, time) * 1000, "/s");
@@ -67,6 +67,10 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+	/* Index of compatible strings, or an ERR_PTR() if it cannot be built */
+	struct dm_compat_index *dm_compat_index;
+	/* Uclasses indexed by ID, see uclass_find() */
+	struct uclass	**uclass_tab;
 #endif
 #ifdef CONFIG_TIMER
 	struct udevice	*timer;		/* Timer instance for Driver Model */
@@ -120,6 +120,69 @@ struct blk_desc {
  */
 int blkcache_init(void);
 
+/* raw read operation used by blkcache_dread() to access the device */
+typedef ulong (*blkcache_read_fn)(struct blk_desc *desc, lbaint_t start,
+				  lbaint_t blkcnt, void *buffer);
+
+/**
+ * blkcache_dread() - read blocks through the block cache
+ *
+ * Blocks present in the cache are copied from it and only the missing runs
+ * are read from the device. Small sequential requests cause the cache to
+ * read ahead up to CONFIG_BLOCK_CACHE_READAHEAD blocks.
+ *
+ * @param desc - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param buffer - buffer to contain the data
+ * @param read - function used to read from the device
+ *
+ * @return - number of blocks read, or the device's error value
+ */
+ulong blkcache_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		     void *buffer, blkcache_read_fn read);
+
+/* raw write operation used by the block cache to access the device */
+typedef ulong (*blkcache_write_fn)(struct blk_desc *desc, lbaint_t start,
+				   lbaint_t blkcnt, const void *buffer);
+
+/**
+ * blkcache_dwrite() - write blocks through the block cache
+ *
+ * Cached copies of the blocks are dropped. With
+ * CONFIG_BLOCK_CACHE_WRITEBACK small writes are held in the cache until
+ * the device is flushed, otherwise they go straight to the device.
+ *
+ * @param desc - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param buffer - buffer containing the data
+ * @param write - function used to write to the device
+ *
+ * @return - number of blocks written, or the device's error value
+ */
+ulong blkcache_dwrite(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		      const void *buffer, blkcache_write_fn write);
+
+/**
+ * blkcache_flush() - write back dirty blocks of a device
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_flush(int iftype, int dev);
+
+/**
+ * blkcache_flush_all() - write back dirty blocks of all devices
+ *
+ * This is called before handing over to an operating system.
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_flush_all(void);
+
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
  *
@@ -154,30 +217,72 @@ void blkcache_fill(int iftype, int dev,
 
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
- * because of a write or device (re)initialization.
+ * because of a write or device (re)initialization. Dirty blocks are
+ * written back first. If that fails they stay in the cache, so that
+ * nothing written is lost, and only the clean blocks are discarded.
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
+ *
+ * @return - 0 if OK, -ve on error writing back dirty blocks
  */
-void blkcache_invalidate(int iftype, int dev);
+int blkcache_invalidate(int iftype, int dev);
+
+/**
+ * blkcache_discard() - discard the cache for a device, including any
+ * dirty blocks. This is only for a device which is going away, once
+ * blkcache_invalidate() has failed to write its blocks back.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ */
+void blkcache_discard(int iftype, int dev);
 
 /**
  * blkcache_configure() - configure block cache
  *
+ * Dirty blocks are written back first. If that fails, the cache is left
+ * as it is.
+ *
  * @param blocks - maximum blocks per entry
  * @param entries - maximum entries in cache
+ *
+ * @return - 0 if OK, -ve on error writing back dirty blocks
+ */
+int blkcache_configure(unsigned blocks, unsigned entries);
+
+/* maximum number of devices tracked by the block cache statistics */
+#define BLKCACHE_MAX_DEVS	8
+
+/*
+ * per-device statistics of the block cache, counted in blocks except for
+ * @reads and @writes which count transfers issued to the device
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned readahead; /* blocks read beyond sequential requests */
+	unsigned reads;
+	unsigned writes;
+	unsigned writeback; /* dirty blocks written to the device */
+	unsigned dirty; /* current dirty block count */
+};
 
 /*
- * statistics of the block cache
+ * statistics of the block cache, hits and misses are counted in blocks
  */
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned readahead;
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned ways; /* associativity, 0 until the cache is allocated */
+	unsigned num_devs;
+	struct block_cache_dev_stats devs[BLKCACHE_MAX_DEVS];
 };
 
 /**
@@ -189,6 +294,36 @@ void blkcache_stats(struct block_cache_stats *stats);
 
 #else
 
+typedef ulong (*blkcache_read_fn)(struct blk_desc *desc, lbaint_t start,
+				  lbaint_t blkcnt, void *buffer);
+
+static inline ulong blkcache_dread(struct blk_desc *desc, lbaint_t start,
+				   lbaint_t blkcnt, void *buffer,
+				   blkcache_read_fn read)
+{
+	return read(desc, start, blkcnt, buffer);
+}
+
+typedef ulong (*blkcache_write_fn)(struct blk_desc *desc, lbaint_t start,
+				   lbaint_t blkcnt, const void *buffer);
+
+static inline ulong blkcache_dwrite(struct blk_desc *desc, lbaint_t start,
+				    lbaint_t blkcnt, const void *buffer,
+				    blkcache_write_fn write)
+{
+	return write(desc, start, blkcnt, buffer);
+}
+
+static inline int blkcache_flush(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline int blkcache_flush_all(void)
+{
+	return 0;
+}
+
 static inline int blkcache_read(int iftype, int dev,
 				lbaint_t start, lbaint_t blkcnt,
 				unsigned long blksz, void *buffer)
@@ -200,7 +335,12 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
-static inline void blkcache_invalidate(int iftype, int dev) {}
+static inline int blkcache_invalidate(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline void blkcache_discard(int iftype, int dev) {}
 
 #endif
 
@@ -456,14 +596,16 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	if (blkcache_invalidate(block_dev->if_type, block_dev->devnum))
+		return 0;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	if (blkcache_invalidate(block_dev->if_type, block_dev->devnum))
+		return 0;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
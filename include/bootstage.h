@@ -205,6 +205,9 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_FS_READ,
+	BOOTSTAGE_ID_ACCUM_DM_INDEX,
+	BOOTSTAGE_ID_ACCUM_DM_LAZY,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -32,6 +32,21 @@ struct driver *lists_driver_lookup_name(const char *name);
  */
 struct uclass_driver *lists_uclass_lookup(enum uclass_id id);
 
+/**
+ * lists_driver_lookup_compat() - find the driver for a compatible string
+ *
+ * This finds the first driver, in linker-list order, with @compat in its
+ * of_match list. With CONFIG_DM_COMPAT_INDEX this uses a hash table, built
+ * on first use, rather than searching all drivers.
+ *
+ * @compat: Compatible string to look up
+ * @drvp: Returns the driver
+ * @idp: Returns the entry in the driver's of_match list
+ * @return 0 if found, -ENOENT if no driver has @compat
+ */
+int lists_driver_lookup_compat(const char *compat, struct driver **drvp,
+			       const struct udevice_id **idp);
+
 /**
  * lists_bind_drivers() - search for and bind all drivers to parent
  *
@@ -252,12 +252,34 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 /**
  * of_find_node_by_phandle() - Find a node given a phandle
  *
+ * This uses an index of the nodes by phandle, which is built again if the
+ * root of the live tree has changed since it was last built.
+ *
  * @handle:	phandle of the node to find
  *
  * @return node pointer, or NULL if not found
  */
 struct device_node *of_find_node_by_phandle(phandle handle);
 
+/**
+ * of_phandle_cache_build() - Build the index used by of_find_node_by_phandle()
+ *
+ * This is called by of_live_build() once the tree has been unflattened.
+ *
+ * @root:	Root of the live tree to index
+ * @return 0 if OK, -ENOMEM if out of memory, in which case phandles are
+ *	looked up by searching the tree
+ */
+int of_phandle_cache_build(struct device_node *root);
+
+/**
+ * of_phandle_cache_invalidate() - Drop the index of nodes by phandle
+ *
+ * This must be called if the phandles in the live tree are changed. The index
+ * is built again when next needed.
+ */
+void of_phandle_cache_invalidate(void);
+
 /**
  * of_read_u32() - Find and read a 32-bit integer from a property
  *
@@ -465,7 +487,9 @@ int of_count_phandle_with_args(const struct device_node *np,
  *
  * The function scans all the properties of the 'aliases' node and populates
  * the lookup table with the properties.  It returns the number of alias
- * properties found, or an error code in case of failure.
+ * properties found, or an error code in case of failure. Any aliases from
+ * an earlier scan are dropped, so this can be called again if the tree
+ * changes.
  *
  * @return 9 if OK, -ENOMEM if not enough memory
  */
@@ -9,6 +9,10 @@
 #ifndef _DM_ROOT_H_
 #define _DM_ROOT_H_
 
+#include <dm/ofnode.h>
+#include <dm/uclass-id.h>
+#include <linux/errno.h>
+
 struct udevice;
 
 /**
@@ -68,6 +72,80 @@ int dm_scan_fdt(const void *blob, bool pre_reloc_only);
  */
 int dm_extended_scan_fdt(const void *blob, bool pre_reloc_only);
 
+/**
+ * dm_scan_fdt_lazy() - Record the devices in the device tree for binding later
+ *
+ * This looks at the same nodes as dm_extended_scan_fdt() but instead of
+ * binding them it records which uclasses each top-level node (and its
+ * subnodes) provides. The nodes are bound when first needed, by
+ * dm_lazy_bind_uclass() or dm_lazy_bind_ofnode(). A node with a driver that
+ * binds its subnodes by name may provide any uclass. This is only used after
+ * relocation.
+ *
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int dm_scan_fdt_lazy(void);
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+
+/**
+ * dm_lazy_bind_uclass() - Bind devices recorded by dm_scan_fdt_lazy()
+ *
+ * This binds every recorded top-level node which may provide a device in
+ * uclass @id, in device tree order. It is called by uclass_get() so that
+ * looking up a device in any way binds it first.
+ *
+ * A node which fails to bind is reported and skipped, so that every caller
+ * sees the same devices.
+ *
+ * @id: Uclass ID to bind devices for
+ * @return 0
+ */
+int dm_lazy_bind_uclass(enum uclass_id id);
+
+/**
+ * dm_lazy_bind_ofnode() - Bind the recorded node containing @node
+ *
+ * @node: Node to bind a device for
+ * @return 0 if something was bound, -ENOENT if @node is not pending,
+ *	other -ve value on error
+ */
+int dm_lazy_bind_ofnode(ofnode node);
+
+/**
+ * dm_lazy_bind_all() - Bind all devices recorded by dm_scan_fdt_lazy()
+ *
+ * As with dm_lazy_bind_uclass(), nodes which fail to bind are skipped.
+ *
+ * @return 0
+ */
+int dm_lazy_bind_all(void);
+
+/**
+ * dm_lazy_reset() - Drop the devices recorded by dm_scan_fdt_lazy()
+ */
+void dm_lazy_reset(void);
+#else
+static inline int dm_lazy_bind_uclass(enum uclass_id id)
+{
+	return 0;
+}
+
+static inline int dm_lazy_bind_ofnode(ofnode node)
+{
+	return -ENOENT;
+}
+
+static inline int dm_lazy_bind_all(void)
+{
+	return 0;
+}
+
+static inline void dm_lazy_reset(void)
+{
+}
+#endif
+
 /**
  * dm_scan_other() - Scan for other devices
  *
@@ -251,4 +251,23 @@ struct uclass *uclass_find(enum uclass_id key);
  */
 int uclass_destroy(struct uclass *uc);
 
+/**
+ * uclass_index_invalidate() - Note that devices in a uclass have changed
+ *
+ * The hash tables used to find devices in the uclass by name, sequence
+ * number or ofnode are built again when next used. This must be called
+ * after a device is added to or removed from the uclass, or its name,
+ * seq, req_seq or node is changed. Driver model does this itself when
+ * binding, probing, removing, unbinding or renaming a device, which also
+ * covers changes made by the device's driver, its parent or its uclass
+ * while that is going on.
+ *
+ * @uc:		uclass whose devices have changed
+ */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void uclass_index_invalidate(struct uclass *uc);
+#else
+static inline void uclass_index_invalidate(struct uclass *uc) {}
+#endif
+
 #endif
@@ -123,6 +123,10 @@ struct ext_block_cache {
 	char *buf;
 	lbaint_t block;
 	int size;
+	/* Last extent looked up: logical block, length, physical block */
+	long int ext_block;
+	long int ext_len;
+	unsigned long long ext_start;
 };
 
 extern struct ext2_data *ext4fs_root;
@@ -157,6 +161,8 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+long int read_allocated_blocks(struct ext2_inode *inode, int fileblock,
+			       struct ext_block_cache *cache, long int *countp);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 struct disk_partition *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -651,6 +651,29 @@ int fdtdec_get_chosen_node(const void *blob, const char *name);
  */
 const char *fdtdec_get_compatible(enum fdt_compat_id id);
 
+/**
+ * fdtdec_node_offset_by_phandle() - find a node given its phandle
+ *
+ * This does the same as fdt_node_offset_by_phandle(). For gd->fdt_blob after
+ * relocation it uses an index of the nodes by phandle, built on first use.
+ * Each offset found in the index is checked, and if the blob has changed the
+ * index is built again, but callers that change gd->fdt_blob should still
+ * call fdtdec_phandle_cache_invalidate().
+ *
+ * @blob:	FDT blob
+ * @phandle:	phandle to look for
+ * @return node offset if found, -ve error code on error
+ */
+int fdtdec_node_offset_by_phandle(const void *blob, u32 phandle);
+
+/**
+ * fdtdec_phandle_cache_invalidate() - drop the index of nodes by phandle
+ *
+ * This should be called after nodes are added to or removed from
+ * gd->fdt_blob, or an overlay is applied to it.
+ */
+void fdtdec_phandle_cache_invalidate(void);
+
 /* Look up a phandle and follow it to its node. Then return the offset
  * of that node.
  *
@@ -308,6 +308,7 @@ enum {
 	IH_COMP_LZMA,			/* lzma  Compression Used	*/
 	IH_COMP_LZO,			/* lzo   Compression Used	*/
 	IH_COMP_LZ4,			/* lz4   Compression Used	*/
+	IH_COMP_ZSTD,			/* zstd  Compression Used	*/
 
 	IH_COMP_COUNT,
 };
@@ -885,7 +886,7 @@ static inline int image_check_target_arch(const image_header_t *hdr)
  * @return	compression type or IH_COMP_NONE if not compressed.
  *
  * Note: Only following compression types are supported now.
- * lzo, lzma, gzip, bzip2
+ * lzo, lzma, gzip, bzip2, zstd
  */
 int image_decomp_type(const unsigned char *buf, ulong len);
 
@@ -906,6 +907,66 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * struct image_decomp_stream - state of a streaming decompression
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space for decompression
+ * @out_len:	Number of bytes decompressed so far
+ * @priv:	Decoder state
+ */
+struct image_decomp_stream {
+	int comp;
+	void *out;
+	ulong out_size;
+	ulong out_len;
+	void *priv;
+};
+
+/**
+ * image_decomp_stream_start() - start a streaming decompression
+ *
+ * Unlike image_decomp(), the compressed data does not have to be in memory
+ * all at once. It is passed to image_decomp_stream_feed() in pieces as it
+ * is read, so that no full copy of the compressed image is needed.
+ *
+ * @ds:		Stream state to set up
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space for decompression
+ * @return 0 if OK, -ENOSYS if @comp cannot be streamed, -ENOMEM if out of
+ *	memory
+ */
+int image_decomp_stream_start(struct image_decomp_stream *ds, int comp,
+			      void *out, ulong out_size);
+
+/**
+ * image_decomp_stream_feed() - decompress the next piece of an image
+ *
+ * @ds:		Stream state
+ * @in:		Next piece of compressed data
+ * @len:	Number of bytes in @in
+ * A gzip or zstd file may hold several members or frames one after the
+ * other, which are decompressed one after the other as well. So input can
+ * still be passed in after 1 is returned; anything that does not start a
+ * new member or frame is then reported as corrupt. LZMA has just one
+ * stream and ignores anything after it.
+ *
+ * @return 0 if more input is needed, 1 if the input so far ends at the end
+ *	of the compressed stream, -ENOBUFS if the output does not fit, other
+ *	-ve value on corrupt data
+ */
+int image_decomp_stream_feed(struct image_decomp_stream *ds, const void *in,
+			     ulong len);
+
+/**
+ * image_decomp_stream_end() - release the state of a streaming decompression
+ *
+ * @ds:		Stream state
+ */
+void image_decomp_stream_end(struct image_decomp_stream *ds);
+
 /**
  * Set up properties in the FDT
  *
@@ -965,6 +1026,8 @@ int booti_setup(ulong image, ulong *relocated_addr, ulong *size,
 #define FIT_ALGO_PROP		"algo"
 #define FIT_VALUE_PROP		"value"
 #define FIT_IGNORE_PROP		"uboot-ignore"
+#define FIT_CHUNK_SIZE_PROP	"chunk-size"
+#define FIT_CHUNK_VALUE_PROP	"chunk-value"
 #define FIT_SIG_NODENAME	"signature"
 #define FIT_KEY_REQUIRED	"required"
 #define FIT_KEY_HINT		"key-name-hint"
@@ -1105,6 +1168,90 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size);
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * struct fit_hash_result - digest for a hash node, worked out in advance
+ *
+ * With CONFIG_WORK_QUEUE, the digests of several hash nodes are calculated
+ * on all CPUs at once, just before they are checked. Checking then looks up
+ * the result here instead of hashing the data again.
+ *
+ * @fit:	FIT containing the hash node
+ * @noffset:	Offset of the hash node
+ * @data:	Image data that was hashed
+ * @size:	Size of the image data in bytes
+ * @algo:	Hash algorithm name
+ * @value:	Digest, if @ret is 0
+ * @value_len:	Length of @value in bytes
+ * @ret:	0 if OK, -ve if the algorithm is not supported
+ */
+struct fit_hash_result {
+	const void *fit;
+	int noffset;
+	const void *data;
+	size_t size;
+	const char *algo;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	int ret;
+};
+
+/**
+ * struct fit_chunk_verify - state for checking image data chunk by chunk
+ *
+ * A hash node may carry a 'chunk-size' property and a 'chunk-value' table
+ * holding the digest of each chunk-size piece of the image data, in order.
+ * This allows each piece to be checked as soon as it is in memory, rather
+ * than waiting for the whole image.
+ *
+ * @data:	Start of the image data
+ * @size:	Size of the image data in bytes
+ * @chunk_size:	Number of bytes covered by each digest (the last chunk may
+ *		be shorter)
+ * @done:	Number of bytes checked so far
+ * @algo:	Hash algorithm name
+ * @table:	Digest of the next chunk to check
+ * @value_len:	Length of each digest in @table
+ */
+struct fit_chunk_verify {
+	const uint8_t *data;
+	size_t size;
+	size_t chunk_size;
+	size_t done;
+	const char *algo;
+	const uint8_t *table;
+	int value_len;
+};
+
+/**
+ * fit_image_chunk_verify_init() - set up chunked checking of an image
+ *
+ * This looks for the first hash node of the image which has a chunk table.
+ *
+ * @fit:	FIT to check
+ * @image_noffset: Offset of image node
+ * @data:	Address where the image data is, or will be, in memory
+ * @size:	Size of image data
+ * @ctx:	Returns the state to pass to fit_image_chunk_verify_update()
+ * @return 0 if OK, -ENOENT if the image has no chunk table, -EINVAL if the
+ *	table is malformed
+ */
+int fit_image_chunk_verify_init(const void *fit, int image_noffset,
+				const void *data, size_t size,
+				struct fit_chunk_verify *ctx);
+
+/**
+ * fit_image_chunk_verify_update() - check the chunks which have arrived
+ *
+ * Every chunk lying wholly within the first @avail bytes of the image data,
+ * and not yet checked, is hashed and compared with the table.
+ *
+ * @ctx:	State from fit_image_chunk_verify_init()
+ * @avail:	Number of bytes of image data now in memory
+ * @return 0 if OK, -EBADMSG if a chunk does not match, -EPROTONOSUPPORT if
+ *	the hash algorithm is not supported
+ */
+int fit_image_chunk_verify_update(struct fit_chunk_verify *ctx, size_t avail);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
 int fit_config_decrypt(const void *fit, int conf_noffset);
@@ -1183,6 +1330,12 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 # define FIT_IMAGE_ENABLE_VERIFY	CONFIG_IS_ENABLED(FIT_SIGNATURE)
 #endif
 
+#ifdef USE_HOSTCC
+# define FIT_IMAGE_ENABLE_CHUNKED_HASH	1
+#else
+# define FIT_IMAGE_ENABLE_CHUNKED_HASH	CONFIG_IS_ENABLED(FIT_CHUNKED_HASH)
+#endif
+
 #if IMAGE_ENABLE_FIT
 #ifdef USE_HOSTCC
 void *image_get_host_blob(void);
@@ -1144,4 +1144,26 @@ size_t ZSTD_decompressBlock(ZSTD_DCtx *dctx, void *dst, size_t dstCapacity,
 size_t ZSTD_insertBlock(ZSTD_DCtx *dctx, const void *blockStart,
 	size_t blockSize);
 
+/*-*****************************************************************************
+ * U-Boot wrapper
+ ******************************************************************************/
+
+/**
+ * zstd_decompress() - Decompress a buffer holding one or more zstd frames
+ *
+ * The decompression context is allocated from the heap for the duration of
+ * the call.
+ *
+ * @src:  Source data to decompress
+ * @srcn: Length of source data
+ * @dst:  Destination for uncompressed data
+ * @dstn: Size of the destination buffer on entry, returns the length of the
+ *        uncompressed data. On error this is left as the size of the buffer
+ *        for -ENOBUFS and set to 0 otherwise, since zstd does not say how
+ *        much was written.
+ * @return 0 if OK, -ENOMEM if the context cannot be allocated, -ENOBUFS if
+ *	the destination buffer is too small, -EINVAL if the data is corrupt
+ */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+
 #endif  /* ZSTD_H */
@@ -9,6 +9,9 @@
 /**
  * ulz4fn() - Decompress LZ4 data
  *
+ * With CONFIG_WORK_QUEUE the blocks of the frame are decompressed on all
+ * available CPUs, unless @src and @dst overlap.
+ *
  * @src: Source data to decompress
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
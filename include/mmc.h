@@ -74,6 +74,8 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+/* Host can end multi-block transfers by block count (CMD23) */
+#define MMC_CAP_CMD23		BIT(17)
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -82,6 +84,7 @@ struct bd_info;
 
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_SCR_CMD23	0x00000002
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -616,6 +619,25 @@ static inline bool supports_uhs(uint caps)
 #endif
 }
 
+/**
+ * struct mmc_stats - transfer statistics for an MMC device
+ *
+ * @read_cmds:		Number of read commands sent
+ * @read_blocks:	Number of blocks read
+ * @read_us:		Time spent reading, in microseconds
+ * @write_cmds:		Number of write commands sent
+ * @write_blocks:	Number of blocks written
+ * @write_us:		Time spent writing, in microseconds
+ */
+struct mmc_stats {
+	ulong read_cmds;
+	u64 read_blocks;
+	u64 read_us;
+	ulong write_cmds;
+	u64 write_blocks;
+	u64 write_us;
+};
+
 /*
  * With CONFIG_DM_MMC enabled, struct mmc can be accessed from the MMC device
  * with mmc_get_mmc_dev().
@@ -697,6 +719,7 @@ struct mmc {
 				  * accessing the boot partitions
 				  */
 	u32 quirks;
+	struct mmc_stats stats;
 };
 
 struct mmc_hwpart_conf {
@@ -758,6 +781,10 @@ int mmc_deinit(struct mmc *mmc);
 /**
  * mmc_of_parse() - Parse the device tree to get the capabilities of the host
  *
+ * As well as the standard properties, "u-boot,cap-cmd23" says that the host
+ * stops a multi-block transfer by itself once the block count set by CMD23
+ * is reached, so that MMC_CAP_CMD23 can be used.
+ *
  * @dev:	MMC device
  * @cfg:	MMC configuration
  * @return 0 if OK, -ve on error
@@ -98,6 +98,48 @@ typedef void rxhand_icmp_f(unsigned type, unsigned code, unsigned dport,
  */
 typedef void	thand_f(void);
 
+/**
+ * struct net_rx_direct - receive payloads straight to their final address
+ *
+ * A protocol which knows where the payload of the next packet it expects
+ * belongs (e.g. TFTP) registers this with net_set_rx_direct(). Drivers that
+ * support it (see eth_ops.recv_split) then receive the headers and the
+ * payload of each packet into separate buffers, so the payload does not
+ * have to be copied out of net_rx_packets[]. This relies on the headers in
+ * front of the payload having a fixed size.
+ *
+ * @hdr_len: length of the protocol header following the UDP header
+ * @get_buf: return the address where the payload of the next expected
+ *	     packet belongs and set *lenp to the space there, or return NULL
+ *	     to receive the next packet in the normal way
+ * @handler: handle a packet received into the buffer from get_buf(). @hdr
+ *	     is the protocol header and @payload the @len bytes following it.
+ *	     Return 0 if the packet was consumed or -EAGAIN to have it passed
+ *	     to the UDP handler in one piece instead
+ */
+struct net_rx_direct {
+	unsigned int hdr_len;
+	uchar *(*get_buf)(unsigned int *lenp);
+	int (*handler)(uchar *hdr, uchar *payload, unsigned int len,
+		       unsigned int dport, struct in_addr sip,
+		       unsigned int sport);
+};
+
+/**
+ * struct eth_rx_split - buffers for receiving a packet in two parts
+ *
+ * @hdr: buffer for the first @hdr_len bytes of the frame
+ * @hdr_len: number of bytes to receive into @hdr
+ * @payload: buffer for the rest of the frame
+ * @payload_len: space available at @payload
+ */
+struct eth_rx_split {
+	uchar *hdr;
+	unsigned int hdr_len;
+	uchar *payload;
+	unsigned int payload_len;
+};
+
 enum eth_state_t {
 	ETH_STATE_INIT,
 	ETH_STATE_PASSIVE,
@@ -143,6 +185,12 @@ enum eth_recv_flags {
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
+ * recv_split: Like recv, but receive the first split->hdr_len bytes of the
+ *	       packet into split->hdr and the rest into split->payload, and
+ *	       return the total length. The packet is released before
+ *	       returning, so free_pkt() is not called. If the packet does not
+ *	       fit, return -E2BIG and leave it to be picked up by recv() -
+ *	       optional
  * stop: Stop the hardware from looking for packets - may be called even if
  *	 state == PASSIVE
  * mcast: Join or leave a multicast group (for TFTP) - optional
@@ -161,6 +209,8 @@ struct eth_ops {
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
+	int (*recv_split)(struct udevice *dev, int flags,
+			  struct eth_rx_split *split);
 	void (*stop)(struct udevice *dev);
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
 	int (*write_hwaddr)(struct udevice *dev);
@@ -700,6 +750,30 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
+/**
+ * net_set_rx_direct() - set the protocol receiving payloads directly
+ *
+ * @rxd: protocol callbacks, or NULL to receive all packets normally
+ */
+void net_set_rx_direct(const struct net_rx_direct *rxd);
+
+/**
+ * net_get_rx_split() - get the buffers for receiving the next packet
+ *
+ * @split: returns the buffers to receive the next packet into
+ * @return true if the next packet should be received split, false if it
+ *	should be received normally
+ */
+bool net_get_rx_split(struct eth_rx_split *split);
+
+/**
+ * net_process_received_split() - process a packet received in two parts
+ *
+ * @split: buffers set up by net_get_rx_split()
+ * @len: total length of the frame
+ */
+void net_process_received_split(struct eth_rx_split *split, int len);
+
 #if defined(CONFIG_NETCONSOLE) && !defined(CONFIG_SPL_BUILD)
 void nc_start(void);
 int nc_input_packet(uchar *pkt, struct in_addr src_ip, unsigned dest_port,
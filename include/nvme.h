@@ -71,7 +71,8 @@ int nvme_scan_namespace(void);
  * nvme_print_info - print detailed NVMe controller and namespace information
  *
  * This prints out detailed human readable NVMe controller and namespace
- * information which is very useful for debugging.
+ * information which is very useful for debugging, followed by the command
+ * statistics of each of the controller's queues.
  *
  * @udev:	NVMe controller device
  * @return:	0 on success, -EIO if NVMe identify command fails
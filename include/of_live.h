@@ -9,15 +9,106 @@
 #ifndef _OF_LIVE_H
 #define _OF_LIVE_H
 
+#include <linux/types.h>
+
 struct device_node;
 
+/* "OFLV", in the byte order of the target */
+#define OF_LIVE_SNAP_MAGIC	0x4f464c56
+#define OF_LIVE_SNAP_VERSION	1
+
+/* Set in @flags once the pointers in a snapshot have been fixed up */
+#define OF_LIVE_SNAP_FIXED	(1U << 0)
+
+/* Set in a relocation if the pointer is relative to the FDT, not snapshot */
+#define OF_LIVE_SNAP_RELOC_FDT	(1U << 31)
+
+/**
+ * struct of_live_snap_hdr - header of a live tree snapshot
+ *
+ * A snapshot holds a live tree which has already been unflattened, using
+ * the target's own struct device_node and struct property layout. Each
+ * pointer in it is stored as an offset from the start of the snapshot or,
+ * for property names and values, from the start of the FDT it was made
+ * from. A table of relocations (one u32 per pointer, holding the offset of
+ * the pointer within the snapshot and OF_LIVE_SNAP_RELOC_FDT if needed)
+ * lists the pointers to fix up. All fields are in the target's byte order.
+ *
+ * Snapshots are written by 'dtoc live' at build time, or by
+ * of_live_snap_create().
+ *
+ * @magic: OF_LIVE_SNAP_MAGIC
+ * @version: OF_LIVE_SNAP_VERSION
+ * @size: Total size of the snapshot in bytes
+ * @flags: OF_LIVE_SNAP_... flags
+ * @ptr_size: sizeof(void *) on the target
+ * @node_size: sizeof(struct device_node) on the target
+ * @prop_size: sizeof(struct property) on the target
+ * @fdt_size: fdt_totalsize() of the FDT the snapshot was made from
+ * @fdt_crc32: crc32() of that FDT
+ * @root: Offset of the root node
+ * @reloc: Offset of the relocation table
+ * @reloc_count: Number of relocations
+ */
+struct of_live_snap_hdr {
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 flags;
+	u32 ptr_size;
+	u32 node_size;
+	u32 prop_size;
+	u32 fdt_size;
+	u32 fdt_crc32;
+	u32 root;
+	u32 reloc;
+	u32 reloc_count;
+};
+
 /**
  * of_live_build() - build a live (hierarchical) tree from a flat DT
  *
+ * With CONFIG_OF_LIVE_SNAPSHOT this uses the snapshot built into U-Boot if
+ * it was made from @fdt_blob, otherwise the tree is unflattened.
+ *
  * @fdt_blob: Input tree to convert
  * @rootp: Returns live tree that was created
  * @return 0 if OK, -ve on error
  */
 int of_live_build(const void *fdt_blob, struct device_node **rootp);
 
+/**
+ * of_live_snap_load() - use a live tree snapshot in place
+ *
+ * This checks that the snapshot suits this build and was made from
+ * @fdt_blob, then fixes up its pointers. It can only be done once, since
+ * the snapshot is updated in place.
+ *
+ * @snap: Snapshot to use, which must be writable and aligned for pointers
+ * @fdt_blob: FDT the snapshot was made from, which must stay in place while
+ *	the tree is in use
+ * @rootp: Returns the root node of the tree
+ * @return 0 if OK, -EPROTONOSUPPORT if the snapshot has the wrong format,
+ *	-ESTALE if it was made from a different FDT, -EALREADY if it has
+ *	already been used, -EINVAL if it is corrupt
+ */
+int of_live_snap_load(void *snap, const void *fdt_blob,
+		      struct device_node **rootp);
+
+/**
+ * of_live_snap_create() - write a snapshot of a live tree
+ *
+ * This does the same as 'dtoc live', but starting from a live tree, so that
+ * snapshots can be tested with any device tree. Strings and values which
+ * are not in @fdt_blob are copied into the snapshot.
+ *
+ * @root: Root of the live tree
+ * @fdt_blob: FDT which the tree was unflattened from
+ * @buf: Buffer to write the snapshot to, or NULL to just get the size
+ * @size: Size of @buf in bytes
+ * @return size of the snapshot in bytes, -ENOSPC if it does not fit in @buf
+ */
+int of_live_snap_create(const struct device_node *root, const void *fdt_blob,
+			void *buf, int size);
+
 #endif
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Helpers for hash tables with open addressing
+ *
+ * Several lookups in driver model and the device tree code use a table of
+ * slots indexed by a hash of the key. A key which hashes to a slot that is
+ * already taken goes in the next free slot (linear probing), so a lookup
+ * checks slots from the one for its hash until it finds the key or an empty
+ * slot. Entries are never removed; a table is built again instead.
+ *
+ * The caller owns the table and decides what a slot holds and what marks it
+ * empty. These helpers only pick the size, hash the key and walk the slots.
+ */
+
+#ifndef __OPEN_HASH_H
+#define __OPEN_HASH_H
+
+#include <linux/types.h>
+
+/**
+ * open_hash_slots() - get the number of slots for a table
+ *
+ * The table is kept at most half full, so that lookups stay short and there
+ * is always an empty slot to end them. The number of slots is a power of two,
+ * so that a hash is turned into a slot index by masking it.
+ *
+ * @count:	Number of entries the table must hold
+ * @min:	Minimum number of slots, which must be a power of two
+ * @return number of slots
+ */
+uint open_hash_slots(uint count, uint min);
+
+/**
+ * open_hash_str() - hash a string
+ *
+ * This uses the FNV-1a hash, which is short and spreads similar strings well.
+ *
+ * @str:	String to hash
+ * @return hash value
+ */
+uint open_hash_str(const char *str);
+
+/**
+ * open_hash_long() - hash an integer
+ *
+ * This uses Fibonacci hashing, which spreads values that differ only in
+ * their upper bits (such as device tree offsets) over the whole table.
+ *
+ * @val:	Value to hash
+ * @return hash value
+ */
+static inline uint open_hash_long(long val)
+{
+	return ((u64)val * 0x9e3779b97f4a7c15ULL) >> 32;
+}
+
+/**
+ * open_hash_for_each_slot() - walk the slots a key may be in
+ *
+ * This loops forever, so the body must break out or return when it finds the
+ * key or an empty slot.
+ *
+ * @pos:	uint variable which is set to the index of each slot
+ * @hash:	Hash of the key
+ * @mask:	Number of slots in the table minus one
+ */
+#define open_hash_for_each_slot(pos, hash, mask) \
+	for (pos = (hash) & (mask);; pos = (pos + 1) & (mask))
+
+#endif
@@ -355,4 +355,34 @@ int os_read_file(const char *name, void **bufp, int *sizep);
  */
 void *os_find_text_base(void);
 
+/**
+ * os_get_cpu_count() - Get the number of CPUs on the host
+ *
+ * @return number of CPUs currently online, at least 1
+ */
+int os_get_cpu_count(void);
+
+/**
+ * os_thread_create() - Run a function in a new host thread
+ *
+ * The thread shares all memory with U-Boot, which has no locking of its
+ * own, so @func must only touch memory that nothing else uses meanwhile.
+ *
+ * @threadp:	Returns a handle for the thread, to pass to os_thread_join()
+ * @func:	Function to run in the thread
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_create(void **threadp, void (*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - Wait for a thread to finish
+ *
+ * This also frees the thread handle.
+ *
+ * @thread:	Handle returned by os_thread_create()
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_join(void *thread);
+
 #endif
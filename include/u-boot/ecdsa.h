@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * ECDSA signatures for FIT images
+ *
+ * A key node for ECDSA holds the name of the curve and the affine
+ * coordinates of the public key point:
+ *
+ *	ecdsa,curve = "prime256v1";	(or "secp384r1")
+ *	ecdsa,x-point = <...>;		(big endian, curve size in bytes)
+ *	ecdsa,y-point = <...>;
+ *
+ * A signature is the concatenation of r and s, each as a big endian number
+ * of the curve size in bytes.
+ */
+
+#ifndef _ECDSA_H
+#define _ECDSA_H
+
+#include <errno.h>
+#include <image.h>
+#include <linux/kconfig.h>
+
+#define ECDSA256_BYTES	(256 / 8)
+#define ECDSA384_BYTES	(384 / 8)
+
+struct image_sign_info;
+struct image_region;
+
+#ifdef USE_HOSTCC
+# define ECDSA_ENABLE_VERIFY	IMAGE_ENABLE_VERIFY
+#else
+# define ECDSA_ENABLE_VERIFY	CONFIG_IS_ENABLED(ECDSA_VERIFY)
+#endif
+
+#if IMAGE_ENABLE_SIGN
+/**
+ * ecdsa_sign() - calculate and return signature for given input data
+ *
+ * The private key is read from <keydir>/<keyname>.key in PEM format.
+ *
+ * @info:	Specifies key and FIT information
+ * @region:	Pointer to the input data
+ * @region_count: Number of regions
+ * @sigp:	Set to an allocated buffer holding the signature
+ * @sig_len:	Set to length of the calculated signature
+ * @return 0 if OK, -ve on error
+ */
+int ecdsa_sign(struct image_sign_info *info,
+	       const struct image_region region[],
+	       int region_count, uint8_t **sigp, uint *sig_len);
+
+/**
+ * ecdsa_add_verify_data() - Add verification information to FDT
+ *
+ * Add the curve and public key point to a key node in @keydest. The public
+ * key is read from the certificate <keydir>/<keyname>.crt.
+ *
+ * @info:	Specifies key and FIT information
+ * @keydest:	Destination FDT blob for public key data
+ * @return: 0, on success, -ENOSPC if the keydest FDT blob ran out of space,
+ *	other -ve value on error
+ */
+int ecdsa_add_verify_data(struct image_sign_info *info, void *keydest);
+#else
+static inline int ecdsa_sign(struct image_sign_info *info,
+			     const struct image_region region[],
+			     int region_count, uint8_t **sigp, uint *sig_len)
+{
+	return -ENXIO;
+}
+
+static inline int ecdsa_add_verify_data(struct image_sign_info *info,
+					void *keydest)
+{
+	return -ENXIO;
+}
+#endif
+
+#if ECDSA_ENABLE_VERIFY
+/**
+ * ecdsa_verify() - Verify a signature against some data
+ *
+ * @info:	Specifies key and FIT information
+ * @region:	Pointer to the input data
+ * @region_count: Number of regions
+ * @sig:	Signature
+ * @sig_len:	Number of bytes in signature
+ * @return 0 if verified, -ve on error
+ */
+int ecdsa_verify(struct image_sign_info *info,
+		 const struct image_region region[], int region_count,
+		 uint8_t *sig, uint sig_len);
+
+/**
+ * ecdsa_verify_hash() - Verify a signature of a hash with a raw key
+ *
+ * @curve:	Name of the curve ("prime256v1" or "secp384r1")
+ * @x:		X coordinate of the public key, big endian
+ * @y:		Y coordinate of the public key, big endian
+ * @hash:	Hash of the signed data
+ * @hash_len:	Number of bytes in @hash
+ * @sig:	Signature, r followed by s
+ * @sig_len:	Number of bytes in @sig, twice the curve size
+ * @return 0 if verified, -EACCES if the signature does not match, other
+ *	-ve value if the key or signature is malformed
+ */
+int ecdsa_verify_hash(const char *curve, const uint8_t *x, const uint8_t *y,
+		      const uint8_t *hash, uint hash_len,
+		      const uint8_t *sig, uint sig_len);
+#else
+static inline int ecdsa_verify(struct image_sign_info *info,
+			       const struct image_region region[],
+			       int region_count, uint8_t *sig, uint sig_len)
+{
+	return -ENXIO;
+}
+#endif
+
+#endif
@@ -52,6 +52,22 @@ void sha1_starts( sha1_context *ctx );
 void sha1_update(sha1_context *ctx, const unsigned char *input,
 		 unsigned int ilen);
 
+/**
+ * \brief	   SHA-1 process whole 64-byte blocks
+ *
+ * The generic version is portable C. Architectures with SHA-1 instructions
+ * override sha1_process() and fall back to sha1_process_generic() when the
+ * CPU lacks them.
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   buffer holding the blocks
+ * \param blocks   number of 64-byte blocks
+ */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   SHA-1 final digest
  *
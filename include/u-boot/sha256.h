@@ -19,6 +19,17 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/*
+ * Hash 'blocks' whole 64-byte blocks into the state of 'ctx'. The generic
+ * version is portable C. Architectures with SHA-256 instructions override
+ * sha256_process() and fall back to sha256_process_generic() when the CPU
+ * lacks them.
+ */
+void sha256_process(sha256_context *ctx, const uint8_t *data,
+		    unsigned int blocks);
+void sha256_process_generic(sha256_context *ctx, const uint8_t *data,
+			    unsigned int blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running independent jobs on secondary CPUs
+ *
+ * U-Boot normally runs on the boot CPU alone. Some work, such as hashing
+ * several images or decompressing independent frames, can be split into
+ * jobs which are then spread over all CPUs with wq_run(). The boot CPU takes
+ * a share of the jobs itself and returns once all of them are done.
+ *
+ * Jobs run at the same time as each other and as the boot CPU, without any
+ * locking in the rest of U-Boot, so they must be self-contained: they may
+ * only compute on memory set up for them before wq_run() is called. They must
+ * not print, allocate or free memory, use driver model, timers or the
+ * watchdog, or change global state. Anything like that belongs before or
+ * after the call to wq_run().
+ */
+
+#ifndef __WORK_QUEUE_H
+#define __WORK_QUEUE_H
+
+#include <linux/kconfig.h>
+#include <linux/types.h>
+
+/**
+ * struct wq_job - a self-contained piece of work
+ *
+ * @func:	Function to run, returning 0 if OK, -ve on error
+ * @arg:	Argument to pass to @func
+ * @ret:	Set to the return value of @func once the job has run
+ */
+struct wq_job {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+};
+
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+/**
+ * wq_cpu_count() - get the number of CPUs that jobs can run on
+ *
+ * @return number of CPUs, including the boot CPU, at least 1
+ */
+int wq_cpu_count(void);
+
+/**
+ * wq_set_max_cpus() - limit the number of CPUs that jobs can run on
+ *
+ * This is intended for benchmarks, which can compare the time taken on one
+ * CPU with that on all of them.
+ *
+ * @max:	Maximum number of CPUs to use, including the boot CPU, or 0 for
+ *		no limit
+ * @return previous limit
+ */
+int wq_set_max_cpus(int max);
+
+/**
+ * wq_run() - run a list of jobs on all available CPUs
+ *
+ * Job i is run by CPU (i % n), where n is the number of CPUs in use, so it
+ * helps to put the largest jobs first. Jobs that were meant for a CPU which
+ * could not be started, or which did not finish within a few times as long
+ * as the boot CPU took for its own jobs, are run on the boot CPU. Each job is
+ * run once, unless its CPU did not finish in which case the job may be run
+ * again from the start on the boot CPU.
+ *
+ * @jobs:	Jobs to run
+ * @count:	Number of jobs
+ * @return 0 if all jobs returned 0, else the return value of the first job
+ *	in @jobs which failed
+ */
+int wq_run(struct wq_job *jobs, int count);
+#else
+static inline int wq_cpu_count(void)
+{
+	return 1;
+}
+
+static inline int wq_set_max_cpus(int max)
+{
+	return 0;
+}
+
+static inline int wq_run(struct wq_job *jobs, int count)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		jobs[i].ret = jobs[i].func(jobs[i].arg);
+		if (jobs[i].ret && !ret)
+			ret = jobs[i].ret;
+	}
+
+	return ret;
+}
+#endif
+
+/**
+ * arch_wq_cpu_count() - get the number of CPUs the architecture can use
+ *
+ * The default returns 1, meaning that only the boot CPU is available.
+ *
+ * @return number of CPUs, including the boot CPU
+ */
+int arch_wq_cpu_count(void);
+
+/**
+ * arch_wq_start() - start running a function on a secondary CPU
+ *
+ * @cpu:	CPU to start, from 1 to arch_wq_cpu_count() - 1
+ * @func:	Function to run on that CPU
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error, in which case @func has not been run
+ */
+int arch_wq_start(int cpu, void (*func)(void *arg), void *arg);
+
+/**
+ * arch_wq_wait() - wait for a secondary CPU to finish running its function
+ *
+ * This is called once for each successful call to arch_wq_start(). Once it
+ * returns 0, the CPU may be started again. If the CPU does not finish in
+ * time it must not be used again, since it may be stuck part-way through.
+ *
+ * @cpu:	CPU to wait for
+ * @timeout_ms:	Time to wait in milliseconds
+ * @return 0 if the function ran to completion, -ETIMEDOUT if the CPU did not
+ *	finish in time, other -ve value if the CPU stopped without finishing
+ */
+int arch_wq_wait(int cpu, ulong timeout_ms);
+
+#endif
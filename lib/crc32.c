@@ -26,6 +26,8 @@
 #ifdef USE_HOSTCC
 #define __efi_runtime
 #define __efi_runtime_data
+#elif defined(CONFIG_ARMV8_CRC32)
+#include <asm/armv8/cpu.h>
 #endif
 
 #define tole(x) cpu_to_le32(x)
@@ -156,6 +158,23 @@ tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
 #endif
 
+/*
+ * Slicing-by-8: look up eight bytes at a time in eight tables instead of one
+ * byte at a time, at the cost of another 7 KiB of tables. The tools always
+ * use it.
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN && !defined(CONFIG_DYNAMIC_CRC_TABLE)
+# if defined(USE_HOSTCC)
+#  define CRC_SLICE_BY_8
+# elif CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#  define CRC_SLICE_BY_8
+# endif
+#endif
+
+#ifdef CRC_SLICE_BY_8
+#include "crc32_table8.h"
+#endif
+
 #if 0
 /* =========================================================================
  * This function can be used by asm versions of crc32()
@@ -189,6 +208,10 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
     if (crc_table_empty)
       make_crc_table();
+#endif
+#if !defined(USE_HOSTCC) && defined(CONFIG_ARMV8_CRC32)
+    if (cpu_has_crc32())
+	 return armv8_crc32_le(crc, buf, len);
 #endif
     crc = cpu_to_le32(crc);
     /* Align it */
@@ -200,6 +223,22 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC_SLICE_BY_8
+    for (; len >= 8; len -= 8) {
+	 uint32_t one = *b++ ^ crc;
+	 uint32_t two = *b++;
+
+	 crc = crc_table8[6][one & 255] ^
+	       crc_table8[5][(one >> 8) & 255] ^
+	       crc_table8[4][(one >> 16) & 255] ^
+	       crc_table8[3][one >> 24] ^
+	       crc_table8[2][two & 255] ^
+	       crc_table8[1][(two >> 8) & 255] ^
+	       crc_table8[0][(two >> 16) & 255] ^
+	       tab[two >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -12,10 +12,22 @@
 
 #include <common.h>
 #include <compiler.h>
+#ifdef CONFIG_ARMV8_CRC32
+#include <asm/armv8/cpu.h>
+#endif
+
+/* Bit-reflected Castagnoli polynomial, the one CRC32C instructions use */
+#define CRC32C_POLY_LE	0x82F63B78
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+#ifdef CONFIG_ARMV8_CRC32
+	/* crc32c_init() puts the polynomial at index 128 */
+	if (crc32c_table[128] == CRC32C_POLY_LE && cpu_has_crc32())
+		return armv8_crc32c_le(crc, (const uint8_t *)data, length);
+#endif
+
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
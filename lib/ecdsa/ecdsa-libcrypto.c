@@ -0,0 +1,366 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * ECDSA signing of FIT images with OpenSSL
+ */
+
+#include "mkimage.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <image.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <u-boot/ecdsa.h>
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || \
+	(defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER < 0x02070000fL)
+static void ECDSA_SIG_get0(const ECDSA_SIG *sig, const BIGNUM **pr,
+			   const BIGNUM **ps)
+{
+	if (pr)
+		*pr = sig->r;
+	if (ps)
+		*ps = sig->s;
+}
+#endif
+
+static int ecdsa_err(const char *msg)
+{
+	unsigned long sslErr = ERR_get_error();
+
+	fprintf(stderr, "%s", msg);
+	fprintf(stderr, ": %s\n",
+		ERR_error_string(sslErr, 0));
+
+	return -1;
+}
+
+/**
+ * ecdsa_get_pub_key() - read a public key from a .crt file
+ *
+ * @keydir:	Directory containing the key
+ * @name	Name of key file (will have a .crt extension)
+ * @ecp		Returns EC_KEY object, or NULL on failure
+ * @return 0 if ok, -ve on error (in which case *ecp will be set to NULL)
+ */
+static int ecdsa_get_pub_key(const char *keydir, const char *name,
+			     EC_KEY **ecp)
+{
+	char path[1024];
+	EVP_PKEY *key;
+	X509 *cert;
+	EC_KEY *ec;
+	FILE *f;
+	int ret;
+
+	*ecp = NULL;
+	snprintf(path, sizeof(path), "%s/%s.crt", keydir, name);
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Couldn't open ECDSA certificate: '%s': %s\n",
+			path, strerror(errno));
+		return -EACCES;
+	}
+
+	/* Read the certificate */
+	cert = NULL;
+	if (!PEM_read_X509(f, &cert, NULL, NULL)) {
+		ecdsa_err("Couldn't read certificate");
+		ret = -EINVAL;
+		goto err_cert;
+	}
+
+	/* Get the public key from the certificate. */
+	key = X509_get_pubkey(cert);
+	if (!key) {
+		ecdsa_err("Couldn't read public key\n");
+		ret = -EINVAL;
+		goto err_pubkey;
+	}
+
+	ec = EVP_PKEY_get1_EC_KEY(key);
+	if (!ec) {
+		ecdsa_err("Couldn't convert to an ECDSA key");
+		ret = -EINVAL;
+		goto err_ec;
+	}
+	fclose(f);
+	EVP_PKEY_free(key);
+	X509_free(cert);
+	*ecp = ec;
+
+	return 0;
+
+err_ec:
+	EVP_PKEY_free(key);
+err_pubkey:
+	X509_free(cert);
+err_cert:
+	fclose(f);
+	return ret;
+}
+
+/**
+ * ecdsa_get_priv_key() - read a private key from a .key file
+ *
+ * @keydir:	Directory containing the key
+ * @name	Name of key file (will have a .key extension)
+ * @ecp		Returns EC_KEY object, or NULL on failure
+ * @return 0 if ok, -ve on error (in which case *ecp will be set to NULL)
+ */
+static int ecdsa_get_priv_key(const char *keydir, const char *name,
+			      EC_KEY **ecp)
+{
+	char path[1024];
+	EC_KEY *ec;
+	FILE *f;
+
+	*ecp = NULL;
+	snprintf(path, sizeof(path), "%s/%s.key", keydir, name);
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Couldn't open ECDSA private key: '%s': %s\n",
+			path, strerror(errno));
+		return -ENOENT;
+	}
+
+	ec = PEM_read_ECPrivateKey(f, NULL, NULL, path);
+	if (!ec) {
+		ecdsa_err("Failure reading private key");
+		fclose(f);
+		return -EPROTO;
+	}
+	fclose(f);
+	*ecp = ec;
+
+	return 0;
+}
+
+/**
+ * ecdsa_check_key() - check that a key suits the chosen algorithm
+ *
+ * @info:	Specifies key and FIT information
+ * @ec:		Key to check
+ * @return name of the key's curve, or NULL if it cannot be used
+ */
+static const char *ecdsa_check_key(struct image_sign_info *info, EC_KEY *ec)
+{
+	const EC_GROUP *group = EC_KEY_get0_group(ec);
+	const char *curve;
+	int bits;
+
+	curve = OBJ_nid2sn(EC_GROUP_get_curve_name(group));
+	if (!curve || (strcmp(curve, "prime256v1") &&
+		       strcmp(curve, "secp384r1"))) {
+		fprintf(stderr, "Key '%s' uses an unsupported curve '%s'\n",
+			info->keyname, curve ? curve : "(unnamed)");
+		return NULL;
+	}
+
+	bits = EC_GROUP_get_degree(group);
+	if ((bits + 7) / 8 != info->crypto->key_len) {
+		fprintf(stderr, "Key '%s' is %d bits, which does not match %s\n",
+			info->keyname, bits, info->crypto->name);
+		return NULL;
+	}
+
+	return curve;
+}
+
+/* Write a number as a big endian array of exactly @len bytes */
+static int ecdsa_bn2bin(const BIGNUM *num, uint8_t *buf, int len)
+{
+	int size = BN_num_bytes(num);
+
+	if (size > len)
+		return -EINVAL;
+	memset(buf, '\0', len - size);
+	BN_bn2bin(num, buf + len - size);
+
+	return 0;
+}
+
+int ecdsa_sign(struct image_sign_info *info,
+	       const struct image_region region[], int region_count,
+	       uint8_t **sigp, uint *sig_len)
+{
+	uint8_t hash[info->checksum->checksum_len];
+	int key_len = info->crypto->key_len;
+	const BIGNUM *r, *s;
+	ECDSA_SIG *sig;
+	uint8_t *buf;
+	EC_KEY *ec;
+	int ret;
+
+	if (info->engine_id) {
+		fprintf(stderr, "ECDSA signing does not support engines\n");
+		return -ENOTSUP;
+	}
+
+	ret = ecdsa_get_priv_key(info->keydir, info->keyname, &ec);
+	if (ret)
+		return ret;
+	if (!ecdsa_check_key(info, ec)) {
+		ret = -EINVAL;
+		goto err_key;
+	}
+
+	ret = info->checksum->calculate(info->checksum->name, region,
+					region_count, hash);
+	if (ret) {
+		fprintf(stderr, "Failed to hash data for signing\n");
+		ret = -EINVAL;
+		goto err_key;
+	}
+
+	sig = ECDSA_do_sign(hash, sizeof(hash), ec);
+	if (!sig) {
+		ret = ecdsa_err("Could not obtain signature");
+		goto err_key;
+	}
+
+	buf = malloc(2 * key_len);
+	if (!buf) {
+		fprintf(stderr, "Out of memory for signature (%d bytes)\n",
+			2 * key_len);
+		ret = -ENOMEM;
+		goto err_sig;
+	}
+
+	/* The signature is r followed by s, each the size of the curve */
+	ECDSA_SIG_get0(sig, &r, &s);
+	if (ecdsa_bn2bin(r, buf, key_len) ||
+	    ecdsa_bn2bin(s, buf + key_len, key_len)) {
+		free(buf);
+		ret = -EINVAL;
+		goto err_sig;
+	}
+	*sigp = buf;
+	*sig_len = 2 * key_len;
+
+err_sig:
+	ECDSA_SIG_free(sig);
+err_key:
+	EC_KEY_free(ec);
+
+	return ret;
+}
+
+static int fdt_add_coordinate(void *blob, int noffset, const char *prop_name,
+			      const BIGNUM *num, int len)
+{
+	uint8_t buf[len];
+
+	if (ecdsa_bn2bin(num, buf, len))
+		return -EINVAL;
+
+	return fdt_setprop(blob, noffset, prop_name, buf, len);
+}
+
+int ecdsa_add_verify_data(struct image_sign_info *info, void *keydest)
+{
+	int key_len = info->crypto->key_len;
+	const EC_GROUP *group;
+	const EC_POINT *point;
+	const char *curve;
+	BIGNUM *x, *y;
+	int parent, node;
+	char name[100];
+	EC_KEY *ec;
+	int ret;
+
+	debug("%s: Getting verification data\n", __func__);
+	ret = ecdsa_get_pub_key(info->keydir, info->keyname, &ec);
+	if (ret)
+		return ret;
+	curve = ecdsa_check_key(info, ec);
+	if (!curve) {
+		ret = -EINVAL;
+		goto err_key;
+	}
+
+	x = BN_new();
+	y = BN_new();
+	if (!x || !y) {
+		fprintf(stderr, "Out of memory (bignum)\n");
+		ret = -ENOMEM;
+		goto err_bn;
+	}
+	group = EC_KEY_get0_group(ec);
+	point = EC_KEY_get0_public_key(ec);
+	if (!EC_POINT_get_affine_coordinates_GFp(group, point, x, y, NULL)) {
+		ret = ecdsa_err("Could not read public key point");
+		goto err_bn;
+	}
+
+	parent = fdt_subnode_offset(keydest, 0, FIT_SIG_NODENAME);
+	if (parent == -FDT_ERR_NOTFOUND) {
+		parent = fdt_add_subnode(keydest, 0, FIT_SIG_NODENAME);
+		if (parent < 0) {
+			ret = parent;
+			if (ret != -FDT_ERR_NOSPACE) {
+				fprintf(stderr, "Couldn't create signature node: %s\n",
+					fdt_strerror(parent));
+			}
+		}
+	}
+	if (ret)
+		goto done;
+
+	/* Either create or overwrite the named key node */
+	snprintf(name, sizeof(name), "key-%s", info->keyname);
+	node = fdt_subnode_offset(keydest, parent, name);
+	if (node == -FDT_ERR_NOTFOUND) {
+		node = fdt_add_subnode(keydest, parent, name);
+		if (node < 0) {
+			ret = node;
+			if (ret != -FDT_ERR_NOSPACE) {
+				fprintf(stderr, "Could not create key subnode: %s\n",
+					fdt_strerror(node));
+			}
+		}
+	} else if (node < 0) {
+		fprintf(stderr, "Cannot select keys parent: %s\n",
+			fdt_strerror(node));
+		ret = node;
+	}
+
+	if (!ret) {
+		ret = fdt_setprop_string(keydest, node, FIT_KEY_HINT,
+					 info->keyname);
+	}
+	if (!ret)
+		ret = fdt_setprop_string(keydest, node, "ecdsa,curve", curve);
+	if (!ret) {
+		ret = fdt_add_coordinate(keydest, node, "ecdsa,x-point", x,
+					 key_len);
+	}
+	if (!ret) {
+		ret = fdt_add_coordinate(keydest, node, "ecdsa,y-point", y,
+					 key_len);
+	}
+	if (!ret) {
+		ret = fdt_setprop_string(keydest, node, FIT_ALGO_PROP,
+					 info->name);
+	}
+	if (!ret && info->require_keys) {
+		ret = fdt_setprop_string(keydest, node, FIT_KEY_REQUIRED,
+					 info->require_keys);
+	}
+done:
+	if (ret)
+		ret = ret == -FDT_ERR_NOSPACE ? -ENOSPC : -EIO;
+err_bn:
+	BN_free(x);
+	BN_free(y);
+err_key:
+	EC_KEY_free(ec);
+
+	return ret;
+}
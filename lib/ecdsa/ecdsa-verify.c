@@ -0,0 +1,735 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * ECDSA signature verification for FIT images
+ *
+ * This supports the NIST P-256 (prime256v1) and P-384 (secp384r1) curves.
+ * Field and scalar arithmetic use Montgomery multiplication on 32-bit
+ * words. Points are kept in Jacobian coordinates so that a verification
+ * needs only two modular inversions.
+ */
+
+#ifndef USE_HOSTCC
+#include <common.h>
+#include <log.h>
+#include <linux/errno.h>
+#else
+#include "fdt_host.h"
+#include "mkimage.h"
+#include <fdt_support.h>
+#endif
+#include <image.h>
+#include <u-boot/ecdsa.h>
+
+#define ECDSA_MAX_BYTES		ECDSA384_BYTES
+#define ECDSA_MAX_WORDS		(ECDSA_MAX_BYTES / sizeof(uint32_t))
+
+/**
+ * struct ecdsa_curve - short Weierstrass curve y^2 = x^3 - 3x + b mod p
+ *
+ * All values are big endian numbers of @bytes bytes.
+ *
+ * @name:	Name of the curve, as used in the ecdsa,curve property
+ * @bytes:	Size of the field and of the group order in bytes
+ * @p:		Field prime
+ * @n:		Order of the base point
+ * @b:		Curve coefficient b
+ * @gx:		X coordinate of the base point
+ * @gy:		Y coordinate of the base point
+ */
+struct ecdsa_curve {
+	const char *name;
+	uint bytes;
+	uint8_t p[ECDSA_MAX_BYTES];
+	uint8_t n[ECDSA_MAX_BYTES];
+	uint8_t b[ECDSA_MAX_BYTES];
+	uint8_t gx[ECDSA_MAX_BYTES];
+	uint8_t gy[ECDSA_MAX_BYTES];
+};
+
+static const struct ecdsa_curve ecdsa_curves[] = {
+	{
+		.name = "prime256v1",
+		.bytes = 32,
+		.p = {
+			0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01,
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		},
+		.n = {
+			0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84,
+			0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+		},
+		.b = {
+			0x5a, 0xc6, 0x35, 0xd8, 0xaa, 0x3a, 0x93, 0xe7,
+			0xb3, 0xeb, 0xbd, 0x55, 0x76, 0x98, 0x86, 0xbc,
+			0x65, 0x1d, 0x06, 0xb0, 0xcc, 0x53, 0xb0, 0xf6,
+			0x3b, 0xce, 0x3c, 0x3e, 0x27, 0xd2, 0x60, 0x4b,
+		},
+		.gx = {
+			0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47,
+			0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+			0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0,
+			0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96,
+		},
+		.gy = {
+			0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b,
+			0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+			0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce,
+			0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5,
+		},
+	},
+	{
+		.name = "secp384r1",
+		.bytes = 48,
+		.p = {
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+			0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+		},
+		.n = {
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xc7, 0x63, 0x4d, 0x81, 0xf4, 0x37, 0x2d, 0xdf,
+			0x58, 0x1a, 0x0d, 0xb2, 0x48, 0xb0, 0xa7, 0x7a,
+			0xec, 0xec, 0x19, 0x6a, 0xcc, 0xc5, 0x29, 0x73,
+		},
+		.b = {
+			0xb3, 0x31, 0x2f, 0xa7, 0xe2, 0x3e, 0xe7, 0xe4,
+			0x98, 0x8e, 0x05, 0x6b, 0xe3, 0xf8, 0x2d, 0x19,
+			0x18, 0x1d, 0x9c, 0x6e, 0xfe, 0x81, 0x41, 0x12,
+			0x03, 0x14, 0x08, 0x8f, 0x50, 0x13, 0x87, 0x5a,
+			0xc6, 0x56, 0x39, 0x8d, 0x8a, 0x2e, 0xd1, 0x9d,
+			0x2a, 0x85, 0xc8, 0xed, 0xd3, 0xec, 0x2a, 0xef,
+		},
+		.gx = {
+			0xaa, 0x87, 0xca, 0x22, 0xbe, 0x8b, 0x05, 0x37,
+			0x8e, 0xb1, 0xc7, 0x1e, 0xf3, 0x20, 0xad, 0x74,
+			0x6e, 0x1d, 0x3b, 0x62, 0x8b, 0xa7, 0x9b, 0x98,
+			0x59, 0xf7, 0x41, 0xe0, 0x82, 0x54, 0x2a, 0x38,
+			0x55, 0x02, 0xf2, 0x5d, 0xbf, 0x55, 0x29, 0x6c,
+			0x3a, 0x54, 0x5e, 0x38, 0x72, 0x76, 0x0a, 0xb7,
+		},
+		.gy = {
+			0x36, 0x17, 0xde, 0x4a, 0x96, 0x26, 0x2c, 0x6f,
+			0x5d, 0x9e, 0x98, 0xbf, 0x92, 0x92, 0xdc, 0x29,
+			0xf8, 0xf4, 0x1d, 0xbd, 0x28, 0x9a, 0x14, 0x7c,
+			0xe9, 0xda, 0x31, 0x13, 0xb5, 0xf0, 0xb8, 0xc0,
+			0x0a, 0x60, 0xb1, 0xce, 0x1d, 0x7e, 0x81, 0x9d,
+			0x7a, 0x43, 0x1d, 0x7c, 0x90, 0xea, 0x0e, 0x5f,
+		},
+	},
+};
+
+/**
+ * struct ecdsa_mod - modulus for Montgomery arithmetic
+ *
+ * @m:		Modulus, as little endian word array
+ * @rr:		R^2 mod m, where R = 2^(32 * words)
+ * @n0inv:	-1 / m[0] mod 2^32
+ */
+struct ecdsa_mod {
+	uint32_t m[ECDSA_MAX_WORDS];
+	uint32_t rr[ECDSA_MAX_WORDS];
+	uint32_t n0inv;
+};
+
+/**
+ * struct ecdsa_ctx - arithmetic state for one curve
+ *
+ * Field elements are kept in Montgomery form, i.e. multiplied by R mod p.
+ *
+ * @words:	Number of 32-bit words in each number
+ * @p:		Field prime
+ * @n:		Group order
+ * @b:		Curve coefficient b, in Montgomery form
+ * @one:	1 in Montgomery form (R mod p)
+ */
+struct ecdsa_ctx {
+	uint words;
+	struct ecdsa_mod p;
+	struct ecdsa_mod n;
+	uint32_t b[ECDSA_MAX_WORDS];
+	uint32_t one[ECDSA_MAX_WORDS];
+};
+
+/* A point in Jacobian coordinates, (X / Z^2, Y / Z^3); Z = 0 is infinity */
+struct ecdsa_point {
+	uint32_t x[ECDSA_MAX_WORDS];
+	uint32_t y[ECDSA_MAX_WORDS];
+	uint32_t z[ECDSA_MAX_WORDS];
+};
+
+static void bn_from_bytes(uint32_t r[], const uint8_t *bytes, uint words)
+{
+	const uint8_t *p = bytes + words * sizeof(uint32_t);
+	uint i;
+
+	for (i = 0; i < words; i++, p -= 4)
+		r[i] = (uint32_t)p[-4] << 24 | (uint32_t)p[-3] << 16 |
+			(uint32_t)p[-2] << 8 | p[-1];
+}
+
+static bool bn_is_zero(const uint32_t a[], uint words)
+{
+	uint32_t acc = 0;
+	uint i;
+
+	for (i = 0; i < words; i++)
+		acc |= a[i];
+
+	return !acc;
+}
+
+/* Return -1, 0 or 1 as a is less than, equal to or greater than b */
+static int bn_cmp(const uint32_t a[], const uint32_t b[], uint words)
+{
+	int i;
+
+	for (i = words - 1; i >= 0; i--) {
+		if (a[i] != b[i])
+			return a[i] > b[i] ? 1 : -1;
+	}
+
+	return 0;
+}
+
+/* r = a + b, returning the carry */
+static uint32_t bn_add(uint32_t r[], const uint32_t a[], const uint32_t b[],
+		       uint words)
+{
+	uint64_t acc = 0;
+	uint i;
+
+	for (i = 0; i < words; i++) {
+		acc += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+
+	return acc;
+}
+
+/* r = a - b, returning the borrow */
+static uint32_t bn_sub(uint32_t r[], const uint32_t a[], const uint32_t b[],
+		       uint words)
+{
+	int64_t acc = 0;
+	uint i;
+
+	for (i = 0; i < words; i++) {
+		acc += (uint64_t)a[i] - b[i];
+		r[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+
+	return acc ? 1 : 0;
+}
+
+/* r = a + b mod m, for a, b < m */
+static void mod_add(const struct ecdsa_mod *m, uint words, uint32_t r[],
+		    const uint32_t a[], const uint32_t b[])
+{
+	if (bn_add(r, a, b, words) || bn_cmp(r, m->m, words) >= 0)
+		bn_sub(r, r, m->m, words);
+}
+
+/* r = a - b mod m, for a, b < m */
+static void mod_sub(const struct ecdsa_mod *m, uint words, uint32_t r[],
+		    const uint32_t a[], const uint32_t b[])
+{
+	if (bn_sub(r, a, b, words))
+		bn_add(r, r, m->m, words);
+}
+
+/**
+ * mont_mul() - Montgomery multiplication
+ *
+ * Operation: r[] = a[] * b[] / R mod m
+ *
+ * @m:		Modulus
+ * @words:	Number of words in each number
+ * @r:		Result, which may be the same as @a or @b
+ * @a:		Multiplier, less than m
+ * @b:		Multiplicand, less than m
+ */
+static void mont_mul(const struct ecdsa_mod *m, uint words, uint32_t r[],
+		     const uint32_t a[], const uint32_t b[])
+{
+	uint32_t t[ECDSA_MAX_WORDS + 1];
+	uint64_t acc_a, acc_b;
+	uint32_t q;
+	uint i, j;
+
+	memset(t, '\0', sizeof(t));
+	for (i = 0; i < words; i++) {
+		/* t = (t + a * b[i] + q * m) / 2^32 */
+		acc_a = (uint64_t)a[0] * b[i] + t[0];
+		q = (uint32_t)acc_a * m->n0inv;
+		acc_b = (uint64_t)q * m->m[0] + (uint32_t)acc_a;
+		for (j = 1; j < words; j++) {
+			acc_a = (acc_a >> 32) + (uint64_t)a[j] * b[i] + t[j];
+			acc_b = (acc_b >> 32) + (uint64_t)q * m->m[j] +
+				(uint32_t)acc_a;
+			t[j - 1] = (uint32_t)acc_b;
+		}
+		acc_a = (acc_a >> 32) + (acc_b >> 32) + t[words];
+		t[words - 1] = (uint32_t)acc_a;
+		t[words] = acc_a >> 32;
+	}
+
+	/* t < 2 * m, so one subtraction is enough to reduce it */
+	if (t[words] || bn_cmp(t, m->m, words) >= 0)
+		bn_sub(t, t, m->m, words);
+	memcpy(r, t, words * sizeof(uint32_t));
+}
+
+static void mod_init(struct ecdsa_mod *m, const uint8_t *bytes, uint words)
+{
+	uint32_t inv;
+	uint i;
+
+	bn_from_bytes(m->m, bytes, words);
+
+	/* Newton iteration; each step doubles the number of correct bits */
+	inv = m->m[0];
+	for (i = 0; i < 4; i++)
+		inv *= 2 - m->m[0] * inv;
+	m->n0inv = -inv;
+
+	/* R^2 mod m = 2^(64 * words) mod m, by repeated doubling */
+	memset(m->rr, '\0', sizeof(m->rr));
+	m->rr[0] = 1;
+	for (i = 0; i < 64 * words; i++)
+		mod_add(m, words, m->rr, m->rr, m->rr);
+}
+
+/**
+ * mod_inv() - Modular inverse, by Fermat's little theorem
+ *
+ * Operation: r[] = a[]^(m - 2) mod m
+ *
+ * @m:		Modulus, which must be prime
+ * @words:	Number of words in each number
+ * @r:		Result, which may be the same as @a
+ * @a:		Value to invert, 0 < a < m
+ */
+static void mod_inv(const struct ecdsa_mod *m, uint words, uint32_t r[],
+		    const uint32_t a[])
+{
+	uint32_t am[ECDSA_MAX_WORDS], e[ECDSA_MAX_WORDS];
+	uint32_t acc[ECDSA_MAX_WORDS], one[ECDSA_MAX_WORDS];
+	int bit;
+
+	memset(one, '\0', sizeof(one));
+	one[0] = 2;
+	bn_sub(e, m->m, one, words);
+	one[0] = 1;
+
+	mont_mul(m, words, am, a, m->rr);	/* a * R */
+	mont_mul(m, words, acc, m->rr, one);	/* R, i.e. 1 */
+	for (bit = words * 32 - 1; bit >= 0; bit--) {
+		mont_mul(m, words, acc, acc, acc);
+		if (e[bit / 32] & (1U << (bit % 32)))
+			mont_mul(m, words, acc, acc, am);
+	}
+	mont_mul(m, words, r, acc, one);
+}
+
+static void fp_mul(const struct ecdsa_ctx *ctx, uint32_t r[],
+		   const uint32_t a[], const uint32_t b[])
+{
+	mont_mul(&ctx->p, ctx->words, r, a, b);
+}
+
+static void fp_add(const struct ecdsa_ctx *ctx, uint32_t r[],
+		   const uint32_t a[], const uint32_t b[])
+{
+	mod_add(&ctx->p, ctx->words, r, a, b);
+}
+
+static void fp_sub(const struct ecdsa_ctx *ctx, uint32_t r[],
+		   const uint32_t a[], const uint32_t b[])
+{
+	mod_sub(&ctx->p, ctx->words, r, a, b);
+}
+
+/* Set up a point from affine coordinates in normal form */
+static void point_from_affine(const struct ecdsa_ctx *ctx,
+			      struct ecdsa_point *r, const uint32_t x[],
+			      const uint32_t y[])
+{
+	fp_mul(ctx, r->x, x, ctx->p.rr);
+	fp_mul(ctx, r->y, y, ctx->p.rr);
+	memcpy(r->z, ctx->one, sizeof(r->z));
+}
+
+/* Check that an affine point in Montgomery form is on the curve */
+static bool point_on_curve(const struct ecdsa_ctx *ctx,
+			   const struct ecdsa_point *pt)
+{
+	uint32_t lhs[ECDSA_MAX_WORDS], rhs[ECDSA_MAX_WORDS];
+	uint32_t t[ECDSA_MAX_WORDS];
+
+	/* y^2 = x^3 - 3x + b = (x^2 - 3) * x + b */
+	fp_mul(ctx, lhs, pt->y, pt->y);
+	fp_mul(ctx, rhs, pt->x, pt->x);
+	fp_add(ctx, t, ctx->one, ctx->one);
+	fp_add(ctx, t, t, ctx->one);
+	fp_sub(ctx, rhs, rhs, t);
+	fp_mul(ctx, rhs, rhs, pt->x);
+	fp_add(ctx, rhs, rhs, ctx->b);
+
+	return !bn_cmp(lhs, rhs, ctx->words);
+}
+
+/**
+ * point_double() - Double a point
+ *
+ * This uses the doubling formula for a = -3 (dbl-2001-b). Doubling the point
+ * at infinity gives the point at infinity.
+ *
+ * @ctx:	Curve context
+ * @r:		Result, which may be the same as @pt
+ * @pt:		Point to double
+ */
+static void point_double(const struct ecdsa_ctx *ctx, struct ecdsa_point *r,
+			 const struct ecdsa_point *pt)
+{
+	uint32_t delta[ECDSA_MAX_WORDS], gamma[ECDSA_MAX_WORDS];
+	uint32_t beta[ECDSA_MAX_WORDS], alpha[ECDSA_MAX_WORDS];
+	uint32_t t1[ECDSA_MAX_WORDS], t2[ECDSA_MAX_WORDS];
+
+	fp_mul(ctx, delta, pt->z, pt->z);
+	fp_mul(ctx, gamma, pt->y, pt->y);
+	fp_mul(ctx, beta, pt->x, gamma);
+
+	/* alpha = 3 * (x - delta) * (x + delta) */
+	fp_sub(ctx, t1, pt->x, delta);
+	fp_add(ctx, t2, pt->x, delta);
+	fp_mul(ctx, alpha, t1, t2);
+	fp_add(ctx, t1, alpha, alpha);
+	fp_add(ctx, alpha, alpha, t1);
+
+	/* z3 = (y + z)^2 - gamma - delta */
+	fp_add(ctx, t1, pt->y, pt->z);
+	fp_mul(ctx, t1, t1, t1);
+	fp_sub(ctx, t1, t1, gamma);
+	fp_sub(ctx, r->z, t1, delta);
+
+	/* x3 = alpha^2 - 8 * beta */
+	fp_add(ctx, beta, beta, beta);
+	fp_add(ctx, beta, beta, beta);
+	fp_mul(ctx, t1, alpha, alpha);
+	fp_add(ctx, t2, beta, beta);
+	fp_sub(ctx, r->x, t1, t2);
+
+	/* y3 = alpha * (4 * beta - x3) - 8 * gamma^2 */
+	fp_sub(ctx, t1, beta, r->x);
+	fp_mul(ctx, t1, alpha, t1);
+	fp_mul(ctx, t2, gamma, gamma);
+	fp_add(ctx, t2, t2, t2);
+	fp_add(ctx, t2, t2, t2);
+	fp_add(ctx, t2, t2, t2);
+	fp_sub(ctx, r->y, t1, t2);
+}
+
+/**
+ * point_add() - Add two points
+ *
+ * @ctx:	Curve context
+ * @r:		Result, which may be the same as @a or @b
+ * @a:		First point
+ * @b:		Second point
+ */
+static void point_add(const struct ecdsa_ctx *ctx, struct ecdsa_point *r,
+		      const struct ecdsa_point *a, const struct ecdsa_point *b)
+{
+	uint32_t z1z1[ECDSA_MAX_WORDS], z2z2[ECDSA_MAX_WORDS];
+	uint32_t u1[ECDSA_MAX_WORDS], u2[ECDSA_MAX_WORDS];
+	uint32_t s1[ECDSA_MAX_WORDS], s2[ECDSA_MAX_WORDS];
+	uint32_t h[ECDSA_MAX_WORDS], rr[ECDSA_MAX_WORDS];
+	uint32_t hh[ECDSA_MAX_WORDS], hhh[ECDSA_MAX_WORDS];
+	uint32_t t[ECDSA_MAX_WORDS];
+	uint words = ctx->words;
+	bool b_affine;
+
+	if (bn_is_zero(a->z, words)) {
+		memcpy(r, b, sizeof(*r));
+		return;
+	}
+	if (bn_is_zero(b->z, words)) {
+		memcpy(r, a, sizeof(*r));
+		return;
+	}
+
+	/* b is usually G or Q, with z = 1, which saves a few multiplications */
+	b_affine = !bn_cmp(b->z, ctx->one, words);
+	if (b_affine) {
+		memcpy(u1, a->x, sizeof(u1));
+		memcpy(s1, a->y, sizeof(s1));
+	} else {
+		fp_mul(ctx, z2z2, b->z, b->z);
+		fp_mul(ctx, u1, a->x, z2z2);
+		fp_mul(ctx, s1, a->y, b->z);
+		fp_mul(ctx, s1, s1, z2z2);
+	}
+	fp_mul(ctx, z1z1, a->z, a->z);
+	fp_mul(ctx, u2, b->x, z1z1);
+	fp_mul(ctx, s2, b->y, a->z);
+	fp_mul(ctx, s2, s2, z1z1);
+	fp_sub(ctx, h, u2, u1);
+	fp_sub(ctx, rr, s2, s1);
+
+	if (bn_is_zero(h, words)) {
+		if (bn_is_zero(rr, words))
+			point_double(ctx, r, a);
+		else
+			memset(r, '\0', sizeof(*r));
+		return;
+	}
+
+	/* z3 = z1 * z2 * h */
+	if (b_affine) {
+		fp_mul(ctx, r->z, a->z, h);
+	} else {
+		fp_mul(ctx, t, a->z, b->z);
+		fp_mul(ctx, r->z, t, h);
+	}
+
+	/* x3 = rr^2 - h^3 - 2 * u1 * h^2 */
+	fp_mul(ctx, hh, h, h);
+	fp_mul(ctx, hhh, hh, h);
+	fp_mul(ctx, u1, u1, hh);
+	fp_mul(ctx, t, rr, rr);
+	fp_sub(ctx, t, t, hhh);
+	fp_sub(ctx, t, t, u1);
+	fp_sub(ctx, r->x, t, u1);
+
+	/* y3 = rr * (u1 * h^2 - x3) - s1 * h^3 */
+	fp_sub(ctx, t, u1, r->x);
+	fp_mul(ctx, t, rr, t);
+	fp_mul(ctx, s1, s1, hhh);
+	fp_sub(ctx, r->y, t, s1);
+}
+
+static const struct ecdsa_curve *ecdsa_find_curve(const char *name)
+{
+	int i;
+
+	if (!name)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(ecdsa_curves); i++) {
+		if (!strcmp(ecdsa_curves[i].name, name))
+			return &ecdsa_curves[i];
+	}
+
+	return NULL;
+}
+
+int ecdsa_verify_hash(const char *curve_name, const uint8_t *x,
+		      const uint8_t *y, const uint8_t *hash, uint hash_len,
+		      const uint8_t *sig, uint sig_len)
+{
+	const struct ecdsa_curve *curve;
+	struct ecdsa_ctx ctx;
+	struct ecdsa_point g, q, gq, acc;
+	uint32_t r[ECDSA_MAX_WORDS], s[ECDSA_MAX_WORDS];
+	uint32_t u1[ECDSA_MAX_WORDS], u2[ECDSA_MAX_WORDS];
+	uint32_t t[ECDSA_MAX_WORDS], ax[ECDSA_MAX_WORDS];
+	uint32_t ay[ECDSA_MAX_WORDS];
+	uint8_t z[ECDSA_MAX_BYTES];
+	uint words, bit, sel;
+
+	curve = ecdsa_find_curve(curve_name);
+	if (!curve) {
+		debug("%s: Unknown curve '%s'\n", __func__, curve_name);
+		return -EINVAL;
+	}
+	if (sig_len != 2 * curve->bytes) {
+		debug("%s: Signature is %u bytes, expected %u\n", __func__,
+		      sig_len, 2 * curve->bytes);
+		return -EINVAL;
+	}
+
+	words = curve->bytes / sizeof(uint32_t);
+	memset(&ctx, '\0', sizeof(ctx));
+	ctx.words = words;
+	mod_init(&ctx.p, curve->p, words);
+	mod_init(&ctx.n, curve->n, words);
+	memset(t, '\0', sizeof(t));
+	t[0] = 1;
+	fp_mul(&ctx, ctx.one, t, ctx.p.rr);
+	bn_from_bytes(t, curve->b, words);
+	fp_mul(&ctx, ctx.b, t, ctx.p.rr);
+
+	/* 0 < r, s < n */
+	bn_from_bytes(r, sig, words);
+	bn_from_bytes(s, sig + curve->bytes, words);
+	if (bn_is_zero(r, words) || bn_cmp(r, ctx.n.m, words) >= 0 ||
+	    bn_is_zero(s, words) || bn_cmp(s, ctx.n.m, words) >= 0)
+		return -EACCES;
+
+	/* The public key must be a point on the curve */
+	bn_from_bytes(ax, x, words);
+	bn_from_bytes(ay, y, words);
+	if (bn_cmp(ax, ctx.p.m, words) >= 0 ||
+	    bn_cmp(ay, ctx.p.m, words) >= 0) {
+		debug("%s: Public key is not a field element\n", __func__);
+		return -EINVAL;
+	}
+	point_from_affine(&ctx, &q, ax, ay);
+	if (!point_on_curve(&ctx, &q)) {
+		debug("%s: Public key is not on the curve\n", __func__);
+		return -EINVAL;
+	}
+
+	/* The hash is truncated, or zero-extended, to the size of n */
+	memset(z, '\0', sizeof(z));
+	if (hash_len >= curve->bytes)
+		memcpy(z, hash, curve->bytes);
+	else
+		memcpy(z + curve->bytes - hash_len, hash, hash_len);
+	bn_from_bytes(t, z, words);
+	if (bn_cmp(t, ctx.n.m, words) >= 0)
+		bn_sub(t, t, ctx.n.m, words);
+
+	/* u1 = z / s mod n, u2 = r / s mod n */
+	mod_inv(&ctx.n, words, s, s);
+	mont_mul(&ctx.n, words, u1, t, s);
+	mont_mul(&ctx.n, words, u1, u1, ctx.n.rr);
+	mont_mul(&ctx.n, words, u2, r, s);
+	mont_mul(&ctx.n, words, u2, u2, ctx.n.rr);
+
+	/* acc = u1 * G + u2 * Q, scanning both scalars together */
+	bn_from_bytes(ax, curve->gx, words);
+	bn_from_bytes(ay, curve->gy, words);
+	point_from_affine(&ctx, &g, ax, ay);
+	point_add(&ctx, &gq, &g, &q);
+	memset(&acc, '\0', sizeof(acc));
+	for (bit = words * 32; bit-- > 0;) {
+		point_double(&ctx, &acc, &acc);
+		sel = (u1[bit / 32] >> (bit % 32) & 1) |
+			(u2[bit / 32] >> (bit % 32) & 1) << 1;
+		if (sel == 1)
+			point_add(&ctx, &acc, &acc, &g);
+		else if (sel == 2)
+			point_add(&ctx, &acc, &acc, &q);
+		else if (sel == 3)
+			point_add(&ctx, &acc, &acc, &gq);
+	}
+	if (bn_is_zero(acc.z, words))
+		return -EACCES;
+
+	/* The affine x coordinate, x / z^2, must equal r mod n */
+	memset(t, '\0', sizeof(t));
+	t[0] = 1;
+	fp_mul(&ctx, ay, acc.z, t);	/* z in normal form */
+	mod_inv(&ctx.p, words, ay, ay);
+	fp_mul(&ctx, ay, ay, ctx.p.rr);
+	fp_mul(&ctx, ay, ay, ay);	/* 1 / z^2 in Montgomery form */
+	fp_mul(&ctx, ax, acc.x, ay);
+	fp_mul(&ctx, ax, ax, t);	/* x / z^2 in normal form */
+	if (bn_cmp(ax, ctx.n.m, words) >= 0)
+		bn_sub(ax, ax, ctx.n.m, words);
+
+	return bn_cmp(ax, r, words) ? -EACCES : 0;
+}
+
+/**
+ * ecdsa_verify_with_keynode() - Verify a signature with a key node
+ *
+ * @info:	Specifies key and FIT information
+ * @hash:	Hash of the signed data
+ * @sig:	Signature
+ * @sig_len:	Number of bytes in signature
+ * @node:	Node with the ECDSA key properties
+ * @return 0 if verified, -ve on error
+ */
+static int ecdsa_verify_with_keynode(struct image_sign_info *info,
+				     const uint8_t *hash, const uint8_t *sig,
+				     uint sig_len, int node)
+{
+	const void *blob = info->fdt_blob;
+	const char *curve;
+	const void *x, *y;
+	int x_len, y_len;
+
+	if (node < 0) {
+		debug("%s: Skipping invalid node\n", __func__);
+		return -EBADF;
+	}
+
+	curve = fdt_getprop(blob, node, "ecdsa,curve", NULL);
+	x = fdt_getprop(blob, node, "ecdsa,x-point", &x_len);
+	y = fdt_getprop(blob, node, "ecdsa,y-point", &y_len);
+	if (!curve || !x || !y) {
+		debug("%s: Missing ECDSA key info\n", __func__);
+		return -EFAULT;
+	}
+	if (x_len != info->crypto->key_len || y_len != info->crypto->key_len) {
+		debug("%s: Key size does not match %s\n", __func__,
+		      info->crypto->name);
+		return -EINVAL;
+	}
+
+	return ecdsa_verify_hash(curve, x, y, hash,
+				 info->checksum->checksum_len, sig, sig_len);
+}
+
+int ecdsa_verify(struct image_sign_info *info,
+		 const struct image_region region[], int region_count,
+		 uint8_t *sig, uint sig_len)
+{
+	const void *blob = info->fdt_blob;
+	uint8_t hash[info->checksum->checksum_len];
+	int ndepth, noffset;
+	int sig_node, node;
+	char name[100];
+	int ret;
+
+	ret = info->checksum->calculate(info->checksum->name,
+					region, region_count, hash);
+	if (ret < 0) {
+		debug("%s: Error in checksum calculation\n", __func__);
+		return -EINVAL;
+	}
+
+	sig_node = fdt_subnode_offset(blob, 0, FIT_SIG_NODENAME);
+	if (sig_node < 0) {
+		debug("%s: No signature node found\n", __func__);
+		return -ENOENT;
+	}
+
+	/* See if we must use a particular key */
+	if (info->required_keynode != -1)
+		return ecdsa_verify_with_keynode(info, hash, sig, sig_len,
+						 info->required_keynode);
+
+	/* Look for a key that matches our hint */
+	snprintf(name, sizeof(name), "key-%s", info->keyname);
+	node = fdt_subnode_offset(blob, sig_node, name);
+	ret = ecdsa_verify_with_keynode(info, hash, sig, sig_len, node);
+	if (!ret)
+		return ret;
+
+	/* No luck, so try each of the keys in turn */
+	for (ndepth = 0, noffset = fdt_next_node(blob, sig_node, &ndepth);
+	     noffset >= 0 && ndepth > 0;
+	     noffset = fdt_next_node(blob, noffset, &ndepth)) {
+		if (ndepth == 1 && noffset != node) {
+			ret = ecdsa_verify_with_keynode(info, hash, sig,
+							sig_len, noffset);
+			if (!ret)
+				break;
+		}
+	}
+
+	return ret;
+}
@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <div64.h>
 #include <efi_loader.h>
 #include <irq_func.h>
@@ -1979,6 +1980,9 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 	/* Make sure that notification functions are not called anymore */
 	efi_tpl = TPL_HIGH_LEVEL;
 
+	/* The OS takes over the block devices, write back cached data */
+	blkcache_flush_all();
+
 	/* Notify variable services */
 	efi_variables_boot_exit_notify();
 
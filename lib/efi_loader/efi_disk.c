@@ -247,7 +247,7 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  * This function implements the FlushBlocks service of the
  * EFI_BLOCK_IO_PROTOCOL.
  *
- * As we always write synchronously nothing is done here.
+ * Data held in the write-back block cache is written to the device.
  *
  * See the Unified Extensible Firmware Interface (UEFI) specification for
  * details.
@@ -257,7 +257,14 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  */
 static efi_status_t EFIAPI efi_disk_flush_blocks(struct efi_block_io *this)
 {
+	struct efi_disk_obj *diskobj;
+
 	EFI_ENTRY("%p", this);
+
+	diskobj = container_of(this, struct efi_disk_obj, ops);
+	if (blkcache_flush(diskobj->desc->if_type, diskobj->desc->devnum))
+		return EFI_EXIT(EFI_DEVICE_ERROR);
+
 	return EFI_EXIT(EFI_SUCCESS);
 }
 
@@ -12,6 +12,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <net.h>
+#include <open_hash.h>
 #include <dm/of_extra.h>
 #include <env.h>
 #include <errno.h>
@@ -586,6 +587,111 @@ int fdtdec_prepare_fdt(void)
 	return 0;
 }
 
+/**
+ * struct fdt_phandle_slot - slot in the index of gd->fdt_blob by phandle
+ *
+ * @phandle:	phandle of the node, or 0 if the slot is empty
+ * @offset:	Offset of the node when the index was built
+ */
+struct fdt_phandle_slot {
+	u32 phandle;
+	int offset;
+};
+
+/*
+ * Index of the nodes of fdt_phandle_blob by phandle, a hash table of
+ * fdt_phandle_mask + 1 slots. It is only used after relocation, since before
+ * that there may be no BSS.
+ */
+static const void *fdt_phandle_blob;
+static struct fdt_phandle_slot *fdt_phandle_cache;
+static uint fdt_phandle_mask;
+
+/* Phandles are mostly allocated in sequence, so they are their own hash */
+static struct fdt_phandle_slot *fdtdec_phandle_slot(u32 phandle)
+{
+	struct fdt_phandle_slot *slot;
+	uint pos;
+
+	open_hash_for_each_slot(pos, phandle, fdt_phandle_mask) {
+		slot = &fdt_phandle_cache[pos];
+		if (!slot->phandle || slot->phandle == phandle)
+			return slot;
+	}
+}
+
+void fdtdec_phandle_cache_invalidate(void)
+{
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	free(fdt_phandle_cache);
+	fdt_phandle_cache = NULL;
+	fdt_phandle_blob = NULL;
+}
+
+static void fdtdec_phandle_cache_build(const void *blob)
+{
+	struct fdt_phandle_slot *slot;
+	uint count = 0;
+	int offset;
+	u32 phandle;
+
+	fdtdec_phandle_cache_invalidate();
+	for (offset = 0; offset >= 0; offset = fdt_next_node(blob, offset,
+							      NULL)) {
+		if (fdt_get_phandle(blob, offset))
+			count++;
+	}
+
+	/* If there is no memory, lookups search the tree instead */
+	fdt_phandle_blob = blob;
+	fdt_phandle_mask = open_hash_slots(count, 2) - 1;
+	fdt_phandle_cache = calloc(fdt_phandle_mask + 1, sizeof(*slot));
+	if (!fdt_phandle_cache)
+		return;
+	for (offset = 0; offset >= 0; offset = fdt_next_node(blob, offset,
+							      NULL)) {
+		phandle = fdt_get_phandle(blob, offset);
+		if (!phandle || phandle == (u32)-1)
+			continue;
+		slot = fdtdec_phandle_slot(phandle);
+		if (!slot->phandle) {
+			slot->phandle = phandle;
+			slot->offset = offset;
+		}
+	}
+}
+
+int fdtdec_node_offset_by_phandle(const void *blob, u32 phandle)
+{
+	struct fdt_phandle_slot *slot;
+	bool cached;
+	int offset;
+
+	cached = !IS_ENABLED(CONFIG_SPL_BUILD) && (gd->flags & GD_FLG_RELOC) &&
+		 blob == gd->fdt_blob && phandle && phandle != (u32)-1;
+	if (cached) {
+		if (fdt_phandle_blob != blob)
+			fdtdec_phandle_cache_build(blob);
+		if (fdt_phandle_cache) {
+			slot = fdtdec_phandle_slot(phandle);
+			if (slot->phandle &&
+			    fdt_get_phandle(blob, slot->offset) == phandle)
+				return slot->offset;
+		}
+	}
+
+	/*
+	 * If the node is there after all, the blob has changed since the
+	 * index was built, so build it again next time
+	 */
+	offset = fdt_node_offset_by_phandle(blob, phandle);
+	if (cached && offset >= 0 && fdt_phandle_cache)
+		fdtdec_phandle_cache_invalidate();
+
+	return offset;
+}
+
 int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 {
 	const u32 *phandle;
@@ -596,7 +702,7 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdtdec_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -727,8 +833,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdtdec_node_offset_by_phandle(blob,
+								     phandle);
 				if (!node) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -1333,6 +1439,8 @@ int fdtdec_add_reserved_memory(void *blob, const char *basename,
 	node = fdt_add_subnode(blob, parent, name);
 	if (node < 0)
 		return node;
+	if (blob == gd->fdt_blob)
+		fdtdec_phandle_cache_invalidate();
 
 	if (phandlep) {
 		err = fdt_generate_phandle(blob, &phandle);
@@ -1401,7 +1509,7 @@ int fdtdec_get_carveout(const void *blob, const char *node, const char *name,
 
 	phandle = fdt32_to_cpu(prop[index]);
 
-	offset = fdt_node_offset_by_phandle(blob, phandle);
+	offset = fdtdec_node_offset_by_phandle(blob, phandle);
 	if (offset < 0) {
 		debug("failed to find node for phandle %u\n", phandle);
 		return offset;
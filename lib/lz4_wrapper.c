@@ -7,6 +7,8 @@
 #include <compiler.h>
 #include <image.h>
 #include <lz4.h>
+#include <malloc.h>
+#include <work_queue.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -62,12 +64,158 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+/**
+ * struct lz4_block - one entry in the block index of a frame
+ *
+ * @in:		Block data
+ * @size:	Size of the block data
+ * @not_compressed: true if the block data is stored as is
+ * @out:	Where the block decompresses to
+ * @avail:	Space available at @out
+ * @ret:	Decompressed size of the block, or -ve on error
+ */
+struct lz4_block {
+	const void *in;
+	u32 size;
+	bool not_compressed;
+	void *out;
+	size_t avail;
+	int ret;
+};
+
+/* Runs on any CPU, so it must only calculate, see work_queue.h */
+static int lz4_block_job(void *arg)
+{
+	struct lz4_block *blk = arg;
+
+	if (blk->not_compressed) {
+		if (blk->size > blk->avail) {
+			blk->ret = -ENOBUFS;
+		} else {
+			memcpy(blk->out, blk->in, blk->size);
+			blk->ret = blk->size;
+		}
+	} else {
+		/* constant folding essential, do not touch params! */
+		blk->ret = LZ4_decompress_generic(blk->in, blk->out, blk->size,
+						  blk->avail, endOnInputSize,
+						  full, 0, noDict, blk->out,
+						  NULL, 0);
+	}
+
+	return 0;
+}
+
+/**
+ * lz4_index() - build an index of the blocks in a frame
+ *
+ * The output position of each block is not recorded in the frame, but the
+ * LZ4 compressor fills every block up to the maximum block size except the
+ * last one, so that is where each block is expected to go. The caller must
+ * check that this held once the blocks are decompressed.
+ *
+ * @src:	Start of the frame
+ * @srcn:	Length of the frame
+ * @in:		First block header in the frame
+ * @has_block_checksum: true if each block is followed by a checksum
+ * @block_size:	Maximum block size of the frame
+ * @dst:	Destination buffer
+ * @dstn:	Size of the destination buffer
+ * @blocks:	Returns the index, or NULL to just count the blocks
+ * @return number of blocks, or -ve if the frame is truncated or has a block
+ *	that does not fit in @dst
+ */
+static int lz4_index(const void *src, size_t srcn, const void *in,
+		     bool has_block_checksum, size_t block_size, void *dst,
+		     size_t dstn, struct lz4_block *blocks)
+{
+	struct lz4_block_header b;
+	size_t pos;
+	int count;
+
+	for (count = 0, pos = 0;; count++, pos += block_size) {
+		if (in - src + sizeof(b) > srcn)
+			return -EINVAL;
+		b.raw = le32_to_cpu(*(u32 *)in);
+		in += sizeof(b);
+		if (in - src + b.size > srcn)
+			return -EINVAL;
+		if (!b.size)
+			return count;
+		if (pos >= dstn)
+			return -ENOBUFS;
+
+		if (blocks) {
+			blocks[count].in = in;
+			blocks[count].size = b.size;
+			blocks[count].not_compressed = b.not_compressed;
+			blocks[count].out = dst + pos;
+			blocks[count].avail = min(block_size, dstn - pos);
+		}
+		in += b.size;
+		if (has_block_checksum)
+			in += sizeof(u32);
+	}
+}
+
+/*
+ * Decompress the blocks of a frame on all CPUs. Returns -EAGAIN if that is
+ * not possible, or if anything goes wrong, so that ulz4fn() can decompress
+ * the frame as usual and report any error in the usual way.
+ */
+static int ulz4fn_parallel(const void *src, size_t srcn, const void *in,
+			   bool has_block_checksum, size_t block_size,
+			   void *dst, size_t dst_size, size_t *dstn)
+{
+	struct lz4_block *blocks;
+	struct wq_job *jobs;
+	size_t total;
+	int count, i;
+	int ret = -EAGAIN;
+
+	count = lz4_index(src, srcn, in, has_block_checksum, block_size, dst,
+			  dst_size, NULL);
+	if (count < 2)
+		return -EAGAIN;
+
+	blocks = calloc(count, sizeof(*blocks));
+	jobs = calloc(count, sizeof(*jobs));
+	if (!blocks || !jobs)
+		goto out;
+	lz4_index(src, srcn, in, has_block_checksum, block_size, dst,
+		  dst_size, blocks);
+	for (i = 0; i < count; i++) {
+		jobs[i].func = lz4_block_job;
+		jobs[i].arg = &blocks[i];
+	}
+	wq_run(jobs, count);
+
+	for (i = 0, total = 0; i < count; i++) {
+		if (blocks[i].ret < 0)
+			goto out;
+		/* Only the last block may be short, see lz4_index() */
+		if (i < count - 1 && (size_t)blocks[i].ret != block_size)
+			goto out;
+		total += blocks[i].ret;
+	}
+	*dstn = total;
+	ret = 0;
+out:
+	free(jobs);
+	free(blocks);
+
+	return ret;
+}
+#endif
+
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
 	int has_block_checksum;
+	size_t block_size __maybe_unused;
 	int ret;
 	*dstn = 0;
 
@@ -85,6 +233,8 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		if (!h->independent_blocks)
 			return -EPROTONOSUPPORT; /* we can't support this yet */
 		has_block_checksum = h->has_block_checksum;
+		block_size = h->max_block_size >= 4 ?
+			1 << (8 + 2 * h->max_block_size) : 0;
 
 		in += sizeof(*h);
 		if (h->has_content_size)
@@ -92,6 +242,21 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		in += sizeof(u8);
 	}
 
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+	/*
+	 * Blocks are independent, so they can be decompressed at the same
+	 * time, unless this is in-place decompression where writing one block
+	 * may overwrite the input of another.
+	 */
+	if (block_size && wq_cpu_count() > 1 &&
+	    (dst >= src + srcn || src >= end)) {
+		ret = ulz4fn_parallel(src, srcn, in, has_block_checksum,
+				      block_size, dst, end - dst, dstn);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+#endif
+
 	while (1) {
 		struct lz4_block_header b;
 
@@ -15,6 +15,10 @@
 #include <malloc.h>
 #include <dm/of_access.h>
 #include <linux/err.h>
+#include <u-boot/crc.h>
+
+/* Snapshot of the control FDT's live tree, from dts/dt-live.bin */
+extern u8 __dtb_live_begin[];
 
 static void *unflatten_dt_alloc(void **mem, unsigned long size,
 				unsigned long align)
@@ -315,16 +319,228 @@ static int unflatten_device_tree(const void *blob,
 	return 0;
 }
 
+/**
+ * struct of_live_snap_ctx - state while writing a snapshot
+ *
+ * of_live_snap_create() makes two passes over the tree: one with @buf set
+ * to NULL to count everything, then one to write it out.
+ *
+ * @buf: Snapshot being written, or NULL if counting
+ * @blob: FDT that the tree was unflattened from
+ * @blob_size: Size of @blob in bytes
+ * @nodes: Offset of the node array in the snapshot
+ * @props: Offset of the property array
+ * @strs: Offset of the area for strings and values not in @blob
+ * @relocs: Offset of the relocation table
+ * @node_count: Number of nodes so far
+ * @prop_count: Number of properties so far
+ * @str_size: Bytes used in the string area so far
+ * @reloc_count: Number of relocations so far
+ */
+struct of_live_snap_ctx {
+	void *buf;
+	const char *blob;
+	uint blob_size;
+	uint nodes;
+	uint props;
+	uint strs;
+	uint relocs;
+	int node_count;
+	int prop_count;
+	int str_size;
+	int reloc_count;
+};
+
+static void of_live_snap_reloc(struct of_live_snap_ctx *ctx, void *ptrp,
+			       uint offset, u32 flags)
+{
+	u32 *relocs = ctx->buf + ctx->relocs;
+
+	if (ctx->buf) {
+		*(ulong *)ptrp = offset;
+		relocs[ctx->reloc_count] = (ptrp - ctx->buf) | flags;
+	}
+	ctx->reloc_count++;
+}
+
+/* Point @ptrp at @data, in the FDT if it is there, else in the snapshot */
+static void of_live_snap_data(struct of_live_snap_ctx *ctx, void *ptrp,
+			      const void *data, int len)
+{
+	const char *ptr = data;
+
+	if (!ptr)
+		return;
+	if (ptr >= ctx->blob && ptr + len <= ctx->blob + ctx->blob_size) {
+		of_live_snap_reloc(ctx, ptrp, ptr - ctx->blob,
+				   OF_LIVE_SNAP_RELOC_FDT);
+		return;
+	}
+	if (ctx->buf)
+		memcpy(ctx->buf + ctx->strs + ctx->str_size, ptr, len);
+	of_live_snap_reloc(ctx, ptrp, ctx->strs + ctx->str_size, 0);
+	ctx->str_size += ALIGN(len, 4);
+}
+
+static void of_live_snap_str(struct of_live_snap_ctx *ctx, void *ptrp,
+			     const char *str)
+{
+	if (str)
+		of_live_snap_data(ctx, ptrp, str, strlen(str) + 1);
+}
+
+/* Write a node and its subnodes, returning its offset in the snapshot */
+static uint of_live_snap_node(struct of_live_snap_ctx *ctx,
+			      const struct device_node *np, uint parent)
+{
+	uint offset = ctx->nodes + ctx->node_count++ * sizeof(*np);
+	struct device_node *out = ctx->buf + offset, *sub;
+	const struct device_node *child;
+	const struct property *pp;
+	struct property *prop;
+	uint child_offset, prop_offset;
+	void *link;
+
+	if (ctx->buf)
+		out->phandle = np->phandle;
+	of_live_snap_str(ctx, &out->name, np->name);
+	of_live_snap_str(ctx, &out->type, np->type);
+	of_live_snap_str(ctx, &out->full_name, np->full_name);
+	if (parent)
+		of_live_snap_reloc(ctx, &out->parent, parent, 0);
+
+	link = &out->properties;
+	for (pp = np->properties; pp; pp = pp->next) {
+		prop_offset = ctx->props + ctx->prop_count++ * sizeof(*pp);
+		prop = ctx->buf + prop_offset;
+		if (ctx->buf)
+			prop->length = pp->length;
+		of_live_snap_reloc(ctx, link, prop_offset, 0);
+		of_live_snap_str(ctx, &prop->name, pp->name);
+		of_live_snap_data(ctx, &prop->value, pp->value, pp->length);
+		link = &prop->next;
+	}
+
+	link = &out->child;
+	for (child = np->child; child; child = child->sibling) {
+		child_offset = of_live_snap_node(ctx, child, offset);
+		of_live_snap_reloc(ctx, link, child_offset, 0);
+		sub = ctx->buf + child_offset;
+		link = &sub->sibling;
+	}
+
+	return offset;
+}
+
+int of_live_snap_create(const struct device_node *root, const void *fdt_blob,
+			void *buf, int size)
+{
+	struct of_live_snap_ctx ctx;
+	struct of_live_snap_hdr *hdr = buf;
+	int total;
+
+	memset(&ctx, '\0', sizeof(ctx));
+	ctx.blob = fdt_blob;
+	ctx.blob_size = fdt_totalsize(fdt_blob);
+	ctx.nodes = ALIGN(sizeof(*hdr), sizeof(void *));
+	of_live_snap_node(&ctx, root, 0);
+
+	ctx.props = ctx.nodes + ctx.node_count * sizeof(struct device_node);
+	ctx.strs = ctx.props + ctx.prop_count * sizeof(struct property);
+	ctx.relocs = ALIGN(ctx.strs + ctx.str_size, 4);
+	total = ctx.relocs + ctx.reloc_count * sizeof(u32);
+	if (!buf)
+		return total;
+	if (total > size)
+		return -ENOSPC;
+
+	memset(buf, '\0', total);
+	ctx.buf = buf;
+	ctx.node_count = 0;
+	ctx.prop_count = 0;
+	ctx.str_size = 0;
+	ctx.reloc_count = 0;
+	hdr->root = of_live_snap_node(&ctx, root, 0);
+
+	hdr->magic = OF_LIVE_SNAP_MAGIC;
+	hdr->version = OF_LIVE_SNAP_VERSION;
+	hdr->size = total;
+	hdr->ptr_size = sizeof(void *);
+	hdr->node_size = sizeof(struct device_node);
+	hdr->prop_size = sizeof(struct property);
+	hdr->fdt_size = ctx.blob_size;
+	hdr->fdt_crc32 = crc32(0, fdt_blob, ctx.blob_size);
+	hdr->reloc = ctx.relocs;
+	hdr->reloc_count = ctx.reloc_count;
+
+	return total;
+}
+
+int of_live_snap_load(void *snap, const void *fdt_blob,
+		      struct device_node **rootp)
+{
+	struct of_live_snap_hdr *hdr = snap;
+	u32 *relocs = snap + hdr->reloc;
+	ulong base;
+	uint i, offset;
+
+	if (hdr->magic != OF_LIVE_SNAP_MAGIC ||
+	    hdr->version != OF_LIVE_SNAP_VERSION ||
+	    hdr->ptr_size != sizeof(void *) ||
+	    hdr->node_size != sizeof(struct device_node) ||
+	    hdr->prop_size != sizeof(struct property))
+		return -EPROTONOSUPPORT;
+	if (hdr->flags & OF_LIVE_SNAP_FIXED)
+		return -EALREADY;
+	if (fdt_check_header(fdt_blob) ||
+	    hdr->fdt_size != fdt_totalsize(fdt_blob) ||
+	    hdr->fdt_crc32 != crc32(0, fdt_blob, hdr->fdt_size))
+		return -ESTALE;
+
+	/* Check everything first, so as not to leave a half-fixed snapshot */
+	if (hdr->size < sizeof(*hdr) + sizeof(struct device_node) ||
+	    hdr->root > hdr->size - sizeof(struct device_node) ||
+	    hdr->reloc > hdr->size ||
+	    hdr->reloc_count > (hdr->size - hdr->reloc) / sizeof(u32))
+		return -EINVAL;
+	for (i = 0; i < hdr->reloc_count; i++) {
+		offset = relocs[i] & ~OF_LIVE_SNAP_RELOC_FDT;
+		if (offset > hdr->size - sizeof(ulong) ||
+		    offset % sizeof(ulong))
+			return -EINVAL;
+	}
+
+	for (i = 0; i < hdr->reloc_count; i++) {
+		offset = relocs[i] & ~OF_LIVE_SNAP_RELOC_FDT;
+		base = relocs[i] & OF_LIVE_SNAP_RELOC_FDT ? (ulong)fdt_blob :
+			(ulong)snap;
+		*(ulong *)(snap + offset) += base;
+	}
+	hdr->flags |= OF_LIVE_SNAP_FIXED;
+	*rootp = snap + hdr->root;
+
+	return 0;
+}
+
 int of_live_build(const void *fdt_blob, struct device_node **rootp)
 {
-	int ret;
+	int ret = -ENOENT;
 
 	debug("%s: start\n", __func__);
-	ret = unflatten_device_tree(fdt_blob, rootp);
+	if (IS_ENABLED(CONFIG_OF_LIVE_SNAPSHOT)) {
+		ret = of_live_snap_load(__dtb_live_begin, fdt_blob, rootp);
+		if (ret)
+			debug("Cannot use live tree snapshot: err=%d\n", ret);
+	}
+	if (ret)
+		ret = unflatten_device_tree(fdt_blob, rootp);
 	if (ret) {
 		debug("Failed to create live tree: err=%d\n", ret);
 		return ret;
 	}
+	ret = of_phandle_cache_build(*rootp);
+	if (ret)
+		debug("Failed to index live tree phandles: err=%d\n", ret);
 	ret = of_alias_scan();
 	if (ret) {
 		debug("Failed to scan live tree aliases: err=%d\n", ret);
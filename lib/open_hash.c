@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Helpers for hash tables with open addressing
+ */
+
+#include <common.h>
+#include <open_hash.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+
+uint open_hash_slots(uint count, uint min)
+{
+	return roundup_pow_of_two(max(count * 2, min));
+}
+
+uint open_hash_str(const char *str)
+{
+	uint hash = 2166136261U;
+
+	while (*str)
+		hash = (hash ^ (u8)*str++) * 16777619U;
+
+	return hash;
+}
@@ -28,100 +28,163 @@
 /* Default public exponent for backward compatibility */
 #define RSA_DEFAULT_PUBEXP	65537
 
+/*
+ * pow_mod() works on limbs of the native word size: 64 bits when the
+ * compiler provides a 128-bit product, 32 bits otherwise.
+ */
+#ifdef __SIZEOF_INT128__
+typedef uint64_t bn_limb;
+typedef unsigned __int128 bn_dlimb;
+#else
+typedef uint32_t bn_limb;
+typedef uint64_t bn_dlimb;
+#endif
+#define BN_LIMB_BITS	(sizeof(bn_limb) * 8)
+#define BN_LIMB_WORDS	(sizeof(bn_limb) / sizeof(uint32_t))
+
+/*
+ * Sliding window width for exponents longer than 65537. Each extra bit
+ * doubles the table of precomputed odd powers.
+ */
+#define RSA_EXP_WINDOW	4
+
 /**
- * subtract_modulus() - subtract modulus from the given value
+ * struct mont_ctx - Montgomery arithmetic modulo an RSA modulus
  *
- * @key:	Key containing modulus to subtract
- * @num:	Number to subtract modulus from, as little endian word array
+ * @len:	Number of limbs in @modulus
+ * @n0inv:	-1 / modulus[0] mod 2^BN_LIMB_BITS
+ * @modulus:	Modulus, as little endian limb array
+ * @t:		Scratch space of @len + 1 limbs
  */
-static void subtract_modulus(const struct rsa_public_key *key, uint32_t num[])
+struct mont_ctx {
+	uint len;
+	bn_limb n0inv;
+	const bn_limb *modulus;
+	bn_limb *t;
+};
+
+/**
+ * mont_n0inv() - Extend the key's n0inv to a full limb
+ *
+ * The key only stores -1 / modulus[0] mod 2^32. One Newton step doubles the
+ * number of correct bits, which is enough for a 64-bit limb.
+ *
+ * @n0inv:	-1 / modulus[0] mod 2^32
+ * @n0:		Lowest limb of the modulus
+ * @return -1 / n0 mod 2^BN_LIMB_BITS
+ */
+static bn_limb mont_n0inv(uint32_t n0inv, bn_limb n0)
 {
-	int64_t acc = 0;
-	uint i;
+	bn_limb inv = -(bn_limb)n0inv;
 
-	for (i = 0; i < key->len; i++) {
-		acc += (uint64_t)num[i] - key->modulus[i];
-		num[i] = (uint32_t)acc;
-		acc >>= 32;
-	}
+	inv *= 2 - n0 * inv;
+
+	return -inv;
 }
 
 /**
- * greater_equal_modulus() - check if a value is >= modulus
+ * mont_reduce() - Subtract the modulus once if needed
  *
- * @key:	Key containing modulus to check
- * @num:	Number to check against modulus, as little endian word array
- * @return 0 if num < modulus, 1 if num >= modulus
+ * @ctx:	Montgomery context
+ * @result:	Place to put result, as little endian limb array
+ * @t:		Value of @len + 1 limbs, less than twice the modulus
  */
-static int greater_equal_modulus(const struct rsa_public_key *key,
-				 uint32_t num[])
+static void mont_reduce(const struct mont_ctx *ctx, bn_limb result[],
+			const bn_limb t[])
 {
-	int i;
+	const bn_limb *n = ctx->modulus;
+	uint len = ctx->len;
+	bn_dlimb acc;
+	bn_limb c;
+	uint i;
 
-	for (i = (int)key->len - 1; i >= 0; i--) {
-		if (num[i] < key->modulus[i])
-			return 0;
-		if (num[i] > key->modulus[i])
-			return 1;
+	for (i = len; i > 0; i--) {
+		if (t[i - 1] != n[i - 1])
+			break;
+	}
+	if (t[len] || !i || t[i - 1] > n[i - 1]) {
+		c = 0;
+		for (i = 0; i < len; i++) {
+			acc = (bn_dlimb)t[i] - n[i] - c;
+			result[i] = (bn_limb)acc;
+			c = (acc >> BN_LIMB_BITS) & 1;
+		}
+	} else {
+		memcpy(result, t, len * sizeof(*t));
 	}
-
-	return 1;  /* equal */
 }
 
 /**
- * montgomery_mul_add_step() - Perform montgomery multiply-add step
+ * mont_shift() - Modular left shift
  *
- * Operation: montgomery result[] += a * b[] / n0inv % modulus
+ * Operation: x[] = x[] * 2^bits % modulus
  *
- * @key:	RSA key
- * @result:	Place to put result, as little endian word array
- * @a:		Multiplier
- * @b:		Multiplicand, as little endian word array
+ * @ctx:	Montgomery context
+ * @x:		Value to shift, as little endian limb array, less than modulus
+ * @bits:	Number of bits to shift by
  */
-static void montgomery_mul_add_step(const struct rsa_public_key *key,
-		uint32_t result[], const uint32_t a, const uint32_t b[])
+static void mont_shift(const struct mont_ctx *ctx, bn_limb x[], uint bits)
 {
-	uint64_t acc_a, acc_b;
-	uint32_t d0;
+	bn_limb *t = ctx->t;
+	uint len = ctx->len;
 	uint i;
 
-	acc_a = (uint64_t)a * b[0] + result[0];
-	d0 = (uint32_t)acc_a * key->n0inv;
-	acc_b = (uint64_t)d0 * key->modulus[0] + (uint32_t)acc_a;
-	for (i = 1; i < key->len; i++) {
-		acc_a = (acc_a >> 32) + (uint64_t)a * b[i] + result[i];
-		acc_b = (acc_b >> 32) + (uint64_t)d0 * key->modulus[i] +
-				(uint32_t)acc_a;
-		result[i - 1] = (uint32_t)acc_b;
+	for (; bits; bits--) {
+		t[len] = x[len - 1] >> (BN_LIMB_BITS - 1);
+		for (i = len - 1; i > 0; i--)
+			t[i] = x[i] << 1 | x[i - 1] >> (BN_LIMB_BITS - 1);
+		t[0] = x[0] << 1;
+		mont_reduce(ctx, x, t);
 	}
-
-	acc_a = (acc_a >> 32) + (acc_b >> 32);
-
-	result[i - 1] = (uint32_t)acc_a;
-
-	if (acc_a >> 32)
-		subtract_modulus(key, result);
 }
 
 /**
- * montgomery_mul() - Perform montgomery mutitply
+ * mont_mul() - Montgomery multiplication
  *
- * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
+ * Operation: result[] = a[] * b[] / R % modulus, where R = 2^(# key bits)
  *
- * @key:	RSA key
- * @result:	Place to put result, as little endian word array
- * @a:		Multiplier, as little endian word array
- * @b:		Multiplicand, as little endian word array
+ * This uses the Coarsely Integrated Operand Scanning (CIOS) method: each
+ * limb of @b adds one row of the product and is followed by one reduction
+ * step, so the intermediate value never exceeds @len + 1 limbs. The row
+ * and the reduction step are done in the same pass over the limbs.
+ *
+ * @ctx:	Montgomery context
+ * @result:	Place to put result, as little endian limb array. This may
+ *		be the same as @a or @b
+ * @a:		Multiplier, as little endian limb array, less than modulus
+ * @b:		Multiplicand, as little endian limb array, less than modulus
  */
-static void montgomery_mul(const struct rsa_public_key *key,
-		uint32_t result[], uint32_t a[], const uint32_t b[])
+static void mont_mul(const struct mont_ctx *ctx, bn_limb result[],
+		     const bn_limb a[], const bn_limb b[])
 {
-	uint i;
+	const bn_limb *n = ctx->modulus;
+	bn_limb *t = ctx->t;
+	uint len = ctx->len;
+	bn_dlimb acc_a, acc_b;
+	bn_limb m;
+	uint i, j;
+
+	memset(t, '\0', (len + 1) * sizeof(*t));
+	for (i = 0; i < len; i++) {
+		/* t = (t + a * b[i] + m * n) >> BN_LIMB_BITS */
+		acc_a = (bn_dlimb)a[0] * b[i] + t[0];
+		m = (bn_limb)acc_a * ctx->n0inv;
+		acc_b = (bn_dlimb)m * n[0] + (bn_limb)acc_a;
+		for (j = 1; j < len; j++) {
+			acc_a = (acc_a >> BN_LIMB_BITS) +
+				(bn_dlimb)a[j] * b[i] + t[j];
+			acc_b = (acc_b >> BN_LIMB_BITS) +
+				(bn_dlimb)m * n[j] + (bn_limb)acc_a;
+			t[j - 1] = (bn_limb)acc_b;
+		}
+		acc_a = (acc_a >> BN_LIMB_BITS) + (acc_b >> BN_LIMB_BITS) +
+			t[len];
+		t[len - 1] = (bn_limb)acc_a;
+		t[len] = acc_a >> BN_LIMB_BITS;
+	}
 
-	for (i = 0; i < key->len; ++i)
-		result[i] = 0;
-	for (i = 0; i < key->len; ++i)
-		montgomery_mul_add_step(key, result, a[i], b);
+	/* t < 2 * modulus, so one subtraction is enough to reduce it */
+	mont_reduce(ctx, result, t);
 }
 
 /**
@@ -163,20 +226,48 @@ static int num_public_exponent_bits(const struct rsa_public_key *key,
 static int is_public_exponent_bit_set(const struct rsa_public_key *key,
 		int pos)
 {
-	return key->exponent & (1ULL << pos);
+	return !!(key->exponent & (1ULL << pos));
+}
+
+/**
+ * bn_from_words() - Convert a little endian word array to limbs
+ *
+ * @dst:	Output, as little endian limb array
+ * @src:	Input, as little endian array of 32-bit words
+ * @words:	Number of words in @src
+ * @len:	Number of limbs in @dst, which are zero-padded past @words
+ */
+static void bn_from_words(bn_limb dst[], const uint32_t src[], uint words,
+			  uint len)
+{
+	uint i, j, w;
+
+	for (i = 0, w = 0; i < len; i++) {
+		dst[i] = 0;
+		for (j = 0; j < BN_LIMB_WORDS && w < words; j++, w++)
+			dst[i] |= (bn_limb)src[w] << (32 * j);
+	}
 }
 
 /**
  * pow_mod() - in-place public exponentiation
  *
+ * The exponent is scanned from the top in a sliding window. For 65537 and
+ * other short exponents the window is one bit wide, which is plain
+ * square-and-multiply; longer exponents use a RSA_EXP_WINDOW-bit window
+ * to save multiplications.
+ *
  * @key:	RSA key
  * @inout:	Big-endian word array containing value and result
  */
 static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 {
-	uint32_t *result, *ptr;
-	uint i;
-	int j, k;
+	struct mont_ctx ctx;
+	uint32_t *ptr;
+	uint len, pad, win, digit;
+	uint i, j, w;
+	int bit, low, k;
+	bool first;
 
 	/* Sanity check for stack size - key->len is in 32-bit words */
 	if (key->len > RSA_MAX_KEY_BITS / 32) {
@@ -185,14 +276,6 @@ static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 		return -EINVAL;
 	}
 
-	uint32_t val[key->len], acc[key->len], tmp[key->len];
-	uint32_t a_scaled[key->len];
-	result = tmp;  /* Re-use location. */
-
-	/* Convert from big endian byte array to little endian word array. */
-	for (i = 0, ptr = inout + key->len - 1; i < key->len; i++, ptr--)
-		val[i] = get_unaligned_be32(ptr);
-
 	if (0 != num_public_exponent_bits(key, &k))
 		return -EINVAL;
 
@@ -207,35 +290,81 @@ static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 		return -EINVAL;
 	}
 
-	/* the bit at e[k-1] is 1 by definition, so start with: C := M */
-	montgomery_mul(key, acc, val, key->rr); /* acc = a * RR / R mod n */
-	/* retain scaled version for intermediate use */
-	memcpy(a_scaled, acc, key->len * sizeof(a_scaled[0]));
+	/*
+	 * A key with an odd number of words is zero-padded to a whole number
+	 * of limbs. This makes R = 2^(len * BN_LIMB_BITS) larger than the R
+	 * the key's rr was computed for, by 2^(32 * pad).
+	 */
+	len = (key->len + BN_LIMB_WORDS - 1) / BN_LIMB_WORDS;
+	pad = len * BN_LIMB_WORDS - key->len;
+	win = k > 17 ? RSA_EXP_WINDOW : 1;
+
+	bn_limb modulus[len], rr[len], val[len], acc[len], t[len + 1];
+	/* odd powers of the value: table[i] = val^(2 * i + 1) * R % modulus */
+	bn_limb table[1 << (win - 1)][len];
+
+	bn_from_words(modulus, key->modulus, key->len, len);
+	bn_from_words(rr, key->rr, key->len, len);
+	ctx.len = len;
+	ctx.n0inv = mont_n0inv(key->n0inv, modulus[0]);
+	ctx.modulus = modulus;
+	ctx.t = t;
+	/* rr = R^2 % modulus for the padded R */
+	mont_shift(&ctx, rr, 64 * pad);
+
+	/* Convert from big endian byte array to little endian limb array. */
+	for (i = 0, w = 0, ptr = inout + key->len - 1; i < len; i++) {
+		val[i] = 0;
+		for (j = 0; j < BN_LIMB_WORDS && w < key->len; j++, w++, ptr--)
+			val[i] |= (bn_limb)get_unaligned_be32(ptr) << (32 * j);
+	}
+
+	mont_mul(&ctx, table[0], val, rr); /* table[0] = val * RR / R mod n */
+	if (win > 1) {
+		mont_mul(&ctx, acc, table[0], table[0]);
+		for (i = 1; i < 1U << (win - 1); i++)
+			mont_mul(&ctx, table[i], table[i - 1], acc);
+	}
 
-	for (j = k - 2; j > 0; --j) {
-		montgomery_mul(key, tmp, acc, acc); /* tmp = acc^2 / R mod n */
+	/* the bit at e[k-1] is 1 by definition, so the first window sets acc */
+	first = true;
+	for (bit = k - 1; bit >= 0; bit = low - 1) {
+		if (!is_public_exponent_bit_set(key, bit)) {
+			mont_mul(&ctx, acc, acc, acc);
+			low = bit;
+			continue;
+		}
 
-		if (is_public_exponent_bit_set(key, j)) {
-			/* acc = tmp * val / R mod n */
-			montgomery_mul(key, acc, tmp, a_scaled);
-		} else {
-			/* e[j] == 0, copy tmp back to acc for next operation */
-			memcpy(acc, tmp, key->len * sizeof(acc[0]));
+		/* take the longest window that ends in a set bit */
+		low = bit - (int)win + 1;
+		if (low < 0)
+			low = 0;
+		while (!is_public_exponent_bit_set(key, low))
+			low++;
+		digit = (key->exponent >> low) & ((1 << (bit - low + 1)) - 1);
+
+		if (first) {
+			memcpy(acc, table[digit >> 1], len * sizeof(acc[0]));
+			first = false;
+			continue;
 		}
+		for (i = 0; i <= (uint)(bit - low); i++)
+			mont_mul(&ctx, acc, acc, acc);
+		mont_mul(&ctx, acc, acc, table[digit >> 1]);
 	}
 
-	/* the bit at e[0] is always 1 */
-	montgomery_mul(key, tmp, acc, acc); /* tmp = acc^2 / R mod n */
-	montgomery_mul(key, acc, tmp, val); /* acc = tmp * a / R mod M */
-	memcpy(result, acc, key->len * sizeof(result[0]));
+	/* acc = acc / R mod n, leaving the Montgomery domain */
+	memset(val, '\0', len * sizeof(val[0]));
+	val[0] = 1;
+	mont_mul(&ctx, acc, acc, val);
 
-	/* Make sure result < mod; result is at most 1x mod too large. */
-	if (greater_equal_modulus(key, result))
-		subtract_modulus(key, result);
+	/* Convert to bigendian byte array, dropping the zero padding */
+	for (w = key->len, ptr = inout; w > 0; w--, ptr++) {
+		i = (w - 1) / BN_LIMB_WORDS;
+		j = (w - 1) % BN_LIMB_WORDS;
+		put_unaligned_be32((uint32_t)(acc[i] >> (32 * j)), ptr);
+	}
 
-	/* Convert to bigendian byte array */
-	for (i = key->len - 1, ptr = inout; (int)i >= 0; i--, ptr++)
-		put_unaligned_be32(result[i], ptr);
 	return 0;
 }
 
@@ -303,6 +432,102 @@ int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 }
 
 #if defined(CONFIG_CMD_ZYNQ_RSA)
+/**
+ * subtract_modulus() - subtract modulus from the given value
+ *
+ * @key:	Key containing modulus to subtract
+ * @num:	Number to subtract modulus from, as little endian word array
+ */
+static void subtract_modulus(const struct rsa_public_key *key, uint32_t num[])
+{
+	int64_t acc = 0;
+	uint i;
+
+	for (i = 0; i < key->len; i++) {
+		acc += (uint64_t)num[i] - key->modulus[i];
+		num[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+}
+
+/**
+ * greater_equal_modulus() - check if a value is >= modulus
+ *
+ * @key:	Key containing modulus to check
+ * @num:	Number to check against modulus, as little endian word array
+ * @return 0 if num < modulus, 1 if num >= modulus
+ */
+static int greater_equal_modulus(const struct rsa_public_key *key,
+				 uint32_t num[])
+{
+	int i;
+
+	for (i = (int)key->len - 1; i >= 0; i--) {
+		if (num[i] < key->modulus[i])
+			return 0;
+		if (num[i] > key->modulus[i])
+			return 1;
+	}
+
+	return 1;  /* equal */
+}
+
+/**
+ * montgomery_mul_add_step() - Perform montgomery multiply-add step
+ *
+ * Operation: montgomery result[] += a * b[] / n0inv % modulus
+ *
+ * @key:	RSA key
+ * @result:	Place to put result, as little endian word array
+ * @a:		Multiplier
+ * @b:		Multiplicand, as little endian word array
+ */
+static void montgomery_mul_add_step(const struct rsa_public_key *key,
+		uint32_t result[], const uint32_t a, const uint32_t b[])
+{
+	uint64_t acc_a, acc_b;
+	uint32_t d0;
+	uint i;
+
+	acc_a = (uint64_t)a * b[0] + result[0];
+	d0 = (uint32_t)acc_a * key->n0inv;
+	acc_b = (uint64_t)d0 * key->modulus[0] + (uint32_t)acc_a;
+	for (i = 1; i < key->len; i++) {
+		acc_a = (acc_a >> 32) + (uint64_t)a * b[i] + result[i];
+		acc_b = (acc_b >> 32) + (uint64_t)d0 * key->modulus[i] +
+				(uint32_t)acc_a;
+		result[i - 1] = (uint32_t)acc_b;
+	}
+
+	acc_a = (acc_a >> 32) + (acc_b >> 32);
+
+	result[i - 1] = (uint32_t)acc_a;
+
+	if (acc_a >> 32)
+		subtract_modulus(key, result);
+}
+
+/**
+ * montgomery_mul() - Perform montgomery mutitply
+ *
+ * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
+ *
+ * @key:	RSA key
+ * @result:	Place to put result, as little endian word array
+ * @a:		Multiplier, as little endian word array
+ * @b:		Multiplicand, as little endian word array
+ */
+static void montgomery_mul(const struct rsa_public_key *key,
+		uint32_t result[], uint32_t a[], const uint32_t b[])
+{
+	uint i;
+
+	for (i = 0; i < key->len; ++i)
+		result[i] = 0;
+	for (i = 0; i < key->len; ++i)
+		montgomery_mul_add_step(key, result, a[i], b);
+}
+
 /**
  * zynq_pow_mod - in-place public exponentiation
  *
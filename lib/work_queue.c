@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running independent jobs on secondary CPUs
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <log.h>
+#include <time.h>
+#include <work_queue.h>
+#include <linux/kernel.h>
+
+/**
+ * struct wq_worker - the share of the jobs given to one CPU
+ *
+ * The jobs are dealt out in turn, so a worker runs jobs @first,
+ * @first + @stride, @first + 2 * @stride, etc. This needs no locking
+ * between CPUs, which is all we can rely on here.
+ *
+ * @jobs:	All jobs
+ * @count:	Number of jobs
+ * @first:	Index of the first job for this worker
+ * @stride:	Number of workers
+ */
+struct wq_worker {
+	struct wq_job *jobs;
+	int count;
+	int first;
+	int stride;
+};
+
+static void wq_worker_run(void *arg)
+{
+	struct wq_worker *worker = arg;
+	struct wq_job *job;
+	int i;
+
+	for (i = worker->first; i < worker->count; i += worker->stride) {
+		job = &worker->jobs[i];
+		job->ret = job->func(job->arg);
+	}
+}
+
+__weak int arch_wq_cpu_count(void)
+{
+	return 1;
+}
+
+__weak int arch_wq_start(int cpu, void (*func)(void *arg), void *arg)
+{
+	return -ENOSYS;
+}
+
+__weak int arch_wq_wait(int cpu, ulong timeout_ms)
+{
+	return 0;
+}
+
+/*
+ * The boot CPU runs its own share of the jobs before waiting for the others.
+ * Their shares are about the same size, so a CPU which takes several times as
+ * long as the boot CPU did is taken to be stuck.
+ */
+#define WQ_WAIT_FACTOR		4
+#define WQ_WAIT_MIN_MS		1000
+
+/* Limit set by wq_set_max_cpus(), 0 if none */
+static int wq_max_cpus;
+
+int wq_cpu_count(void)
+{
+	int max = CONFIG_WORK_QUEUE_MAX_CPUS;
+
+	if (wq_max_cpus && wq_max_cpus < max)
+		max = wq_max_cpus;
+
+	return clamp(arch_wq_cpu_count(), 1, max);
+}
+
+int wq_set_max_cpus(int max)
+{
+	int old = wq_max_cpus;
+
+	wq_max_cpus = max;
+
+	return old;
+}
+
+int wq_run(struct wq_job *jobs, int count)
+{
+	struct wq_worker workers[CONFIG_WORK_QUEUE_MAX_CPUS];
+	bool started[CONFIG_WORK_QUEUE_MAX_CPUS];
+	ulong start, timeout_ms;
+	int cpus, cpu, i;
+
+	cpus = count > 1 ? min(wq_cpu_count(), count) : 1;
+	for (cpu = 0; cpu < cpus; cpu++) {
+		workers[cpu].jobs = jobs;
+		workers[cpu].count = count;
+		workers[cpu].first = cpu;
+		workers[cpu].stride = cpus;
+	}
+
+	for (cpu = 1; cpu < cpus; cpu++) {
+		started[cpu] = !arch_wq_start(cpu, wq_worker_run,
+					      &workers[cpu]);
+		if (!started[cpu])
+			log_debug("Cannot start CPU %d, running its jobs here\n",
+				  cpu);
+	}
+	start = get_timer(0);
+	wq_worker_run(&workers[0]);
+	timeout_ms = WQ_WAIT_MIN_MS + WQ_WAIT_FACTOR * get_timer(start);
+
+	for (cpu = 1; cpu < cpus; cpu++) {
+		if (started[cpu] && !arch_wq_wait(cpu, timeout_ms))
+			continue;
+		if (started[cpu])
+			log_warning("CPU %d did not finish, running its jobs here\n",
+				    cpu);
+		wq_worker_run(&workers[cpu]);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].ret)
+			return jobs[i].ret;
+	}
+
+	return 0;
+}
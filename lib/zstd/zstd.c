@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Buffer to buffer Zstandard decompression
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <work_queue.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+
+/* This may be called from a job, so must not print anything */
+static int zstd_error(size_t ret)
+{
+	if (ZSTD_getErrorCode(ret) == ZSTD_error_dstSize_tooSmall)
+		return -ENOBUFS;
+
+	return -EINVAL;
+}
+
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+/**
+ * struct zstd_frame - one frame of a multi-frame input
+ *
+ * @src:	Start of the compressed frame
+ * @srcn:	Length of the compressed frame
+ * @dst:	Where the frame decompresses to
+ * @dstn:	Decompressed size of the frame, from its header
+ */
+struct zstd_frame {
+	const void *src;
+	size_t srcn;
+	void *dst;
+	size_t dstn;
+};
+
+/**
+ * struct zstd_worker - frames decompressed by one CPU
+ *
+ * Each worker needs its own context, which is too large to have one per
+ * frame, so the frames are dealt out in turn between the workers.
+ *
+ * @dctx:	Decompression context for this worker
+ * @frames:	All frames
+ * @count:	Number of frames
+ * @first:	Index of the first frame for this worker
+ * @stride:	Number of workers
+ */
+struct zstd_worker {
+	ZSTD_DCtx *dctx;
+	struct zstd_frame *frames;
+	int count;
+	int first;
+	int stride;
+};
+
+static int zstd_worker_run(void *arg)
+{
+	struct zstd_worker *worker = arg;
+	struct zstd_frame *frame;
+	size_t ret;
+	int i;
+
+	for (i = worker->first; i < worker->count; i += worker->stride) {
+		frame = &worker->frames[i];
+		ret = ZSTD_decompressDCtx(worker->dctx, frame->dst, frame->dstn,
+					  frame->src, frame->srcn);
+		if (ZSTD_isError(ret))
+			return zstd_error(ret);
+		if (ret != frame->dstn)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * zstd_split() - split the input into frames which can be decompressed apart
+ *
+ * This only succeeds if each frame records its decompressed size, so that it
+ * is known where in @dst it goes.
+ *
+ * @src:	Compressed data
+ * @srcn:	Length of compressed data
+ * @dst:	Destination buffer
+ * @dstn:	Size of the destination buffer
+ * @frames:	Returns the frames, or NULL to just count them
+ * @return number of frames, -ENOBUFS if @dst is too small, other -ve value if
+ *	the input cannot be split up
+ */
+static int zstd_split(const void *src, size_t srcn, void *dst, size_t dstn,
+		      struct zstd_frame *frames)
+{
+	unsigned long long size;
+	size_t pos, out, len;
+	int count = 0;
+
+	for (pos = 0, out = 0; pos < srcn; pos += len, count++) {
+		len = ZSTD_findFrameCompressedSize(src + pos, srcn - pos);
+		if (ZSTD_isError(len))
+			return -EINVAL;
+		size = ZSTD_getFrameContentSize(src + pos, srcn - pos);
+		if (size == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    size == ZSTD_CONTENTSIZE_ERROR)
+			return -EINVAL;
+		if (size > dstn - out)
+			return -ENOBUFS;
+		if (frames) {
+			frames[count].src = src + pos;
+			frames[count].srcn = len;
+			frames[count].dst = dst + out;
+			frames[count].dstn = size;
+		}
+		out += size;
+	}
+
+	return count;
+}
+
+/*
+ * Decompress independent frames on all CPUs. Returns -EAGAIN if it is not
+ * worth it, leaving zstd_decompress() to handle the input as a whole.
+ */
+static int zstd_decompress_parallel(const void *src, size_t srcn, void *dst,
+				    size_t *dstn)
+{
+	struct zstd_worker workers[CONFIG_WORK_QUEUE_MAX_CPUS];
+	struct wq_job jobs[CONFIG_WORK_QUEUE_MAX_CPUS];
+	void *workspace[CONFIG_WORK_QUEUE_MAX_CPUS] = { NULL };
+	struct zstd_frame *frames;
+	int count, cpus, i, ret;
+	size_t wsize, total;
+
+	cpus = wq_cpu_count();
+	if (cpus < 2)
+		return -EAGAIN;
+	count = zstd_split(src, srcn, dst, *dstn, NULL);
+	if (count == -ENOBUFS)
+		return count;
+	if (count < 2)
+		return -EAGAIN;
+	cpus = min(cpus, count);
+
+	frames = calloc(count, sizeof(*frames));
+	if (!frames)
+		return -EAGAIN;
+	zstd_split(src, srcn, dst, *dstn, frames);
+
+	wsize = ZSTD_DCtxWorkspaceBound();
+	for (i = 0; i < cpus; i++) {
+		workspace[i] = malloc(wsize);
+		if (!workspace[i])
+			break;
+		workers[i].dctx = ZSTD_initDCtx(workspace[i], wsize);
+		if (!workers[i].dctx)
+			break;
+		workers[i].frames = frames;
+		workers[i].count = count;
+		workers[i].first = i;
+		workers[i].stride = cpus;
+		jobs[i].func = zstd_worker_run;
+		jobs[i].arg = &workers[i];
+	}
+	if (i < cpus) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ret = wq_run(jobs, cpus);
+	if (ret) {
+		debug("%s: error %d\n", __func__, ret);
+		*dstn = 0;
+	} else {
+		for (i = 0, total = 0; i < count; i++)
+			total += frames[i].dstn;
+		*dstn = total;
+	}
+out:
+	for (i = 0; i < cpus; i++)
+		free(workspace[i]);
+	free(frames);
+
+	return ret;
+}
+#endif
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	ZSTD_DCtx *dctx;
+	void *workspace;
+	size_t wsize;
+	size_t ret;
+	int err;
+
+#if CONFIG_IS_ENABLED(WORK_QUEUE)
+	err = zstd_decompress_parallel(src, srcn, dst, dstn);
+	if (err != -EAGAIN)
+		return err;
+#endif
+
+	wsize = ZSTD_DCtxWorkspaceBound();
+	workspace = malloc(wsize);
+	if (!workspace) {
+		debug("%s: cannot allocate workspace of size %zu\n", __func__,
+		      wsize);
+		return -ENOMEM;
+	}
+
+	dctx = ZSTD_initDCtx(workspace, wsize);
+	if (!dctx) {
+		free(workspace);
+		return -ENOMEM;
+	}
+
+	ret = ZSTD_decompressDCtx(dctx, dst, *dstn, src, srcn);
+	free(workspace);
+	if (ZSTD_isError(ret)) {
+		debug("%s: error %d\n", __func__, ZSTD_getErrorCode(ret));
+		err = zstd_error(ret);
+		/* Only a full buffer tells the caller the image is too large */
+		if (err != -ENOBUFS)
+			*dstn = 0;
+		return err;
+	}
+	*dstn = ret;
+
+	return 0;
+}
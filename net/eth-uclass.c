@@ -366,6 +366,7 @@ int eth_send(void *packet, int length)
 int eth_rx(void)
 {
 	struct udevice *current;
+	struct eth_rx_split split;
 	uchar *packet;
 	int flags;
 	int ret;
@@ -381,6 +382,21 @@ int eth_rx(void)
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < 32; i++) {
+		/* Let the driver put the payload where it finally belongs */
+		if (eth_get_ops(current)->recv_split &&
+		    net_get_rx_split(&split)) {
+			ret = eth_get_ops(current)->recv_split(current, flags,
+							       &split);
+			if (ret != -E2BIG) {
+				flags = 0;
+				if (ret > 0)
+					net_process_received_split(&split,
+								   ret);
+				if (ret <= 0)
+					break;
+				continue;
+			}
+		}
 		ret = eth_get_ops(current)->recv(current, flags, &packet);
 		flags = 0;
 		if (ret > 0)
@@ -520,6 +536,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->recv += gd->reloc_off;
 		if (ops->free_pkt)
 			ops->free_pkt += gd->reloc_off;
+		if (ops->recv_split)
+			ops->recv_split += gd->reloc_off;
 		if (ops->stop)
 			ops->stop += gd->reloc_off;
 		if (ops->mcast)
@@ -198,6 +198,10 @@ uchar *net_rx_packets[PKTBUFSRX];
 static rxhand_f *udp_packet_handler;
 /* Current ARP RX packet handler */
 static rxhand_f *arp_packet_handler;
+/* Protocol receiving payloads directly to their final address */
+static const struct net_rx_direct *rx_direct;
+/* Headers of a split packet, with room to put the payload back behind them */
+static uchar net_rx_split_hdr[PKTSIZE_ALIGN] __aligned(PKTALIGN);
 #ifdef CONFIG_CMD_TFTPPUT
 /* Current ICMP rx handler */
 static rxhand_icmp_f *packet_icmp_handler;
@@ -365,6 +369,7 @@ static void net_clear_handlers(void)
 {
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
+	net_set_rx_direct(NULL);
 	net_set_timeout_handler(0, NULL);
 }
 
@@ -674,6 +679,8 @@ done:
 	net_set_udp_handler(NULL);
 	net_set_icmp_handler(NULL);
 #endif
+	/* Don't let netconsole receive into the load area */
+	net_set_rx_direct(NULL);
 	net_set_state(prev_net_state);
 
 #if defined(CONFIG_CMD_PCAP)
@@ -769,6 +776,11 @@ void net_set_udp_handler(rxhand_f *f)
 		udp_packet_handler = f;
 }
 
+void net_set_rx_direct(const struct net_rx_direct *rxd)
+{
+	rx_direct = rxd;
+}
+
 rxhand_f *net_get_arp_handler(void)
 {
 	return arp_packet_handler;
@@ -1328,6 +1340,77 @@ void net_process_received_packet(uchar *in_packet, int len)
 	}
 }
 
+bool net_get_rx_split(struct eth_rx_split *split)
+{
+	unsigned int len;
+
+	if (!rx_direct)
+		return false;
+#if defined(CONFIG_API) || defined(CONFIG_EFI_LOADER)
+	if (push_packet)
+		return false;
+#endif
+#if defined(CONFIG_CMD_PCAP)
+	if (pcap_active())
+		return false;
+#endif
+	/* The split point assumes there is no VLAN tag */
+	if ((ntohs(net_our_vlan) & VLAN_IDMASK) != VLAN_NONE)
+		return false;
+
+	split->payload = rx_direct->get_buf(&len);
+	if (!split->payload)
+		return false;
+	split->hdr = net_rx_split_hdr;
+	split->hdr_len = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + rx_direct->hdr_len;
+	split->payload_len = min(len, (unsigned int)PKTSIZE - split->hdr_len);
+
+	return true;
+}
+
+void net_process_received_split(struct eth_rx_split *split, int len)
+{
+	struct ethernet_hdr *et = (struct ethernet_hdr *)split->hdr;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(split->hdr +
+						      ETHER_HDR_SIZE);
+	unsigned int hdr_len = split->hdr_len - ETHER_HDR_SIZE;
+	unsigned int ip_len = ntohs(ip->ip_len);
+
+	/*
+	 * Only a plain UDP packet for us has its payload where the split put
+	 * it. Anything else, including a packet which needs a closer look
+	 * than this, is put back together and goes through the usual path.
+	 */
+	if (rx_direct && len > split->hdr_len &&
+	    et->et_protlen == htons(PROT_IP) && ip->ip_hl_v == 0x45 &&
+	    ip->ip_p == IPPROTO_UDP &&
+	    !(ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG)) &&
+	    ip_len >= hdr_len && ip_len <= len - ETHER_HDR_SIZE &&
+	    ntohs(ip->udp_len) == ip_len - IP_HDR_SIZE &&
+	    ip_checksum_ok((uchar *)ip, IP_HDR_SIZE) &&
+	    net_read_ip(&ip->ip_dst).s_addr == net_ip.s_addr) {
+#ifdef CONFIG_UDP_CHECKSUM
+		if (ip->udp_xsum != 0)
+			goto gather;
+#endif
+		net_rx_packet = split->hdr;
+		net_rx_packet_len = len;
+		if (!rx_direct->handler((uchar *)ip + IP_UDP_HDR_SIZE,
+					split->payload, ip_len - hdr_len,
+					ntohs(ip->udp_dst),
+					net_read_ip(&ip->ip_src),
+					ntohs(ip->udp_src)))
+			return;
+	}
+#ifdef CONFIG_UDP_CHECKSUM
+gather:
+#endif
+	if (len > split->hdr_len)
+		memcpy(split->hdr + split->hdr_len, split->payload,
+		       len - split->hdr_len);
+	net_process_received_packet(split->hdr, len);
+}
+
 /**********************************************************************/
 
 static int net_check_prereq(enum proto_t protocol)
@@ -37,6 +37,7 @@
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
+#include <linux/log2.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
@@ -52,9 +53,37 @@
 static int fs_mounted;
 static unsigned long rpc_id;
 static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/* NFSv2 cannot READ more than this at once */
+#define NFS2_MAXDATA		8192
+/* Room for the IP, UDP, RPC and NFS headers of a READ reply */
+#define NFS_READ_OVERHEAD	256
+
+/**
+ * struct nfs_read_slot - a READ request waiting for its reply
+ *
+ * @id: RPC transaction ID of the request, or 0 if the slot is free
+ * @offset: file offset asked for
+ * @len: number of bytes asked for
+ */
+struct nfs_read_slot {
+	unsigned long id;
+	int offset;
+	int len;
+};
+
+/* READs in flight, replies may come back in any order */
+static struct nfs_read_slot nfs_reads[CONFIG_NFS_READ_WINDOW];
+/* Slot whose data nfs_rx_buf() expects next */
+static struct nfs_read_slot *nfs_rx_slot;
+/* Bytes asked for by each READ */
+static int nfs_read_size;
+/* File size, once a READ has hit the end of the file */
+static int nfs_read_end;
+/* Bytes received so far, for the progress display */
+static int nfs_read_bytes;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -108,7 +137,9 @@ static inline int store_block(uchar *src, unsigned offset, unsigned len)
 	{
 		void *ptr = map_sysmem(image_load_addr + offset, len);
 
-		memcpy(ptr, src, len);
+		/* Already in place if it was received directly */
+		if (ptr != src)
+			memcpy(ptr, src, len);
 		unmap_sysmem(ptr);
 	}
 
@@ -391,6 +422,74 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+/* Send the READ in @slot under a new transaction ID */
+static void nfs_read_send(struct nfs_read_slot *slot)
+{
+	nfs_read_req(slot->offset, slot->len);
+	slot->id = rpc_id;
+}
+
+/* Start READs for the rest of the file in any free slots */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_reads; slot < nfs_reads + ARRAY_SIZE(nfs_reads);
+	     slot++) {
+		if (slot->id)
+			continue;
+		if (nfs_offset >= nfs_read_end)
+			break;
+		slot->offset = nfs_offset;
+		slot->len = nfs_read_size;
+		nfs_offset += nfs_read_size;
+		nfs_read_send(slot);
+	}
+}
+
+/* (Re)send all the READs in flight and fill up the window */
+static void nfs_read_send_all(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_reads; slot < nfs_reads + ARRAY_SIZE(nfs_reads);
+	     slot++) {
+		if (slot->id && slot->offset < nfs_read_end)
+			nfs_read_send(slot);
+	}
+	nfs_read_fill();
+}
+
+/* Find the READ answered by the reply with transaction ID @id */
+static struct nfs_read_slot *nfs_read_find(uint32_t id)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_reads; slot < nfs_reads + ARRAY_SIZE(nfs_reads);
+	     slot++) {
+		if (slot->id && slot->id == ntohl(id))
+			return slot;
+	}
+
+	return NULL;
+}
+
+/* Largest READ whose reply can be received */
+static int nfs_get_read_size(void)
+{
+	int size = CONFIG_NFS_RSIZE;
+
+#ifdef CONFIG_IP_DEFRAG
+	/* The whole reply has to fit in the reassembly buffer */
+	size = min_t(int, size, rounddown_pow_of_two(CONFIG_NET_MAXDEFRAG -
+						     NFS_READ_OVERHEAD));
+#endif
+	if (supported_nfs_versions & NFSV2_FLAG)
+		size = min(size, NFS2_MAXDATA);
+
+	return max(size, NFS_READ_SIZE);
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -421,7 +520,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_send_all();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -664,62 +763,98 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+/* Header words in front of the data of a READ reply */
+#define NFS2_READ_HDR_WORDS	(6 + 19)
+#define NFS3_READ_HDR_WORDS	(6 + 26)
+
+/*
+ * Check the header of a READ reply to @slot, copied to @reply. Return the
+ * offset of the data in words, setting *rlenp to its length and *eofp if it
+ * reaches the end of the file, or a -ve error
+ */
+static int nfs_read_hdr(uint32_t *reply, struct nfs_read_slot *slot,
+			int *rlenp, bool *eofp)
 {
-	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	uint32_t *data = reply + 6;
+	int nfsv3_data_offset;
 
-	debug("%s\n", __func__);
+	if (reply[2] || reply[5])	/* rstatus, astatus */
+		return -9999;
+	if (data[0])
+		return -ntohl(data[0]);
+	if (reply[3])			/* verifier */
+		return -9999;
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	if (supported_nfs_versions & NFSV2_FLAG) {
+		*rlenp = ntohl(data[18]);
+		/* NFSv2 only returns less than asked for at the end */
+		*eofp = *rlenp < slot->len;
+		return NFS2_READ_HDR_WORDS;
+	}
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
+	/* NFSV3_FLAG */
+	nfsv3_data_offset = nfs3_get_attributes_offset(data);
+	/* count value */
+	*rlenp = ntohl(data[1 + nfsv3_data_offset]);
+	*eofp = data[2 + nfsv3_data_offset] != 0;
+	/* Skip data_size, which repeats count */
 
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus  ||
-	    rpc_pkt.u.reply.data[0]) {
-		if (rpc_pkt.u.reply.rstatus)
-			return -9999;
-		if (rpc_pkt.u.reply.astatus)
-			return -9999;
-		return -ntohl(rpc_pkt.u.reply.data[0]);
-	}
+	return 6 + 4 + nfsv3_data_offset;
+}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
+/* Store the data of a READ reply, returning its length or an error */
+static int nfs_read_data(struct nfs_read_slot *slot, uchar *data_ptr,
+			 int rlen)
+{
+	int hash = NFS_READ_SIZE / 2 * 10;
+	int i;
+
+	if (rlen < 0 || rlen > slot->len)
+		return -9999;
+	if (store_block(data_ptr, slot->offset, rlen))
+		return -9999;
+
+	/* One hash per 5 KiB received, whatever order it arrived in */
+	for (i = DIV_ROUND_UP(nfs_read_bytes, hash);
+	     i < DIV_ROUND_UP(nfs_read_bytes + rlen, hash); i++) {
+		if (i && !(i % HASHES_PER_LINE))
+			puts("\n\t ");
 		putc('#');
+	}
+	nfs_read_bytes += rlen;
 
-	if (supported_nfs_versions & NFSV2_FLAG) {
-		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
-	} else {  /* NFSV3_FLAG */
-		int nfsv3_data_offset =
-			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
+	return rlen;
+}
 
-		/* count value */
-		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
-			data_size:	32 bits value,
-		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
-	}
+static void nfs_read_done(struct nfs_read_slot *slot, int rlen, bool eof);
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+static void nfs_read_reply(uchar *pkt, unsigned len)
+{
+	uint32_t reply[NFS3_READ_HDR_WORDS];
+	struct nfs_read_slot *slot;
+	bool eof = false;
+	int rlen;
+	int ret;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	debug("%s\n", __func__);
 
-	return rlen;
+	memset(reply, '\0', sizeof(reply));
+	memcpy(reply, pkt, min_t(unsigned int, len, sizeof(reply)));
+
+	/* Drop replies to READs which have been answered or resent */
+	slot = nfs_read_find(reply[0]);
+	if (!slot)
+		return;
+
+	ret = nfs_read_hdr(reply, slot, &rlen, &eof);
+	if (ret >= 0) {
+		if (ret * sizeof(uint32_t) + rlen > len)
+			ret = -9999;
+		else
+			ret = nfs_read_data(slot, pkt + ret * sizeof(uint32_t),
+					    rlen);
+	}
+	nfs_read_done(slot, ret, eof);
 }
 
 /**************************************************************************
@@ -739,15 +874,133 @@ static void nfs_timeout_handler(void)
 	}
 }
 
+/* Move on after the reply to the READ in @slot, given its length or error */
+static void nfs_read_done(struct nfs_read_slot *slot, int rlen, bool eof)
+{
+	struct nfs_read_slot *s;
+
+	net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
+	if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
+		/* symbolic link */
+		nfs_state = STATE_READLINK_REQ;
+		nfs_send();
+		return;
+	} else if (rlen < 0) {
+		debug("NFS READ error (%d)\n", rlen);
+		nfs_state = STATE_UMOUNT_REQ;
+		nfs_send();
+		return;
+	}
+
+	slot->id = 0;
+	if (eof || !rlen) {
+		nfs_read_end = min(nfs_read_end, slot->offset + rlen);
+	} else if (rlen < slot->len) {
+		/* The server sends less than we ask for, so ask for less */
+		nfs_read_size = max(rlen, NFS_READ_SIZE);
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_send(slot);
+		return;
+	}
+
+	/* Done once everything before the end of the file has arrived */
+	for (s = nfs_reads; s < nfs_reads + ARRAY_SIZE(nfs_reads); s++) {
+		if (s->id && s->offset < nfs_read_end)
+			break;
+	}
+	if (s == nfs_reads + ARRAY_SIZE(nfs_reads) &&
+	    nfs_offset >= nfs_read_end) {
+		nfs_download_state = NETLOOP_SUCCESS;
+		nfs_state = STATE_UMOUNT_REQ;
+		nfs_send();
+		return;
+	}
+	nfs_read_fill();
+}
+
+/*
+ * Receive the data of the next READ reply straight into the load area. The
+ * replies usually come back in order, so expect the one for the lowest
+ * offset.
+ */
+static uchar *nfs_rx_buf(unsigned int *lenp)
+{
+	struct nfs_read_slot *slot;
+
+	if (nfs_state != STATE_READ_REQ)
+		return NULL;
+
+	nfs_rx_slot = NULL;
+	for (slot = nfs_reads; slot < nfs_reads + ARRAY_SIZE(nfs_reads);
+	     slot++) {
+		if (slot->id && slot->offset < nfs_read_end &&
+		    (!nfs_rx_slot || slot->offset < nfs_rx_slot->offset))
+			nfs_rx_slot = slot;
+	}
+	if (!nfs_rx_slot)
+		return NULL;
+	*lenp = nfs_rx_slot->len;
+
+	return map_sysmem(image_load_addr + nfs_rx_slot->offset,
+			  nfs_rx_slot->len);
+}
+
+static int nfs_rx_handler(uchar *hdr, uchar *payload, unsigned int len,
+			  unsigned int dport, struct in_addr sip,
+			  unsigned int sport)
+{
+	uint32_t reply[NFS3_READ_HDR_WORDS];
+	int hdr_words = NFS3_READ_HDR_WORDS;
+	bool eof;
+	int rlen;
+	int ret;
+
+	if (dport != nfs_our_port || nfs_state != STATE_READ_REQ)
+		return -EAGAIN;
+
+	if (supported_nfs_versions & NFSV2_FLAG)
+		hdr_words = NFS2_READ_HDR_WORDS;
+
+	/*
+	 * Only a successful reply to the READ which nfs_rx_buf() expected,
+	 * with the header size the split assumed, has its data in place; the
+	 * rest take the normal path to be checked by nfs_read_reply().
+	 */
+	memcpy(reply, hdr, hdr_words * sizeof(uint32_t));
+	if (nfs_read_find(reply[0]) != nfs_rx_slot)
+		return -EAGAIN;
+	ret = nfs_read_hdr(reply, nfs_rx_slot, &rlen, &eof);
+	if (ret != hdr_words || rlen < 0 || rlen > len)
+		return -EAGAIN;
+
+	nfs_read_done(nfs_rx_slot, nfs_read_data(nfs_rx_slot, payload, rlen),
+		      eof);
+
+	return 0;
+}
+
+static const struct net_rx_direct nfs2_rx_direct = {
+	.hdr_len	= NFS2_READ_HDR_WORDS * sizeof(uint32_t),
+	.get_buf	= nfs_rx_buf,
+	.handler	= nfs_rx_handler,
+};
+
+static const struct net_rx_direct nfs3_rx_direct = {
+	.hdr_len	= NFS3_READ_HDR_WORDS * sizeof(uint32_t),
+	.get_buf	= nfs_rx_buf,
+	.handler	= nfs_rx_handler,
+};
+
 static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			unsigned src, unsigned len)
 {
-	int rlen;
 	int reply;
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* READ replies are parsed in place and can be much bigger */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -815,7 +1068,16 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		} else {
 			nfs_state = STATE_READ_REQ;
 			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_size = nfs_get_read_size();
+			nfs_read_end = INT_MAX;
+			nfs_read_bytes = 0;
+			memset(nfs_reads, '\0', sizeof(nfs_reads));
+#ifndef CONFIG_SYS_DIRECT_FLASH_NFS
+			if (supported_nfs_versions & NFSV2_FLAG)
+				net_set_rx_direct(&nfs2_rx_direct);
+			else
+				net_set_rx_direct(&nfs3_rx_direct);
+#endif
 			nfs_send();
 		}
 		break;
@@ -839,25 +1101,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		break;
 
 	case STATE_READ_REQ:
-		rlen = nfs_read_reply(pkt, len);
-		if (rlen == -NFS_RPC_DROP)
-			break;
-		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
-		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
-			/* symbolic link */
-			nfs_state = STATE_READLINK_REQ;
-			nfs_send();
-		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
-			nfs_state = STATE_UMOUNT_REQ;
-			nfs_send();
-		}
+		nfs_read_reply(pkt, len);
 		break;
 	}
 }
@@ -82,6 +82,10 @@ static int	timeout_count;
 static ulong	tftp_cur_block;
 /* last packet sequence number received */
 static ulong	tftp_prev_block;
+/* last in-order block acknowledged because a later block arrived first */
+static ulong	tftp_last_nack;
+/* number of blocks received since the last ACK was sent */
+static ulong	tftp_window_count;
 /* count of sequence number wraparounds */
 static ulong	tftp_block_wrap;
 /* memory offset due to wrapping */
@@ -139,6 +143,13 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 
+/*
+ * RFC 7440: the server sends a window of blocks and we only ACK the last
+ * one, which saves a round trip per block on fast links.
+ */
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_window_size_option = CONFIG_TFTP_WINDOWSIZE;
+
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
@@ -182,7 +193,9 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 		}
 #endif
 		ptr = map_sysmem(store_addr, len);
-		memcpy(ptr, src, len);
+		/* Already in place if it was received directly */
+		if (ptr != src)
+			memcpy(ptr, src, len);
 		unmap_sysmem(ptr);
 	}
 
@@ -196,6 +209,8 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
+	tftp_last_nack = ULONG_MAX;
+	tftp_window_count = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
 #ifdef CONFIG_CMD_TFTPPUT
@@ -306,6 +321,8 @@ static void tftp_complete(void)
 			time_start * 1000, "/s");
 	}
 	puts("\ndone\n");
+	/* Nothing more should land in the load area */
+	net_set_rx_direct(NULL);
 	net_set_state(NETLOOP_SUCCESS);
 }
 
@@ -350,6 +367,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* ask to ACK only once per window of blocks */
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+				       0, tftp_window_size_option, 0);
 		len = pkt - xp;
 		break;
 
@@ -415,6 +436,121 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/* Handle a DATA packet, whose payload may already be at its final address */
+static void tftp_recv_data(u16 block, uchar *data, unsigned int len,
+			   unsigned int src)
+{
+	u16 gap;
+
+	if (tftp_state == STATE_SEND_RRQ)
+		debug("Server did not acknowledge timeout option!\n");
+
+	if (tftp_state == STATE_SEND_RRQ || tftp_state == STATE_OACK ||
+	    tftp_state == STATE_RECV_WRQ) {
+		/* first block received */
+		tftp_state = STATE_DATA;
+		tftp_remote_port = src;
+		new_transfer();
+
+		if (block != 1) {	/* Assertion */
+			puts("\nTFTP error: ");
+			printf("First block is not block 1 (%d)\n", block);
+			puts("Starting again\n\n");
+			net_start_again();
+			return;
+		}
+	}
+
+	gap = block - tftp_prev_block;
+	if (gap != 1) {
+		/*
+		 * Either a block we already have, which we ignore, or
+		 * one from later in the window, meaning that the one
+		 * we want was lost. In that case ACK the last block
+		 * we have, once, so that the server resends the
+		 * window from there rather than waiting to time out.
+		 */
+		if (gap >= 2 && gap <= tftp_windowsize &&
+		    tftp_last_nack != tftp_prev_block) {
+			tftp_last_nack = tftp_prev_block;
+			tftp_window_count = 0;
+			tftp_send();
+		}
+		return;
+	}
+
+	tftp_cur_block = block;
+	update_block_number();
+	tftp_prev_block = tftp_cur_block;
+	timeout_count_max = tftp_timeout_count_max;
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+
+	if (store_block(tftp_cur_block - 1, data, len)) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	/*
+	 *	Acknowledge the last block of each window, which will
+	 *	prompt the remote for the next window, and the final
+	 *	block.
+	 */
+	if (++tftp_window_count >= tftp_windowsize ||
+	    len < tftp_block_size) {
+		tftp_window_count = 0;
+		tftp_send();
+	}
+
+	if (len < tftp_block_size)
+		tftp_complete();
+}
+
+/* Receive the payload of the next block straight into the load area */
+static uchar *tftp_rx_buf(unsigned int *lenp)
+{
+	ulong offset = tftp_prev_block * tftp_block_size +
+		tftp_block_wrap_offset;
+
+	if (tftp_state != STATE_DATA || tftp_put_active)
+		return NULL;
+#ifdef CONFIG_LMB
+	if (tftp_load_size && offset + tftp_block_size > tftp_load_size)
+		return NULL;
+#endif
+#ifdef CONFIG_TFTP_TSIZE
+	/* Don't let a stray packet write past the end of the file */
+	if (tftp_tsize && offset >= tftp_tsize)
+		return NULL;
+#endif
+	*lenp = tftp_block_size;
+
+	return map_sysmem(tftp_load_addr + offset, tftp_block_size);
+}
+
+static int tftp_rx_handler(uchar *hdr, uchar *payload, unsigned int len,
+			   unsigned int dport, struct in_addr sip,
+			   unsigned int sport)
+{
+	/* Anything but the block tftp_rx_buf() expected is handled as usual */
+	if (dport != tftp_our_port || sport != tftp_remote_port ||
+	    tftp_state != STATE_DATA ||
+	    ntohs(*(__be16 *)hdr) != TFTP_DATA ||
+	    ntohs(*(__be16 *)(hdr + 2)) !=
+	    (unsigned short)(tftp_prev_block + 1))
+		return -EAGAIN;
+
+	tftp_recv_data(ntohs(*(__be16 *)(hdr + 2)), payload, len, sport);
+
+	return 0;
+}
+
+static const struct net_rx_direct tftp_rx_direct = {
+	.hdr_len	= 4,
+	.get_buf	= tftp_rx_buf,
+	.handler	= tftp_rx_handler,
+};
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -494,6 +630,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* The server may only make it smaller */
+				tftp_windowsize = clamp_t(unsigned short,
+						tftp_windowsize, 1,
+						tftp_window_size_option);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -515,54 +662,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	case TFTP_DATA:
 		if (len < 2)
 			return;
-		len -= 2;
-		tftp_cur_block = ntohs(*(__be16 *)pkt);
-
-		update_block_number();
-
-		if (tftp_state == STATE_SEND_RRQ)
-			debug("Server did not acknowledge timeout option!\n");
-
-		if (tftp_state == STATE_SEND_RRQ || tftp_state == STATE_OACK ||
-		    tftp_state == STATE_RECV_WRQ) {
-			/* first block received */
-			tftp_state = STATE_DATA;
-			tftp_remote_port = src;
-			new_transfer();
-
-			if (tftp_cur_block != 1) {	/* Assertion */
-				puts("\nTFTP error: ");
-				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
-				puts("Starting again\n\n");
-				net_start_again();
-				break;
-			}
-		}
-
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
-			break;
-		}
-
-		tftp_prev_block = tftp_cur_block;
-		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-
-		if (store_block(tftp_cur_block - 1, pkt + 2, len)) {
-			eth_halt();
-			net_set_state(NETLOOP_FAIL);
-			break;
-		}
-
-		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
-		 */
-		tftp_send();
-
-		if (len < tftp_block_size)
-			tftp_complete();
+		tftp_recv_data(ntohs(*(__be16 *)pkt), pkt + 2, len - 2, src);
 		break;
 
 	case TFTP_ERROR:
@@ -598,6 +698,8 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* The server restarts its window after our ACK */
+		tftp_window_count = 0;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -636,6 +738,12 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL)
+		tftp_window_size_option = simple_strtol(ep, NULL, 10);
+	else
+		tftp_window_size_option = CONFIG_TFTP_WINDOWSIZE;
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -657,8 +765,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -737,6 +845,10 @@ void tftp_start(enum proto_t protocol)
 
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
+#ifndef CONFIG_SYS_DIRECT_FLASH_TFTP
+	/* Blocks going to flash have to be written with flash_write() */
+	net_set_rx_direct(&tftp_rx_direct);
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
 #endif
@@ -757,8 +869,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
@@ -789,8 +902,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
@@ -801,6 +915,9 @@ void tftp_start_server(void)
 
 	tftp_state = STATE_RECV_WRQ;
 	net_set_udp_handler(tftp_handler);
+#ifndef CONFIG_SYS_DIRECT_FLASH_TFTP
+	net_set_rx_direct(&tftp_rx_direct);
+#endif
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
@@ -12,7 +12,11 @@
 #include <lz4.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <rand.h>
+#include <time.h>
+#include <work_queue.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -22,6 +26,8 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -121,6 +127,23 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 -c /tmp/plain.txt > /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -296,6 +319,40 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size, strlen(plain));
+	ut_asserteq_mem(plain, in, in_size);
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	int ret;
+	size_t output_size = out_max;
+
+	ret = zstd_decompress(in, in_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -440,6 +497,230 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* Blocks in the LZ4 benchmark, the last being half the size of the others */
+#define LZ4_TEST_BLOCKS		64
+#define LZ4_TEST_BLOCK_SIZE	SZ_64K
+#define LZ4_TEST_SIZE		((LZ4_TEST_BLOCKS - 1) * LZ4_TEST_BLOCK_SIZE + \
+				 LZ4_TEST_BLOCK_SIZE / 2)
+
+/*
+ * Write an LZ4 block which decompresses to 'size' bytes repeating 'lits',
+ * as 16 literals, a match with offset 16 and 16 more literals
+ */
+static u8 *lz4_test_block(u8 *out, const u8 *lits, ulong size)
+{
+	u8 *start = out + sizeof(u32);
+	ulong len;
+
+	out = start;
+	*out++ = 0xff;
+	*out++ = 16 - 15;
+	memcpy(out, lits, 16);
+	out += 16;
+	*out++ = 16;
+	*out++ = 0;
+	for (len = size - 32 - 4 - 15; len >= 255; len -= 255)
+		*out++ = 255;
+	*out++ = len;
+	*out++ = 0xf0;
+	*out++ = 16 - 15;
+	memcpy(out, lits, 16);
+	out += 16;
+	put_unaligned_le32(out - start, start - sizeof(u32));
+
+	return out;
+}
+
+/*
+ * The blocks of a frame are independent, so they are decompressed on all
+ * CPUs if CONFIG_WORK_QUEUE is enabled. Check that this gives the same
+ * result as a single CPU and report how long each takes.
+ */
+static int compression_test_lz4_blocks(struct unit_test_state *uts)
+{
+	u8 lits[LZ4_TEST_BLOCKS][16];
+	ulong start, single, all;
+	size_t in_size, out_size;
+	u8 *in, *out, *ptr;
+	int i, j, old;
+
+	in = malloc(LZ4_TEST_BLOCKS * SZ_1K);
+	out = malloc(LZ4_TEST_SIZE);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+
+	/* Version 1, independent 64KiB blocks; ulz4fn() ignores the checksum */
+	ptr = in;
+	put_unaligned_le32(LZ4F_MAGIC, ptr);
+	ptr += sizeof(u32);
+	*ptr++ = 0x60;
+	*ptr++ = 0x40;
+	*ptr++ = 0;
+	for (i = 0; i < LZ4_TEST_BLOCKS; i++) {
+		for (j = 0; j < 16; j++)
+			lits[i][j] = rand();
+		ptr = lz4_test_block(ptr, lits[i], i < LZ4_TEST_BLOCKS - 1 ?
+				     LZ4_TEST_BLOCK_SIZE :
+				     LZ4_TEST_BLOCK_SIZE / 2);
+	}
+	put_unaligned_le32(0, ptr);
+	in_size = ptr + sizeof(u32) - in;
+
+	old = wq_set_max_cpus(1);
+	memset(out, '\0', LZ4_TEST_SIZE);
+	out_size = LZ4_TEST_SIZE;
+	start = timer_get_us();
+	ut_assertok(ulz4fn(in, in_size, out, &out_size));
+	single = timer_get_us() - start;
+	ut_asserteq(LZ4_TEST_SIZE, out_size);
+	for (i = 0; i < LZ4_TEST_SIZE; i++)
+		ut_asserteq(lits[i / LZ4_TEST_BLOCK_SIZE][i % 16], out[i]);
+
+	wq_set_max_cpus(old);
+	memset(out, '\0', LZ4_TEST_SIZE);
+	out_size = LZ4_TEST_SIZE;
+	start = timer_get_us();
+	ut_assertok(ulz4fn(in, in_size, out, &out_size));
+	all = timer_get_us() - start;
+	ut_asserteq(LZ4_TEST_SIZE, out_size);
+	for (i = 0; i < LZ4_TEST_SIZE; i++)
+		ut_asserteq(lits[i / LZ4_TEST_BLOCK_SIZE][i % 16], out[i]);
+
+	log_debug("lz4: %lu us on one CPU, %lu us on %d CPUs\n", single, all,
+		  wq_cpu_count());
+
+	/* The last block does not fit, which the decoder sees as corruption */
+	out_size = LZ4_TEST_SIZE - 1;
+	ut_asserteq(-EPROTO, ulz4fn(in, in_size, out, &out_size));
+
+	free(out);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_blocks, 0);
+
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+/* Number of copies of zstd_compressed to decompress as separate frames */
+#define ZSTD_TEST_FRAMES	5
+
+/*
+ * Several frames are decompressed independently, on other CPUs if
+ * CONFIG_WORK_QUEUE is enabled, so check that they all end up in order
+ */
+static int compression_test_zstd_frames(struct unit_test_state *uts)
+{
+	ulong plain_size = strlen(plain);
+	size_t out_size;
+	char *in, *out;
+	int i;
+
+	in = malloc(zstd_compressed_size * ZSTD_TEST_FRAMES);
+	out = malloc(plain_size * ZSTD_TEST_FRAMES);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+	for (i = 0; i < ZSTD_TEST_FRAMES; i++)
+		memcpy(in + i * zstd_compressed_size, zstd_compressed,
+		       zstd_compressed_size);
+
+	memset(out, '\0', plain_size * ZSTD_TEST_FRAMES);
+	out_size = plain_size * ZSTD_TEST_FRAMES;
+	ut_assertok(zstd_decompress(in, zstd_compressed_size * ZSTD_TEST_FRAMES,
+				    out, &out_size));
+	ut_asserteq(plain_size * ZSTD_TEST_FRAMES, out_size);
+	for (i = 0; i < ZSTD_TEST_FRAMES; i++)
+		ut_asserteq_mem(plain, out + i * plain_size, plain_size);
+
+	/* The last frame does not fit */
+	out_size = plain_size * ZSTD_TEST_FRAMES - 1;
+	ut_asserteq(-ENOBUFS,
+		    zstd_decompress(in, zstd_compressed_size * ZSTD_TEST_FRAMES,
+				    out, &out_size));
+	ut_asserteq(plain_size * ZSTD_TEST_FRAMES - 1, out_size);
+
+	/* A corrupt frame in the middle is reported */
+	in[zstd_compressed_size * 2 + zstd_compressed_size / 2] ^= 0xff;
+	out_size = plain_size * ZSTD_TEST_FRAMES;
+	ut_assert(zstd_decompress(in, zstd_compressed_size * ZSTD_TEST_FRAMES,
+				  out, &out_size));
+	ut_asserteq(0, out_size);
+
+	free(out);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_frames, 0);
+
+/* Number of copies of the plain text in the zstd and gzip benchmark */
+#define ZSTD_BENCH_COPIES	1000
+
+/*
+ * Compare the time taken to decompress the same data from zstd and gzip on
+ * one CPU. The zstd input is one frame per copy, since there is no zstd
+ * compressor to hand, so gzip has the advantage of matching across copies.
+ */
+static int compression_test_zstd_bench(struct unit_test_state *uts)
+{
+	ulong plain_size = strlen(plain);
+	ulong size = plain_size * ZSTD_BENCH_COPIES;
+	ulong start, zstd_time, gzip_time;
+	unsigned long gz_size;
+	size_t out_size;
+	char *zst, *gz, *out;
+	int i, old;
+
+	zst = malloc(zstd_compressed_size * ZSTD_BENCH_COPIES);
+	gz = malloc(size);
+	out = malloc(size);
+	ut_assertnonnull(zst);
+	ut_assertnonnull(gz);
+	ut_assertnonnull(out);
+	for (i = 0; i < ZSTD_BENCH_COPIES; i++) {
+		memcpy(zst + i * zstd_compressed_size, zstd_compressed,
+		       zstd_compressed_size);
+		memcpy(out + i * plain_size, plain, plain_size);
+	}
+	ut_assertok(compress_using_gzip(uts, out, size, gz, size, &gz_size));
+
+	old = wq_set_max_cpus(1);
+	memset(out, '\0', size);
+	out_size = size;
+	start = timer_get_us();
+	ut_assertok(zstd_decompress(zst, zstd_compressed_size *
+				    ZSTD_BENCH_COPIES, out, &out_size));
+	zstd_time = timer_get_us() - start;
+	wq_set_max_cpus(old);
+	ut_asserteq(size, out_size);
+	for (i = 0; i < ZSTD_BENCH_COPIES; i++)
+		ut_asserteq_mem(plain, out + i * plain_size, plain_size);
+
+	memset(out, '\0', size);
+	start = timer_get_us();
+	ut_assertok(uncompress_using_gzip(uts, gz, gz_size, out, size,
+					  &gz_size));
+	gzip_time = timer_get_us() - start;
+	ut_asserteq(size, gz_size);
+	for (i = 0; i < ZSTD_BENCH_COPIES; i++)
+		ut_asserteq_mem(plain, out + i * plain_size, plain_size);
+
+	log_debug("%lu bytes: %lu us from zstd, %lu us from gzip\n", size,
+		  zstd_time, gzip_time);
+
+	free(out);
+	free(gz);
+	free(zst);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_bench, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -530,12 +811,130 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+/**
+ * run_stream_test() - Run tests on streaming decompression
+ *
+ * The compressed data is fed in small pieces so that headers and blocks are
+ * split between calls.
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	struct image_decomp_stream ds;
+	ulong compress_size = 1024;
+	void *compress_buff, *out;
+	ulong unc_len, pos, len;
+	int ret = 0;
+
+	printf("Testing: stream %s\n", genimg_get_comp_name(comp_type));
+	unc_len = strlen(plain);
+	compress_buff = malloc(compress_size);
+	out = malloc(unc_len);
+	ut_assertnonnull(compress_buff);
+	ut_assertnonnull(out);
+	compress(uts, (void *)plain, unc_len, compress_buff, compress_size,
+		 &compress_size);
+	ut_asserteq(comp_type, image_decomp_type(compress_buff,
+						  compress_size));
+
+	ut_assertok(image_decomp_stream_start(&ds, comp_type, out, unc_len));
+	for (pos = 0; !ret && pos < compress_size; pos += len) {
+		len = min(compress_size - pos, 7UL);
+		ret = image_decomp_stream_feed(&ds, compress_buff + pos, len);
+	}
+	image_decomp_stream_end(&ds);
+	ut_asserteq(comp_type == IH_COMP_NONE ? 0 : 1, ret);
+	ut_asserteq(unc_len, ds.out_len);
+	ut_asserteq_mem(plain, out, unc_len);
+
+	/* One byte short of the uncompressed size must be reported */
+	ut_assertok(image_decomp_stream_start(&ds, comp_type, out,
+					      unc_len - 1));
+	ret = image_decomp_stream_feed(&ds, compress_buff, compress_size);
+	image_decomp_stream_end(&ds);
+	ut_asserteq(-ENOBUFS, ret);
+
+	/* gzip members and zstd frames can be joined together */
+	if (comp_type == IH_COMP_GZIP || comp_type == IH_COMP_ZSTD) {
+		void *two_in = malloc(compress_size * 2);
+		void *two_out = malloc(unc_len * 2);
+
+		ut_assertnonnull(two_in);
+		ut_assertnonnull(two_out);
+		memcpy(two_in, compress_buff, compress_size);
+		memcpy(two_in + compress_size, compress_buff, compress_size);
+		ut_assertok(image_decomp_stream_start(&ds, comp_type, two_out,
+						      unc_len * 2));
+		ret = 0;
+		for (pos = 0; ret >= 0 && pos < compress_size * 2; pos += len) {
+			len = min(compress_size * 2 - pos, 7UL);
+			ret = image_decomp_stream_feed(&ds, two_in + pos, len);
+		}
+		image_decomp_stream_end(&ds);
+		ut_asserteq(1, ret);
+		ut_asserteq(unc_len * 2, ds.out_len);
+		ut_asserteq_mem(plain, two_out, unc_len);
+		ut_asserteq_mem(plain, two_out + unc_len, unc_len);
+
+		/* Anything else after the end is corrupt */
+		memset(two_in + compress_size, '\xaa', compress_size);
+		ut_assertok(image_decomp_stream_start(&ds, comp_type, two_out,
+						      unc_len * 2));
+		ret = image_decomp_stream_feed(&ds, two_in, compress_size * 2);
+		image_decomp_stream_end(&ds);
+		ut_asserteq(-EINVAL, ret);
+		free(two_out);
+		free(two_in);
+	}
+
+	free(out);
+	free(compress_buff);
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZMA, compress_using_lzma);
+}
+COMPRESSION_TEST(compression_test_stream_lzma, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+#endif /* CONFIG_IMAGE_DECOMP_STREAM */
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
@@ -5,7 +5,11 @@
 
 #include <common.h>
 #include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <os.h>
 #include <part.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -163,3 +167,235 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_BLOCK_CACHE
+#define BLKCACHE_TEST_FILE	"blkcache.img"
+#define BLKCACHE_TEST_BLKS	128
+
+/* Read a whole device one block at a time, returning the time taken in us */
+static ulong blkcache_read_all(struct unit_test_state *uts,
+			       struct blk_desc *desc, const char *data)
+{
+	char buf[512];
+	ulong start;
+	int i;
+
+	start = timer_get_us();
+	for (i = 0; i < BLKCACHE_TEST_BLKS; i++) {
+		ut_asserteq(1, blk_dread(desc, i, 1, buf));
+		ut_asserteq_mem(data + i * 512, buf, 512);
+	}
+
+	return timer_get_us() - start;
+}
+
+/* Test that the block cache serves partial hits and reads ahead */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	ulong uncached, cached;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char *data, *buf;
+	int i;
+
+	data = malloc(BLKCACHE_TEST_BLKS * 512);
+	ut_assertnonnull(data);
+	buf = malloc(8 * 512);
+	ut_assertnonnull(buf);
+	for (i = 0; i < BLKCACHE_TEST_BLKS * 512; i++)
+		data[i] = i / 512 + i;
+	ut_assertok(os_write_file(BLKCACHE_TEST_FILE, data,
+				  BLKCACHE_TEST_BLKS * 512));
+	ut_assertok(host_dev_bind(0, BLKCACHE_TEST_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+
+	/* Start with an empty cache, probing the partitions read some blocks */
+	ut_assertok(blkcache_configure(8, 0));
+	ut_assertok(blkcache_configure(8, 32));
+
+	/* The second read is partly served from the cache */
+	ut_asserteq(4, blk_dread(desc, 0, 4, buf));
+	ut_asserteq_mem(data, buf, 4 * 512);
+	ut_asserteq(8, blk_dread(desc, 2, 8, buf));
+	ut_asserteq_mem(data + 2 * 512, buf, 8 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.num_devs);
+	ut_asserteq(IF_TYPE_HOST, stats.devs[0].iftype);
+	ut_asserteq(2, stats.devs[0].hits);
+	ut_asserteq(4 + 6, stats.devs[0].misses);
+	ut_asserteq(2, stats.devs[0].reads);
+	ut_asserteq(0, stats.devs[0].readahead);
+
+	/* Sequential single-block reads trigger readahead */
+	for (i = 16; i < 90; i++) {
+		ut_asserteq(1, blk_dread(desc, i, 1, buf));
+		ut_asserteq_mem(data + i * 512, buf, 512);
+	}
+	blkcache_stats(&stats);
+	ut_assert(stats.devs[0].reads < 10);
+	ut_assert(stats.devs[0].readahead > 0);
+	ut_asserteq(stats.devs[0].hits + stats.devs[0].misses, 90 - 16);
+
+	/* Writes replace cached data */
+	memset(buf, '\xa5', 512);
+	ut_asserteq(1, blk_dwrite(desc, 20, 1, buf));
+	memset(buf, '\0', 512);
+	ut_asserteq(1, blk_dread(desc, 20, 1, buf));
+	ut_asserteq(0xa5, (u8)buf[511]);
+	memset(data + 20 * 512, '\xa5', 512);
+	ut_assertok(blkcache_flush(IF_TYPE_HOST, 0));
+
+	/* Compare the time taken to read the device without and with cache */
+	ut_assertok(blkcache_configure(8, 0));
+	uncached = blkcache_read_all(uts, desc, data);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.hits);
+	ut_assertok(blkcache_configure(8, 32));
+	cached = blkcache_read_all(uts, desc, data);
+	blkcache_stats(&stats);
+	ut_assert(stats.devs[0].reads < BLKCACHE_TEST_BLKS / 4);
+	log_debug("blkcache: %d single-block reads, uncached %lu us, cached %lu us\n",
+		  BLKCACHE_TEST_BLKS, uncached, cached);
+
+	ut_assertok(host_dev_bind(0, NULL));
+	os_unlink(BLKCACHE_TEST_FILE);
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_BLOCK_CACHE_WRITEBACK
+/* Test that the write-back cache merges small writes */
+static int dm_test_blk_cache_writeback(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char *data, *buf;
+	int i;
+
+	data = calloc(BLKCACHE_TEST_BLKS, 512);
+	ut_assertnonnull(data);
+	buf = malloc(BLKCACHE_TEST_BLKS * 512);
+	ut_assertnonnull(buf);
+	ut_assertok(os_write_file(BLKCACHE_TEST_FILE, data,
+				  BLKCACHE_TEST_BLKS * 512));
+	ut_assertok(host_dev_bind(0, BLKCACHE_TEST_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+	ut_assertok(blkcache_configure(8, 0));
+	ut_assertok(blkcache_configure(8, 32));
+
+	/* Rewrite the same blocks, as a filesystem does with its bitmaps */
+	for (i = 0; i < 16; i++) {
+		memset(data + 4 * 512, i, 512);
+		ut_asserteq(1, blk_dwrite(desc, 4, 1, data + 4 * 512));
+	}
+
+	/* Then write a run of single blocks, in reverse order */
+	for (i = 23; i >= 8; i--) {
+		memset(data + i * 512, i, 512);
+		ut_asserteq(1, blk_dwrite(desc, i, 1, data + i * 512));
+	}
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.devs[0].writes);
+	ut_asserteq(17, stats.devs[0].dirty);
+
+	/* Dirty blocks are visible to small and large reads */
+	ut_asserteq(2, blk_dread(desc, 4, 2, buf));
+	ut_asserteq_mem(data + 4 * 512, buf, 2 * 512);
+	ut_asserteq(BLKCACHE_TEST_BLKS,
+		    blk_dread(desc, 0, BLKCACHE_TEST_BLKS, buf));
+	ut_asserteq_mem(data, buf, BLKCACHE_TEST_BLKS * 512);
+
+	/* Blocks 4 and 8-23 reach the device in two writes */
+	ut_assertok(blkcache_flush(IF_TYPE_HOST, 0));
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.devs[0].writes);
+	ut_asserteq(17, stats.devs[0].writeback);
+	ut_asserteq(0, stats.devs[0].dirty);
+
+	/* Check the backing file, bypassing the cache */
+	ut_assertok(blkcache_configure(8, 0));
+	ut_asserteq(BLKCACHE_TEST_BLKS,
+		    blk_dread(desc, 0, BLKCACHE_TEST_BLKS, buf));
+	ut_asserteq_mem(data, buf, BLKCACHE_TEST_BLKS * 512);
+
+	/* Removing the device writes back anything left in the cache */
+	ut_assertok(blkcache_configure(8, 32));
+	memset(data + 100 * 512, 0x5a, 512);
+	ut_asserteq(1, blk_dwrite(desc, 100, 1, data + 100 * 512));
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_assertok(host_dev_bind(0, BLKCACHE_TEST_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+	ut_assertok(blkcache_configure(8, 0));
+	ut_asserteq(1, blk_dread(desc, 100, 1, buf));
+	ut_asserteq_mem(data + 100 * 512, buf, 512);
+
+	ut_assertok(blkcache_configure(8, 32));
+	ut_assertok(host_dev_bind(0, NULL));
+	os_unlink(BLKCACHE_TEST_FILE);
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_writeback, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that blocks stay dirty if they cannot be written back */
+static int dm_test_blk_cache_writeback_fail(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char data[4 * 512], buf[4 * 512];
+	int i;
+
+	/* Every write to /dev/full fails */
+	ut_assertok(host_dev_bind(0, "/dev/full"));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+	ut_assertok(blkcache_configure(8, 0));
+	ut_assertok(blkcache_configure(8, 32));
+
+	for (i = 0; i < 4; i++) {
+		memset(data + i * 512, 0xa0 + i, 512);
+		ut_asserteq(1, blk_dwrite(desc, 4 + i, 1, data + i * 512));
+	}
+	ut_asserteq(-EIO, blkcache_flush(IF_TYPE_HOST, 0));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.devs[0].writes);
+	ut_asserteq(4, stats.devs[0].dirty);
+
+	/* The data is still in the cache and the next flush tries again */
+	ut_asserteq(4, blk_dread(desc, 4, 4, buf));
+	ut_asserteq_mem(data, buf, sizeof(buf));
+	ut_asserteq(-EIO, blkcache_flush(IF_TYPE_HOST, 0));
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.devs[0].writes);
+	ut_asserteq(4, stats.devs[0].dirty);
+
+	/* Neither invalidating nor reconfiguring the cache drops them */
+	ut_asserteq(-EIO, blkcache_invalidate(IF_TYPE_HOST, 0));
+	ut_asserteq(-EIO, blkcache_configure(8, 0));
+	blkcache_stats(&stats);
+	ut_asserteq(32, stats.max_entries);
+	ut_asserteq(4, stats.devs[0].dirty);
+	ut_asserteq(4, blk_dread(desc, 4, 4, buf));
+	ut_asserteq_mem(data, buf, sizeof(buf));
+
+	/* Removing the device has to drop them */
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_assertok(blkcache_configure(8, 32));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_writeback_fail,
+	DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+#endif
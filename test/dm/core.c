@@ -12,6 +12,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -905,3 +906,253 @@ static int dm_test_inactive_child(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_inactive_child, DM_TESTF_SCAN_PDATA);
+
+/* Check that every compatible string leads to the same driver as before */
+static int dm_test_lookup_compat(struct unit_test_state *uts)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id, *found_id, *first_id;
+	struct driver *entry, *first, *found;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++) {
+			ut_assertok(lists_driver_lookup_compat(id->compatible,
+							       &found,
+							       &found_id));
+
+			/* The first match in the list must win */
+			for (first = driver; first <= entry; first++) {
+				for (first_id = first->of_match;
+				     first_id && first_id->compatible;
+				     first_id++) {
+					if (!strcmp(first_id->compatible,
+						    id->compatible))
+						break;
+				}
+				if (first_id && first_id->compatible)
+					break;
+			}
+			ut_asserteq_ptr(first, found);
+			ut_asserteq_ptr(first_id, found_id);
+		}
+	}
+
+	ut_asserteq(-ENOENT, lists_driver_lookup_compat("u-boot,no-such-device",
+							&found, &found_id));
+
+	return 0;
+}
+DM_TEST(dm_test_lookup_compat, 0);
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/* Check that devices are bound when first needed, not by the scan */
+static int dm_test_lazy_bind(struct unit_test_state *uts)
+{
+	struct list_head *root_head = &gd->dm_root->child_head;
+	struct udevice *dev;
+	struct uclass *uc;
+	int before, count;
+	ofnode node;
+
+	before = list_count_items(root_head);
+	ut_assertok(dm_scan_fdt_lazy());
+	ut_asserteq(before, list_count_items(root_head));
+
+	/* Using the uclass binds all of its devices, as dm_test_fdt() finds */
+	ut_assertok(uclass_get(UCLASS_TEST_FDT, &uc));
+	ut_asserteq(8, list_count_items(&uc->dev_head));
+	count = list_count_items(root_head);
+	ut_assert(count > before);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 8, true, &dev));
+	ut_asserteq_str("a-test", dev->name);
+
+	/* Looking up a node binds just that node */
+	node = ofnode_path("/syscon@0");
+	ut_assert(ofnode_valid(node));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq_str("syscon@0", dev->name);
+	ut_asserteq(count + 1, list_count_items(root_head));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq(count + 1, list_count_items(root_head));
+
+	/* Nothing is bound twice */
+	ut_assertok(dm_lazy_bind_all());
+	count = list_count_items(root_head);
+	ut_assertok(uclass_get(UCLASS_TEST_FDT, &uc));
+	ut_asserteq(8, list_count_items(&uc->dev_head));
+	ut_assertok(uclass_get(UCLASS_SYSCON, &uc));
+	ut_asserteq(count, list_count_items(root_head));
+
+	return 0;
+}
+DM_TEST(dm_test_lazy_bind, DM_TESTF_SCAN_PDATA);
+#endif
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/* Number of devices and lookup passes for the uclass index benchmark */
+#define TEST_INDEX_DEVS		300
+#define TEST_INDEX_PASSES	20
+
+/* Check each lookup against a search of the uclass's device list */
+static int check_uclass_index(struct unit_test_state *uts, enum uclass_id id)
+{
+	struct udevice *dev, *first, *found;
+	struct uclass *uc;
+
+	ut_assertok(uclass_get(id, &uc));
+	uclass_foreach_dev(dev, uc) {
+		uclass_foreach_dev(first, uc) {
+			if (!strcmp(first->name, dev->name))
+				break;
+		}
+		ut_assertok(uclass_find_device_by_name(id, dev->name, &found));
+		ut_asserteq_ptr(first, found);
+
+		if (dev->seq != -1) {
+			ut_assertok(uclass_find_device_by_seq(id, dev->seq,
+							      false, &found));
+			ut_asserteq_ptr(dev, found);
+		}
+
+		if (dev->req_seq != -1) {
+			uclass_foreach_dev(first, uc) {
+				if (first->req_seq == dev->req_seq)
+					break;
+			}
+			ut_assertok(uclass_find_device_by_seq(id, dev->req_seq,
+							      true, &found));
+			ut_asserteq_ptr(first, found);
+		}
+
+		if (ofnode_valid(dev_ofnode(dev))) {
+			uclass_foreach_dev(first, uc) {
+				if (ofnode_equal(dev_ofnode(first),
+						 dev_ofnode(dev)))
+					break;
+			}
+			ut_assertok(uclass_find_device_by_ofnode(id,
+							dev_ofnode(dev),
+							&found));
+			ut_asserteq_ptr(first, found);
+		}
+	}
+
+	return 0;
+}
+
+/* Check that the uclass table and hash tables keep up with the devices */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *dev, *dev1, *dev2;
+	struct uclass *uc;
+	int seq;
+
+	ut_assertnonnull(gd->uclass_tab);
+	list_for_each_entry(uc, &gd->uclass_root, sibling_node)
+		ut_asserteq_ptr(uc, uclass_find(uc->uc_drv->id));
+	ut_asserteq_ptr(NULL, uclass_find(UCLASS_INVALID));
+
+	/* Lookups give the same results before and after probing */
+	ut_assertok(check_uclass_index(uts, UCLASS_TEST_FDT));
+	for (uclass_first_device(UCLASS_TEST_FDT, &dev); dev;
+	     uclass_next_device(&dev))
+		;
+	ut_assertok(check_uclass_index(uts, UCLASS_TEST_FDT));
+
+	/* The first device with a name is found, and renaming is seen */
+	dms->skip_post_probe = 1;
+	ut_assertok(device_bind_ofnode(dms->root, DM_GET_DRIVER(test_drv),
+				       "same", NULL, ofnode_null(), &dev1));
+	ut_assertok(device_bind_ofnode(dms->root, DM_GET_DRIVER(test_drv),
+				       "same", NULL, ofnode_null(), &dev2));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "same", &dev));
+	ut_asserteq_ptr(dev1, dev);
+	ut_assertok(device_set_name(dev1, "renamed"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "same", &dev));
+	ut_asserteq_ptr(dev2, dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "renamed", &dev));
+	ut_asserteq_ptr(dev1, dev);
+
+	/* A device has a sequence number only while it is probed */
+	ut_assertok(device_probe(dev2));
+	seq = dev2->seq;
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, seq, false, &dev));
+	ut_asserteq_ptr(dev2, dev);
+	ut_assertok(device_remove(dev2, DM_REMOVE_NORMAL));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq, false,
+						       &dev));
+
+	/* Unbound devices are not found */
+	ut_assertok(device_unbind(dev2));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST, "same",
+							&dev));
+	ut_assertok(check_uclass_index(uts, UCLASS_TEST));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Compare lookups in a large uclass with a search of the device list */
+static int dm_test_uclass_index_bench(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *devs[TEST_INDEX_DEVS], *dev;
+	ulong start, linear, indexed;
+	struct uclass *uc;
+	char name[20];
+	int i, pass;
+
+	dms->skip_post_probe = 1;
+	for (i = 0; i < TEST_INDEX_DEVS; i++) {
+		ut_assertok(device_bind_ofnode(dms->root,
+					       DM_GET_DRIVER(test_drv), "bench",
+					       NULL, ofnode_null(), &devs[i]));
+		snprintf(name, sizeof(name), "bench%d", i);
+		ut_assertok(device_set_name(devs[i], name));
+		ut_assertok(device_probe(devs[i]));
+	}
+	ut_assertok(uclass_get(UCLASS_TEST, &uc));
+
+	/* This is what the lookups did before */
+	start = timer_get_us();
+	for (pass = 0; pass < TEST_INDEX_PASSES; pass++) {
+		for (i = 0; i < TEST_INDEX_DEVS; i++) {
+			uclass_foreach_dev(dev, uc) {
+				if (!strcmp(dev->name, devs[i]->name))
+					break;
+			}
+			ut_asserteq_ptr(devs[i], dev);
+			uclass_foreach_dev(dev, uc) {
+				if (dev->seq == devs[i]->seq)
+					break;
+			}
+			ut_asserteq_ptr(devs[i], dev);
+		}
+	}
+	linear = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (pass = 0; pass < TEST_INDEX_PASSES; pass++) {
+		for (i = 0; i < TEST_INDEX_DEVS; i++) {
+			ut_assertok(uclass_find_device_by_name(UCLASS_TEST,
+							       devs[i]->name,
+							       &dev));
+			ut_asserteq_ptr(devs[i], dev);
+			ut_assertok(uclass_find_device_by_seq(UCLASS_TEST,
+							      devs[i]->seq,
+							      false, &dev));
+			ut_asserteq_ptr(devs[i], dev);
+		}
+	}
+	indexed = timer_get_us() - start;
+
+	log_debug("%d devices, %d lookups: %lu us linear, %lu us indexed\n",
+		  TEST_INDEX_DEVS, TEST_INDEX_DEVS * TEST_INDEX_PASSES * 2,
+		  linear, indexed);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index_bench, 0);
+#endif
@@ -10,13 +10,16 @@
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
+#include <image.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <test/ut.h>
 
 #define DM_TEST_ETH_NUM		4
@@ -430,3 +433,215 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, DM_TESTF_SCAN_FDT);
+
+/* State of the TFTP server mocked by sb_tftp_handler() */
+struct sb_tftp_server {
+	int window;		/* windowsize to grant in the OACK */
+	int blocks;		/* number of blocks in the file */
+	int drop_block;		/* block to drop the first time it is sent */
+	int dup_block;		/* block to send twice the first time */
+	int acks;		/* number of ACKs received */
+	unsigned int client_port;
+};
+
+static struct sb_tftp_server sb_tftp;
+
+/* TFTP opcodes used by the mock server */
+#define TFTP_RRQ		1
+#define TFTP_DATA		3
+#define TFTP_ACK		4
+#define TFTP_OACK		6
+
+#define SB_TFTP_BLOCK_SIZE	512
+#define SB_TFTP_SERVER_PORT	1069
+#define SB_TFTP_FILE_SIZE	(20 * SB_TFTP_BLOCK_SIZE + 100)
+
+static void sb_tftp_queue(struct udevice *dev, void *packet, const void *data,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+
+	/* Don't allow the buffer to overrun */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ipr, net_ip, priv->fake_host_ipaddr,
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ipr->udp_src = htons(SB_TFTP_SERVER_PORT);
+	ipr->udp_dst = htons(sb_tftp.client_port);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+	memcpy((void *)ipr + IP_UDP_HDR_SIZE, data, len);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+static void sb_tftp_send_window(struct udevice *dev, void *packet, int acked)
+{
+	uchar data[4 + SB_TFTP_BLOCK_SIZE];
+	int block, len;
+
+	for (block = acked + 1;
+	     block <= acked + sb_tftp.window && block <= sb_tftp.blocks;
+	     block++) {
+		if (block == sb_tftp.drop_block) {
+			sb_tftp.drop_block = 0;
+			continue;
+		}
+		len = SB_TFTP_BLOCK_SIZE;
+		if (block == sb_tftp.blocks)
+			len = SB_TFTP_FILE_SIZE % SB_TFTP_BLOCK_SIZE;
+		put_unaligned_be16(TFTP_DATA, data);
+		put_unaligned_be16(block, data + 2);
+		memset(data + 4, block, len);
+		sb_tftp_queue(dev, packet, data, 4 + len);
+		if (block == sb_tftp.dup_block) {
+			sb_tftp.dup_block = 0;
+			sb_tftp_queue(dev, packet, data, 4 + len);
+		}
+	}
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *pkt = (uchar *)ip + IP_UDP_HDR_SIZE;
+	char oack[64];
+	int oack_len;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (get_unaligned_be16(pkt)) {
+	case TFTP_RRQ:
+		sb_tftp.client_port = ntohs(ip->udp_src);
+		oack_len = 2;
+		put_unaligned_be16(TFTP_OACK, oack);
+		oack_len += sprintf(oack + oack_len, "blksize%c%d%c", 0,
+				    SB_TFTP_BLOCK_SIZE, 0);
+		if (sb_tftp.window > 1)
+			oack_len += sprintf(oack + oack_len, "windowsize%c%d%c",
+					    0, sb_tftp.window, 0);
+		sb_tftp_queue(dev, packet, oack, oack_len);
+		break;
+	case TFTP_ACK:
+		sb_tftp.acks++;
+		sb_tftp_send_window(dev, packet, get_unaligned_be16(pkt + 2));
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_get(struct unit_test_state *uts, int window, int drop,
+		       int dup)
+{
+	u8 *buf;
+	int i;
+
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.window = window;
+	sb_tftp.blocks = SB_TFTP_FILE_SIZE / SB_TFTP_BLOCK_SIZE + 1;
+	sb_tftp.drop_block = drop;
+	sb_tftp.dup_block = dup;
+	env_set_ulong("tftpwindowsize", window);
+
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+
+	buf = map_sysmem(image_load_addr, SB_TFTP_FILE_SIZE);
+	for (i = 0; i < SB_TFTP_FILE_SIZE; i++)
+		ut_asserteq(i / SB_TFTP_BLOCK_SIZE + 1, buf[i]);
+	unmap_sysmem(buf);
+
+	return sb_tftp.acks;
+}
+
+static int dm_test_eth_tftp_windowsize(struct unit_test_state *uts)
+{
+	ulong old_load_addr = image_load_addr;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	env_set("ethact", "eth@10002000");
+	env_set("serverip", "1.1.2.2");
+	env_set_ulong("tftpblocksize", SB_TFTP_BLOCK_SIZE);
+	strcpy(net_boot_file_name, "tftp.bin");
+	image_load_addr = 0x1000000;
+
+	/* ACK 0 for the OACK, then one for every block */
+	ut_asserteq(1 + 21, sb_tftp_get(uts, 1, 0, 0));
+
+	/* ACK 0, then one for every window of three blocks */
+	ut_asserteq(1 + 7, sb_tftp_get(uts, 3, 0, 0));
+
+	/* Losing block 5 costs one early ACK of block 4, but no timeout */
+	ut_asserteq(1 + 8, sb_tftp_get(uts, 3, 5, 0));
+
+	/* A duplicate of block 5 is ignored, without an early ACK */
+	ut_asserteq(1 + 7, sb_tftp_get(uts, 3, 0, 5));
+
+	image_load_addr = old_load_addr;
+	net_boot_file_name[0] = '\0';
+	env_set("tftpblocksize", NULL);
+	env_set("tftpwindowsize", NULL);
+	env_set("serverip", NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+
+DM_TEST(dm_test_eth_tftp_windowsize, DM_TESTF_SCAN_FDT);
+
+static int dm_test_eth_tftp_direct(struct unit_test_state *uts)
+{
+	ulong old_load_addr = image_load_addr;
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	env_set("ethact", "eth@10002000");
+	env_set("serverip", "1.1.2.2");
+	env_set_ulong("tftpblocksize", SB_TFTP_BLOCK_SIZE);
+	strcpy(net_boot_file_name, "tftp.bin");
+	image_load_addr = 0x1000000;
+
+	/* Every block after the first goes straight to the load address */
+	priv->split_packets = 0;
+	ut_asserteq(1 + 21, sb_tftp_get(uts, 1, 0, 0));
+	ut_asserteq(20, priv->split_packets);
+
+	/* A block landing in the wrong place is still stored correctly */
+	priv->split_packets = 0;
+	ut_asserteq(1 + 8, sb_tftp_get(uts, 3, 5, 0));
+	ut_assert(priv->split_packets >= 20);
+
+	image_load_addr = old_load_addr;
+	net_boot_file_name[0] = '\0';
+	env_set("tftpblocksize", NULL);
+	env_set("tftpwindowsize", NULL);
+	env_set("serverip", NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+
+DM_TEST(dm_test_eth_tftp_direct, DM_TESTF_SCAN_FDT);
@@ -7,6 +7,7 @@
 #include <dm.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -42,3 +43,51 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Check that reads are counted in the transfer statistics */
+static int dm_test_mmc_stats(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	struct blk_desc *dev_desc;
+	struct mmc *mmc;
+	uint set_count, stop;
+	ulong cmds;
+	u64 blocks;
+	char buf[1024];
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	dev = dev_get_parent(dev_desc->bdev);
+	mmc = mmc_get_mmc_dev(dev);
+	cmds = mmc->stats.read_cmds;
+	blocks = mmc->stats.read_blocks;
+	set_count = sandbox_mmc_get_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT);
+	stop = sandbox_mmc_get_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION);
+
+	/* Read directly from the device, bypassing the block cache */
+	ut_asserteq(2, blk_get_ops(dev_desc->bdev)->read(dev_desc->bdev, 0, 2,
+							 buf));
+	ut_assertok(strcmp(buf, "this is a test"));
+	ut_asserteq(cmds + 1, mmc->stats.read_cmds);
+	ut_asserteq(blocks + 2, mmc->stats.read_blocks);
+
+	/* mmc0 has u-boot,cap-cmd23 so the block count is set, with no CMD12 */
+	ut_asserteq(set_count + 1,
+		    sandbox_mmc_get_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	ut_asserteq(stop,
+		    sandbox_mmc_get_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION));
+
+	/* mmc1 does not, so it must be stopped with CMD12 */
+	ut_assertok(blk_get_device_by_str("mmc", "1", &dev_desc));
+	dev = dev_get_parent(dev_desc->bdev);
+	set_count = sandbox_mmc_get_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT);
+	stop = sandbox_mmc_get_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION);
+	ut_asserteq(2, blk_get_ops(dev_desc->bdev)->read(dev_desc->bdev, 0, 2,
+							 buf));
+	ut_asserteq(set_count,
+		    sandbox_mmc_get_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	ut_asserteq(stop + 1,
+		    sandbox_mmc_get_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_stats, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -2,7 +2,11 @@
 
 #include <common.h>
 #include <dm.h>
+#include <fdtdec.h>
 #include <log.h>
+#include <malloc.h>
+#include <of_live.h>
+#include <os.h>
 #include <dm/of_extra.h>
 #include <dm/test.h>
 #include <test/ut.h>
@@ -135,3 +139,158 @@ static int dm_test_ofnode_get_child_count(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_ofnode_get_child_count,
 	DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Every phandle in the tree must lead to its own node */
+static int dm_test_ofnode_phandle(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	char path[256];
+	int offset, count = 0;
+	u32 phandle;
+
+	for (offset = 0; offset >= 0; offset = fdt_next_node(blob, offset,
+							      NULL)) {
+		phandle = fdt_get_phandle(blob, offset);
+		if (!phandle)
+			continue;
+		ut_assertok(fdt_get_path(blob, offset, path, sizeof(path)));
+		ut_assert(ofnode_equal(ofnode_path(path),
+				       ofnode_get_by_phandle(phandle)));
+		count++;
+	}
+	ut_assert(count > 1);
+	ut_assert(!ofnode_valid(ofnode_get_by_phandle(fdt_get_max_phandle(blob)
+						      + 1)));
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Nodes found through the phandle index must still be right after a change */
+static int dm_test_ofnode_phandle_change(struct unit_test_state *uts)
+{
+	const void *old_blob = gd->fdt_blob;
+	int size = fdt_totalsize(old_blob) + 0x100;
+	int offset, node;
+	u32 phandle, max;
+	void *blob;
+
+	blob = malloc(size);
+	ut_assertnonnull(blob);
+	ut_assertok(fdt_open_into(old_blob, blob, size));
+	gd->fdt_blob = blob;
+
+	max = fdt_get_max_phandle(blob);
+	offset = fdt_path_offset(blob, "/clk-sbox");
+	ut_assert(offset > 0);
+	phandle = fdt_get_phandle(blob, offset);
+	ut_assert(phandle);
+	ut_asserteq(offset, fdtdec_node_offset_by_phandle(blob, phandle));
+
+	/* Add a node near the start, which moves all the others */
+	node = fdt_add_subnode(blob, 0, "aaa-new-node");
+	ut_assert(node > 0);
+	ut_assertok(fdt_setprop_u32(blob, node, "phandle", max + 1));
+	offset = fdt_path_offset(blob, "/clk-sbox");
+	ut_asserteq(offset, fdtdec_node_offset_by_phandle(blob, phandle));
+	node = fdt_path_offset(blob, "/aaa-new-node");
+	ut_asserteq(node, fdtdec_node_offset_by_phandle(blob, max + 1));
+
+	/* Going back to the old blob must not use the index of this one */
+	gd->fdt_blob = old_blob;
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_node_offset_by_phandle(old_blob, max + 1));
+	free(blob);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle_change, DM_TESTF_FLAT_TREE);
+
+#ifdef CONFIG_OF_LIVE_SNAPSHOT
+/* Check that a snapshot of a live tree matches the tree */
+static int check_snapshot(struct unit_test_state *uts,
+			  const struct device_node *np,
+			  const struct device_node *ref)
+{
+	const struct device_node *child, *ref_child;
+	const struct property *pp, *ref_pp;
+
+	ut_asserteq_str(ref->full_name, np->full_name);
+	ut_asserteq_str(ref->name, np->name);
+	ut_asserteq_str(ref->type, np->type);
+	ut_asserteq(ref->phandle, np->phandle);
+
+	for (pp = np->properties, ref_pp = ref->properties; pp && ref_pp;
+	     pp = pp->next, ref_pp = ref_pp->next) {
+		ut_asserteq_str(ref_pp->name, pp->name);
+		ut_asserteq(ref_pp->length, pp->length);
+		ut_asserteq_mem(ref_pp->value, pp->value, pp->length);
+	}
+	ut_assert(!pp && !ref_pp);
+
+	for (child = np->child, ref_child = ref->child; child && ref_child;
+	     child = child->sibling, ref_child = ref_child->sibling) {
+		ut_asserteq_ptr(np, child->parent);
+		ut_assertok(check_snapshot(uts, child, ref_child));
+	}
+	ut_assert(!child && !ref_child);
+
+	return 0;
+}
+
+static int dm_test_ofnode_snapshot(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	struct device_node *root;
+	void *buf, *blob;
+	int size, node;
+
+	size = of_live_snap_create(gd->of_root, fdt, NULL, 0);
+	ut_assert(size > 0);
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_asserteq(-ENOSPC, of_live_snap_create(gd->of_root, fdt, buf,
+						 size - 1));
+	ut_asserteq(size, of_live_snap_create(gd->of_root, fdt, buf, size));
+
+	/* It cannot be used with a different FDT */
+	blob = malloc(fdt_totalsize(fdt));
+	ut_assertnonnull(blob);
+	memcpy(blob, fdt, fdt_totalsize(fdt));
+	node = fdt_path_offset(blob, "/a-test");
+	ut_assert(node > 0);
+	ut_assertok(fdt_setprop_inplace_u32(blob, node, "ping-expect", 1));
+	ut_asserteq(-ESTALE, of_live_snap_load(buf, blob, &root));
+
+	ut_assertok(of_live_snap_load(buf, fdt, &root));
+	ut_asserteq(-EALREADY, of_live_snap_load(buf, fdt, &root));
+	ut_assertok(check_snapshot(uts, root, gd->of_root));
+
+	free(blob);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_snapshot, DM_TESTF_LIVE_TREE);
+
+/*
+ * Check a snapshot written by 'dtoc live', which must use the same layout as
+ * struct device_node and struct property. This is written from test.dtb by
+ * test_ut_dm_init() in test/py/tests/test_ut.py
+ */
+static int dm_test_ofnode_snapshot_dtoc(struct unit_test_state *uts)
+{
+	struct device_node *root;
+	void *snap;
+	int size;
+
+	ut_assertok(os_read_file("test-live.bin", &snap, &size));
+	ut_asserteq(size, ((struct of_live_snap_hdr *)snap)->size);
+	ut_assertok(of_live_snap_load(snap, gd->fdt_blob, &root));
+	ut_assertok(check_snapshot(uts, root, gd->of_root));
+	free(snap);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_snapshot_dtoc, DM_TESTF_LIVE_TREE);
+#endif
@@ -91,6 +91,26 @@ static int dm_test_power_regulator_get(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_power_regulator_get, DM_TESTF_SCAN_FDT);
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/* Test that regulators bound by their PMIC are found with lazy binding */
+static int dm_test_power_regulator_lazy(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	int i;
+
+	ut_assertok(dm_scan_fdt_lazy());
+	for (i = 0; i < OUTPUT_COUNT; i++) {
+		ut_assertok(regulator_get_by_platname(regulator_names[i][PLATNAME],
+						      &dev));
+		ut_asserteq_str(regulator_names[i][DEVNAME], dev->name);
+		ut_asserteq(UCLASS_PMIC, device_get_uclass_id(dev->parent));
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_power_regulator_lazy, DM_TESTF_SCAN_PDATA);
+#endif
+
 /* Test regulator set and get Voltage method */
 static int dm_test_power_regulator_set_get_voltage(struct unit_test_state *uts)
 {
@@ -10,7 +10,9 @@
 #include <errno.h>
 #include <log.h>
 #include <malloc.h>
+#include <of_live.h>
 #include <asm/state.h>
+#include <dm/of_access.h>
 #include <dm/test.h>
 #include <dm/root.h>
 #include <dm/uclass-internal.h>
@@ -21,6 +23,42 @@ DECLARE_GLOBAL_DATA_PTR;
 struct unit_test_state global_dm_test_state;
 static struct dm_test_state _global_priv_dm_test_state;
 
+#ifdef CONFIG_OF_LIVE_SNAPSHOT
+/* Snapshot of the live tree, used as a third way of running the tests */
+static struct device_node *dm_test_snap_root;
+
+/*
+ * Make a snapshot of the live tree, as 'dtoc live' does at build time, so
+ * that the tests can run with it as well
+ */
+static void *dm_test_snapshot(struct device_node *root)
+{
+	void *buf;
+	int size;
+
+	size = of_live_snap_create(root, gd->fdt_blob, NULL, 0);
+	buf = malloc(size);
+	if (!buf)
+		return NULL;
+	if (of_live_snap_create(root, gd->fdt_blob, buf, size) < 0 ||
+	    of_live_snap_load(buf, gd->fdt_blob, &dm_test_snap_root)) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* Switch to another live tree, which has its own aliases */
+static void dm_test_set_of_root(struct unit_test_state *uts,
+				struct device_node *root)
+{
+	uts->of_root = root;
+	gd->of_root = root;
+	of_alias_scan();
+}
+#endif
+
 /* Get ready for testing */
 static int dm_test_init(struct unit_test_state *uts, bool of_live)
 {
@@ -82,8 +120,13 @@ static int dm_do_test(struct unit_test_state *uts, struct unit_test *test,
 	struct sandbox_state *state = state_get_current();
 	const char *fname = strrchr(test->file, '/') + 1;
 
-	printf("Test: %s: %s%s\n", test->name, fname,
-	       !of_live ? " (flat tree)" : "");
+	const char *tree = !of_live ? " (flat tree)" : "";
+
+#ifdef CONFIG_OF_LIVE_SNAPSHOT
+	if (of_live && uts->of_root == dm_test_snap_root)
+		tree = " (live tree snapshot)";
+#endif
+	printf("Test: %s: %s%s\n", test->name, fname, tree);
 	ut_assertok(dm_test_init(uts, of_live));
 
 	uts->start = mallinfo();
@@ -131,6 +174,7 @@ static int dm_test_main(const char *test_name)
 	const int n_ents = ll_entry_count(struct unit_test, dm_test);
 	struct unit_test_state *uts = &global_dm_test_state;
 	struct unit_test *test;
+	void *snap = NULL;
 	int found;
 
 	uts->priv = &_global_priv_dm_test_state;
@@ -152,6 +196,13 @@ static int dm_test_main(const char *test_name)
 	found = 0;
 #ifdef CONFIG_OF_LIVE
 	uts->of_root = gd->of_root;
+#endif
+#ifdef CONFIG_OF_LIVE_SNAPSHOT
+	if (uts->of_root) {
+		snap = dm_test_snapshot(uts->of_root);
+		if (!snap)
+			printf("Cannot snapshot the live tree\n");
+	}
 #endif
 	for (test = tests; test < tests + n_ents; test++) {
 		const char *name = test->name;
@@ -172,6 +223,21 @@ static int dm_test_main(const char *test_name)
 			}
 		}
 
+#ifdef CONFIG_OF_LIVE_SNAPSHOT
+		/*
+		 * Run again with the snapshot of the live tree, skipping slow
+		 * tests as for the flat tree
+		 */
+		if (snap && !(test->flags & DM_TESTF_FLAT_TREE) &&
+		    dm_test_run_on_flattree(test)) {
+			struct device_node *of_root = uts->of_root;
+
+			dm_test_set_of_root(uts, dm_test_snap_root);
+			ut_assertok(dm_do_test(uts, test, true));
+			dm_test_set_of_root(uts, of_root);
+		}
+#endif
+
 		/*
 		 * Run with the flat tree if we couldn't run it with live tree,
 		 * or it is a core test.
@@ -193,6 +259,7 @@ static int dm_test_main(const char *test_name)
 #ifdef CONFIG_OF_LIVE
 	gd->of_root = uts->of_root;
 #endif
+	free(snap);
 	gd->dm_root = NULL;
 	ut_assertok(dm_init(IS_ENABLED(CONFIG_OF_LIVE)));
 	dm_scan_platdata(false);
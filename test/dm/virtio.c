@@ -81,6 +81,77 @@ static int dm_test_virtio_all_ops(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_virtio_all_ops, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/* Test that multi-part buffers use indirect descriptors when negotiated */
+static int dm_test_virtio_ring_indirect(struct unit_test_state *uts)
+{
+	struct udevice *bus, *dev;
+	struct virtio_dev_priv *uc_priv;
+	struct virtio_sg sg[3], *sgs[3];
+	struct vring_desc *desc;
+	struct virtqueue *vq;
+	u8 buf[3][16];
+	uint len;
+	int i;
+
+	/* check probe success */
+	ut_assertok(uclass_first_device(UCLASS_VIRTIO, &bus));
+
+	/* check the child virtio-blk device is bound */
+	ut_assertok(device_find_first_child(bus, &dev));
+
+	/* fake the virtio device probe, with indirect descriptors */
+	uc_priv = dev_get_uclass_priv(bus);
+	uc_priv->vdev = dev;
+	__virtio_set_bit(bus, VIRTIO_RING_F_INDIRECT_DESC);
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	ut_assert(vq->indirect);
+	ut_asserteq(4, virtqueue_get_vring_size(vq));
+
+	for (i = 0; i < 3; i++) {
+		sg[i].addr = buf[i];
+		sg[i].length = sizeof(buf[i]);
+		sgs[i] = &sg[i];
+	}
+
+	/* a three-part buffer takes a single ring entry */
+	ut_assertok(virtqueue_add(vq, sgs, 1, 2));
+	ut_asserteq(3, vq->num_free);
+	ut_asserteq(VRING_DESC_F_INDIRECT,
+		    virtio16_to_cpu(dev, vq->vring.desc[0].flags));
+	ut_asserteq(3 * sizeof(struct vring_desc),
+		    virtio32_to_cpu(dev, vq->vring.desc[0].len));
+	desc = vq->indir_desc[0];
+	ut_asserteq_ptr(desc, (void *)(uintptr_t)virtio64_to_cpu(dev,
+						vq->vring.desc[0].addr));
+	ut_asserteq(VRING_DESC_F_NEXT, virtio16_to_cpu(dev, desc[0].flags));
+	ut_asserteq(VRING_DESC_F_NEXT | VRING_DESC_F_WRITE,
+		    virtio16_to_cpu(dev, desc[1].flags));
+	ut_asserteq(VRING_DESC_F_WRITE, virtio16_to_cpu(dev, desc[2].flags));
+	ut_asserteq_ptr(buf[2], (void *)(uintptr_t)virtio64_to_cpu(dev,
+						desc[2].addr));
+
+	/* four of them fill the ring */
+	for (i = 1; i < 4; i++)
+		ut_assertok(virtqueue_add(vq, sgs, 1, 2));
+	ut_asserteq(0, vq->num_free);
+	ut_asserteq(-ENOSPC, virtqueue_add(vq, sgs, 1, 2));
+
+	/* pretend the device has used the first one */
+	vq->vring.used->ring[0].id = cpu_to_virtio32(dev, 0);
+	vq->vring.used->ring[0].len = cpu_to_virtio32(dev, sizeof(buf[1]));
+	vq->vring.used->idx = cpu_to_virtio16(dev, 1);
+	ut_asserteq_ptr(buf[0], virtqueue_get_buf(vq, &len));
+	ut_asserteq(sizeof(buf[1]), len);
+	ut_asserteq(1, vq->num_free);
+	ut_assertnull(vq->indir_desc[0]);
+	ut_assertnull(virtqueue_get_buf(vq, &len));
+
+	ut_assertok(virtio_del_vqs(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_ring_indirect, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* Test of the virtio driver that does not have required driver ops */
 static int dm_test_virtio_missing_ops(struct unit_test_state *uts)
 {
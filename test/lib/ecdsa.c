@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for ecdsa_verify_hash()
+ */
+
+#include <common.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/ecdsa.h>
+
+/*
+ * openssl ecparam -name prime256v1 -genkey -noout -out key.pem
+ * openssl ec -in key.pem -pubout -outform der -out public.der
+ * openssl dgst -sha256 -sign key.pem -out sig.der msg
+ *
+ * The public key is the last 64 bytes of public.der and the signature is r
+ * and s from sig.der, each padded to 32 bytes.
+ */
+static const u8 p256_x[] = {
+	0x81, 0x99, 0x40, 0xf2, 0xed, 0x9a, 0xdb, 0x2e, 0x22, 0x88, 0xbd, 0xc3,
+	0xde, 0x78, 0x8a, 0x8f, 0xfe, 0x7c, 0x0d, 0x17, 0x9e, 0xc0, 0xc4, 0x26,
+	0x47, 0x38, 0x5a, 0xe2, 0x33, 0xad, 0xa8, 0xc7
+};
+
+static const u8 p256_y[] = {
+	0x9a, 0x61, 0x92, 0x0f, 0x63, 0xd0, 0xe8, 0x2a, 0x58, 0x28, 0xf4, 0xf4,
+	0x5f, 0xbd, 0x04, 0xab, 0x34, 0xf8, 0xb8, 0xbf, 0x95, 0x00, 0xdb, 0x48,
+	0xdb, 0xdf, 0x7d, 0xdd, 0x38, 0xdb, 0xa1, 0x9d
+};
+
+/* openssl dgst -sha256 -binary msg */
+static const u8 p256_hash[] = {
+	0xb8, 0xe7, 0x4c, 0x98, 0xe7, 0x4d, 0xb3, 0x3e, 0x07, 0x59, 0x76, 0x3d,
+	0x33, 0xef, 0xc0, 0x52, 0xac, 0xe2, 0xec, 0xe2, 0x0d, 0x97, 0x3b, 0x3a,
+	0x20, 0xbb, 0xed, 0xd2, 0xf0, 0x6f, 0x17, 0xa5
+};
+
+static const u8 p256_sig[] = {
+	0x34, 0x74, 0x98, 0xf9, 0xb5, 0xc3, 0x30, 0xb0, 0xb1, 0xb8, 0x17, 0xcc,
+	0x30, 0x01, 0xbc, 0x4b, 0xcb, 0xef, 0x46, 0x9a, 0x5b, 0x9a, 0x70, 0x3b,
+	0x86, 0x46, 0x2b, 0x9f, 0x93, 0x92, 0xe0, 0x5d, 0x88, 0x14, 0x65, 0x47,
+	0x68, 0xd2, 0x46, 0x3d, 0x12, 0x85, 0xdc, 0xd5, 0xb9, 0x05, 0xee, 0xc7,
+	0xa2, 0x3a, 0x1d, 0xb9, 0x02, 0x3d, 0xb7, 0x39, 0x14, 0xbb, 0xe1, 0x8c,
+	0x8c, 0x99, 0x37, 0xf0
+};
+
+/* As above, with secp384r1 and sha384 */
+static const u8 p384_x[] = {
+	0xdc, 0x64, 0x2f, 0xf2, 0x23, 0x53, 0x19, 0x8e, 0xfe, 0x11, 0xfb, 0x9f,
+	0xfd, 0x7a, 0xbd, 0xe4, 0x29, 0xf8, 0x75, 0x93, 0xdb, 0xc5, 0x03, 0x23,
+	0x6f, 0x95, 0xac, 0x9e, 0x11, 0x02, 0xe6, 0xdd, 0x09, 0x3c, 0xd2, 0x57,
+	0xee, 0x4c, 0x31, 0xfe, 0xb8, 0x7c, 0xe7, 0x3a, 0x8c, 0xc9, 0xa8, 0x05
+};
+
+static const u8 p384_y[] = {
+	0x9c, 0x0e, 0xa6, 0x18, 0xb0, 0x0c, 0xf3, 0xe0, 0x52, 0xe2, 0x84, 0x31,
+	0x9f, 0xb6, 0x6a, 0x5a, 0xdf, 0x12, 0x3b, 0x94, 0x3b, 0x57, 0x83, 0xb7,
+	0xc8, 0x2f, 0x46, 0x47, 0x1f, 0x27, 0x14, 0xa1, 0x3a, 0xde, 0x27, 0xb4,
+	0x3d, 0x10, 0x87, 0xdf, 0x45, 0xd3, 0x57, 0x81, 0x0b, 0xc7, 0x22, 0x27
+};
+
+static const u8 p384_hash[] = {
+	0x62, 0x8a, 0x1e, 0x19, 0xc3, 0xff, 0xfb, 0xec, 0x62, 0x64, 0x4e, 0xca,
+	0x36, 0xcc, 0x2f, 0xfa, 0x73, 0x82, 0x6c, 0x74, 0x34, 0xf3, 0x08, 0x57,
+	0x34, 0xc3, 0x9e, 0xf9, 0x7f, 0x43, 0x2b, 0x10, 0x2c, 0x71, 0xaa, 0x87,
+	0x36, 0xce, 0xbf, 0x90, 0xfc, 0x7d, 0xe2, 0x0d, 0xe6, 0x82, 0xba, 0x5d
+};
+
+static const u8 p384_sig[] = {
+	0xf2, 0x85, 0x5b, 0xba, 0x5f, 0x70, 0xba, 0x02, 0x3c, 0x39, 0x13, 0x37,
+	0xff, 0xc1, 0x8f, 0x40, 0x80, 0x3f, 0x1b, 0x84, 0x5b, 0x8b, 0xe5, 0xa1,
+	0xa2, 0x5c, 0xa1, 0x1d, 0x23, 0x6b, 0x7a, 0xfd, 0xc0, 0xfd, 0xba, 0xda,
+	0x77, 0x80, 0x59, 0x0b, 0x80, 0x05, 0x85, 0xfb, 0x4e, 0xbd, 0x4a, 0xe2,
+	0x1d, 0x41, 0x8b, 0xc9, 0x86, 0x56, 0x8c, 0x05, 0x89, 0xd7, 0x6a, 0xfc,
+	0x35, 0xdc, 0xc9, 0xf9, 0x38, 0x3d, 0x41, 0x0c, 0x31, 0xf9, 0x96, 0xbd,
+	0xd3, 0x63, 0xb8, 0x40, 0x58, 0x5d, 0xe8, 0xb7, 0xba, 0xb2, 0xa2, 0xce,
+	0xd4, 0xe9, 0x1e, 0x3b, 0x09, 0xe0, 0x33, 0x1f, 0xd4, 0x1e, 0x6f, 0x76
+};
+
+/**
+ * lib_ecdsa_check() - check a signature and some tampered copies of it
+ *
+ * @uts:	unit test state
+ * @curve:	name of the curve
+ * @x:		X coordinate of the public key
+ * @y:		Y coordinate of the public key
+ * @hash_in:	hash which was signed
+ * @sig_in:	signature, r followed by s
+ * @bytes:	curve size in bytes, which is also the hash size
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_ecdsa_check(struct unit_test_state *uts, const char *curve,
+			   const u8 *x, const u8 *y, const u8 *hash_in,
+			   const u8 *sig_in, uint bytes)
+{
+	u8 hash[ECDSA384_BYTES], sig[2 * ECDSA384_BYTES];
+
+	memcpy(hash, hash_in, bytes);
+	memcpy(sig, sig_in, 2 * bytes);
+	ut_assertok(ecdsa_verify_hash(curve, x, y, hash, bytes, sig,
+				      2 * bytes));
+
+	/* Tampered hash */
+	hash[bytes - 1] ^= 1;
+	ut_asserteq(-EACCES, ecdsa_verify_hash(curve, x, y, hash, bytes, sig,
+					       2 * bytes));
+	hash[bytes - 1] ^= 1;
+
+	/* Tampered r */
+	sig[0] ^= 0x10;
+	ut_asserteq(-EACCES, ecdsa_verify_hash(curve, x, y, hash, bytes, sig,
+					       2 * bytes));
+	sig[0] ^= 0x10;
+
+	/* Tampered s */
+	sig[2 * bytes - 1] ^= 1;
+	ut_asserteq(-EACCES, ecdsa_verify_hash(curve, x, y, hash, bytes, sig,
+					       2 * bytes));
+	sig[2 * bytes - 1] ^= 1;
+
+	/* r of zero is never valid */
+	memset(sig, '\0', bytes);
+	ut_asserteq(-EACCES, ecdsa_verify_hash(curve, x, y, hash, bytes, sig,
+					       2 * bytes));
+
+	/* Nor is a signature of the wrong length */
+	ut_asserteq(-EINVAL, ecdsa_verify_hash(curve, x, y, hash, bytes,
+					       sig_in, 2 * bytes - 1));
+
+	return 0;
+}
+
+/**
+ * lib_ecdsa_verify_p256() - unit test for ecdsa_verify_hash() with P-256
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_ecdsa_verify_p256(struct unit_test_state *uts)
+{
+	return lib_ecdsa_check(uts, "prime256v1", p256_x, p256_y, p256_hash,
+			       p256_sig, ECDSA256_BYTES);
+}
+LIB_TEST(lib_ecdsa_verify_p256, 0);
+
+/**
+ * lib_ecdsa_verify_p384() - unit test for ecdsa_verify_hash() with P-384
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_ecdsa_verify_p384(struct unit_test_state *uts)
+{
+	return lib_ecdsa_check(uts, "secp384r1", p384_x, p384_y, p384_hash,
+			       p384_sig, ECDSA384_BYTES);
+}
+LIB_TEST(lib_ecdsa_verify_p384, 0);
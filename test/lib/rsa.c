@@ -9,10 +9,14 @@
 #include <common.h>
 #include <command.h>
 #include <image.h>
+#include <log.h>
+#include <time.h>
+#include <asm/unaligned.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
 #include <u-boot/rsa.h>
+#include <u-boot/rsa-mod-exp.h>
 
 #ifdef CONFIG_RSA_VERIFY_WITH_PKEY
 /*
@@ -203,4 +207,295 @@ static int lib_rsa_verify_invalid(struct unit_test_state *uts)
 }
 
 LIB_TEST(lib_rsa_verify_invalid, 0);
+
+#ifdef CONFIG_RSA_SOFTWARE_EXP
+/* 64-bit public exponent, to exercise the windowed exponentiation */
+static const unsigned char long_exp[] = {
+	0xd6, 0xc1, 0xe8, 0xd9, 0xa3, 0xb5, 0xf4, 0xc7
+};
+
+/*
+ * data_enc ^ long_exp mod n, for the modulus n in public_key
+ * computed with python3 pow(data_enc, 0xd6c1e8d9a3b5f4c7, n)
+ */
+static const unsigned char data_dec_long_exp[] = {
+	0xa7, 0x69, 0x76, 0x03, 0xe0, 0x34, 0xc1, 0x28, 0xef, 0x4e, 0x8b, 0xb0,
+	0x28, 0x98, 0xbb, 0x09, 0x32, 0x52, 0xea, 0x97, 0xe7, 0xcb, 0x37, 0x5a,
+	0x53, 0xb0, 0x8b, 0xc7, 0x19, 0xac, 0x96, 0x00, 0xb7, 0x52, 0x7a, 0x35,
+	0x2b, 0xa6, 0xa8, 0xd8, 0x83, 0xd1, 0xb0, 0x38, 0x24, 0x09, 0xb6, 0x60,
+	0xe2, 0xad, 0x30, 0x97, 0x4f, 0x1b, 0xec, 0xeb, 0x81, 0xa0, 0x83, 0x6e,
+	0x16, 0x6a, 0x0b, 0x6f, 0x8f, 0x75, 0x69, 0x90, 0xae, 0x1b, 0xa3, 0x85,
+	0xd5, 0x0f, 0x03, 0x28, 0x19, 0xc9, 0x7c, 0xa2, 0x6e, 0xa7, 0x5e, 0x56,
+	0xd1, 0x22, 0xf5, 0x5e, 0x71, 0x6e, 0xd8, 0x4f, 0x90, 0x05, 0xab, 0x89,
+	0x7b, 0xb1, 0x52, 0xb1, 0x16, 0x7b, 0x0b, 0x56, 0x64, 0xf5, 0x88, 0x56,
+	0x54, 0x53, 0x0f, 0x64, 0x21, 0x82, 0xfa, 0x2a, 0xe2, 0x9d, 0x6d, 0x08,
+	0x2a, 0x0e, 0x88, 0x8f, 0x37, 0x4a, 0x0c, 0x27, 0x4a, 0x29, 0xe6, 0xc7,
+	0xfe, 0x71, 0x1e, 0xb8, 0xbe, 0x4a, 0x9a, 0x05, 0x76, 0x6a, 0x11, 0x70,
+	0xc5, 0x1d, 0x76, 0x36, 0x72, 0xdc, 0x4f, 0x8b, 0x1f, 0x20, 0xa1, 0xed,
+	0x86, 0xc0, 0x08, 0x22, 0x2b, 0x66, 0xbc, 0xc1, 0x0d, 0xf4, 0xe4, 0xfc,
+	0xc4, 0x06, 0xf5, 0xd7, 0x47, 0xa1, 0x70, 0x63, 0xfb, 0xec, 0x23, 0xb2,
+	0x10, 0xa5, 0xd6, 0x17, 0x60, 0x8f, 0x59, 0x18, 0xed, 0xa3, 0xe5, 0x1a,
+	0x09, 0x86, 0xd9, 0x6d, 0x94, 0xaa, 0x54, 0x90, 0xb2, 0x1a, 0x02, 0x55,
+	0x16, 0x66, 0x02, 0x94, 0xf1, 0x02, 0xdf, 0x55, 0xda, 0xea, 0x4a, 0x3c,
+	0x25, 0x63, 0x56, 0x8e, 0x7e, 0x75, 0xe5, 0x66, 0x12, 0xe1, 0x4f, 0x06,
+	0x7a, 0x65, 0x2d, 0xf1, 0x1c, 0x3e, 0x6b, 0xbb, 0x0c, 0xc2, 0xfb, 0x49,
+	0x48, 0x63, 0x0e, 0x0d, 0x4d, 0xce, 0x1e, 0x7f, 0x38, 0xc9, 0x0f, 0xf9,
+	0x21, 0x20, 0x3d, 0x8b
+};
+
+/**
+ * lib_rsa_mod_exp() - unit test for rsa_mod_exp_sw()
+ *
+ * Test rsa_mod_exp_sw() with the default and a 64-bit public exponent
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_rsa_mod_exp(struct unit_test_state *uts)
+{
+	static const unsigned char pkcs_prefix[] = { 0x00, 0x01, 0xff, 0xff };
+	struct key_prop *prop;
+	unsigned char out[256];
+
+	ut_assertok(rsa_gen_key_prop(public_key, public_key_len, &prop));
+
+	ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	ut_asserteq_mem(pkcs_prefix, out, sizeof(pkcs_prefix));
+
+	memcpy((void *)prop->public_exponent, long_exp, sizeof(long_exp));
+	prop->exp_len = sizeof(long_exp);
+	ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	ut_asserteq_mem(data_dec_long_exp, out, sizeof(out));
+
+	rsa_free_key_prop(prop);
+
+	return CMD_RET_SUCCESS;
+}
+
+LIB_TEST(lib_rsa_mod_exp, 0);
+
+#define TEST_RSA_LOOPS	100
+
+/* Subtract the modulus n from num, both little endian word arrays */
+static void test_rsa_sub(uint len, const u32 *n, u32 *num)
+{
+	s64 acc = 0;
+	uint i;
+
+	for (i = 0; i < len; i++) {
+		acc += (u64)num[i] - n[i];
+		num[i] = (u32)acc;
+		acc >>= 32;
+	}
+}
+
+/* Montgomery multiplication one 32-bit word at a time: result = a * b / R */
+static void test_rsa_mont_mul(uint len, u32 n0inv, const u32 *n, u32 *result,
+			      const u32 *a, const u32 *b)
+{
+	u64 acc_a, acc_b;
+	uint i, j;
+	u32 d0;
+
+	memset(result, '\0', len * sizeof(u32));
+	for (j = 0; j < len; j++) {
+		acc_a = (u64)a[j] * b[0] + result[0];
+		d0 = (u32)acc_a * n0inv;
+		acc_b = (u64)d0 * n[0] + (u32)acc_a;
+		for (i = 1; i < len; i++) {
+			acc_a = (acc_a >> 32) + (u64)a[j] * b[i] + result[i];
+			acc_b = (acc_b >> 32) + (u64)d0 * n[i] + (u32)acc_a;
+			result[i - 1] = (u32)acc_b;
+		}
+		acc_a = (acc_a >> 32) + (acc_b >> 32);
+		result[i - 1] = (u32)acc_a;
+		if (acc_a >> 32)
+			test_rsa_sub(len, n, result);
+	}
+}
+
+/*
+ * Raise a value to the power 65537 in the way rsa_mod_exp_sw() did before it
+ * used word-sized limbs, as a reference for lib_rsa_mod_exp_bench()
+ */
+static void test_rsa_pow_mod_ref(uint len, u32 n0inv, const u32 *n,
+				 const u32 *rr, const u32 *val, u32 *result)
+{
+	u32 acc[len], tmp[len];
+	int i;
+
+	test_rsa_mont_mul(len, n0inv, n, acc, val, rr);
+	for (i = 0; i < 16; i += 2) {
+		test_rsa_mont_mul(len, n0inv, n, tmp, acc, acc);
+		test_rsa_mont_mul(len, n0inv, n, acc, tmp, tmp);
+	}
+	test_rsa_mont_mul(len, n0inv, n, result, acc, val);
+	for (i = len - 1; i >= 0 && result[i] == n[i]; i--)
+		;
+	if (i < 0 || result[i] > n[i])
+		test_rsa_sub(len, n, result);
+}
+
+/* Convert a big endian byte array to a little endian word array */
+static void test_rsa_to_words(u32 *dst, const void *src, uint len)
+{
+	uint i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = get_unaligned_be32(src + (len - 1 - i) * 4);
+}
+
+/**
+ * lib_rsa_mod_exp_bench() - compare rsa_mod_exp_sw() with 32-bit Montgomery
+ *
+ * Time rsa_mod_exp_sw() against the word-at-a-time implementation it
+ * replaced, for the 2048-bit key and exponent 65537
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_rsa_mod_exp_bench(struct unit_test_state *uts)
+{
+	const uint len = data_enc_len / 4;
+	u32 n[len], rr[len], val[len], ref[len];
+	ulong start, before, after;
+	struct key_prop *prop;
+	unsigned char out[256];
+	int i;
+
+	ut_assertok(rsa_gen_key_prop(public_key, public_key_len, &prop));
+	ut_asserteq(data_enc_len * 8, prop->num_bits);
+	test_rsa_to_words(n, prop->modulus, len);
+	test_rsa_to_words(rr, prop->rr, len);
+	test_rsa_to_words(val, data_enc, len);
+
+	start = timer_get_us();
+	for (i = 0; i < TEST_RSA_LOOPS; i++)
+		test_rsa_pow_mod_ref(len, prop->n0inv, n, rr, val, ref);
+	before = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < TEST_RSA_LOOPS; i++)
+		ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	after = timer_get_us() - start;
+
+	for (i = 0; i < len; i++)
+		ut_asserteq(ref[len - 1 - i], get_unaligned_be32(out + i * 4));
+	rsa_free_key_prop(prop);
+
+	log_debug("%u-bit key, %d runs: %lu us word-at-a-time, %lu us now\n",
+		  data_enc_len * 8, TEST_RSA_LOOPS, before, after);
+
+	return CMD_RET_SUCCESS;
+}
+
+LIB_TEST(lib_rsa_mod_exp_bench, 0);
+
+/*
+ * 2080-bit modulus, which is an odd number of 32-bit words, with its R^2 and
+ * 2 ^ 65537 mod n computed with python3
+ */
+static const unsigned char odd_modulus[] = {
+	0xa3, 0x74, 0xa1, 0xc2, 0xef, 0xa2, 0xc5, 0x30, 0xa9, 0xd9, 0x54, 0x85,
+	0xef, 0x01, 0x5e, 0xa3, 0x28, 0xd1, 0x9b, 0x14, 0xfa, 0x21, 0x9e, 0x1d,
+	0xda, 0x15, 0xe8, 0x9a, 0x92, 0xa3, 0xa9, 0x5a, 0x79, 0x93, 0x6e, 0x99,
+	0xcc, 0xde, 0x69, 0xa3, 0x6b, 0x53, 0x57, 0xb0, 0x38, 0x51, 0x3b, 0xd8,
+	0x1c, 0xbd, 0x15, 0x0f, 0x4b, 0x46, 0x04, 0x6a, 0xbc, 0x86, 0x95, 0xdc,
+	0x53, 0xc7, 0xc7, 0xa8, 0x98, 0x98, 0xf3, 0x65, 0xb0, 0x55, 0x39, 0x65,
+	0xb6, 0xe1, 0xa3, 0xf2, 0xeb, 0xf4, 0x6a, 0x78, 0x8c, 0x54, 0xa2, 0x8c,
+	0x72, 0x73, 0x7e, 0x0f, 0xc4, 0x31, 0x73, 0x87, 0x06, 0x58, 0xc2, 0x3c,
+	0x54, 0xff, 0xfa, 0x2e, 0x10, 0x70, 0xae, 0x2b, 0xe8, 0x83, 0x7a, 0x7b,
+	0x4a, 0x23, 0x67, 0xe3, 0x35, 0xde, 0x3d, 0x9b, 0xc4, 0x37, 0x6d, 0x49,
+	0x02, 0xf9, 0x93, 0x61, 0xa5, 0x16, 0xb8, 0xe6, 0x5f, 0xdf, 0x63, 0xc5,
+	0xf9, 0xc4, 0x3f, 0x5e, 0x6b, 0x97, 0xbf, 0x70, 0x2c, 0x6a, 0x73, 0x9e,
+	0x23, 0x9a, 0x7c, 0x17, 0x42, 0x3d, 0xa2, 0x9c, 0xb7, 0x5a, 0x3b, 0x6a,
+	0x50, 0xb9, 0xcf, 0xf1, 0x88, 0x8b, 0x62, 0xf7, 0x92, 0x72, 0xc7, 0x3a,
+	0x33, 0xef, 0x0b, 0x53, 0x68, 0x92, 0x61, 0xbb, 0x69, 0x53, 0x12, 0x89,
+	0xf2, 0xef, 0x09, 0xae, 0x34, 0x32, 0xdd, 0xb8, 0x4a, 0x7f, 0x8e, 0xe0,
+	0x23, 0xe3, 0xdc, 0x94, 0x3b, 0x29, 0x1c, 0xef, 0xa3, 0x8c, 0xd6, 0x3c,
+	0xca, 0x71, 0x89, 0x3a, 0xac, 0x2a, 0x40, 0x55, 0x76, 0xec, 0x69, 0x7c,
+	0x9a, 0x51, 0x7c, 0xa8, 0x91, 0x83, 0xae, 0x54, 0x6f, 0x77, 0xfc, 0x84,
+	0x2a, 0xe5, 0x54, 0x0e, 0x50, 0x3f, 0x0c, 0xa3, 0x7b, 0x2f, 0xe2, 0xaf,
+	0x97, 0x30, 0x05, 0x37, 0xc1, 0x15, 0x46, 0x16, 0x6a, 0xf2, 0x65, 0x8d,
+	0x67, 0xf0, 0x16, 0x11, 0x0a, 0x76, 0xfb, 0xb9
+};
+
+static const unsigned char odd_rr[] = {
+	0x32, 0x71, 0xb0, 0xd8, 0xa6, 0xae, 0xc0, 0x9d, 0x2f, 0x2e, 0x9b, 0xf7,
+	0xdd, 0x1c, 0x3d, 0xe3, 0x9c, 0xeb, 0x61, 0x4d, 0xdc, 0x88, 0x3c, 0x22,
+	0x90, 0xe6, 0xe9, 0x9a, 0xc9, 0xba, 0xe4, 0x9b, 0xdd, 0x00, 0x59, 0xc2,
+	0x57, 0x12, 0xeb, 0x68, 0x22, 0xbd, 0xa3, 0xbb, 0xcb, 0xe6, 0xa0, 0xda,
+	0x89, 0xdf, 0x3e, 0xc7, 0xca, 0xa4, 0x89, 0x90, 0x22, 0xe7, 0x7e, 0xaf,
+	0x04, 0x7e, 0x1b, 0x93, 0xbc, 0x40, 0x05, 0x2d, 0x66, 0x77, 0xb7, 0x87,
+	0x24, 0xed, 0xba, 0x15, 0x65, 0x3f, 0xab, 0xdf, 0xb4, 0xb2, 0x68, 0x46,
+	0x0a, 0x79, 0xf7, 0xa3, 0x74, 0xab, 0x94, 0x9a, 0xed, 0xe9, 0xc0, 0x8a,
+	0xf9, 0x7e, 0xf2, 0x30, 0x71, 0x84, 0xe3, 0xf6, 0x4b, 0x0a, 0xd7, 0x6b,
+	0x2a, 0xdf, 0x72, 0xc6, 0xa5, 0xd6, 0x7b, 0x99, 0x77, 0x51, 0x6d, 0x5c,
+	0xd3, 0x5c, 0x7c, 0x28, 0x23, 0x5e, 0xae, 0x66, 0x96, 0xbb, 0xe4, 0x92,
+	0xa7, 0x35, 0x83, 0x05, 0x99, 0x53, 0xf4, 0x6c, 0xb4, 0xa6, 0xb1, 0x69,
+	0x42, 0xdf, 0xb6, 0x86, 0x58, 0xc1, 0xdd, 0x34, 0x2c, 0xb3, 0xf6, 0xbe,
+	0xda, 0x9b, 0x67, 0xe7, 0x89, 0x44, 0x07, 0x5d, 0x5a, 0x98, 0x86, 0x0f,
+	0xa2, 0xb1, 0xd6, 0xbd, 0x59, 0x8f, 0x6c, 0x3f, 0x29, 0xea, 0x24, 0x99,
+	0x23, 0x07, 0x51, 0x1d, 0xf2, 0x91, 0x8d, 0xfc, 0x84, 0x23, 0x4a, 0x82,
+	0xc6, 0x98, 0xe7, 0x94, 0x5d, 0xb1, 0xfc, 0x7c, 0x77, 0x50, 0x3b, 0x61,
+	0xb3, 0xf5, 0xf6, 0xa7, 0x4c, 0xf0, 0xa8, 0x3f, 0xc5, 0x25, 0xee, 0x05,
+	0x14, 0x14, 0xa5, 0xd0, 0xcb, 0x48, 0x8d, 0x53, 0xf5, 0x97, 0x2d, 0xfc,
+	0x0a, 0x40, 0x59, 0xeb, 0x00, 0x19, 0x21, 0x94, 0x8d, 0xcb, 0xac, 0xc1,
+	0x0b, 0x04, 0x46, 0xbf, 0x96, 0xf3, 0x1a, 0x87, 0x71, 0x55, 0x2c, 0x7f,
+	0xbc, 0xb1, 0xa2, 0x10, 0x49, 0xa3, 0xcf, 0xbf
+};
+
+static const unsigned char odd_data_dec[] = {
+	0x91, 0xc2, 0x0f, 0xd2, 0xec, 0xac, 0xf7, 0x66, 0x42, 0xe3, 0x37, 0x64,
+	0x20, 0xf2, 0x86, 0xff, 0x02, 0xb2, 0x69, 0x22, 0xcc, 0xf1, 0x91, 0xc5,
+	0xe9, 0x83, 0xf6, 0xf6, 0xf2, 0xec, 0x51, 0xfc, 0xa4, 0xd4, 0xdf, 0x84,
+	0x19, 0xec, 0x24, 0x2c, 0x40, 0x20, 0x43, 0xbd, 0xb6, 0x8f, 0x99, 0x5f,
+	0xf3, 0xb1, 0xad, 0x40, 0x65, 0x0c, 0xd5, 0xcb, 0xa5, 0xa7, 0xe9, 0x55,
+	0x5e, 0xa4, 0x95, 0x21, 0xdc, 0x0b, 0x70, 0xfb, 0xfe, 0x77, 0x4b, 0x72,
+	0x6f, 0xdc, 0xe3, 0xea, 0x6e, 0xda, 0x4e, 0xb1, 0x4c, 0x49, 0x92, 0x8a,
+	0xcd, 0x36, 0xe1, 0x94, 0xb5, 0x6d, 0x98, 0x53, 0x99, 0xee, 0xbd, 0xf7,
+	0xef, 0xe3, 0xb2, 0x66, 0xfa, 0x57, 0x14, 0xe8, 0x5f, 0xc3, 0xb9, 0x5c,
+	0xc8, 0xe0, 0xf0, 0xd8, 0x9b, 0xd6, 0x32, 0xc8, 0x7e, 0xad, 0x66, 0x22,
+	0xa4, 0xc0, 0xba, 0x68, 0x4c, 0xb9, 0xbb, 0x14, 0x7a, 0x60, 0xde, 0x76,
+	0x3e, 0xab, 0x19, 0x6a, 0x37, 0x18, 0x02, 0x7c, 0x14, 0x2f, 0x38, 0x28,
+	0xd9, 0x49, 0x77, 0xcf, 0xf0, 0xe6, 0x4a, 0x57, 0x9d, 0xff, 0xef, 0xa0,
+	0xeb, 0xf1, 0x88, 0xb1, 0xc9, 0xf9, 0xba, 0x53, 0x43, 0x54, 0xdd, 0x8e,
+	0xb0, 0x1d, 0xcf, 0xc3, 0x29, 0x89, 0x66, 0x2e, 0x56, 0x39, 0x86, 0x54,
+	0x12, 0xbc, 0xf8, 0xe7, 0x8e, 0x56, 0x18, 0x82, 0x9c, 0xb2, 0xfb, 0xe6,
+	0x48, 0xb6, 0x44, 0x40, 0xde, 0xd5, 0x3a, 0x71, 0x5f, 0xdc, 0x3d, 0x03,
+	0x35, 0x45, 0x57, 0x29, 0x84, 0xcf, 0xa3, 0x54, 0xbc, 0xe0, 0xbd, 0x87,
+	0x69, 0x0f, 0x2d, 0x9d, 0x1a, 0x12, 0xce, 0x63, 0x9e, 0x87, 0x3d, 0xe3,
+	0x83, 0x17, 0x5e, 0x6f, 0x18, 0xd4, 0xfa, 0x80, 0x93, 0xad, 0x9a, 0x78,
+	0x8a, 0xfc, 0x12, 0x69, 0x86, 0xb2, 0x4d, 0x6f, 0xab, 0x34, 0xf8, 0x15,
+	0x1d, 0x4f, 0x27, 0xf7, 0x91, 0xdd, 0xb4, 0x48
+};
+
+/**
+ * lib_rsa_mod_exp_odd() - unit test for rsa_mod_exp_sw() with an odd key size
+ *
+ * Test rsa_mod_exp_sw() with a modulus which does not fill the last limb
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_rsa_mod_exp_odd(struct unit_test_state *uts)
+{
+	struct key_prop prop = {
+		.rr = odd_rr,
+		.modulus = odd_modulus,
+		.n0inv = 0xc6e96577,
+		.num_bits = sizeof(odd_modulus) * 8,
+	};
+	unsigned char in[sizeof(odd_modulus)], out[sizeof(odd_modulus)];
+
+	memset(in, '\0', sizeof(in));
+	in[sizeof(in) - 1] = 2;
+	ut_assertok(rsa_mod_exp_sw(in, sizeof(in), &prop, out));
+	ut_asserteq_mem(odd_data_dec, out, sizeof(out));
+
+	return CMD_RET_SUCCESS;
+}
+
+LIB_TEST(lib_rsa_mod_exp_odd, 0);
+#endif /* RSA_SOFTWARE_EXP */
 #endif /* RSA_VERIFY_WITH_PKEY */
@@ -12,6 +12,7 @@
 #include <common.h>
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -193,3 +194,85 @@ static int lib_memmove(struct unit_test_state *uts)
 }
 
 LIB_TEST(lib_memmove, 0);
+
+/* Region length used to reach the block loops and DC ZVA style clearing */
+#define LONGLEN 2048
+
+/**
+ * lib_memmove_long() - unit test for long memset(), memcpy() and memmove()
+ *
+ * The tests above only cover regions of up to 32 bytes. Check longer regions
+ * with varied alignment against a byte by byte reference, including
+ * overlapping moves in both directions.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_memmove_long(struct unit_test_state *uts)
+{
+	static const int lens[] = { 63, 64, 65, 255, 256, 257, 1000,
+				    LONGLEN - SWEEP };
+	int buflen = 2 * LONGLEN;
+	u8 *buf, *ref;
+	unsigned int i;
+	int j, offset1, offset2, len;
+
+	buf = malloc(buflen);
+	ref = malloc(buflen);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(ref);
+
+	for (i = 0; i < ARRAY_SIZE(lens); ++i) {
+		len = lens[i];
+		for (offset1 = 0; offset1 <= SWEEP; ++offset1) {
+			for (j = 0; j < buflen; ++j)
+				buf[j] = ref[j] = j * 7 + 3;
+			ut_asserteq_ptr(buf + offset1,
+					memset(buf + offset1, 0, len));
+			for (j = 0; j < len; ++j)
+				ref[offset1 + j] = 0;
+			ut_asserteq_mem(ref, buf, buflen);
+			memset(buf + offset1, MASK, len);
+			for (j = 0; j < len; ++j)
+				ref[offset1 + j] = MASK;
+			ut_asserteq_mem(ref, buf, buflen);
+
+			for (offset2 = 0; offset2 <= SWEEP; ++offset2) {
+				for (j = 0; j < buflen; ++j)
+					buf[j] = ref[j] = j * 7 + 3;
+				ut_asserteq_ptr(buf + LONGLEN + offset2,
+						memcpy(buf + LONGLEN + offset2,
+						       buf + offset1, len));
+				for (j = 0; j < len; ++j)
+					ref[LONGLEN + offset2 + j] =
+						ref[offset1 + j];
+				ut_asserteq_mem(ref, buf, buflen);
+
+				/* overlapping, destination above source */
+				ut_asserteq_ptr(buf + offset1 + offset2 + 1,
+						memmove(buf + offset1 + offset2 + 1,
+							buf + offset1, len));
+				for (j = len - 1; j >= 0; --j)
+					ref[offset1 + offset2 + 1 + j] =
+						ref[offset1 + j];
+				ut_asserteq_mem(ref, buf, buflen);
+
+				/* overlapping, destination below source */
+				ut_asserteq_ptr(buf + offset1,
+						memmove(buf + offset1,
+							buf + offset1 + offset2 + 1,
+							len));
+				for (j = 0; j < len; ++j)
+					ref[offset1 + j] =
+						ref[offset1 + offset2 + 1 + j];
+				ut_asserteq_mem(ref, buf, buflen);
+			}
+		}
+	}
+	free(ref);
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_memmove_long, 0);
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and a benchmark for the CRC-32 and CRC-32C functions
+ *
+ * These may use lookup tables several bytes at a time or CPU instructions,
+ * so check them against a plain bit-at-a-time version over all alignments
+ * and report how fast they are.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define CRC32_POLY_LE	0xedb88320
+#define CRC32C_POLY_LE	0x82f63b78
+
+/* Size of the buffer used for the benchmark */
+#define TEST_CRC_SIZE	(1 << 20)
+
+static const char test_crc_check[] = "123456789";
+
+/* Reference CRC without the ones' complement, one bit at a time */
+static u32 test_crc_bitwise(u32 crc, const u8 *p, uint len, u32 poly)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+	}
+
+	return crc;
+}
+
+static u8 *test_crc_buf(void)
+{
+	u8 *buf;
+	int i;
+
+	buf = malloc(TEST_CRC_SIZE);
+	if (!buf)
+		return NULL;
+	for (i = 0; i < TEST_CRC_SIZE; i++)
+		buf[i] = rand() & 0xff;
+
+	return buf;
+}
+
+static void test_crc_report(const char *name, ulong us)
+{
+	log_debug("%s: %lu us for %u bytes, %lu KiB/s\n", name, us,
+		  TEST_CRC_SIZE,
+		  us ? (TEST_CRC_SIZE / 1024) * 1000000UL / us : 0);
+}
+
+static int lib_test_crc32(struct unit_test_state *uts)
+{
+	ulong start, us;
+	uint ofs, len;
+	u8 *buf;
+
+	ut_asserteq(0xcbf43926, crc32(0, (const u8 *)test_crc_check,
+				      strlen(test_crc_check)));
+
+	buf = test_crc_buf();
+	ut_assertnonnull(buf);
+
+	/* Every alignment, with lengths around the word and table sizes */
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len < 70; len++) {
+			ut_asserteq(test_crc_bitwise(~0, buf + ofs, len,
+						     CRC32_POLY_LE),
+				    crc32_no_comp(~0, buf + ofs, len));
+		}
+	}
+	ut_asserteq(test_crc_bitwise(0, buf + 3, 4093, CRC32_POLY_LE),
+		    crc32_no_comp(0, buf + 3, 4093));
+
+	start = timer_get_us();
+	crc32(0, buf, TEST_CRC_SIZE);
+	us = timer_get_us() - start;
+	test_crc_report("crc32", us);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32, 0);
+
+#ifdef CONFIG_CRC32C
+static int lib_test_crc32c(struct unit_test_state *uts)
+{
+	u32 *table;
+	ulong start, us;
+	uint ofs, len;
+	u8 *buf;
+
+	table = malloc(256 * sizeof(*table));
+	ut_assertnonnull(table);
+	crc32c_init(table, CRC32C_POLY_LE);
+
+	ut_asserteq(0xe3069283, ~crc32c_cal(~0, test_crc_check,
+					    strlen(test_crc_check), table));
+
+	buf = test_crc_buf();
+	ut_assertnonnull(buf);
+
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len < 70; len++) {
+			ut_asserteq(test_crc_bitwise(~0, buf + ofs, len,
+						     CRC32C_POLY_LE),
+				    crc32c_cal(~0, (char *)buf + ofs, len,
+					       table));
+		}
+	}
+
+	start = timer_get_us();
+	crc32c_cal(~0, (char *)buf, TEST_CRC_SIZE, table);
+	us = timer_get_us() - start;
+	test_crc_report("crc32c", us);
+	free(buf);
+	free(table);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32c, 0);
+#endif
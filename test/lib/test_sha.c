@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and a benchmark for the SHA-1 and SHA-256 functions
+ *
+ * The block functions may be provided by the architecture, e.g. using the
+ * ARMv8 Crypto Extensions, so check them against the generic C code and
+ * report how fast each one is.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the test buffer and of the blocks hashed from it, one byte in */
+#define TEST_SHA_SIZE		(1 << 20)
+#define TEST_SHA_BLOCKS		(TEST_SHA_SIZE / 64 - 1)
+
+static const char test_sha_abc[] = "abc";
+static const char test_sha_two_blocks[] =
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmjklmnklmnolmnopmnopqnopq";
+
+static u8 *test_sha_buf(void)
+{
+	u8 *buf;
+	int i;
+
+	buf = malloc(TEST_SHA_SIZE);
+	if (!buf)
+		return NULL;
+	for (i = 0; i < TEST_SHA_SIZE; i++)
+		buf[i] = rand() & 0xff;
+
+	return buf;
+}
+
+/* Show the speed for hashing TEST_SHA_BLOCKS blocks in 'us' microseconds */
+static void test_sha_report(const char *name, const char *impl, ulong us)
+{
+	ulong len = TEST_SHA_BLOCKS * 64;
+
+	log_debug("%s %s: %lu us for %lu bytes, %lu KiB/s\n", name, impl, us,
+		  len, us ? len / 1024 * 1000000UL / us : 0);
+}
+
+#ifdef CONFIG_SHA1
+static int lib_test_sha1(struct unit_test_state *uts)
+{
+	const u8 abc[SHA1_SUM_LEN] = {
+		0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+		0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d,
+	};
+	const u8 two_blocks[SHA1_SUM_LEN] = {
+		0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+		0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1,
+	};
+	sha1_context ctx, ref;
+	u8 sum[SHA1_SUM_LEN];
+	ulong start, generic, selected;
+	u8 *buf;
+
+	sha1_csum((const u8 *)test_sha_abc, strlen(test_sha_abc), sum);
+	ut_asserteq_mem(abc, sum, SHA1_SUM_LEN);
+	sha1_csum((const u8 *)test_sha_two_blocks,
+		  strlen(test_sha_two_blocks), sum);
+	ut_asserteq_mem(two_blocks, sum, SHA1_SUM_LEN);
+
+	buf = test_sha_buf();
+	ut_assertnonnull(buf);
+
+	/* Use an unaligned buffer, as the callers do not align theirs */
+	sha1_starts(&ref);
+	start = timer_get_us();
+	sha1_process_generic(&ref, buf + 1, TEST_SHA_BLOCKS);
+	generic = timer_get_us() - start;
+
+	sha1_starts(&ctx);
+	start = timer_get_us();
+	sha1_process(&ctx, buf + 1, TEST_SHA_BLOCKS);
+	selected = timer_get_us() - start;
+	ut_asserteq_mem(ref.state, ctx.state, sizeof(ctx.state));
+
+	test_sha_report("sha1", "generic", generic);
+	test_sha_report("sha1", "selected", selected);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha1, 0);
+#endif
+
+#ifdef CONFIG_SHA256
+static int lib_test_sha256(struct unit_test_state *uts)
+{
+	const u8 abc[SHA256_SUM_LEN] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+	};
+	const u8 two_blocks[SHA256_SUM_LEN] = {
+		0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+		0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+		0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+		0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+	};
+	sha256_context ctx, ref;
+	u8 sum[SHA256_SUM_LEN];
+	ulong start, generic, selected;
+	u8 *buf;
+
+	sha256_csum_wd((const u8 *)test_sha_abc, strlen(test_sha_abc), sum,
+		       CHUNKSZ_SHA256);
+	ut_asserteq_mem(abc, sum, SHA256_SUM_LEN);
+	sha256_csum_wd((const u8 *)test_sha_two_blocks,
+		       strlen(test_sha_two_blocks), sum, CHUNKSZ_SHA256);
+	ut_asserteq_mem(two_blocks, sum, SHA256_SUM_LEN);
+
+	buf = test_sha_buf();
+	ut_assertnonnull(buf);
+
+	/* Use an unaligned buffer, as the callers do not align theirs */
+	sha256_starts(&ref);
+	start = timer_get_us();
+	sha256_process_generic(&ref, buf + 1, TEST_SHA_BLOCKS);
+	generic = timer_get_us() - start;
+
+	sha256_starts(&ctx);
+	start = timer_get_us();
+	sha256_process(&ctx, buf + 1, TEST_SHA_BLOCKS);
+	selected = timer_get_us() - start;
+	ut_asserteq_mem(ref.state, ctx.state, sizeof(ctx.state));
+
+	test_sha_report("sha256", "generic", generic);
+	test_sha_report("sha256", "selected", selected);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256, 0);
+#endif
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests and a benchmark for running jobs on secondary CPUs
+ *
+ * On sandbox each CPU is a host thread, so this shows how much faster
+ * independent hashing gets and checks that the results do not depend on
+ * which CPU ran which job.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <work_queue.h>
+#include <u-boot/sha256.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Number of jobs and the size of the buffer each one hashes */
+#define TEST_WQ_JOBS		12
+#define TEST_WQ_SIZE		(1 << 19)
+
+struct test_wq_hash {
+	const u8 *buf;
+	u8 sum[SHA256_SUM_LEN];
+};
+
+static int test_wq_hash_job(void *arg)
+{
+	struct test_wq_hash *hash = arg;
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, hash->buf, TEST_WQ_SIZE);
+	sha256_finish(&ctx, hash->sum);
+
+	return 0;
+}
+
+static void test_wq_setup(struct wq_job *jobs, struct test_wq_hash *hashes,
+			  const u8 *buf)
+{
+	int i;
+
+	for (i = 0; i < TEST_WQ_JOBS; i++) {
+		memset(&hashes[i], '\0', sizeof(hashes[i]));
+		hashes[i].buf = buf + i * TEST_WQ_SIZE;
+		jobs[i].func = test_wq_hash_job;
+		jobs[i].arg = &hashes[i];
+		jobs[i].ret = -1;
+	}
+}
+
+static int lib_test_wq_hash(struct unit_test_state *uts)
+{
+	struct test_wq_hash ref[TEST_WQ_JOBS], hashes[TEST_WQ_JOBS];
+	struct wq_job jobs[TEST_WQ_JOBS];
+	ulong start, serial, parallel;
+	int i, pass;
+	u8 *buf;
+
+	buf = malloc(TEST_WQ_JOBS * TEST_WQ_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < TEST_WQ_JOBS * TEST_WQ_SIZE; i++)
+		buf[i] = rand() & 0xff;
+
+	test_wq_setup(jobs, ref, buf);
+	start = timer_get_us();
+	for (i = 0; i < TEST_WQ_JOBS; i++)
+		ut_assertok(test_wq_hash_job(&ref[i]));
+	serial = timer_get_us() - start;
+
+	/* Each run must give the same answers, whichever CPU did the work */
+	for (pass = 0; pass < 3; pass++) {
+		test_wq_setup(jobs, hashes, buf);
+		start = timer_get_us();
+		ut_assertok(wq_run(jobs, TEST_WQ_JOBS));
+		parallel = timer_get_us() - start;
+		for (i = 0; i < TEST_WQ_JOBS; i++) {
+			ut_assertok(jobs[i].ret);
+			ut_asserteq_mem(ref[i].sum, hashes[i].sum,
+					SHA256_SUM_LEN);
+		}
+	}
+
+	log_debug("%d CPUs: %lu us serial, %lu us parallel, speed-up x%lu.%02lu\n",
+		  wq_cpu_count(), serial, parallel,
+		  parallel ? serial / parallel : 0,
+		  parallel ? serial * 100 / parallel % 100 : 0);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_wq_hash, 0);
+
+static int test_wq_fail_job(void *arg)
+{
+	return (long)arg;
+}
+
+/* Every job runs even if some fail, and the first failure is returned */
+static int lib_test_wq_fail(struct unit_test_state *uts)
+{
+	struct wq_job jobs[TEST_WQ_JOBS];
+	int i;
+
+	for (i = 0; i < TEST_WQ_JOBS; i++) {
+		jobs[i].func = test_wq_fail_job;
+		jobs[i].arg = (void *)(long)(i == 5 || i == 9 ? -i : 0);
+		jobs[i].ret = 1;
+	}
+	ut_asserteq(-5, wq_run(jobs, TEST_WQ_JOBS));
+	for (i = 0; i < TEST_WQ_JOBS; i++)
+		ut_asserteq(i == 5 || i == 9 ? -i : 0, jobs[i].ret);
+
+	/* Nothing to do */
+	ut_assertok(wq_run(jobs, 0));
+
+	return 0;
+}
+LIB_TEST(lib_test_wq_fail, 0);
@@ -25,6 +25,7 @@ base_its = '''
                         compression = "%(compression)s";
                         load = <0x40000>;
                         entry = <0x8>;
+                        %(kernel_hash)s
                 };
                 kernel@2 {
                         data = /incbin/("%(loadables1)s");
@@ -338,6 +339,7 @@ def test_fit(u_boot_console):
             'kernel_out' : kernel_out,
             'kernel_addr' : 0x40000,
             'kernel_size' : filesize(kernel),
+            'kernel_hash' : '',
 
             'fdt' : fdt,
             'fdt_out' : fdt_out,
@@ -432,6 +434,31 @@ def test_fit(u_boot_console):
             check_equal(loadables2, loadables2_out,
                         'Loadables2 (ramdisk) not loaded')
 
+        # Kernel with a hash table covering 1KB chunks
+        with cons.log.section('Kernel with chunked hash'):
+            params['kernel_hash'] = ('hash-1 { algo = "sha256"; '
+                                     'chunk-size = <0x400>; };')
+            fit = make_fit(mkimage, params)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            check_equal(kernel, kernel_out, 'Kernel not loaded')
+
+            # Corrupt the last chunk of the kernel, which must be noticed
+            data = bytearray(read_file(fit))
+            kernel_data = read_file(kernel)
+            pos = data.find(kernel_data) + len(kernel_data) - 10
+            data[pos] ^= 0xff
+            with open(fit, 'wb') as fd:
+                fd.write(data)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            if cons.config.buildconfig.get('config_fit_chunked_hash'):
+                find_matching(output, 'Bad chunk hash value')
+            else:
+                find_matching(output, 'Bad hash value')
+            check_not_equal(kernel, kernel_out, 'Corrupt kernel loaded')
+            params['kernel_hash'] = ''
+
         # Kernel, FDT and Ramdisk all compressed
         with cons.log.section('(Kernel + FDT + Ramdisk) compressed'):
             params['compression'] = 'gzip'
@@ -0,0 +1,83 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Test that 'load -z' decompresses files made of several gzip members or zstd
+# frames, as produced by concatenating compressed files
+
+import gzip
+import os
+import pytest
+import u_boot_utils as util
+import zlib
+
+# Address to load to, well clear of U-Boot in sandbox
+LOAD_ADDR = 0x1000000
+
+def make_parts():
+    """Make some test data in three parts
+
+    Each part is larger than the 1MiB chunks that 'load -z' reads, so that
+    both the members and the chunks are split in various places.
+
+    Returns:
+        List of bytes objects
+    """
+    parts = []
+    for part in range(3):
+        data = ''.join('part %d line %d of a multi-stream file\n' %
+                       (part, i) for i in range(30000))
+        parts.append(data.encode('utf-8'))
+    return parts
+
+def check_load(cons, fname, expected):
+    """Load a compressed file with 'load -z' and check what comes out
+
+    Args:
+        cons: U-Boot console
+        fname: Compressed file to load
+        expected: Data it should decompress to
+    """
+    output = cons.run_command_list([
+        'load -z hostfs - %x %s' % (LOAD_ADDR, fname),
+        'printenv filesize',
+        'crc32 %x $filesize' % LOAD_ADDR])
+    assert 'filesize=%x' % len(expected) in output[1]
+    assert '==> %08x' % zlib.crc32(expected) in output[2]
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('image_decomp_stream')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_load_decomp_gzip(u_boot_console):
+    """Test 'load -z' with a file holding several gzip members"""
+    cons = u_boot_console
+    parts = make_parts()
+    fname = os.path.join(cons.config.build_dir, 'multi.gz')
+    with open(fname, 'wb') as fd:
+        for data in parts:
+            fd.write(gzip.compress(data))
+    check_load(cons, fname, b''.join(parts))
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('image_decomp_stream')
+@pytest.mark.buildconfigspec('zstd')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.requiredtool('zstd')
+def test_load_decomp_zstd(u_boot_console):
+    """Test 'load -z' with a file holding several zstd frames"""
+    cons = u_boot_console
+    parts = make_parts()
+    fname = os.path.join(cons.config.build_dir, 'multi.zst')
+    with open(fname, 'wb') as fd:
+        for i, data in enumerate(parts):
+            part_fname = '%s.%d' % (fname, i)
+            with open(part_fname, 'wb') as part_fd:
+                part_fd.write(data)
+            util.run_and_log(cons, ['zstd', '-q', '-f', part_fname])
+            with open(part_fname + '.zst', 'rb') as part_fd:
+                fd.write(part_fd.read())
+    check_load(cons, fname, b''.join(parts))
+
+    # Anything after the last frame which is not a frame is an error
+    with open(fname, 'ab') as fd:
+        fd.write(b'\xaa' * 16)
+    output = cons.run_command('load -z hostfs - %x %s' % (LOAD_ADDR, fname))
+    assert 'decompression failed' in output
@@ -3,6 +3,9 @@
 
 import os.path
 import pytest
+import struct
+import sys
+import u_boot_utils as util
 
 @pytest.mark.buildconfigspec('ut_dm')
 def test_ut_dm_init(u_boot_console):
@@ -21,6 +24,21 @@ def test_ut_dm_init(u_boot_console):
         with open(fn, 'wb') as fh:
             fh.write(data)
 
+    # Snapshot of the test device tree, as 'dtoc live' writes for U-Boot's
+    # own device tree. This is rebuilt each time, since test.dtb may change.
+    if u_boot_console.config.buildconfig.get('config_of_live_snapshot',
+                                              'n') == 'y':
+        build_dir = u_boot_console.config.build_dir
+        fn = u_boot_console.config.source_dir + '/test-live.bin'
+        cmd = ['env', 'PYTHONPATH=%s/scripts/dtc/pylibfdt' % build_dir,
+               u_boot_console.config.source_dir + '/tools/dtoc/dtoc',
+               '-d', build_dir + '/arch/sandbox/dts/test.dtb', '-o', fn,
+               '--ptr-size', str(struct.calcsize('P'))]
+        if sys.byteorder == 'big':
+            cmd.append('--big-endian')
+        cmd.append('live')
+        util.run_and_log(u_boot_console, cmd)
+
 def test_ut(u_boot_console, ut_subtest):
     """Execute a "ut" subtest.
 
@@ -40,6 +40,9 @@ TESTDATA = [
     ['sha256', '-pss', '-E -p 0x10000', False],
     ['sha256', '-pss', None, True],
     ['sha256', '-pss', '-E -p 0x10000', True],
+    ['sha256', '-ecdsa256', None, False],
+    ['sha256', '-ecdsa256', '-E -p 0x10000', False],
+    ['sha256', '-ecdsa384', None, False],
 ]
 
 @pytest.mark.boardspec('sandbox')
@@ -162,6 +165,20 @@ def test_vboot(u_boot_console, sha_algo, padding, sign_options, required):
         util.run_and_log(cons, 'openssl req -batch -new -x509 -key %s%s.key '
                          '-out %s%s.crt' % (tmpdir, name, tmpdir, name))
 
+    def create_ecdsa_pair(name, curve):
+        """Generate a new ECDSA key pair and certificate
+
+        Args:
+            name: Name of of the key (e.g. 'dev')
+            curve: Name of the curve (e.g. 'prime256v1')
+        """
+        util.run_and_log(cons, 'openssl ecparam -name %s -genkey -noout '
+                         '-out %s%s.key' % (curve, tmpdir, name))
+
+        # Create a certificate containing the public key
+        util.run_and_log(cons, 'openssl req -batch -new -x509 -key %s%s.key '
+                         '-out %s%s.crt' % (tmpdir, name, tmpdir, name))
+
     def test_with_algo(sha_algo, padding, sign_options):
         """Test verified boot with the given hash algorithm.
 
@@ -172,7 +189,8 @@ def test_vboot(u_boot_console, sha_algo, padding, sign_options, required):
             sha_algo: Either 'sha1' or 'sha256', to select the algorithm to
                     use.
             padding: Either '' or '-pss', to select the padding to use for the
-                    rsa signature algorithm.
+                    rsa signature algorithm, or '-ecdsa256' or '-ecdsa384' to
+                    sign with ECDSA instead.
             sign_options: Options to mkimage when signing a fit image.
         """
         # Compile our device tree files for kernel and U-Boot. These are
@@ -298,8 +316,15 @@ def test_vboot(u_boot_console, sha_algo, padding, sign_options, required):
     dtb = '%ssandbox-u-boot.dtb' % tmpdir
     sig_node = '/configurations/conf-1/signature'
 
-    create_rsa_pair('dev')
-    create_rsa_pair('prod')
+    if padding.startswith('-ecdsa'):
+        if not cons.config.buildconfig.get('config_ecdsa_verify'):
+            pytest.skip('ECDSA verification is not enabled')
+        curve = 'secp384r1' if padding == '-ecdsa384' else 'prime256v1'
+        create_ecdsa_pair('dev', curve)
+        create_ecdsa_pair('prod', curve)
+    else:
+        create_rsa_pair('dev')
+        create_rsa_pair('prod')
 
     # Create a number kernel image with zeroes
     with open('%stest-kernel.bin' % tmpdir, 'w') as fd:
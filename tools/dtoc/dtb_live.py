@@ -0,0 +1,305 @@
+#!/usr/bin/python
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright (C) 2020 Google, Inc
+#
+
+"""Device tree to live tree snapshot
+
+This unflattens a device tree binary at build time into the same struct
+device_node and struct property records that of_live_build() would create
+at run time, laid out for the target. U-Boot then only needs to fix up the
+pointers in the snapshot to use it. See struct of_live_snap_hdr in
+include/of_live.h for the format.
+
+The snapshot refers to property names and values in the .dtb it was made
+from, so it can only be used with that .dtb.
+"""
+
+import struct
+import zlib
+
+from patman import tools
+
+# Must match include/of_live.h
+SNAP_MAGIC = 0x4f464c56
+SNAP_VERSION = 1
+SNAP_RELOC_FDT = 1 << 31
+SNAP_HDR_FIELDS = 12
+
+FDT_MAGIC = 0xd00dfeed
+FDT_BEGIN_NODE = 1
+FDT_END_NODE = 2
+FDT_PROP = 3
+FDT_NOP = 4
+FDT_END = 9
+
+class LiveProp:
+    """A property, as found in the .dtb
+
+    Properties
+        name: Property name
+        name_offset: Offset of the name in the .dtb
+        value: Property value (bytes)
+        value_offset: Offset of the value in the .dtb, or None if the
+            property was made up (i.e. 'name')
+    """
+    def __init__(self, name, name_offset, value, value_offset):
+        self.name = name
+        self.name_offset = name_offset
+        self.value = value
+        self.value_offset = value_offset
+
+
+class LiveNode:
+    """A node, set up as unflatten_dt_node() does
+
+    Properties
+        name: Node name including any unit address
+        full_name: Full path of the node
+        props: List of LiveProp in .dtb order
+        subnodes: List of LiveNode in .dtb order
+    """
+    def __init__(self, name, parent):
+        self.name = name
+        if not parent:
+            self.full_name = '/'
+        elif parent.full_name == '/':
+            self.full_name = '/' + name
+        else:
+            self.full_name = parent.full_name + '/' + name
+        self.props = []
+        self.subnodes = []
+
+    def get_prop(self, name):
+        """Get the first property with the given name, or None"""
+        for prop in self.props:
+            if prop.name == name:
+                return prop
+        return None
+
+    def finish(self):
+        """Add a 'name' property if needed, as U-Boot does"""
+        if not self.get_prop('name'):
+            value = self.name.split('@')[0].encode('utf-8') + b'\0'
+            self.props.append(LiveProp('name', None, value, None))
+
+    def get_phandle(self):
+        """Get the node's phandle, as unflatten_dt_node() works it out"""
+        phandle = 0
+        for prop in self.props:
+            if prop.name in ('phandle', 'linux,phandle') and not phandle:
+                phandle = struct.unpack('>I', prop.value[:4])[0]
+            elif prop.name == 'ibm,phandle':
+                phandle = struct.unpack('>I', prop.value[:4])[0]
+        return phandle
+
+
+def get_string(data, offset):
+    """Get a nul-terminated string from the .dtb"""
+    end = data.index(b'\0', offset)
+    return data[offset:end].decode('utf-8')
+
+def scan_fdt(data):
+    """Scan a .dtb into a tree of LiveNode objects
+
+    Args:
+        data: Contents of the .dtb
+
+    Returns:
+        Root LiveNode
+    """
+    (magic, _, off_struct, off_strings) = struct.unpack('>IIII', data[:16])
+    if magic != FDT_MAGIC:
+        raise ValueError('Not a device tree binary (magic %#x)' % magic)
+    pos = off_struct
+    stack = []
+    root = None
+    while True:
+        tag = struct.unpack('>I', data[pos:pos + 4])[0]
+        pos += 4
+        if tag == FDT_BEGIN_NODE:
+            end = data.index(b'\0', pos)
+            node = LiveNode(data[pos:end].decode('utf-8'),
+                            stack[-1] if stack else None)
+            pos = (end + 1 + 3) & ~3
+            if stack:
+                stack[-1].subnodes.append(node)
+            else:
+                root = node
+            stack.append(node)
+        elif tag == FDT_END_NODE:
+            stack.pop().finish()
+        elif tag == FDT_PROP:
+            (size, nameoff) = struct.unpack('>II', data[pos:pos + 8])
+            pos += 8
+            name_offset = off_strings + nameoff
+            stack[-1].props.append(LiveProp(get_string(data, name_offset),
+                                            name_offset, data[pos:pos + size],
+                                            pos))
+            pos = (pos + size + 3) & ~3
+        elif tag == FDT_NOP:
+            pass
+        elif tag == FDT_END:
+            break
+        else:
+            raise ValueError('Bad tag %d at offset %#x' % (tag, pos - 4))
+    if not root or stack:
+        raise ValueError('Device tree binary is truncated')
+    return root
+
+
+class LiveWriter:
+    """Writes a snapshot in the same order as of_live_snap_create()
+
+    The snapshot is a header, then all the nodes, then all the properties,
+    then strings and values which are not in the .dtb (each aligned to 4
+    bytes), then the relocation table.
+
+    Properties
+        _ptr_size: Size of a pointer on the target (4 or 8)
+        _endian: '<' or '>' for the target's byte order
+        _node_size: sizeof(struct device_node) on the target
+        _prop_size: sizeof(struct property) on the target
+        _buf: Snapshot, as a bytearray
+        _nodes: Offset of the first node
+        _props: Offset of the first property
+        _strs_base: Offset of the area for strings and values
+        _strs: bytearray holding strings and values not in the .dtb
+        _relocs: List of relocations
+        _node_count: Number of nodes written so far
+        _prop_count: Number of properties written so far
+    """
+    def __init__(self, ptr_size, big_endian):
+        if ptr_size not in (4, 8):
+            raise ValueError('Unsupported pointer size %d' % ptr_size)
+        self._ptr_size = ptr_size
+        self._endian = '>' if big_endian else '<'
+
+        # struct device_node has seven pointers and a u32, padded to a
+        # pointer; struct property has three pointers and an int
+        self._node_size = ptr_size * 8
+        self._prop_size = ptr_size * 4
+        self._buf = None
+        self._nodes = None
+        self._props = None
+        self._strs_base = None
+        self._strs = bytearray()
+        self._relocs = []
+        self._node_count = 0
+        self._prop_count = 0
+
+    def _put(self, fmt, offset, value):
+        struct.pack_into(self._endian + fmt, self._buf, offset, value)
+
+    def _reloc(self, ptr_offset, value, flags=0):
+        """Set a pointer to an offset, and add a relocation for it"""
+        self._put('Q' if self._ptr_size == 8 else 'I', ptr_offset, value)
+        self._relocs.append(ptr_offset | flags)
+
+    def _data(self, ptr_offset, value, fdt_offset):
+        """Point to some data, in the .dtb if possible, else the snapshot"""
+        if fdt_offset is not None:
+            self._reloc(ptr_offset, fdt_offset, SNAP_RELOC_FDT)
+            return
+        self._reloc(ptr_offset, self._strs_base + len(self._strs))
+        self._strs += value
+        self._strs += bytes(-len(value) & 3)
+
+    def _str(self, ptr_offset, value):
+        self._data(ptr_offset, value.encode('utf-8') + b'\0', None)
+
+    def _node(self, node, parent):
+        """Write a node and its subnodes, returning its offset"""
+        ptr = self._ptr_size
+        offset = self._nodes + self._node_count * self._node_size
+        self._node_count += 1
+
+        self._put('I', offset + ptr * 2, node.get_phandle())
+        name = node.get_prop('name')
+        self._data(offset, name.value, name.value_offset)
+        device_type = node.get_prop('device_type')
+        if device_type:
+            self._data(offset + ptr, device_type.value,
+                       device_type.value_offset)
+        else:
+            self._str(offset + ptr, '<NULL>')
+        self._str(offset + ptr * 3, node.full_name)
+        if parent:
+            self._reloc(offset + ptr * 5, parent)
+
+        link = offset + ptr * 4
+        for prop in node.props:
+            prop_offset = self._props + self._prop_count * self._prop_size
+            self._prop_count += 1
+            self._put('i', prop_offset + ptr, len(prop.value))
+            self._reloc(link, prop_offset)
+            if prop.name_offset is None:
+                self._str(prop_offset, prop.name)
+            else:
+                self._reloc(prop_offset, prop.name_offset, SNAP_RELOC_FDT)
+            self._data(prop_offset + ptr * 2, prop.value, prop.value_offset)
+            link = prop_offset + ptr * 3
+
+        link = offset + ptr * 6
+        for subnode in node.subnodes:
+            sub_offset = self._node(subnode, offset)
+            self._reloc(link, sub_offset)
+            link = sub_offset + ptr * 7
+
+        return offset
+
+    def write(self, data):
+        """Write a snapshot of a .dtb
+
+        Args:
+            data: Contents of the .dtb
+
+        Returns:
+            Snapshot, as bytes
+        """
+        root = scan_fdt(data)
+        node_count = 0
+        prop_count = 0
+        todo = [root]
+        while todo:
+            node = todo.pop()
+            node_count += 1
+            prop_count += len(node.props)
+            todo += node.subnodes
+
+        hdr_size = SNAP_HDR_FIELDS * 4
+        self._nodes = (hdr_size + self._ptr_size - 1) & ~(self._ptr_size - 1)
+        self._props = self._nodes + node_count * self._node_size
+        self._strs_base = self._props + prop_count * self._prop_size
+        self._buf = bytearray(self._strs_base)
+        root_offset = self._node(root, 0)
+
+        relocs = self._strs_base + len(self._strs)
+        size = relocs + len(self._relocs) * 4
+        fdt_size = struct.unpack('>I', data[4:8])[0]
+        hdr = struct.pack(self._endian + 'I' * SNAP_HDR_FIELDS,
+                          SNAP_MAGIC, SNAP_VERSION, size, 0, self._ptr_size,
+                          self._node_size, self._prop_size, fdt_size,
+                          zlib.crc32(data[:fdt_size]) & 0xffffffff,
+                          root_offset, relocs, len(self._relocs))
+        self._buf[:hdr_size] = hdr
+        self._buf += self._strs
+        self._buf += struct.pack(self._endian + 'I' * len(self._relocs),
+                                 *self._relocs)
+        return bytes(self._buf)
+
+
+def run_live(dtb_file, output, ptr_size, big_endian):
+    """Write a live tree snapshot of a .dtb file
+
+    Args:
+        dtb_file: Filename of .dtb file to process
+        output: Name of output file
+        ptr_size: Size of a pointer on the target (4 or 8)
+        big_endian: True if the target is big-endian
+    """
+    if not output or output == '-':
+        raise ValueError('Please specify an output file for the snapshot')
+    data = tools.ReadFile(dtb_file)
+    tools.WriteFile(output, LiveWriter(ptr_size, big_endian).write(data))
@@ -39,6 +39,7 @@ sys.path.insert(0, 'scripts/dtc/pylibfdt')
 sys.path.insert(0, os.path.join(our_path,
                 '../../build-sandbox_spl/scripts/dtc/pylibfdt'))
 
+from dtoc import dtb_live
 from dtoc import dtb_platdata
 from patman import test_util
 
@@ -93,6 +94,10 @@ parser.add_option('--include-disabled', action='store_true',
                   help='Include disabled nodes')
 parser.add_option('-o', '--output', action='store', default='-',
                   help='Select output filename')
+parser.add_option('--ptr-size', type=int, default=8,
+                  help='Pointer size of the target, for a live tree snapshot')
+parser.add_option('--big-endian', action='store_true',
+                  help='Target is big-endian, for a live tree snapshot')
 parser.add_option('-P', '--processes', type=int,
                   help='set number of processes to use for running tests')
 parser.add_option('-t', '--test', action='store_true', dest='test',
@@ -109,6 +114,10 @@ if options.test:
 elif options.test_coverage:
     RunTestCoverage()
 
+elif args and args[0] == 'live':
+    dtb_live.run_live(options.dtb_file, options.output, options.ptr_size,
+                      options.big_endian)
+
 else:
     dtb_platdata.run_steps(args, options.dtb_file, options.include_disabled,
                            options.output)
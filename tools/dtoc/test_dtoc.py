@@ -13,7 +13,9 @@ import collections
 import os
 import struct
 import unittest
+import zlib
 
+from dtoc import dtb_live
 from dtoc import dtb_platdata
 from dtb_platdata import conv_name_to_c
 from dtb_platdata import get_compat_name
@@ -709,3 +711,84 @@ U_BOOT_DEVICE(spl_test2) = {
             dtb_platdata.run_steps(['invalid-cmd'], dtb_file, False, output)
         self.assertIn("Unknown command 'invalid-cmd': (use: struct, platdata)",
                       str(e.exception))
+
+    def _CheckLive(self, dtb_file, ptr_size, big_endian):
+        """Check a live tree snapshot against the .dtb it was made from
+
+        Args:
+            dtb_file: Filename of .dtb file to snapshot
+            ptr_size: Pointer size to use (4 or 8)
+            big_endian: True to write a big-endian snapshot
+        """
+        output = tools.GetOutputFilename('output')
+        dtb_live.run_live(dtb_file, output, ptr_size, big_endian)
+        data = bytearray(tools.ReadFile(output))
+        fdt_data = tools.ReadFile(dtb_file)
+        endian = '>' if big_endian else '<'
+        ptr = 'Q' if ptr_size == 8 else 'I'
+        (magic, version, size, flags, hdr_ptr_size, node_size, prop_size,
+         fdt_size, fdt_crc32, root, reloc, reloc_count) = struct.unpack(
+             endian + '12I', data[:48])
+        self.assertEqual(dtb_live.SNAP_MAGIC, magic)
+        self.assertEqual(dtb_live.SNAP_VERSION, version)
+        self.assertEqual(len(data), size)
+        self.assertEqual(0, flags)
+        self.assertEqual(ptr_size, hdr_ptr_size)
+        self.assertEqual(ptr_size * 8, node_size)
+        self.assertEqual(ptr_size * 4, prop_size)
+        self.assertEqual(len(fdt_data), fdt_size)
+        self.assertEqual(zlib.crc32(fdt_data), fdt_crc32)
+
+        # Fix up the pointers as U-Boot does, with the .dtb after the snapshot
+        for rel in struct.unpack_from(endian + '%dI' % reloc_count, data,
+                                      reloc):
+            offset = rel & ~dtb_live.SNAP_RELOC_FDT
+            base = size if rel & dtb_live.SNAP_RELOC_FDT else 0
+            value = struct.unpack_from(endian + ptr, data, offset)[0]
+            struct.pack_into(endian + ptr, data, offset, value + base)
+        mem = bytes(data) + fdt_data
+
+        def _GetPtr(offset):
+            return struct.unpack_from(endian + ptr, mem, offset)[0]
+
+        def _GetStr(offset):
+            return mem[offset:mem.index(b'\0', offset)].decode('utf-8')
+
+        def _CheckNode(offset, node, parent):
+            name = '' if node.path == '/' else node.name.split('@')[0]
+            self.assertEqual(name, _GetStr(_GetPtr(offset)))
+            self.assertEqual('<NULL>', _GetStr(_GetPtr(offset + ptr_size)))
+            self.assertEqual(node.path, _GetStr(_GetPtr(offset + ptr_size * 3)))
+            self.assertEqual(parent, _GetPtr(offset + ptr_size * 5))
+
+            names = []
+            prop = _GetPtr(offset + ptr_size * 4)
+            while prop:
+                names.append(_GetStr(_GetPtr(prop)))
+                prop = _GetPtr(prop + ptr_size * 3)
+            self.assertEqual(list(node.props.keys()) + ['name'], names)
+
+            child = _GetPtr(offset + ptr_size * 6)
+            for subnode in node.subnodes:
+                _CheckNode(child, subnode, offset)
+                child = _GetPtr(child + ptr_size * 7)
+            self.assertEqual(0, child)
+
+        _CheckNode(root, fdt.FdtScan(dtb_file).GetRoot(), 0)
+
+    def test_live(self):
+        """Test writing a live tree snapshot"""
+        dtb_file = get_dtb_file('dtoc_test_simple.dts')
+        self._CheckLive(dtb_file, 8, False)
+        self._CheckLive(dtb_file, 4, True)
+
+    def test_live_bad(self):
+        """Test live tree snapshot errors"""
+        dtb_file = get_dtb_file('dtoc_test_simple.dts')
+        with self.assertRaises(ValueError) as e:
+            dtb_live.run_live(dtb_file, '-', 8, False)
+        self.assertIn('Please specify an output file', str(e.exception))
+        with self.assertRaises(ValueError) as e:
+            dtb_live.run_live(dtb_file, tools.GetOutputFilename('output'), 2,
+                              False)
+        self.assertIn('Unsupported pointer size 2', str(e.exception))
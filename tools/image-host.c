@@ -44,6 +44,71 @@ static int fit_set_hash_value(void *fit, int noffset, uint8_t *value,
 	return 0;
 }
 
+/**
+ * fit_set_chunk_values() - add a table of per-chunk hashes to a hash node
+ *
+ * If the hash node has a 'chunk-size' property, the data is split into pieces
+ * of that size (the last may be shorter) and the hash of each piece is stored
+ * in order in the 'chunk-value' property. This lets U-Boot check each piece of
+ * the image as it is loaded.
+ *
+ * @fit:	pointer to the FIT format image header
+ * @noffset:	hash node offset
+ * @algo:	hash algorithm to use
+ * @data:	data to process
+ * @size:	size of data in bytes
+ * @return 0 if ok (including when there is no 'chunk-size'), -ve on error
+ */
+static int fit_set_chunk_values(void *fit, int noffset, const char *algo,
+				const void *data, size_t size)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	const fdt32_t *prop;
+	size_t chunk_size;
+	size_t offset;
+	uint8_t *table;
+	int value_len;
+	int count;
+	int ret;
+	int len;
+
+	prop = fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, &len);
+	if (!prop)
+		return 0;
+	if (len != sizeof(*prop) || !fdt32_to_cpu(*prop)) {
+		printf("Invalid '%s' property for '%s' node\n",
+		       FIT_CHUNK_SIZE_PROP, fit_get_name(fit, noffset, NULL));
+		return -EINVAL;
+	}
+	chunk_size = fdt32_to_cpu(*prop);
+
+	if (calculate_hash(data, 0, algo, value, &value_len))
+		return -EPROTONOSUPPORT;
+	count = (size + chunk_size - 1) / chunk_size;
+	table = malloc(count * value_len + 1);
+	if (!table)
+		return -ENOMEM;
+
+	for (offset = 0; offset < size; offset += chunk_size) {
+		len = size - offset < chunk_size ? size - offset : chunk_size;
+		calculate_hash(data + offset, len, algo,
+			       table + offset / chunk_size * value_len,
+			       &value_len);
+	}
+
+	ret = fdt_setprop(fit, noffset, FIT_CHUNK_VALUE_PROP, table,
+			  count * value_len);
+	free(table);
+	if (ret) {
+		printf("Can't set hash '%s' property for '%s' node(%s)\n",
+		       FIT_CHUNK_VALUE_PROP, fit_get_name(fit, noffset, NULL),
+		       fdt_strerror(ret));
+		return ret == -FDT_ERR_NOSPACE ? -ENOSPC : -EIO;
+	}
+
+	return 0;
+}
+
 /**
  * fit_image_process_hash - Process a single subnode of the images/ node
  *
@@ -80,6 +145,14 @@ static int fit_image_process_hash(void *fit, const char *image_name,
 		return -EPROTONOSUPPORT;
 	}
 
+	/* This moves properties around, so do it before @algo is stale */
+	ret = fit_set_chunk_values(fit, noffset, algo, data, size);
+	if (ret) {
+		printf("Can't set chunk hash values for '%s' hash node in '%s' image node\n",
+		       node_name, image_name);
+		return ret;
+	}
+
 	ret = fit_set_hash_value(fit, noffset, value, value_len);
 	if (ret) {
 		printf("Can't set hash value for '%s' hash node in '%s' image node\n",